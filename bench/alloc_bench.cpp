@@ -0,0 +1,194 @@
+/**
+ * 请求路径堆分配计数
+ *
+ * 替换全局 operator new 统计分配次数，按 main.cpp 中的路由流程
+ * （HttpParser 解析 → JSON 解析 → 请求结构体 → 业务处理 → 序列化 → 构造响应）
+ * 重复执行同一请求，输出稳定状态下每个请求的堆分配次数。
+ * 存储层持有的数据（DataPoint 等）必须独立于请求分配区，这部分单独列出
+ *
+ * 用法：alloc_bench [--iterations N] [--max-allocs N]
+ *       指定 --max-allocs 时，任一请求路径（不含存储写入）超过该值则返回非 0
+ */
+#include "business/DeviceManager.hpp"
+#include "business/ReportHandler.hpp"
+#include "net/HttpParser.hpp"
+#include "storage/MemoryStore.hpp"
+#include "utils/JsonParser.hpp"
+#include "utils/RequestArena.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(std::size_t size) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// 分别统计：整个请求、其中的存储写入
+struct Counts {
+    uint64_t total = 0;
+    uint64_t store = 0;
+};
+
+class CountingStore : public StoreInterface {
+public:
+    explicit CountingStore(StoreInterface& inner) : inner_(inner) {}
+
+    void append(InternId deviceId, const DataPoint& point) override {
+        uint64_t before = g_allocs.load();
+        inner_.append(deviceId, point);
+        storeAllocs += g_allocs.load() - before;
+    }
+    std::vector<DataPoint> queryLatest(InternId deviceId, std::size_t limit) const override {
+        uint64_t before = g_allocs.load();
+        auto r = inner_.queryLatest(deviceId, limit);
+        storeAllocs += g_allocs.load() - before;
+        return r;
+    }
+    void appendRequirement(const Requirement& req) override {
+        uint64_t before = g_allocs.load();
+        inner_.appendRequirement(req);
+        storeAllocs += g_allocs.load() - before;
+    }
+    RequirementQueryResult queryRequirements(int page, int limit, int willingToPay,
+                                             const std::string& keyword) const override {
+        uint64_t before = g_allocs.load();
+        auto r = inner_.queryRequirements(page, limit, willingToPay, keyword);
+        storeAllocs += g_allocs.load() - before;
+        return r;
+    }
+
+    mutable uint64_t storeAllocs = 0;
+
+private:
+    StoreInterface& inner_;
+};
+
+// 与 main.cpp 中对应路由的处理流程一致
+void handleReport(ReportHandler& handler, const std::string& raw, std::string& response) {
+    RequestArena arena;
+    std::pmr::memory_resource* mr = arena.resource();
+    std::pmr::string body(mr);
+    HttpRequest req(mr);
+    if (!HttpParser::parseRequest(raw, req)) std::abort();
+    JsonValue json = JsonParser::parse(req.body, mr);
+    ReportRequest reportReq(mr);
+    if (!ReportHandler::parseReportRequest(json, reportReq)) std::abort();
+    JsonParser::stringifyTo(handler.handleReport(reportReq, mr), body);
+    HttpParser::buildResponse(response, 200, body);
+}
+
+void handleQuery(ReportHandler& handler, const std::string& raw, std::string& response) {
+    RequestArena arena;
+    std::pmr::memory_resource* mr = arena.resource();
+    std::pmr::string body(mr);
+    HttpRequest req(mr);
+    if (!HttpParser::parseRequest(raw, req)) std::abort();
+    RequirementQueryRequest queryReq(mr);
+    ReportHandler::parseRequirementQueryRequest(req.query, queryReq);
+    std::pmr::string etag = handler.requirementQueryETag(mr);
+    if (HttpParser::notModified(req, etag, response)) return;
+    handler.handleRequirementQueryTo(queryReq, body, mr);
+    HttpParser::buildCacheableResponse(response, body, etag, mr);
+}
+
+template <typename Fn>
+Counts measure(CountingStore& store, int iterations, Fn&& fn) {
+    std::string response;
+    // 预热：设备注册、存储容器扩容、响应缓冲区扩容
+    for (int i = 0; i < 100; ++i) fn(response);
+    store.storeAllocs = 0;
+    uint64_t before = g_allocs.load();
+    for (int i = 0; i < iterations; ++i) fn(response);
+    Counts c;
+    c.total = g_allocs.load() - before;
+    c.store = store.storeAllocs;
+    return c;
+}
+
+void print(const char* name, const Counts& c, int iterations) {
+    double total = static_cast<double>(c.total) / iterations;
+    double store = static_cast<double>(c.store) / iterations;
+    std::printf("%-28s %10.2f %10.2f %10.2f\n", name, total, store, total - store);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 10000;
+    long maxAllocs = -1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--iterations") == 0) iterations = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-allocs") == 0) maxAllocs = std::atol(argv[i + 1]);
+    }
+    if (iterations <= 0) iterations = 10000;
+
+    MemoryStore memoryStore;
+    CountingStore store(memoryStore);
+    DeviceManager deviceMgr;
+    ReportHandler handler(store, deviceMgr);
+    // 与默认配置一致（[cache] requirement_query_mb = 16）；另一个不带缓存，统计每次写入后首个查询的开销
+    handler.enableRequirementCache(16 * 1024 * 1024);
+    ReportHandler uncachedHandler(store, deviceMgr);
+
+    const std::string reportBody =
+        "{\"device_id\":\"DEV_0001\",\"timestamp\":1700000000,"
+        "\"metrics\":{\"temperature\":23.5,\"humidity\":61.2,\"voltage\":3.3}}";
+    const std::string reportRaw =
+        "POST /api/v1/report HTTP/1.1\r\nHost: localhost:8080\r\nUser-Agent: alloc_bench\r\n"
+        "Content-Type: application/json\r\nContent-Length: " + std::to_string(reportBody.size()) +
+        "\r\n\r\n" + reportBody;
+    const std::string queryRaw =
+        "GET /api/v1/requirement/query?page=1&limit=5&keyword=bench HTTP/1.1\r\n"
+        "Host: localhost:8080\r\nUser-Agent: alloc_bench\r\n\r\n";
+
+    for (int i = 0; i < 20; ++i) {
+        Requirement req;
+        req.title = "bench requirement " + std::to_string(i);
+        req.content = "requirement used by alloc_bench";
+        memoryStore.appendRequirement(req);
+    }
+
+    std::printf("heap allocations per request (%d iterations)\n\n", iterations);
+    std::printf("%-28s %10s %10s %10s\n", "path", "total", "store", "request");
+
+    Counts report = measure(store, iterations,
+        [&](std::string& response) { handleReport(handler, reportRaw, response); });
+    print("POST /api/v1/report", report, iterations);
+
+    Counts query = measure(store, iterations,
+        [&](std::string& response) { handleQuery(handler, queryRaw, response); });
+    print("GET /api/v1/requirement/query", query, iterations);
+
+    Counts queryMiss = measure(store, iterations,
+        [&](std::string& response) { handleQuery(uncachedHandler, queryRaw, response); });
+    print("  (cache miss)", queryMiss, iterations);
+
+    if (maxAllocs >= 0) {
+        for (const Counts* c : {&report, &query, &queryMiss}) {
+            // 按总数比较，避免整除截断（每请求 1.9 次不应通过上限 1）
+            if (c->total - c->store > static_cast<uint64_t>(maxAllocs) * static_cast<uint64_t>(iterations)) {
+                std::fprintf(stderr, "request path exceeds %ld allocations per request\n", maxAllocs);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,529 @@
+/**
+ * device_server 端到端 HTTP 压测工具
+ *
+ * 多线程、每线程一个 epoll 循环，按权重回放设备上报 / 查询与需求上报 / 查询接口。
+ * 支持长连接或每请求新建连接、流水线深度、闭环（收到响应立即发下一个）与
+ * 开环恒定速率两种模式。开环模式下延迟从“计划发送时间”算起，服务端变慢导致的
+ * 排队会计入延迟（修正 coordinated omission）；闭环模式只反映已发出请求的响应时间。
+ * 随机数按 --seed 与线程号确定，相同参数可复现相同的请求序列。
+ *
+ * 用法：device_bench [--host H] [--port P] [--threads N] [--connections N]
+ *                    [--duration-s N] [--warmup-s N] [--pipeline N] [--rate R]
+ *                    [--no-keepalive] [--mix report=6,query=2,req-report=1,req-query=1]
+ *                    [--devices N] [--seed N]
+ */
+#include "utils/Metrics.hpp"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum Route { DEVICE_REPORT, DEVICE_QUERY, REQUIREMENT_REPORT, REQUIREMENT_QUERY, ROUTE_COUNT };
+
+const char* const kRouteNames[ROUTE_COUNT] = {"report", "query", "req-report", "req-query"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int threads = 2;
+    int connections = 16;
+    int durationS = 10;
+    int warmupS = 1;
+    int pipeline = 1;
+    double rate = 0;  // 总请求速率（req/s），0 为闭环
+    bool keepAlive = true;
+    int weights[ROUTE_COUNT] = {6, 2, 1, 1};
+    int devices = 1000;
+    uint64_t seed = 1;
+};
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct ThreadStats {
+    uint64_t responses[ROUTE_COUNT] = {};
+    uint64_t non2xx = 0;
+    uint64_t socketErrors = 0;
+    uint64_t bytesIn = 0;
+};
+
+struct InFlight {
+    uint64_t intendedNs;  // 开环为计划发送时间，闭环为实际发送时间
+    Route route;
+};
+
+struct ClientConn {
+    int fd = -1;
+    bool connected = false;
+    std::string out;
+    std::size_t outOffset = 0;
+    std::string in;
+    std::deque<InFlight> inflight;
+    uint64_t nextIntendedNs = 0;  // 开环：下一个请求的计划发送时间
+    uint64_t intervalNs = 0;      // 开环：本连接的发送间隔
+    bool wantWrite = false;
+};
+
+/**
+ * 单个压测线程：管理若干连接，生成请求并解析响应
+ */
+class Worker {
+public:
+    Worker(const Options& opt, int index, int connections, Histogram& latency,
+           const std::atomic<bool>& recording, const std::atomic<bool>& stopping)
+        : opt_(opt), rng_(opt.seed * 1000003 + static_cast<uint64_t>(index)),
+          conns_(static_cast<std::size_t>(connections)), latency_(latency),
+          recording_(recording), stopping_(stopping) {
+        for (int w : opt.weights) totalWeight_ += w;
+    }
+
+    void run(uint64_t startNs) {
+        epollFd_ = epoll_create1(0);
+        double perConnRate = opt_.rate / (static_cast<double>(opt_.connections));
+        for (std::size_t i = 0; i < conns_.size(); ++i) {
+            ClientConn& c = conns_[i];
+            if (opt_.rate > 0) {
+                c.intervalNs = static_cast<uint64_t>(1e9 / perConnRate);
+                // 各连接的发送时刻错开，避免同时突发
+                c.nextIntendedNs = startNs + c.intervalNs * i / conns_.size();
+            }
+            connect(c);
+        }
+
+        std::vector<epoll_event> events(conns_.size() + 1);
+        while (!stopping_.load(std::memory_order_relaxed)) {
+            uint64_t now = nowNs();
+            for (auto& c : conns_) {
+                if (c.fd < 0) connect(c);
+                if (c.connected) fillRequests(c, now);
+            }
+            int n = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), waitTimeoutMs());
+            for (int i = 0; i < n; ++i) {
+                ClientConn& c = conns_[events[i].data.u64];
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    fail(c);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) onWritable(c);
+                if (c.fd >= 0 && (events[i].events & EPOLLIN)) onReadable(c);
+            }
+        }
+        for (auto& c : conns_) {
+            if (c.fd >= 0) ::close(c.fd);
+        }
+        ::close(epollFd_);
+    }
+
+    const ThreadStats& stats() const { return stats_; }
+
+private:
+    // 开环：等到最近一个计划发送时刻；闭环：事件驱动
+    int waitTimeoutMs() const {
+        if (opt_.rate <= 0) return 10;
+        uint64_t next = UINT64_MAX;
+        for (const auto& c : conns_) {
+            if (c.connected && c.inflight.size() < static_cast<std::size_t>(opt_.pipeline)) {
+                next = std::min(next, c.nextIntendedNs);
+            }
+        }
+        if (next == UINT64_MAX) return 10;
+        uint64_t now = nowNs();
+        if (next <= now) return 0;
+        return static_cast<int>(std::min<uint64_t>((next - now) / 1000000, 10));
+    }
+
+    void connect(ClientConn& c) {
+        c.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c.fd < 0) return;
+        int one = 1;
+        ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(opt_.port));
+        inet_pton(AF_INET, opt_.host.c_str(), &addr.sin_addr);
+        int rc = ::connect(c.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        if (rc < 0 && errno != EINPROGRESS) {
+            ++stats_.socketErrors;
+            ::close(c.fd);
+            c.fd = -1;
+            return;
+        }
+        c.connected = rc == 0;
+        c.wantWrite = !c.connected;
+        epoll_event ev{};
+        ev.events = EPOLLIN | (c.wantWrite ? EPOLLOUT : 0u);
+        ev.data.u64 = static_cast<uint64_t>(&c - conns_.data());
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, c.fd, &ev);
+    }
+
+    void closeConn(ClientConn& c) {
+        if (c.fd >= 0) ::close(c.fd);
+        c.fd = -1;
+        c.connected = false;
+        c.out.clear();
+        c.outOffset = 0;
+        c.in.clear();
+        c.wantWrite = false;
+    }
+
+    // 连接出错：未完成的请求计为 socket 错误，下一轮重连
+    void fail(ClientConn& c) {
+        stats_.socketErrors += c.inflight.empty() ? 1 : c.inflight.size();
+        c.inflight.clear();
+        closeConn(c);
+    }
+
+    void setWantWrite(ClientConn& c, bool want) {
+        if (c.wantWrite == want) return;
+        c.wantWrite = want;
+        epoll_event ev{};
+        ev.events = EPOLLIN | (want ? EPOLLOUT : 0u);
+        ev.data.u64 = static_cast<uint64_t>(&c - conns_.data());
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    void fillRequests(ClientConn& c, uint64_t now) {
+        std::size_t depth = opt_.keepAlive ? static_cast<std::size_t>(opt_.pipeline) : 1;
+        bool added = false;
+        while (c.inflight.size() < depth) {
+            uint64_t intended = now;
+            if (opt_.rate > 0) {
+                if (c.nextIntendedNs > now) break;
+                intended = c.nextIntendedNs;
+                c.nextIntendedNs += c.intervalNs;
+            }
+            Route route = pickRoute();
+            appendRequest(c.out, route);
+            c.inflight.push_back({intended, route});
+            added = true;
+        }
+        if (added) flush(c);
+    }
+
+    Route pickRoute() {
+        int r = static_cast<int>(rng_() % static_cast<uint64_t>(totalWeight_));
+        for (int i = 0; i < ROUTE_COUNT; ++i) {
+            if (r < opt_.weights[i]) return static_cast<Route>(i);
+            r -= opt_.weights[i];
+        }
+        return DEVICE_REPORT;
+    }
+
+    void appendRequest(std::string& out, Route route) {
+        char body[256];
+        int bodyLen = 0;
+        unsigned device = static_cast<unsigned>(rng_() % static_cast<uint64_t>(opt_.devices));
+        const char* connection = opt_.keepAlive ? "keep-alive" : "close";
+        char head[512];
+        int headLen = 0;
+        switch (route) {
+            case DEVICE_REPORT:
+                bodyLen = std::snprintf(body, sizeof(body),
+                    "{\"device_id\":\"bench-%u\",\"timestamp\":%llu,\"metrics\":{\"temperature\":%.1f,\"humidity\":%.1f}}",
+                    device, static_cast<unsigned long long>(++sequence_),
+                    20.0 + static_cast<double>(rng_() % 200) / 10.0, static_cast<double>(rng_() % 1000) / 10.0);
+                headLen = std::snprintf(head, sizeof(head),
+                    "POST /api/v1/report HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n"
+                    "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n",
+                    opt_.host.c_str(), connection, bodyLen);
+                break;
+            case DEVICE_QUERY:
+                headLen = std::snprintf(head, sizeof(head),
+                    "GET /api/v1/query?device_id=bench-%u&limit=10 HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                    device, opt_.host.c_str(), connection);
+                break;
+            case REQUIREMENT_REPORT:
+                bodyLen = std::snprintf(body, sizeof(body),
+                    "{\"title\":\"bench requirement %llu\",\"content\":\"generated by device_bench\","
+                    "\"willing_to_pay\":%d,\"contact\":\"bench@example.com\"}",
+                    static_cast<unsigned long long>(++sequence_), static_cast<int>(rng_() % 2));
+                headLen = std::snprintf(head, sizeof(head),
+                    "POST /api/v1/requirement/report HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n"
+                    "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n",
+                    opt_.host.c_str(), connection, bodyLen);
+                break;
+            default:
+                headLen = std::snprintf(head, sizeof(head),
+                    "GET /api/v1/requirement/query?page=1&limit=20 HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                    opt_.host.c_str(), connection);
+                break;
+        }
+        out.append(head, static_cast<std::size_t>(headLen));
+        out.append(body, static_cast<std::size_t>(bodyLen));
+    }
+
+    void flush(ClientConn& c) {
+        while (c.outOffset < c.out.size()) {
+            ssize_t n = ::send(c.fd, c.out.data() + c.outOffset, c.out.size() - c.outOffset, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    setWantWrite(c, true);
+                    return;
+                }
+                fail(c);
+                return;
+            }
+            c.outOffset += static_cast<std::size_t>(n);
+        }
+        c.out.clear();
+        c.outOffset = 0;
+        setWantWrite(c, false);
+    }
+
+    void onWritable(ClientConn& c) {
+        if (!c.connected) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            ::getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                fail(c);
+                return;
+            }
+            c.connected = true;
+            setWantWrite(c, false);
+            fillRequests(c, nowNs());
+            return;
+        }
+        flush(c);
+    }
+
+    void onReadable(ClientConn& c) {
+        char buf[65536];
+        while (true) {
+            ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                stats_.bytesIn += static_cast<uint64_t>(n);
+                c.in.append(buf, static_cast<std::size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            // 对端关闭
+            parseResponses(c);
+            fail(c);
+            return;
+        }
+        parseResponses(c);
+        if (!opt_.keepAlive && c.inflight.empty() && c.fd >= 0) {
+            closeConn(c);
+        }
+    }
+
+    void parseResponses(ClientConn& c) {
+        std::size_t pos = 0;
+        while (!c.inflight.empty()) {
+            std::size_t headerEnd = c.in.find("\r\n\r\n", pos);
+            if (headerEnd == std::string::npos) break;
+            std::size_t contentLength = 0;
+            std::size_t lineStart = c.in.find("\r\n", pos) + 2;
+            while (lineStart < headerEnd) {
+                std::size_t lineEnd = c.in.find("\r\n", lineStart);
+                if (lineEnd - lineStart > 15 && strncasecmp(c.in.data() + lineStart, "content-length:", 15) == 0) {
+                    contentLength = std::strtoull(c.in.c_str() + lineStart + 15, nullptr, 10);
+                }
+                lineStart = lineEnd + 2;
+            }
+            std::size_t total = headerEnd + 4 + contentLength;
+            if (c.in.size() < total) break;
+
+            int status = std::atoi(c.in.c_str() + pos + 9);  // "HTTP/1.1 200"
+            InFlight done = c.inflight.front();
+            c.inflight.pop_front();
+            if (recording_.load(std::memory_order_relaxed)) {
+                uint64_t now = nowNs();
+                latency_.record(now > done.intendedNs ? now - done.intendedNs : 0);
+                ++stats_.responses[done.route];
+                if (status < 200 || status >= 300) ++stats_.non2xx;
+            }
+            pos = total;
+        }
+        c.in.erase(0, pos);
+    }
+
+    const Options& opt_;
+    std::mt19937_64 rng_;
+    std::vector<ClientConn> conns_;
+    Histogram& latency_;
+    const std::atomic<bool>& recording_;
+    const std::atomic<bool>& stopping_;
+    ThreadStats stats_;
+    int epollFd_ = -1;
+    int totalWeight_ = 0;
+    uint64_t sequence_ = 0;
+};
+
+bool parseMix(const char* text, Options& opt) {
+    int weights[ROUTE_COUNT] = {};
+    std::string s(text);
+    std::size_t pos = 0;
+    while (pos < s.size()) {
+        std::size_t comma = s.find(',', pos);
+        std::string item = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        pos = comma == std::string::npos ? s.size() : comma + 1;
+        std::size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string name = item.substr(0, eq);
+        int route = -1;
+        for (int i = 0; i < ROUTE_COUNT; ++i) {
+            if (name == kRouteNames[i]) route = i;
+        }
+        if (route < 0) return false;
+        weights[route] = std::atoi(item.c_str() + eq + 1);
+        if (weights[route] < 0) return false;
+    }
+    int total = 0;
+    for (int i = 0; i < ROUTE_COUNT; ++i) total += weights[i];
+    if (total <= 0) return false;
+    std::copy(weights, weights + ROUTE_COUNT, opt.weights);
+    return true;
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--no-keepalive") == 0) {
+            opt.keepAlive = false;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (std::strcmp(argv[i - 1], "--host") == 0) {
+            opt.host = value;
+        } else if (std::strcmp(argv[i - 1], "--port") == 0) {
+            opt.port = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--threads") == 0) {
+            opt.threads = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--connections") == 0) {
+            opt.connections = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--duration-s") == 0) {
+            opt.durationS = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--warmup-s") == 0) {
+            opt.warmupS = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--pipeline") == 0) {
+            opt.pipeline = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--rate") == 0) {
+            opt.rate = std::atof(value);
+        } else if (std::strcmp(argv[i - 1], "--mix") == 0) {
+            if (!parseMix(value, opt)) return false;
+        } else if (std::strcmp(argv[i - 1], "--devices") == 0) {
+            opt.devices = std::atoi(value);
+        } else if (std::strcmp(argv[i - 1], "--seed") == 0) {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    if (opt.threads > opt.connections) opt.threads = opt.connections;
+    return opt.port > 0 && opt.threads > 0 && opt.connections > 0 && opt.durationS > 0 &&
+           opt.warmupS >= 0 && opt.pipeline > 0 && opt.rate >= 0 && opt.devices > 0;
+}
+
+double percentileMs(const Histogram::Snapshot& snap, double q) {
+    if (snap.count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(snap.count));
+    if (rank >= snap.count) rank = snap.count - 1;
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < snap.buckets.size(); ++i) {
+        seen += snap.buckets[i];
+        if (seen > rank) return static_cast<double>(Histogram::bucketUpperBound(i)) / 1e6;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        std::fprintf(stderr,
+            "Usage: %s [--host H] [--port P] [--threads N] [--connections N] [--duration-s N] [--warmup-s N]\n"
+            "          [--pipeline N] [--rate R] [--no-keepalive] [--mix report=6,query=2,req-report=1,req-query=1]\n"
+            "          [--devices N] [--seed N]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("device_bench %s:%d threads=%d connections=%d pipeline=%d %s %s duration=%ds warmup=%ds\n",
+                opt.host.c_str(), opt.port, opt.threads, opt.connections, opt.keepAlive ? opt.pipeline : 1,
+                opt.keepAlive ? "keep-alive" : "close", opt.rate > 0 ? "open-loop" : "closed-loop",
+                opt.durationS, opt.warmupS);
+    if (opt.rate > 0) std::printf("target rate=%.0f req/s\n", opt.rate);
+    std::printf("mix:");
+    for (int i = 0; i < ROUTE_COUNT; ++i) std::printf(" %s=%d", kRouteNames[i], opt.weights[i]);
+    std::printf(" seed=%llu\n\n", static_cast<unsigned long long>(opt.seed));
+
+    auto latency = std::make_unique<Histogram>();
+    std::atomic<bool> recording{false};
+    std::atomic<bool> stopping{false};
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < opt.threads; ++t) {
+        int conns = opt.connections / opt.threads + (t < opt.connections % opt.threads ? 1 : 0);
+        workers.push_back(std::make_unique<Worker>(opt, t, conns, *latency, recording, stopping));
+    }
+    uint64_t startNs = nowNs();
+    for (auto& w : workers) {
+        threads.emplace_back([&w, startNs] { w->run(startNs); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(opt.warmupS));
+    recording.store(true);
+    uint64_t measureStart = nowNs();
+    std::this_thread::sleep_for(std::chrono::seconds(opt.durationS));
+    recording.store(false);
+    double seconds = static_cast<double>(nowNs() - measureStart) / 1e9;
+    stopping.store(true);
+    for (auto& t : threads) t.join();
+
+    ThreadStats total;
+    for (const auto& w : workers) {
+        const ThreadStats& s = w->stats();
+        for (int i = 0; i < ROUTE_COUNT; ++i) total.responses[i] += s.responses[i];
+        total.non2xx += s.non2xx;
+        total.socketErrors += s.socketErrors;
+        total.bytesIn += s.bytesIn;
+    }
+    uint64_t responses = 0;
+    for (uint64_t n : total.responses) responses += n;
+
+    std::printf("%-14s %12llu  (%.0f req/s)\n", "responses", static_cast<unsigned long long>(responses),
+                static_cast<double>(responses) / seconds);
+    for (int i = 0; i < ROUTE_COUNT; ++i) {
+        std::printf("  %-12s %12llu\n", kRouteNames[i], static_cast<unsigned long long>(total.responses[i]));
+    }
+    std::printf("%-14s %12llu\n", "non-2xx", static_cast<unsigned long long>(total.non2xx));
+    std::printf("%-14s %12llu\n", "socket errors", static_cast<unsigned long long>(total.socketErrors));
+    std::printf("%-14s %12.2f MB/s\n\n", "read", static_cast<double>(total.bytesIn) / seconds / 1e6);
+
+    Histogram::Snapshot snap = latency->snapshot();
+    std::printf("latency (ms, %s)\n", opt.rate > 0 ? "from intended send time, coordinated-omission corrected"
+                                                     : "closed loop, not corrected; use --rate for corrected numbers");
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999, 0.9999, 1.0};
+    const char* const labels[] = {"p50", "p90", "p99", "p99.9", "p99.99", "max"};
+    for (std::size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        std::printf("  %-8s %10.3f\n", labels[i], percentileMs(snap, quantiles[i]));
+    }
+    if (snap.count > 0) {
+        std::printf("  %-8s %10.3f\n", "mean", static_cast<double>(snap.sum) / static_cast<double>(snap.count) / 1e6);
+    }
+    return total.socketErrors > 0 && responses == 0 ? 1 : 0;
+}
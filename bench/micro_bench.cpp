@@ -0,0 +1,490 @@
+/**
+ * 热路径微基准
+ *
+ * 覆盖 HTTP 解析、连接拆包、JSON 解析 / 序列化、数据点编码（JSON 与时间桶打包）、MemoryStore 需求读写（不同数据量）、
+ * DeviceManager::ensureRegistered 多线程争用、ThreadPool::submit 吞吐。
+ * 每个用例按倍增批量运行到不少于 --min-time-ms，重复 --repetitions 次取中位数。
+ * --json 输出机器可读结果，可用 scripts/bench_compare.py 对比两次提交
+ *
+ * 用法：micro_bench [--filter SUBSTR] [--min-time-ms N] [--repetitions N]
+ *                   [--max-rows N] [--json PATH] [--label TEXT]
+ */
+#include "business/DeviceManager.hpp"
+#include "business/IngestSession.hpp"
+#include "business/ReportHandler.hpp"
+#include "net/Connection.hpp"
+#include "net/HttpParser.hpp"
+#include "storage/BinaryCodec.hpp"
+#include "storage/BucketCodec.hpp"
+#include "storage/MemoryStore.hpp"
+#include "thread/ThreadPool.hpp"
+#include "utils/InternTable.hpp"
+#include "utils/JsonParser.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string filter;
+    int minTimeMs = 200;
+    int repetitions = 3;
+    int maxRows = 1000000;
+    std::string jsonPath;
+    std::string label;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0;  // 中位数那一轮的操作数
+    double nsPerOp = 0;
+};
+
+// 防止编译器把基准结果当作无用计算删除
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+const char kReportBody[] =
+    "{\"device_id\":\"TEST_001\",\"timestamp\":1700000000,"
+    "\"metrics\":{\"heart_rate\":78,\"spo2\":98,\"temperature\":36.6,\"steps\":1024}}";
+
+std::string makeReportRequest() {
+    std::string body(kReportBody);
+    return "POST /api/v1/report HTTP/1.1\r\nHost: 127.0.0.1:8080\r\nUser-Agent: micro_bench\r\n"
+           "Accept: */*\r\nContent-Type: application/json\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+std::string makeBatchBody(int points) {
+    std::string body = "{\"device_id\":\"TEST_001\",\"data\":[";
+    for (int i = 0; i < points; ++i) {
+        if (i) body += ',';
+        body += "{\"timestamp\":" + std::to_string(1700000000 + i) +
+                ",\"metrics\":{\"heart_rate\":" + std::to_string(60 + i % 40) + ",\"spo2\":98.5}}";
+    }
+    body += "]}";
+    return body;
+}
+
+Requirement makeRequirement(uint64_t n) {
+    Requirement req;
+    req.title = "bench requirement " + std::to_string(n);
+    req.content = "generated by micro_bench, sequence " + std::to_string(n);
+    req.willing_to_pay = static_cast<int>(n % 3) - 1;
+    req.contact = "bench@example.com";
+    return req;
+}
+
+// 需求查询第一页的响应 DOM（与 ReportHandler 输出结构一致）
+JsonValue makeQueryResponse() {
+    JsonValue::Array items;
+    for (int i = 0; i < 20; ++i) {
+        JsonValue::Object item;
+        item.emplace("id", JsonValue(i + 1));
+        item.emplace("title", JsonValue("bench requirement " + std::to_string(i)));
+        item.emplace("content", JsonValue("generated by micro_bench with \"quotes\" and \\ escapes"));
+        item.emplace("willing_to_pay", i % 2 ? JsonValue(1) : JsonValue(nullptr));
+        item.emplace("contact", JsonValue("bench@example.com"));
+        item.emplace("created_at", JsonValue("2024-01-01 00:00:00"));
+        items.push_back(JsonValue(std::move(item)));
+    }
+    JsonValue::Object data;
+    data.emplace("total", JsonValue(1000));
+    data.emplace("page", JsonValue(1));
+    data.emplace("items", JsonValue(std::move(items)));
+    JsonValue::Object root;
+    root.emplace("code", JsonValue(0));
+    root.emplace("data", JsonValue(std::move(data)));
+    return JsonValue(std::move(root));
+}
+
+// 在 threads 个线程上并发执行共 n 次 op(thread, i)
+void runParallel(int threads, uint64_t n, const std::function<void(int, uint64_t)>& op) {
+    std::atomic<int> ready{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            ready.fetch_add(1);
+            while (ready.load() < threads) std::this_thread::yield();
+            for (uint64_t i = static_cast<uint64_t>(t); i < n; i += static_cast<uint64_t>(threads)) op(t, i);
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& opt) : opt_(opt) {}
+
+    bool selected(const std::string& name) const {
+        return opt_.filter.empty() || name.find(opt_.filter) != std::string::npos;
+    }
+
+    // batch(n) 执行 n 次操作；每轮倍增 n 直到累计耗时达到 min-time
+    void run(const std::string& name, const std::function<void(uint64_t)>& batch) {
+        if (!selected(name)) return;
+        std::vector<Result> reps;
+        for (int r = 0; r < opt_.repetitions; ++r) {
+            uint64_t total = 0;
+            Clock::duration elapsed{};
+            uint64_t n = 1;
+            while (elapsed < std::chrono::milliseconds(opt_.minTimeMs)) {
+                auto start = Clock::now();
+                batch(n);
+                elapsed += Clock::now() - start;
+                total += n;
+                n *= 2;
+            }
+            Result res;
+            res.name = name;
+            res.iterations = total;
+            res.nsPerOp = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+                          static_cast<double>(total);
+            reps.push_back(res);
+        }
+        std::sort(reps.begin(), reps.end(), [](const Result& a, const Result& b) { return a.nsPerOp < b.nsPerOp; });
+        const Result& median = reps[reps.size() / 2];
+        std::printf("%-44s %14.1f %16.0f %12llu\n", name.c_str(), median.nsPerOp, 1e9 / median.nsPerOp,
+                    static_cast<unsigned long long>(median.iterations));
+        std::fflush(stdout);
+        results_.push_back(median);
+    }
+
+    bool writeJson() const {
+        if (opt_.jsonPath.empty()) return true;
+        FILE* f = std::fopen(opt_.jsonPath.c_str(), "w");
+        if (!f) {
+            std::fprintf(stderr, "cannot open %s: %s\n", opt_.jsonPath.c_str(), std::strerror(errno));
+            return false;
+        }
+        std::fprintf(f, "{\n  \"context\": {\"label\": \"");
+        for (char c : opt_.label) {
+            if (c == '"' || c == '\\') std::fputc('\\', f);
+            if (static_cast<unsigned char>(c) >= 0x20) std::fputc(c, f);
+        }
+        std::fprintf(f, "\", \"timestamp\": %lld, \"hw_threads\": %u, \"min_time_ms\": %d, \"repetitions\": %d},\n",
+                     static_cast<long long>(std::time(nullptr)), std::thread::hardware_concurrency(),
+                     opt_.minTimeMs, opt_.repetitions);
+        std::fprintf(f, "  \"benchmarks\": [\n");
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Result& r = results_[i];
+            std::fprintf(f, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"iterations\": %llu}%s\n",
+                         r.name.c_str(), r.nsPerOp, 1e9 / r.nsPerOp, static_cast<unsigned long long>(r.iterations),
+                         i + 1 < results_.size() ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+        return std::fclose(f) == 0;
+    }
+
+private:
+    const Options& opt_;
+    std::vector<Result> results_;
+};
+
+void benchHttp(Runner& runner) {
+    const std::string raw = makeReportRequest();
+    runner.run("http.parse_request/report", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            HttpRequest req;
+            if (!HttpParser::parseRequest(raw, req)) std::abort();
+            keep(req);
+        }
+    });
+
+    // 每批向 socketpair 写入 kPipelined 个请求，onReadable 读入后逐个拆出
+    if (!runner.selected("connection.read_extract")) return;
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) std::abort();
+    Connection conn(fds[0]);
+    constexpr uint64_t kPipelined = 32;
+    std::string burst;
+    for (uint64_t i = 0; i < kPipelined; ++i) burst += raw;
+    runner.run("connection.read_extract/pipelined32", [&](uint64_t n) {
+        for (uint64_t done = 0; done < n; done += kPipelined) {
+            if (::write(fds[1], burst.data(), burst.size()) != static_cast<ssize_t>(burst.size())) std::abort();
+            conn.onReadable();
+            for (uint64_t i = 0; i < kPipelined; ++i) {
+                std::string request = conn.extractRequest();
+                if (request.empty()) std::abort();
+                keep(request);
+            }
+        }
+    });
+    ::close(fds[1]);
+}
+
+void benchJson(Runner& runner) {
+    runner.run("json.parse/report", [](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            JsonValue v = JsonParser::parse(kReportBody);
+            keep(v);
+        }
+    });
+    const std::string batch = makeBatchBody(100);
+    runner.run("json.parse/batch100", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            JsonValue v = JsonParser::parse(batch);
+            keep(v);
+        }
+    });
+    const JsonValue response = makeQueryResponse();
+    runner.run("json.stringify/requirement_page20", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            std::string out = JsonParser::stringify(response);
+            keep(out);
+        }
+    });
+}
+
+// MySQL 两种布局下一个样本的编码：data_points 的 metrics JSON，data_buckets 的记录与整理后的列式块
+void benchCodec(Runner& runner) {
+    InternTable& names = InternTable::getInstance();
+    const char* metricNames[] = {"heart_rate", "spo2", "temperature", "steps"};
+    constexpr long long kBucket = 1700000000;
+    constexpr int kSamples = 3600;  // 每秒一个样本的一小时桶
+    std::vector<DataPoint> points(kSamples);
+    for (int i = 0; i < kSamples; ++i) {
+        points[i].timestamp = kBucket + i;
+        points[i].metrics = {Metric{names.intern(metricNames[0]), 70.0 + i % 7},
+                             Metric{names.intern(metricNames[1]), 98},
+                             Metric{names.intern(metricNames[2]), 36.5 + (i / 600) * 0.1},
+                             Metric{names.intern(metricNames[3]), static_cast<double>(i / 2)}};
+    }
+
+    std::size_t jsonBytes = 0;
+    runner.run("codec.encode/json", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            JsonValue::Object obj;
+            for (const Metric& m : points[i % kSamples].metrics) obj.emplace(names.name(m.name), JsonValue(m.value));
+            std::string out = JsonParser::stringify(JsonValue(std::move(obj)));
+            jsonBytes = out.size();
+            keep(out);
+        }
+    });
+    std::string record;
+    runner.run("codec.encode/packed_record", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            record.clear();
+            BucketCodec::appendRecord(record, kBucket, points[i % kSamples]);
+            keep(record);
+        }
+    });
+    std::string block;
+    runner.run("codec.encode/packed_block3600", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            block.clear();
+            BucketCodec::encodeBlock(block, kBucket, points);
+            keep(block);
+        }
+    });
+    runner.run("codec.decode/packed_block3600", [&](uint64_t n) {
+        std::vector<DataPoint> out;
+        for (uint64_t i = 0; i < n; ++i) {
+            out.clear();
+            if (!BucketCodec::decode(block, kBucket, out) || out.size() != kSamples) std::abort();
+            keep(out);
+        }
+    });
+    if (!block.empty()) {
+        std::printf("%-44s json=%zuB record=%zuB block=%.1fB (per sample, before COMPRESS)\n", "  codec sizes",
+                    jsonBytes, record.size(), static_cast<double>(block.size()) / kSamples);
+    }
+}
+
+// 同样 100 个样本的两种上报：HTTP 批量上报的 JSON 解析，WebSocket 二进制 REPORT 的解码（不含存储写入）
+void benchIngest(Runner& runner) {
+    constexpr int kPoints = 100;
+    std::string json = "[";
+    for (int i = 0; i < kPoints; ++i) {
+        if (i) json += ',';
+        json += "{\"device_id\":\"TEST_001\",\"timestamp\":" + std::to_string(1700000000 + i) +
+                ",\"metrics\":{\"heart_rate\":" + std::to_string(60 + i % 40) + ",\"spo2\":98.5}}";
+    }
+    json += ']';
+    runner.run("ingest.decode/json_batch100", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            BatchReportRequest req;
+            if (!ReportHandler::parseBatchReportRequest(json, req)) std::abort();
+            keep(req);
+        }
+    });
+
+    // REPORT 中 seq 之后的部分，样本与上面的 JSON 一致
+    std::string samples;
+    ByteWriter w(samples);
+    w.putVarint(0);
+    w.putVarint(kPoints);
+    for (int i = 0; i < kPoints; ++i) {
+        w.putZigzag(i == 0 ? 1700000000 : 1);
+        w.putVarint(2);
+        w.putVarint(0 << 1);
+        w.putZigzag(60 + i % 40);
+        w.putVarint(1 << 1 | 1);
+        w.putDouble(98.5);
+    }
+
+    IngestSession session([](const BatchReportRequest& batch) { keep(batch); return true; }, 1u << 30);
+    struct Name {
+        uint8_t kind;
+        uint64_t index;
+        const char* name;
+    };
+    std::string define, reply;
+    for (const Name& name : {Name{0, 0, "TEST_001"}, Name{1, 0, "heart_rate"}, Name{1, 1, "spo2"}}) {
+        define.clear();
+        ByteWriter d(define);
+        d.putU8(IngestSession::DEFINE);
+        d.putU8(name.kind);
+        d.putVarint(name.index);
+        d.putString(name.name);
+        if (!session.onMessage(define, true, reply)) std::abort();
+    }
+    uint64_t seq = 0;
+    std::string message;
+    runner.run("ingest.decode/ws_report100", [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            message.clear();
+            ByteWriter m(message);
+            m.putU8(IngestSession::REPORT);
+            m.putVarint(++seq);
+            message += samples;
+            reply.clear();
+            if (!session.onMessage(message, true, reply)) std::abort();
+            keep(reply);
+        }
+    });
+    if (!message.empty()) {
+        std::printf("%-44s json=%.1fB ws=%.1fB (per sample)\n", "  ingest sizes",
+                    static_cast<double>(json.size()) / kPoints, static_cast<double>(message.size()) / kPoints);
+    }
+}
+
+void benchStore(Runner& runner, int maxRows) {
+    for (int rows = 10000; rows <= maxRows; rows *= 10) {
+        std::string suffix = "/" + std::to_string(rows);
+        if (!runner.selected("store.append_requirement" + suffix) &&
+            !runner.selected("store.query_requirements" + suffix) &&
+            !runner.selected("store.query_requirements_keyword" + suffix)) {
+            continue;
+        }
+        MemoryStore store;
+        for (int i = 0; i < rows; ++i) store.appendRequirement(makeRequirement(static_cast<uint64_t>(i)));
+
+        runner.run("store.query_requirements" + suffix, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                RequirementQueryResult r = store.queryRequirements(1, 20, -1, "");
+                keep(r);
+            }
+        });
+        runner.run("store.query_requirements_keyword" + suffix, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                RequirementQueryResult r = store.queryRequirements(1, 20, 1, "sequence 42");
+                keep(r);
+            }
+        });
+        // 最后测写入，避免写入的记录影响上面的查询规模
+        const Requirement req = makeRequirement(static_cast<uint64_t>(rows));
+        runner.run("store.append_requirement" + suffix, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) store.appendRequirement(req);
+        });
+    }
+}
+
+void benchDeviceManager(Runner& runner) {
+    constexpr uint64_t kDevices = 4096;
+    std::vector<InternId> ids;
+    for (uint64_t i = 0; i < kDevices; ++i) {
+        ids.push_back(InternTable::getInstance().intern("bench-device-" + std::to_string(i)));
+    }
+    // 线程数固定为 1~8（不随核数变化），便于跨机器对比同名用例
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        // 已注册设备上的重复调用，即上报热路径
+        DeviceManager manager(DeviceManagerMode::MEMORY);
+        for (InternId id : ids) manager.ensureRegistered(id);
+        runner.run("device.ensure_registered/threads:" + std::to_string(threads), [&](uint64_t n) {
+            runParallel(threads, n, [&](int, uint64_t i) { manager.ensureRegistered(ids[i % kDevices]); });
+        });
+    }
+}
+
+void benchThreadPool(Runner& runner) {
+    for (std::size_t workers = 1; workers <= 4; workers *= 4) {
+        std::string name = "threadpool.submit/workers:" + std::to_string(workers);
+        if (!runner.selected(name)) continue;
+        ThreadPool pool;
+        pool.start(workers);
+        std::atomic<uint64_t> executed{0};
+        // 单生产者提交 n 个空任务并等待全部执行完，即任务的端到端开销
+        runner.run(name, [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                pool.submit([&executed] { executed.fetch_add(1, std::memory_order_relaxed); });
+            }
+            pool.waitForTasks();
+        });
+        pool.stop();
+    }
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) return false;
+        if (std::strcmp(argv[i], "--filter") == 0) {
+            opt.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time-ms") == 0) {
+            opt.minTimeMs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--repetitions") == 0) {
+            opt.repetitions = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--max-rows") == 0) {
+            opt.maxRows = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            opt.jsonPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--label") == 0) {
+            opt.label = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return opt.minTimeMs > 0 && opt.repetitions > 0 && opt.maxRows >= 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        std::fprintf(stderr, "Usage: %s [--filter SUBSTR] [--min-time-ms N] [--repetitions N] [--max-rows N]"
+                             " [--json PATH] [--label TEXT]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("hot path microbenchmarks: min_time=%dms repetitions=%d (median) hw_threads=%u\n\n",
+                opt.minTimeMs, opt.repetitions, std::thread::hardware_concurrency());
+    std::printf("%-44s %14s %16s %12s\n", "benchmark", "ns/op", "ops/s", "iterations");
+
+    Runner runner(opt);
+    benchHttp(runner);
+    benchJson(runner);
+    benchCodec(runner);
+    benchIngest(runner);
+    benchStore(runner, opt.maxRows);
+    benchDeviceManager(runner);
+    benchThreadPool(runner);
+    return runner.writeJson() ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/**
+ * MemoryStore 需求记录读写混合扩展性基准
+ *
+ * 对 1~64 个线程分别运行固定时长，每个线程按写比例随机执行
+ * appendRequirement 或 queryRequirements（第一页），输出各线程数下的吞吐
+ *
+ * 用法：store_bench [--duration-ms N] [--write-ratio R] [--max-threads N] [--preload N]
+ */
+#include "storage/MemoryStore.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    int durationMs = 1000;
+    double writeRatio = 0.1;
+    int maxThreads = 64;
+    int preload = 2000;
+};
+
+struct Result {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+};
+
+Requirement makeRequirement(uint64_t n) {
+    Requirement req;
+    req.title = "bench requirement " + std::to_string(n);
+    req.content = "generated by store_bench, sequence " + std::to_string(n);
+    req.willing_to_pay = static_cast<int>(n % 3) - 1;
+    req.contact = "bench@example.com";
+    return req;
+}
+
+Result runOnce(const Options& opt, int threads) {
+    MemoryStore store;
+    for (int i = 0; i < opt.preload; ++i) store.appendRequirement(makeRequirement(i));
+
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::vector<Result> perThread(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 rng(static_cast<uint64_t>(t) * 7919 + 1);
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            Result local;
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (dist(rng) < opt.writeRatio) {
+                    store.appendRequirement(makeRequirement(local.writes));
+                    ++local.writes;
+                } else {
+                    RequirementQueryResult r = store.queryRequirements(1, 20, -1, "");
+                    if (r.data.empty()) std::abort();
+                    ++local.reads;
+                }
+            }
+            perThread[t] = local;
+        });
+    }
+
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(opt.durationMs));
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& w : workers) w.join();
+
+    Result total;
+    for (const auto& r : perThread) {
+        total.reads += r.reads;
+        total.writes += r.writes;
+    }
+    return total;
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) return false;
+        if (std::strcmp(argv[i], "--duration-ms") == 0) {
+            opt.durationMs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--write-ratio") == 0) {
+            opt.writeRatio = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--max-threads") == 0) {
+            opt.maxThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--preload") == 0) {
+            opt.preload = std::atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return opt.durationMs > 0 && opt.maxThreads > 0 && opt.preload > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        std::fprintf(stderr, "Usage: %s [--duration-ms N] [--write-ratio R] [--max-threads N] [--preload N]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("MemoryStore requirement mixed read/write benchmark\n");
+    std::printf("duration=%dms write_ratio=%.2f preload=%d hw_threads=%u\n\n",
+                opt.durationMs, opt.writeRatio, opt.preload, std::thread::hardware_concurrency());
+    std::printf("%8s %14s %14s %14s %12s\n", "threads", "ops/s", "reads/s", "writes/s", "speedup");
+
+    double baseline = 0.0;
+    for (int threads = 1; threads <= opt.maxThreads; threads *= 2) {
+        Result r = runOnce(opt, threads);
+        double seconds = opt.durationMs / 1000.0;
+        double ops = (r.reads + r.writes) / seconds;
+        if (threads == 1) baseline = ops;
+        std::printf("%8d %14.0f %14.0f %14.0f %11.2fx\n", threads, ops,
+                    r.reads / seconds, r.writes / seconds, baseline > 0 ? ops / baseline : 0.0);
+        std::fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# 对比两次 micro_bench --json 结果，ns/op 变慢超过阈值的用例视为回归
+# 用法：python3 scripts/bench_compare.py baseline.json current.json [--threshold 0.10]
+# 存在回归时退出码为 1，可直接用于 CI
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8") as f:
+        doc = json.load(f)
+    return doc.get("context", {}), {b["name"]: b for b in doc["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two micro_bench JSON results")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative ns/op increase treated as a regression (default 0.10)")
+    args = parser.parse_args()
+
+    base_ctx, base = load(args.baseline)
+    cur_ctx, cur = load(args.current)
+    print("baseline: %s  current: %s  threshold: %.0f%%" % (
+        base_ctx.get("label") or args.baseline, cur_ctx.get("label") or args.current, args.threshold * 100))
+    if base_ctx.get("hw_threads") != cur_ctx.get("hw_threads"):
+        print("warning: hw_threads differ (%s vs %s), results may not be comparable" % (
+            base_ctx.get("hw_threads"), cur_ctx.get("hw_threads")))
+    print()
+    print("%-44s %14s %14s %9s" % ("benchmark", "base ns/op", "cur ns/op", "change"))
+
+    regressions = 0
+    for name, c in cur.items():
+        b = base.get(name)
+        if b is None:
+            print("%-44s %14s %14.1f %9s" % (name, "-", c["ns_per_op"], "new"))
+            continue
+        change = c["ns_per_op"] / b["ns_per_op"] - 1.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  improved"
+        print("%-44s %14.1f %14.1f %+8.1f%%%s" % (name, b["ns_per_op"], c["ns_per_op"], change * 100, mark))
+    for name in base:
+        if name not in cur:
+            print("%-44s %14.1f %14s %9s" % (name, base[name]["ns_per_op"], "-", "missing"))
+
+    print()
+    print("%d regression(s)" % regressions)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
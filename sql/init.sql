@@ -50,26 +50,27 @@ CREATE TABLE IF NOT EXISTS data_points (
   COMMENT='数据点表';
 
 -- ============================================
--- 可选：数据点分区表（用于大数据量场景）
--- 按月分区，便于数据归档和清理
--- ============================================
--- CREATE TABLE IF NOT EXISTS data_points_partitioned (
---     id BIGINT AUTO_INCREMENT,
---     device_id VARCHAR(128) NOT NULL,
---     timestamp BIGINT NOT NULL,
---     metrics JSON NOT NULL,
---     created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
---     
---     PRIMARY KEY (id, created_at),
---     INDEX idx_device_timestamp (device_id, timestamp DESC),
---     INDEX idx_timestamp (timestamp)
--- ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci
---   PARTITION BY RANGE (TO_DAYS(created_at)) (
---     PARTITION p202601 VALUES LESS THAN (TO_DAYS('2026-02-01')),
---     PARTITION p202602 VALUES LESS THAN (TO_DAYS('2026-03-01')),
---     PARTITION p202603 VALUES LESS THAN (TO_DAYS('2026-04-01')),
---     PARTITION p_future VALUES LESS THAN MAXVALUE
--- );
+-- 数据点时间桶表（[mysql] data_layout = packed 时使用）
+-- 一行保存一个设备在一个时间桶内的全部样本（二进制编码），主键即聚簇索引，
+-- 没有自增 id 与逐行的 JSON 解析。桶结束后由服务端整理为列式块并 COMPRESS。
+-- 按 bucket_start 做 RANGE 分区：服务端从 p_future 拆出未来分区、删除超出保留期的分区，
+-- 无需手工维护；表不存在时服务端也会自动创建
+-- ============================================
+CREATE TABLE IF NOT EXISTS data_buckets (
+    device_id VARCHAR(128) NOT NULL COMMENT '设备ID',
+    bucket_start BIGINT NOT NULL COMMENT '桶起点（timestamp 向下取整到 bucket_span）',
+    sample_count INT UNSIGNED NOT NULL DEFAULT 0 COMMENT '桶内样本数',
+    compacted TINYINT NOT NULL DEFAULT 0 COMMENT '1 表示 samples 已整理并压缩',
+    samples MEDIUMBLOB NOT NULL COMMENT '样本编码（见 BucketCodec）',
+    
+    PRIMARY KEY (device_id, bucket_start),
+    -- 后台整理查找未整理的已结束桶
+    INDEX idx_compacted (compacted, bucket_start)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci
+  COMMENT='数据点时间桶表'
+  PARTITION BY RANGE (bucket_start) (
+    PARTITION p_future VALUES LESS THAN MAXVALUE
+);
 
 -- ============================================
 -- 存储过程：清理指定天数之前的数据
@@ -1,45 +1,151 @@
 #include "DeviceManager.hpp"
-#include "storage/MySQLStore.hpp"
 #include "utils/Logger.hpp"
+#include <algorithm>
+#include <chrono>
+
+#ifdef ENABLE_MYSQL
+#include "storage/MySQLStore.hpp"
+#endif
 
 DeviceManager::DeviceManager(DeviceManagerMode mode)
     : mode_(mode)
-    , mysqlStore_(nullptr) {
+    , mysqlStore_(nullptr)
+    , registrarRunning_(false)
+    , intervalMs_(200)
+    , maxBatch_(500) {
+}
+
+DeviceManager::~DeviceManager() {
+    stopRegistrar();
 }
 
 void DeviceManager::setMySQLStore(MySQLStore* store) {
     mysqlStore_ = store;
 }
 
-bool DeviceManager::exists(const std::string& deviceId) {
+void DeviceManager::startRegistrar(int intervalMs, std::size_t maxBatch) {
+    if (mode_ == DeviceManagerMode::MEMORY || !mysqlStore_) return;
+    if (registrarThread_.joinable()) return;
+
+#ifdef ENABLE_MYSQL
+    // 预热：一次性加载已注册设备，避免已知设备再次入队
+    std::vector<std::string> known;
+    if (mysqlStore_->loadDeviceIds(known)) {
+        InternTable& names = InternTable::getInstance();
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto& id : known) devices_.insert(names.intern(id));
+        LOG_INFO("DeviceManager warmed with " + std::to_string(known.size()) + " devices");
+    } else {
+        LOG_WARNING("DeviceManager failed to load device ids, starting with empty cache");
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        intervalMs_ = intervalMs > 0 ? intervalMs : 200;
+        maxBatch_ = maxBatch > 0 ? maxBatch : 500;
+        registrarRunning_ = true;
+    }
+    registrarThread_ = std::thread(&DeviceManager::registrarLoop, this);
+}
+
+void DeviceManager::stopRegistrar() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!registrarRunning_) return;
+        registrarRunning_ = false;
+    }
+    registrarCv_.notify_all();
+    if (registrarThread_.joinable()) {
+        registrarThread_.join();
+    }
+}
+
+void DeviceManager::registrarLoop() {
+    std::vector<InternId> batch;
+    int retryDelayMs = 0;  // 上次写库失败后的等待时长，0 表示上次成功
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true) {
+        if (retryDelayMs > 0) {
+            // 失败后等满退避时长：放回的批次可能已达 maxBatch_，不能据此提前重试
+            registrarCv_.wait_for(lock, std::chrono::milliseconds(retryDelayMs), [this] {
+                return !registrarRunning_;
+            });
+        } else {
+            registrarCv_.wait_for(lock, std::chrono::milliseconds(intervalMs_), [this] {
+                return !registrarRunning_ || pending_.size() >= maxBatch_;
+            });
+        }
+        bool stopping = !registrarRunning_;
+        batch.swap(pending_);
+        lock.unlock();
+
+        flushPending(batch);
+
+        lock.lock();
+        if (batch.empty()) {
+            retryDelayMs = 0;
+        } else {
+            // 写库失败：放回队列，退避后重试
+            pending_.insert(pending_.end(), batch.begin(), batch.end());
+            batch.clear();
+            retryDelayMs = retryDelayMs == 0 ? intervalMs_ : std::min(retryDelayMs * 2, kMaxRetryDelayMs);
+            if (stopping) {
+                LOG_ERROR("DeviceManager dropped " + std::to_string(pending_.size()) + " unregistered devices on shutdown");
+                pending_.clear();
+            } else {
+                LOG_WARNING("DeviceManager failed to register " + std::to_string(pending_.size()) +
+                            " devices, retrying in " + std::to_string(retryDelayMs) + " ms");
+            }
+        }
+        if (stopping) break;
+    }
+}
+
+void DeviceManager::flushPending(std::vector<InternId>& batch) {
+    if (batch.empty()) return;
+#ifdef ENABLE_MYSQL
+    InternTable& names = InternTable::getInstance();
+    std::size_t done = 0;
+    while (done < batch.size()) {
+        std::size_t count = std::min(maxBatch_, batch.size() - done);
+        std::vector<std::string> chunk;
+        chunk.reserve(count);
+        for (std::size_t i = done; i < done + count; ++i) chunk.emplace_back(names.name(batch[i]));
+        if (!mysqlStore_->registerDevices(chunk)) break;
+        done += count;
+    }
+    batch.erase(batch.begin(), batch.begin() + static_cast<std::ptrdiff_t>(done));
+#else
+    batch.clear();
+#endif
+}
+
+bool DeviceManager::exists(InternId deviceId) {
     switch (mode_) {
         case DeviceManagerMode::MEMORY: {
             std::lock_guard<std::mutex> lock(mtx_);
             return devices_.find(deviceId) != devices_.end();
         }
         
-        case DeviceManagerMode::MYSQL: {
-            if (!mysqlStore_) {
-                LOG_ERROR("MySQL store not set");
-                return false;
-            }
-            return mysqlStore_->deviceExists(deviceId);
-        }
+        case DeviceManagerMode::MYSQL:
         case DeviceManagerMode::HYBRID: {
-            // 先检查内存缓存
+            // 先检查内存缓存（已预热，含尚未写库的新设备）
             {
                 std::lock_guard<std::mutex> lock(mtx_);
                 if (devices_.find(deviceId) != devices_.end()) {
                     return true;
                 }
             }
-            // 再检查数据库
-            if (mysqlStore_ && mysqlStore_->deviceExists(deviceId)) {
+#ifdef ENABLE_MYSQL
+            // 再检查数据库（其他实例注册的设备）
+            if (mysqlStore_ && mysqlStore_->deviceExists(std::string(InternTable::getInstance().name(deviceId)))) {
                 // 加入内存缓存
                 std::lock_guard<std::mutex> lock(mtx_);
                 devices_.insert(deviceId);
                 return true;
             }
+#endif
             return false;
         }
         
@@ -48,36 +154,36 @@ bool DeviceManager::exists(const std::string& deviceId) {
     }
 }
 
-void DeviceManager::ensureRegistered(const std::string& deviceId) {
-    switch (mode_) {
-        case DeviceManagerMode::MEMORY: {
-            std::lock_guard<std::mutex> lock(mtx_);
-            devices_.insert(deviceId);
-            break;
-        }
-        
-        case DeviceManagerMode::MYSQL: {
-            if (!mysqlStore_) {
-                LOG_ERROR("MySQL store not set");
-                return;
-            }
-            mysqlStore_->ensureDeviceRegistered(deviceId);
-            break;
+void DeviceManager::ensureRegistered(InternId deviceId) {
+    if (mode_ == DeviceManagerMode::MEMORY) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        devices_.insert(deviceId);
+        return;
+    }
+
+    if (!mysqlStore_) {
+        LOG_ERROR("MySQL store not set");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!devices_.insert(deviceId).second) {
+            return;  // 已知设备：不访问数据库
         }
-        
-        case DeviceManagerMode::HYBRID: {
-            // 先注册到内存
-            {
-                std::lock_guard<std::mutex> lock(mtx_);
-                devices_.insert(deviceId);
-            }
-            // 再注册到数据库
-            if (mysqlStore_) {
-                mysqlStore_->ensureDeviceRegistered(deviceId);
+        if (registrarRunning_) {
+            pending_.push_back(deviceId);
+            if (pending_.size() >= maxBatch_) {
+                registrarCv_.notify_one();
             }
-            break;
+            return;
         }
     }
+
+#ifdef ENABLE_MYSQL
+    // 未启动后台注册线程时同步写库（仅首次出现的设备）
+    mysqlStore_->ensureDeviceRegistered(std::string(InternTable::getInstance().name(deviceId)));
+#endif
 }
 
 std::size_t DeviceManager::getDeviceCount() const {
@@ -85,6 +191,11 @@ std::size_t DeviceManager::getDeviceCount() const {
     return devices_.size();
 }
 
+std::size_t DeviceManager::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return pending_.size();
+}
+
 void DeviceManager::clearMemoryCache() {
     std::lock_guard<std::mutex> lock(mtx_);
     devices_.clear();
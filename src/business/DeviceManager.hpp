@@ -2,8 +2,12 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <memory>
+#include "utils/InternTable.hpp"
 
 // 前向声明
 class MySQLStore;
@@ -20,6 +24,8 @@ enum class DeviceManagerMode {
 /**
  * 设备管理类
  * 支持内存模式和 MySQL 模式
+ * MySQL / 混合模式下，首次出现的设备由后台注册线程合并为多行 INSERT IGNORE 批量写库，
+ * 上报路径只访问内存设备表。设备以 InternTable id 标识，写库时再取回字符串
  */
 class DeviceManager {
 public:
@@ -28,6 +34,7 @@ public:
      * @param mode 管理模式
      */
     explicit DeviceManager(DeviceManagerMode mode = DeviceManagerMode::MEMORY);
+    ~DeviceManager();
 
     /**
      * 设置 MySQL 存储（用于 MySQL 或混合模式）
@@ -35,18 +42,31 @@ public:
      */
     void setMySQLStore(MySQLStore* store);
 
+    /**
+     * 启动后台注册线程（仅 MySQL / 混合模式有效）
+     * 启动前用一次 SELECT device_id 预热内存设备表
+     * @param intervalMs 批量写库间隔（毫秒）
+     * @param maxBatch 单条 INSERT 最大行数，待注册数达到该值时提前写库
+     */
+    void startRegistrar(int intervalMs, std::size_t maxBatch);
+
+    /**
+     * 停止后台注册线程，退出前写入剩余待注册设备
+     */
+    void stopRegistrar();
+
     /**
      * 检查设备是否存在
-     * @param deviceId 设备ID
+     * @param deviceId 设备ID（InternTable id）
      * @return 是否存在
      */
-    bool exists(const std::string& deviceId);
+    bool exists(InternId deviceId);
 
     /**
      * 确保设备已注册（如不存在则注册）
-     * @param deviceId 设备ID
+     * @param deviceId 设备ID（InternTable id）
      */
-    void ensureRegistered(const std::string& deviceId);
+    void ensureRegistered(InternId deviceId);
 
     /**
      * 获取已注册设备数量
@@ -54,6 +74,11 @@ public:
      */
     std::size_t getDeviceCount() const;
 
+    /**
+     * 获取等待写库的设备数量
+     */
+    std::size_t getPendingCount() const;
+
     /**
      * 清空内存中的设备记录
      */
@@ -65,9 +90,23 @@ public:
     DeviceManagerMode getMode() const { return mode_; }
 
 private:
+    // 写库失败后的重试间隔从 intervalMs 起逐次加倍，不超过该上限
+    static constexpr int kMaxRetryDelayMs = 30000;
+
+    void registrarLoop();
+    void flushPending(std::vector<InternId>& batch);
+
     DeviceManagerMode mode_;
     MySQLStore* mysqlStore_;
     
-    mutable std::mutex mtx_;
-    std::unordered_set<std::string> devices_;
+    mutable std::mutex mtx_;  // 保护 devices_ / pending_ / registrarRunning_
+    std::unordered_set<InternId> devices_;
+
+    // 后台注册
+    std::condition_variable registrarCv_;
+    std::thread registrarThread_;
+    std::vector<InternId> pending_;
+    bool registrarRunning_;
+    int intervalMs_;
+    std::size_t maxBatch_;
 };
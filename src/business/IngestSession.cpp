@@ -0,0 +1,218 @@
+#include "IngestSession.hpp"
+#include "storage/BinaryCodec.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
+
+namespace {
+
+struct IngestMetrics {
+    Gauge& sessions = Metrics::getInstance().gauge(
+        "device_server_ws_sessions", "Open WebSocket ingestion sessions");
+    Counter& messages = Metrics::getInstance().counter(
+        "device_server_ws_messages_total", "WebSocket ingestion messages received");
+    Counter& samples = Metrics::getInstance().counter(
+        "device_server_ws_samples_total", "Samples received over WebSocket ingestion");
+    Counter& acks = Metrics::getInstance().counter(
+        "device_server_ws_acks_total", "Cumulative acknowledgements sent (one store flush each)");
+    Counter& errors = Metrics::getInstance().counter(
+        "device_server_ws_protocol_errors_total", "WebSocket ingestion sessions closed on a protocol error");
+    Counter& storeFailures = Metrics::getInstance().counter(
+        "device_server_ws_store_failures_total", "WebSocket ingestion sessions closed because a store write failed");
+};
+
+IngestMetrics& ingestMetrics() {
+    static IngestMetrics metrics;
+    return metrics;
+}
+
+}  // namespace
+
+IngestSession::IngestSession(Sink sink, std::size_t window)
+    : sink_(std::move(sink)), window_(window > 0 ? window : 1) {
+    ingestMetrics().sessions.inc();
+}
+
+IngestSession::~IngestSession() {
+    ingestMetrics().sessions.dec();
+}
+
+void IngestSession::greeting(std::string& out) const {
+    ByteWriter w(out);
+    w.putU8(READY);
+    w.putVarint(window_);
+}
+
+bool IngestSession::onMessage(std::string_view message, bool more, std::string& reply) {
+    // 空消息：排队的帧已处理完，提交累积的样本
+    if (message.empty()) {
+        return unacked_ == 0 || flush(reply);
+    }
+    ingestMetrics().messages.inc();
+    ByteReader reader(message.data(), message.size());
+    std::string error;
+    uint8_t type = 0;
+    reader.getU8(type);
+    bool ok = false;
+    if (type == DEFINE) {
+        ok = define(reader, error);
+    } else if (type == REPORT) {
+        ok = report(reader, error);
+    } else {
+        error = "unknown message type";
+    }
+    if (ok && reader.remaining() != 0) {
+        ok = false;
+        error = "trailing bytes";
+    }
+
+    if (!ok) {
+        // 未确认的样本不写入：客户端重连后会重发，避免重复
+        ingestMetrics().errors.inc();
+        batch_ = BatchReportRequest();
+        ByteWriter w(reply);
+        w.putU8(ERROR);
+        w.putString(error);
+        return false;
+    }
+
+    // 后续帧已在排队时继续累积，合并为一次写入与一次确认
+    if (unacked_ > 0 && (!more || unacked_ * 2 >= window_ ||
+                         batch_.accepted >= ReportHandler::kMaxBatchPoints)) {
+        return flush(reply);
+    }
+    return true;
+}
+
+bool IngestSession::define(ByteReader& reader, std::string& error) {
+    uint8_t kind = 0;
+    uint64_t index = 0;
+    std::string name;
+    if (!reader.getU8(kind) || !reader.getVarint(index) || !reader.getString(name)) {
+        error = "malformed DEFINE";
+        return false;
+    }
+    if (kind > 1 || name.empty()) {
+        error = "invalid DEFINE";
+        return false;
+    }
+    if (++defines_ > kMaxDefines) {
+        error = "too many DEFINEs";
+        return false;
+    }
+    std::vector<Name>& table = kind == 0 ? devices_ : metrics_;
+    if (index > table.size() || index >= kMaxNames) {
+        error = "DEFINE index out of range";
+        return false;
+    }
+    // 只查找不驻留：定义了却从未上报的名字不进入全局驻留表
+    InternId id = InternTable::getInstance().find(name);
+    if (index == table.size()) {
+        table.push_back(Name{std::move(name), id});
+        if (kind == 0) lastTimestamp_.push_back(0);
+    } else {
+        table[index] = Name{std::move(name), id};
+        if (kind == 0) lastTimestamp_[index] = 0;
+    }
+    return true;
+}
+
+InternId IngestSession::resolve(Name& name) {
+    if (name.id == InternTable::kInvalidId) name.id = InternTable::getInstance().intern(name.text);
+    return name.id;
+}
+
+bool IngestSession::report(ByteReader& reader, std::string& error) {
+    TRACE_SPAN("ws.report");
+    uint64_t seq = 0, device = 0, count = 0;
+    if (!reader.getVarint(seq) || !reader.getVarint(device) || !reader.getVarint(count)) {
+        error = "malformed REPORT";
+        return false;
+    }
+    if (seq <= lastSeq_) {
+        error = "REPORT seq must increase";
+        return false;
+    }
+    if (device >= devices_.size()) {
+        error = "undefined device";
+        return false;
+    }
+    // 每个样本至少 2 字节，先按剩余长度拒绝不可能的 count，避免按它预留内存
+    if (count > ReportHandler::kMaxBatchPoints || count * 2 > reader.remaining()) {
+        error = "invalid sample count";
+        return false;
+    }
+
+    std::vector<DataPoint>* points = nullptr;  // 有样本写入时才驻留设备名
+    long long& timestamp = lastTimestamp_[device];
+    for (uint64_t i = 0; i < count; ++i) {
+        int64_t dt = 0;
+        uint64_t n = 0;
+        if (!reader.getZigzag(dt) || !reader.getVarint(n) || n > kMaxMetricsPerSample) {
+            error = "malformed sample";
+            return false;
+        }
+        // 按无符号回绕相加，异常增量不触发有符号溢出
+        timestamp = static_cast<long long>(static_cast<uint64_t>(timestamp) + static_cast<uint64_t>(dt));
+
+        DataPoint point;
+        point.timestamp = timestamp;
+        point.metrics.reserve(n);
+        for (uint64_t j = 0; j < n; ++j) {
+            uint64_t key = 0;
+            if (!reader.getVarint(key) || (key >> 1) >= metrics_.size()) {
+                error = "undefined metric";
+                return false;
+            }
+            double value = 0;
+            if (key & 1) {
+                if (!reader.getDouble(value)) {
+                    error = "malformed sample";
+                    return false;
+                }
+            } else {
+                int64_t v = 0;
+                if (!reader.getZigzag(v)) {
+                    error = "malformed sample";
+                    return false;
+                }
+                value = static_cast<double>(v);
+            }
+            point.metrics.push_back(Metric{resolve(metrics_[key >> 1]), value});
+        }
+        // 与 HTTP 上报一致：没有指标的样本不写入
+        if (point.metrics.empty()) {
+            ++batch_.rejected;
+            continue;
+        }
+        if (!points) points = &batch_.points[resolve(devices_[device])];
+        points->push_back(std::move(point));
+        ++batch_.accepted;
+    }
+
+    ingestMetrics().samples.inc(count);
+    lastSeq_ = seq;
+    ++unacked_;
+    return true;
+}
+
+bool IngestSession::flush(std::string& reply) {
+    bool stored = batch_.accepted == 0 || sink_(batch_);
+    batch_.points.clear();
+    batch_.accepted = 0;
+    batch_.rejected = 0;
+    unacked_ = 0;
+
+    if (!stored) {
+        // 不确认：客户端按协议重发上次 ACK 之后的 REPORT
+        ingestMetrics().storeFailures.inc();
+        ByteWriter w(reply);
+        w.putU8(ERROR);
+        w.putString("store write failed");
+        return false;
+    }
+    ingestMetrics().acks.inc();
+    ByteWriter w(reply);
+    w.putU8(ACK);
+    w.putVarint(lastSeq_);
+    return true;
+}
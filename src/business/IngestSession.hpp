@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "business/ReportHandler.hpp"
+
+class ByteReader;
+
+/**
+ * WebSocket 二进制上报会话（/api/v1/ws/report），每个连接一个，消息由 TcpServer 串行交付。
+ * 消息首字节为类型，整数为 LEB128 变长编码，有符号数先 zigzag，浮点数为 8 字节小端，
+ * 字符串为变长长度 + 字节（与 BinaryCodec 一致）：
+ *
+ *   客户端 → 服务端
+ *     DEFINE 0x01  kind:u8(0 设备 / 1 指标)  index:varint  name:string
+ *                  为设备 ID / 指标名分配会话内下标，之后只传下标；下标从 0 连续分配，可重定义。
+ *                  名字在首个引用它的 REPORT 中才驻留，每个会话最多 kMaxDefines 条 DEFINE
+ *     REPORT 0x02  seq:varint  device:varint  count:varint  count × 样本
+ *                  样本：dt:zigzag  n:varint  n × (key:varint, value)
+ *                  dt 为相对该设备上一个样本的时间戳增量（会话内首个样本相对 0，即绝对值）；
+ *                  key = 指标下标 << 1 | 是否浮点，value 为 zigzag 整数或 8 字节浮点
+ *   服务端 → 客户端
+ *     READY  0x80  window:varint   握手后立即发送：未确认的 REPORT 不应超过 window 条
+ *     ACK    0x81  seq:varint      seq 及之前的 REPORT 已写入存储（累计确认）
+ *     ERROR  0x82  message:string  协议错误或写入存储失败，随后以 1008 关闭，未确认的数据由客户端重发
+ *
+ * 样本先在会话内累积，连接上没有排队的帧、未确认的 REPORT 达到半个窗口或样本数达到上限时
+ * 一次写入存储（每个设备一次 appendBatch）并回复 ACK，写入失败时回复 ERROR 而不是 ACK；
+ * 连接断开时未确认的样本丢弃，由客户端重发（写入失败前已写入的部分可能重复）
+ */
+class IngestSession {
+public:
+    // 返回 false 表示写入失败，这批样本不确认
+    using Sink = std::function<bool(const BatchReportRequest& batch)>;
+
+    enum MessageType : uint8_t {
+        DEFINE = 0x01,
+        REPORT = 0x02,
+        READY = 0x80,
+        ACK = 0x81,
+        ERROR = 0x82
+    };
+
+    // 会话内设备 / 指标下标上限，单个样本的指标数上限，每个会话的 DEFINE 条数上限（含重定义）
+    static constexpr std::size_t kMaxNames = 4096;
+    static constexpr std::size_t kMaxDefines = 4 * kMaxNames;
+    static constexpr std::size_t kMaxMetricsPerSample = 256;
+
+    /**
+     * @param sink 写入存储（通常为 ReportHandler::storeBatch）
+     * @param window 确认窗口（REPORT 条数）
+     */
+    IngestSession(Sink sink, std::size_t window);
+    ~IngestSession();
+    IngestSession(const IngestSession&) = delete;
+    IngestSession& operator=(const IngestSession&) = delete;
+
+    // 握手后发送的第一条消息（READY）
+    void greeting(std::string& out) const;
+
+    // TcpServer::MessageHandler：处理一条消息，需要回复时写入 reply；协议错误返回 false
+    bool onMessage(std::string_view message, bool more, std::string& reply);
+
+private:
+    // 会话下标对应的名字；id 在首次被 REPORT 引用时才驻留，之前为 find() 的结果（可能无效）
+    struct Name {
+        std::string text;
+        InternId id = InternTable::kInvalidId;
+    };
+
+    static InternId resolve(Name& name);
+    bool define(ByteReader& reader, std::string& error);
+    bool report(ByteReader& reader, std::string& error);
+    // 写入累积的样本并写入 ACK；写入失败时写入 ERROR 并返回 false
+    bool flush(std::string& reply);
+
+    Sink sink_;
+    std::size_t window_;
+    std::vector<Name> devices_;            // 会话下标 → 名字
+    std::vector<long long> lastTimestamp_; // 与 devices_ 对应，增量解码的基准
+    std::vector<Name> metrics_;
+    std::size_t defines_ = 0;  // 已收到的 DEFINE 数
+    BatchReportRequest batch_;
+    std::size_t unacked_ = 0;  // 已收到、尚未确认的 REPORT 数
+    uint64_t lastSeq_ = 0;
+};
@@ -1,9 +1,180 @@
 #include "ReportHandler.hpp"
+#include "net/EventHub.hpp"
 #include "utils/Logger.hpp"
-#include <sstream>
+#include "utils/RequestArena.hpp"
+#include "utils/Tracer.hpp"
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// URL 解码：%XX 转义与 '+' 转空格，结果写入 out
+static void urlDecode(std::string_view s, std::pmr::string& out) {
+    out.clear();
+    out.reserve(s.size());
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() &&
+                   std::isxdigit(static_cast<unsigned char>(s[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(s[i + 2]))) {
+            int c = 0;
+            std::from_chars(s.data() + i + 1, s.data() + i + 3, c, 16);
+            out += static_cast<char>(c);
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+}
+
+// 遍历 key=value&key=value，跳过不含 '=' 的片段
+template <typename Fn>
+static void forEachQueryParam(std::string_view queryStr, Fn&& fn) {
+    while (!queryStr.empty()) {
+        std::size_t amp = queryStr.find('&');
+        std::string_view token = queryStr.substr(0, amp);
+        queryStr = amp == std::string_view::npos ? std::string_view() : queryStr.substr(amp + 1);
+        std::size_t pos = token.find('=');
+        if (pos == std::string_view::npos) continue;
+        fn(token.substr(0, pos), token.substr(pos + 1));
+    }
+}
+
+// 整数参数：整段都是数字才接受，否则返回 false 且不修改 out（"12abc" 不接受）
+template <typename T>
+static bool parseNumber(std::string_view value, T& out) {
+    T parsed{};
+    const char* end = value.data() + value.size();
+    auto res = std::from_chars(value.data(), end, parsed);
+    if (res.ec != std::errc() || res.ptr != end) return false;
+    out = parsed;
+    return true;
+}
+
+static Histogram& storeHistogram(const char* op) {
+    return Metrics::getInstance().histogram("device_server_store_duration_seconds",
+                                            "Time spent in storage calls", std::string("op=\"") + op + "\"");
+}
+
+static JsonValue okResponse(std::pmr::memory_resource* mr) {
+    JsonValue::Object resp(mr);
+    resp.emplace("code", JsonValue(0LL));
+    resp.emplace("message", JsonValue("ok", mr));
+    return JsonValue(std::move(resp));
+}
+
+static JsonValue queryResponse(std::string_view deviceId, const std::vector<DataPoint>& data,
+                               std::pmr::memory_resource* mr) {
+    InternTable& names = InternTable::getInstance();
+    JsonValue::Object resp(mr);
+    resp.emplace("device_id", JsonValue(deviceId, mr));
+    
+    JsonValue::Array dataArray(mr);
+    dataArray.reserve(data.size());
+    for (const auto& point : data) {
+        JsonValue::Object item(mr);
+        item.emplace("timestamp", JsonValue(point.timestamp));
+        for (const Metric& metric : point.metrics) {
+            item.emplace(names.name(metric.name), JsonValue(metric.value));
+        }
+        dataArray.emplace_back(std::move(item));
+    }
+    resp.emplace("data", JsonValue(std::move(dataArray)));
+    return JsonValue(std::move(resp));
+}
+
+static JsonValue requirementQueryResponse(const RequirementQueryResult& result, std::pmr::memory_resource* mr) {
+    JsonValue::Array dataArray(mr);
+    dataArray.reserve(result.data.size());
+    for (const auto& r : result.data) {
+        JsonValue::Object item(mr);
+        item.emplace("id", JsonValue(r.id));
+        item.emplace("title", JsonValue(r.title, mr));
+        item.emplace("content", JsonValue(r.content, mr));
+        item.emplace("willing_to_pay", r.willing_to_pay < 0 ? JsonValue(nullptr) : JsonValue(r.willing_to_pay));
+        item.emplace("contact", JsonValue(r.contact, mr));
+        item.emplace("notes", JsonValue(r.notes, mr));
+        item.emplace("created_at", JsonValue(r.created_at, mr));
+        item.emplace("updated_at", JsonValue(r.updated_at, mr));
+        dataArray.emplace_back(std::move(item));
+    }
+    
+    JsonValue::Object resp(mr);
+    resp.emplace("code", JsonValue(0LL));
+    resp.emplace("data", JsonValue(std::move(dataArray)));
+    resp.emplace("total", JsonValue(result.total));
+    resp.emplace("page", JsonValue(result.page));
+    resp.emplace("limit", JsonValue(result.limit));
+    return JsonValue(std::move(resp));
+}
+
+// 需求查询缓存键：参数已规范化（默认值、上下限），等价的查询串映射到同一个键
+static void requirementCacheKey(const RequirementQueryRequest& req, std::pmr::string& key) {
+    char prefix[64];
+    int n = std::snprintf(prefix, sizeof(prefix), "%d|%d|%d|", req.page, req.limit, req.willingToPay);
+    key.reserve(static_cast<std::size_t>(n) + req.keyword.size());
+    key.append(prefix, static_cast<std::size_t>(n));
+    key.append(req.keyword);
+}
 
 ReportHandler::ReportHandler(StoreInterface& store, DeviceManager& deviceMgr)
-    : store_(store), deviceMgr_(deviceMgr) {
+    : store_(store), deviceMgr_(deviceMgr),
+      appendTime_(storeHistogram("append")),
+      appendBatchTime_(storeHistogram("append_batch")),
+      queryLatestTime_(storeHistogram("query_latest")),
+      appendRequirementTime_(storeHistogram("append_requirement")),
+      queryRequirementsTime_(storeHistogram("query_requirements")) {
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "W/\"%llx-", static_cast<unsigned long long>(
+        std::chrono::system_clock::now().time_since_epoch().count() ^ std::random_device()()));
+    etagPrefix_ = prefix;
+}
+
+std::string ReportHandler::deviceTopic(std::string_view deviceId) {
+    std::string topic("device/");
+    topic += deviceId;
+    return topic;
+}
+
+template <typename MetricRange>
+bool ReportHandler::reportEvent(InternId deviceId, long long timestamp, const MetricRange& metrics,
+                                std::string& topic, std::string& data) const {
+    if (!events_ || !events_->active()) return false;
+    InternTable& names = InternTable::getInstance();
+    topic = deviceTopic(names.name(deviceId));
+    if (!events_->hasSubscribers(topic)) return false;
+    
+    RequestArena arena;
+    std::pmr::memory_resource* mr = arena.resource();
+    JsonValue::Object metricsObj(mr);
+    for (const Metric& metric : metrics) {
+        metricsObj.emplace(names.name(metric.name), JsonValue(metric.value));
+    }
+    JsonValue::Object event(mr);
+    event.emplace("device_id", JsonValue(names.name(deviceId), mr));
+    event.emplace("timestamp", JsonValue(timestamp));
+    event.emplace("metrics", JsonValue(std::move(metricsObj)));
+    std::pmr::string body(mr);
+    JsonParser::stringifyTo(JsonValue(std::move(event)), body);
+    data.assign(body);
+    return true;
+}
+
+void ReportHandler::publishRequirement(const Requirement& r) const {
+    if (!events_ || !events_->hasSubscribers(kRequirementTopic)) return;
+    RequestArena arena;
+    std::pmr::memory_resource* mr = arena.resource();
+    JsonValue::Object event(mr);
+    event.emplace("title", JsonValue(r.title, mr));
+    event.emplace("content", JsonValue(r.content, mr));
+    event.emplace("willing_to_pay", r.willing_to_pay < 0 ? JsonValue(nullptr) : JsonValue(r.willing_to_pay));
+    event.emplace("contact", JsonValue(r.contact, mr));
+    event.emplace("notes", JsonValue(r.notes, mr));
+    std::pmr::string body(mr);
+    JsonParser::stringifyTo(JsonValue(std::move(event)), body);
+    events_->publish(kRequirementTopic, "requirement", body);
 }
 
 bool ReportHandler::parseReportRequest(const JsonValue& json, ReportRequest& req) {
@@ -14,8 +185,8 @@ bool ReportHandler::parseReportRequest(const JsonValue& json, ReportRequest& req
     if (!json.has("device_id") || !json.get("device_id").isString()) {
         return false;
     }
-    req.deviceId = json.get("device_id").asString();
-    if (req.deviceId.empty()) {
+    const JsonValue::String& deviceId = json.get("device_id").asString();
+    if (deviceId.empty()) {
         return false;
     }
     
@@ -28,81 +199,335 @@ bool ReportHandler::parseReportRequest(const JsonValue& json, ReportRequest& req
         return false;
     }
     
+    // JSON 对象的键本身不重复，直接驻留即可
+    InternTable& names = InternTable::getInstance();
     const auto& metricsObj = json.get("metrics").asObject();
+    req.metrics.reserve(metricsObj.size());
     for (const auto& [key, value] : metricsObj) {
         if (value.isNumber()) {
-            req.metrics[key] = value.asDouble();
+            req.metrics.push_back(Metric{names.intern(key), value.asDouble()});
         }
     }
+    if (req.metrics.empty()) {
+        return false;
+    }
     
-    return !req.metrics.empty();
+    req.deviceId = names.intern(deviceId);
+    return true;
 }
 
-bool ReportHandler::parseQueryRequest(const std::string& queryStr, QueryRequest& req) {
+bool ReportHandler::parseBatchReportRequest(std::string_view body, BatchReportRequest& req) {
+    bool ok = JsonParser::forEach(body, [&req](const JsonValue& item) {
+        if (req.accepted + req.rejected >= kMaxBatchPoints) {
+            return false;
+        }
+        ReportRequest single;
+        if (!parseReportRequest(item, single)) {
+            ++req.rejected;
+            return true;
+        }
+        DataPoint point;
+        point.timestamp = single.timestamp;
+        point.metrics.assign(single.metrics.begin(), single.metrics.end());
+        req.points[single.deviceId].push_back(std::move(point));
+        ++req.accepted;
+        return true;
+    });
+    return ok && req.accepted > 0;
+}
+
+bool ReportHandler::parseQueryRequest(std::string_view queryStr, QueryRequest& req) {
     // 简单解析：device_id=xxx&limit=100
-    std::istringstream iss(queryStr);
-    std::string token;
     bool hasDeviceId = false;
     req.limit = 100; // 默认值
     
-    while (std::getline(iss, token, '&')) {
-        size_t pos = token.find('=');
-        if (pos == std::string::npos) continue;
-        
-        std::string key = token.substr(0, pos);
-        std::string value = token.substr(pos + 1);
-        
+    forEachQueryParam(queryStr, [&](std::string_view key, std::string_view value) {
         if (key == "device_id") {
-            req.deviceId = value;
+            req.deviceId.assign(value);
             hasDeviceId = true;
         } else if (key == "limit") {
-            try {
-                req.limit = std::stoull(value);
-                if (req.limit > 1000) req.limit = 1000; // 上限
-            } catch (...) {
+            if (!parseNumber(value, req.limit)) {
                 req.limit = 100;
+            } else if (req.limit > 1000) {
+                req.limit = 1000; // 上限
             }
         }
-    }
+    });
     
     return hasDeviceId && !req.deviceId.empty();
 }
 
-JsonValue ReportHandler::handleReport(const ReportRequest& req) {
+JsonValue ReportHandler::handleReport(const ReportRequest& req, std::pmr::memory_resource* mr) {
     // 自动注册设备
     deviceMgr_.ensureRegistered(req.deviceId);
     
-    // 构造数据点
+    // 构造数据点（存储持有的数据需独立于请求分配区）
     DataPoint point;
     point.timestamp = req.timestamp;
-    point.metrics = req.metrics;
+    point.metrics.assign(req.metrics.begin(), req.metrics.end());
+    
+    // 写入存储
+    {
+        TRACE_SPAN("store.append");
+        ScopedTimer timer(&appendTime_);
+        store_.append(req.deviceId, point);
+    }
     
-    // 写入内存存储
-    store_.append(req.deviceId, point);
+    std::string topic, data;
+    if (reportEvent(req.deviceId, req.timestamp, req.metrics, topic, data)) {
+        events_->publish(topic, "data", data);
+    }
+    return okResponse(mr);
+}
+
+JsonValue ReportHandler::handleBatchReport(const BatchReportRequest& req, std::pmr::memory_resource* mr) {
+    storeBatch(req);
     
-    // 返回成功响应
-    std::unordered_map<std::string, JsonValue> resp;
-    resp["code"] = JsonValue(0LL);
-    resp["message"] = JsonValue(std::string("ok"));
-    return JsonValue(resp);
+    JsonValue::Object resp(mr);
+    resp.emplace("code", JsonValue(0LL));
+    resp.emplace("message", JsonValue("ok", mr));
+    resp.emplace("accepted", JsonValue(req.accepted));
+    resp.emplace("rejected", JsonValue(req.rejected));
+    return JsonValue(std::move(resp));
 }
 
-JsonValue ReportHandler::handleQuery(const QueryRequest& req) {
-    auto data = store_.queryLatest(req.deviceId, req.limit);
+bool ReportHandler::storeBatch(const BatchReportRequest& req) {
+    for (const auto& [deviceId, points] : req.points) {
+        deviceMgr_.ensureRegistered(deviceId);
+        TRACE_SPAN("store.appendBatch");
+        ScopedTimer timer(&appendBatchTime_);
+        if (!store_.appendBatch(deviceId, points)) return false;
+    }
     
-    std::unordered_map<std::string, JsonValue> resp;
-    resp["device_id"] = JsonValue(req.deviceId);
+    if (events_ && events_->active()) {
+        std::string topic, data;
+        for (const auto& [deviceId, points] : req.points) {
+            for (const DataPoint& point : points) {
+                if (!reportEvent(deviceId, point.timestamp, point.metrics, topic, data)) break;
+                events_->publish(topic, "data", data);
+            }
+        }
+    }
+    return true;
+}
+
+JsonValue ReportHandler::handleQuery(const QueryRequest& req, std::pmr::memory_resource* mr) {
+    // 查询参数来自客户端，只查找不驻留：未知设备没有数据
+    InternId deviceId = InternTable::getInstance().find(req.deviceId);
+    std::vector<DataPoint> data;
+    if (deviceId != InternTable::kInvalidId) {
+        TRACE_SPAN("store.queryLatest");
+        ScopedTimer timer(&queryLatestTime_);
+        data = store_.queryLatest(deviceId, req.limit);
+    }
     
-    std::vector<JsonValue> dataArray;
-    for (const auto& point : data) {
-        std::unordered_map<std::string, JsonValue> item;
-        item["timestamp"] = JsonValue(point.timestamp);
-        for (const auto& [key, value] : point.metrics) {
-            item[key] = JsonValue(value);
+    return queryResponse(req.deviceId, data, mr);
+}
+
+bool ReportHandler::parseRequirementReportRequest(const JsonValue& json, RequirementReportRequest& req) {
+    if (!json.isObject()) {
+        return false;
+    }
+    
+    if (!json.get("title").isString() || !json.get("content").isString()) {
+        return false;
+    }
+    req.title.assign(json.get("title").asString());
+    req.content.assign(json.get("content").asString());
+    if (req.title.empty() || req.content.empty()) {
+        return false;
+    }
+    
+    // willing_to_pay 可为 null / 缺省
+    const JsonValue& pay = json.get("willing_to_pay");
+    if (pay.isNumber()) {
+        long long v = pay.asInt();
+        if (v != 0 && v != 1) return false;
+        req.willingToPay = static_cast<int>(v);
+    } else if (!pay.isNull()) {
+        return false;
+    }
+    
+    if (json.get("contact").isString()) {
+        req.contact.assign(json.get("contact").asString());
+    }
+    if (json.get("notes").isString()) {
+        req.notes.assign(json.get("notes").asString());
+    }
+    return true;
+}
+
+void ReportHandler::parseRequirementQueryRequest(std::string_view queryStr, RequirementQueryRequest& req) {
+    // page=1&limit=20&willing_to_pay=1&keyword=xxx
+    std::pmr::string value(req.keyword.get_allocator());
+    
+    forEachQueryParam(queryStr, [&](std::string_view key, std::string_view raw) {
+        urlDecode(raw, value);
+        // 非法数值保持默认值
+        if (key == "page") {
+            parseNumber(std::string_view(value), req.page);
+        } else if (key == "limit") {
+            parseNumber(std::string_view(value), req.limit);
+        } else if (key == "willing_to_pay") {
+            parseNumber(std::string_view(value), req.willingToPay);
+        } else if (key == "keyword") {
+            req.keyword = value;
+        }
+    });
+    
+    if (req.page < 1) req.page = 1;
+    if (req.limit < 1) req.limit = 20;
+    if (req.limit > 100) req.limit = 100; // 上限
+    if (req.willingToPay < -1 || req.willingToPay > 2) req.willingToPay = -1;
+}
+
+JsonValue ReportHandler::handleRequirementReport(const RequirementReportRequest& req, std::pmr::memory_resource* mr) {
+    Requirement r;
+    r.title.assign(req.title);
+    r.content.assign(req.content);
+    r.willing_to_pay = req.willingToPay;
+    r.contact.assign(req.contact);
+    r.notes.assign(req.notes);
+    {
+        TRACE_SPAN("store.appendRequirement");
+        ScopedTimer timer(&appendRequirementTime_);
+        store_.appendRequirement(r);
+    }
+    
+    publishRequirement(r);
+    return okResponse(mr);
+}
+
+RequirementQueryResult ReportHandler::queryRequirements(const RequirementQueryRequest& req) {
+    TRACE_SPAN("store.queryRequirements");
+    ScopedTimer timer(&queryRequirementsTime_);
+    return store_.queryRequirements(req.page, req.limit, req.willingToPay, std::string(req.keyword));
+}
+
+JsonValue ReportHandler::handleRequirementQuery(const RequirementQueryRequest& req, std::pmr::memory_resource* mr) {
+    return requirementQueryResponse(queryRequirements(req), mr);
+}
+
+static std::pmr::string makeETag(const std::string& prefix, char kind, uint64_t version,
+                                 std::pmr::memory_resource* mr) {
+    char buf[64];
+    int n = std::snprintf(buf, sizeof(buf), "%s%c%llx\"", prefix.c_str(), kind,
+                          static_cast<unsigned long long>(version));
+    return std::pmr::string(buf, static_cast<std::size_t>(n), mr);
+}
+
+std::pmr::string ReportHandler::queryETag(const QueryRequest& req, std::pmr::memory_resource* mr) const {
+    if (!conditionalRequests_) return std::pmr::string(mr);
+    // 与 handleQuery 一致只查找：未知设备没有数据，版本号为 0
+    InternId deviceId = InternTable::getInstance().find(req.deviceId);
+    uint64_t version = deviceId == InternTable::kInvalidId ? 0 : store_.deviceVersion(deviceId);
+    return makeETag(etagPrefix_, 'd', version, mr);
+}
+
+std::pmr::string ReportHandler::requirementQueryETag(std::pmr::memory_resource* mr) const {
+    if (!conditionalRequests_) return std::pmr::string(mr);
+    return makeETag(etagPrefix_, 'r', store_.requirementVersion(), mr);
+}
+
+void ReportHandler::enableRequirementCache(std::size_t maxBytes) {
+    requirementCache_.reset(maxBytes > 0 ? new ResponseCache(maxBytes) : nullptr);
+}
+
+bool ReportHandler::resizeRequirementCache(std::size_t maxBytes) {
+    // 缓存对象在处理请求期间被无锁读取，运行中只调整上限、不创建或销毁
+    if (!requirementCache_) return maxBytes == 0;
+    requirementCache_->setMaxBytes(maxBytes);
+    return true;
+}
+
+void ReportHandler::handleRequirementQueryTo(const RequirementQueryRequest& req, std::pmr::string& body,
+                                             std::pmr::memory_resource* mr) {
+    if (!requirementCache_) {
+        JsonParser::stringifyTo(handleRequirementQuery(req, mr), body);
+        return;
+    }
+    
+    std::pmr::string key(mr);
+    requirementCacheKey(req, key);
+    
+    // 先取版本号再查询：查询期间有写入时，这次的结果存入后下次读取即失效
+    uint64_t version = store_.requirementVersion();
+    if (requirementCache_->get(key, version, body)) return;
+    
+    std::size_t start = body.size();
+    RequirementQueryResult result = queryRequirements(req);
+    JsonParser::stringifyTo(requirementQueryResponse(result, mr), body);
+    // 查询失败时的空结果不缓存，否则存储恢复后仍返回空列表直到有新写入
+    if (result.ok) requirementCache_->put(key, version, std::string_view(body).substr(start));
+}
+
+void ReportHandler::handleReportAsync(const ReportRequest& req, std::function<void(BodyWriter)> done) {
+    deviceMgr_.ensureRegistered(req.deviceId);
+    
+    DataPoint point;
+    point.timestamp = req.timestamp;
+    point.metrics.assign(req.metrics.begin(), req.metrics.end());
+    
+    // 事件在写入完成后、于工作线程中发布（不占用存储的 I/O 线程）
+    std::string topic, data;
+    bool publish = reportEvent(req.deviceId, req.timestamp, req.metrics, topic, data);
+    
+    auto start = std::chrono::steady_clock::now();
+    store_.appendAsync(req.deviceId, std::move(point),
+        [this, start, publish, topic = std::move(topic), data = std::move(data), done = std::move(done)]() {
+            appendTime_.recordSince(start);
+            done([this, publish, topic, data](std::pmr::string& body) {
+                if (publish) events_->publish(topic, "data", data);
+                JsonParser::stringifyTo(okResponse(body.get_allocator().resource()), body);
+            });
+        });
+}
+
+void ReportHandler::handleQueryAsync(const QueryRequest& req, std::function<void(BodyWriter)> done) {
+    InternId deviceId = InternTable::getInstance().find(req.deviceId);
+    if (deviceId == InternTable::kInvalidId) {
+        done([name = std::string(req.deviceId)](std::pmr::string& body) {
+            JsonParser::stringifyTo(queryResponse(name, {}, body.get_allocator().resource()), body);
+        });
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    store_.queryLatestAsync(deviceId, req.limit,
+        [this, start, name = std::string(req.deviceId), done = std::move(done)](std::vector<DataPoint> data) {
+            queryLatestTime_.recordSince(start);
+            done([name, data = std::move(data)](std::pmr::string& body) {
+                JsonParser::stringifyTo(queryResponse(name, data, body.get_allocator().resource()), body);
+            });
+        });
+}
+
+void ReportHandler::handleRequirementQueryAsync(const RequirementQueryRequest& req,
+                                                std::function<void(BodyWriter)> done) {
+    std::string key;
+    uint64_t version = 0;
+    if (requirementCache_) {
+        std::pmr::string pmrKey;
+        requirementCacheKey(req, pmrKey);
+        key.assign(pmrKey);
+        // 与 handleRequirementQueryTo 相同：先取版本号再查询
+        version = store_.requirementVersion();
+        std::pmr::string cached;
+        if (requirementCache_->get(key, version, cached)) {
+            done([cached = std::move(cached)](std::pmr::string& body) { body.append(cached); });
+            return;
         }
-        dataArray.push_back(JsonValue(item));
     }
-    resp["data"] = JsonValue(dataArray);
     
-    return JsonValue(resp);
+    auto start = std::chrono::steady_clock::now();
+    store_.queryRequirementsAsync(req.page, req.limit, req.willingToPay, std::string(req.keyword),
+        [this, start, key = std::move(key), version, done = std::move(done)](RequirementQueryResult result) {
+            queryRequirementsTime_.recordSince(start);
+            done([this, key, version, result = std::move(result)](std::pmr::string& body) {
+                std::size_t begin = body.size();
+                JsonParser::stringifyTo(requirementQueryResponse(result, body.get_allocator().resource()), body);
+                if (requirementCache_ && result.ok) {
+                    requirementCache_->put(key, version, std::string_view(body).substr(begin));
+                }
+            });
+        });
 }
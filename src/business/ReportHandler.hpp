@@ -1,26 +1,72 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+#include <memory_resource>
 #include "storage/StoreInterface.hpp"
 #include "business/DeviceManager.hpp"
 #include "utils/JsonParser.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/ResponseCache.hpp"
 
+class EventHub;
+
+// 单次请求内的结构体使用 pmr 容器，可分配在请求级分配区上；写入存储时再拷贝为 std 类型
+// 设备 ID 与指标名在解析时驻留为 InternId，后续各层只处理整数 id
 struct ReportRequest {
-    std::string deviceId;
-    long long timestamp;
-    std::unordered_map<std::string, double> metrics;
+    explicit ReportRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : metrics(mr) {}
+
+    InternId deviceId = InternTable::kInvalidId;
+    long long timestamp = 0;
+    std::pmr::vector<Metric> metrics;
+};
+
+// 批量上报：按设备分组的数据点
+struct BatchReportRequest {
+    std::unordered_map<InternId, std::vector<DataPoint>> points;
+    std::size_t accepted = 0;
+    std::size_t rejected = 0;
 };
 
 struct QueryRequest {
-    std::string deviceId;
-    std::size_t limit;
+    explicit QueryRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : deviceId(mr) {}
+
+    std::pmr::string deviceId;
+    std::size_t limit = 100;
+};
+
+struct RequirementReportRequest {
+    explicit RequirementReportRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : title(mr), content(mr), contact(mr), notes(mr) {}
+
+    std::pmr::string title;
+    std::pmr::string content;
+    int willingToPay = -1;  // -1 表示未填
+    std::pmr::string contact;
+    std::pmr::string notes;
+};
+
+struct RequirementQueryRequest {
+    explicit RequirementQueryRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : keyword(mr) {}
+
+    int page = 1;
+    int limit = 20;
+    int willingToPay = -1;  // -1 表示不过滤
+    std::pmr::string keyword;
 };
 
 /**
  * 业务处理类
  * 处理设备数据上报和查询请求
  * 支持多态存储（MemoryStore / MySQLStore）
+ * handleXxx 的响应 JSON 分配在 mr 上（通常为请求级分配区）
  */
 class ReportHandler {
 public:
@@ -32,18 +78,116 @@ public:
     ReportHandler(StoreInterface& store, DeviceManager& deviceMgr);
     
     // 处理上报请求
-    JsonValue handleReport(const ReportRequest& req);
+    JsonValue handleReport(const ReportRequest& req,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    // 处理批量上报请求（每个设备一次 appendBatch）
+    JsonValue handleBatchReport(const BatchReportRequest& req,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    /**
+     * 写入批量数据点（注册设备、每个设备一次 appendBatch、发布事件），不生成响应。
+     * 任一设备写入失败时停止并返回 false（之前的设备可能已写入），不发布事件
+     */
+    bool storeBatch(const BatchReportRequest& req);
     
     // 处理查询请求
-    JsonValue handleQuery(const QueryRequest& req);
+    JsonValue handleQuery(const QueryRequest& req,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    // 处理需求上报请求
+    JsonValue handleRequirementReport(const RequirementReportRequest& req,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    // 处理需求查询请求
+    JsonValue handleRequirementQuery(const RequirementQueryRequest& req,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    /**
+     * 处理需求查询请求并把响应 JSON 追加到 body
+     * 启用缓存时按规范化后的查询参数返回已序列化的结果，需求写入后自动失效
+     */
+    void handleRequirementQueryTo(const RequirementQueryRequest& req, std::pmr::string& body,
+        std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    
+    /**
+     * 非阻塞处理（存储 supportsAsync() 时使用）：数据库往返在存储自己的 I/O 线程上进行，
+     * 调用线程不等待。done 在结果就绪时调用一次，参数 BodyWriter 把响应 JSON 追加到 body，
+     * 应转交到工作线程执行（body 的分配器同时用于构造响应 JSON）
+     */
+    using BodyWriter = std::function<void(std::pmr::string& body)>;
+    bool asyncStore() const { return store_.supportsAsync(); }
+    void handleReportAsync(const ReportRequest& req, std::function<void(BodyWriter)> done);
+    void handleQueryAsync(const QueryRequest& req, std::function<void(BodyWriter)> done);
+    // 与 handleRequirementQueryTo 共用结果缓存，命中时直接回调
+    void handleRequirementQueryAsync(const RequirementQueryRequest& req, std::function<void(BodyWriter)> done);
+    
+    /**
+     * 查询结果的弱 ETag，只读取存储版本号、不执行查询：数据变化后必然不同。
+     * 带进程实例前缀，重启后客户端持有的旧 ETag 不会误匹配。
+     * 应在执行查询之前取得，查询期间的写入只会让下次请求多一次完整响应。
+     * 关闭条件请求后返回空串（响应不带 ETag）
+     */
+    std::pmr::string queryETag(const QueryRequest& req, std::pmr::memory_resource* mr) const;
+    std::pmr::string requirementQueryETag(std::pmr::memory_resource* mr) const;
+    // 版本号只反映本进程的写入：多实例共用一个 MySQL 库时应关闭，否则其他实例的写入被 304 掩盖
+    void setConditionalRequests(bool enabled) { conditionalRequests_ = enabled; }
+    
+    /**
+     * 启用需求查询结果缓存
+     * @param maxBytes 缓存内存上限，0 表示不缓存
+     */
+    void enableRequirementCache(std::size_t maxBytes);
+    // 运行时调整需求查询缓存上限；启动时未启用缓存则返回 false（需重启生效）
+    bool resizeRequirementCache(std::size_t maxBytes);
+    
+    /**
+     * 启用事件推送：上报的数据点与新需求发布到 hub（有订阅者时才序列化）。
+     * 设备数据的主题为 deviceTopic(device_id)，事件名 data；新需求的主题为 kRequirementTopic，事件名 requirement
+     */
+    void setEventHub(EventHub* hub) { events_ = hub; }
+    static std::string deviceTopic(std::string_view deviceId);
+    static constexpr const char* kRequirementTopic = "requirements";
     
     // 从 JSON 解析上报请求
     static bool parseReportRequest(const JsonValue& json, ReportRequest& req);
     
+    // 从 JSON 数组或 NDJSON 请求体解析批量上报请求（单次遍历，按设备分组）
+    static bool parseBatchReportRequest(std::string_view body, BatchReportRequest& req);
+    
     // 从 URL 参数解析查询请求
-    static bool parseQueryRequest(const std::string& queryStr, QueryRequest& req);
+    static bool parseQueryRequest(std::string_view queryStr, QueryRequest& req);
+    
+    // 从 JSON 解析需求上报请求
+    static bool parseRequirementReportRequest(const JsonValue& json, RequirementReportRequest& req);
+    
+    // 从 URL 参数解析需求查询请求（缺省参数使用默认值）
+    static void parseRequirementQueryRequest(std::string_view queryStr, RequirementQueryRequest& req);
+
+    // 单次批量上报的数据点上限
+    static constexpr std::size_t kMaxBatchPoints = 10000;
 
 private:
     StoreInterface& store_;
     DeviceManager& deviceMgr_;
+
+    // 各类存储操作耗时（device_server_store_duration_seconds{op=...}）
+    Histogram& appendTime_;
+    Histogram& appendBatchTime_;
+    Histogram& queryLatestTime_;
+    Histogram& appendRequirementTime_;
+    Histogram& queryRequirementsTime_;
+
+    // 有订阅者时把数据点序列化为事件（格式同上报请求体），返回 false 表示无需发布
+    template <typename MetricRange>
+    bool reportEvent(InternId deviceId, long long timestamp, const MetricRange& metrics,
+                     std::string& topic, std::string& data) const;
+    void publishRequirement(const Requirement& r) const;
+    // 计时执行存储的需求查询
+    RequirementQueryResult queryRequirements(const RequirementQueryRequest& req);
+
+    std::unique_ptr<ResponseCache> requirementCache_;
+    EventHub* events_ = nullptr;
+    std::string etagPrefix_;  // W/"<实例 id>-
+    bool conditionalRequests_ = true;
 };
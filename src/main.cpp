@@ -1,19 +1,34 @@
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
 #include <atomic>
 #include <thread>
 #include <chrono>
 #include <memory>
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <fstream>
+#include <set>
 
 #include "utils/Logger.hpp"
 #include "utils/Config.hpp"
 #include "net/TcpServer.hpp"
 #include "net/HttpParser.hpp"
+#include "net/EventHub.hpp"
+#include "net/WebSocket.hpp"
+#include "net/ListenerHandoff.hpp"
 #include "business/ReportHandler.hpp"
+#include "business/IngestSession.hpp"
+#include "business/DeviceManager.hpp"
 #include "storage/MemoryStore.hpp"
 #include "storage/StoreInterface.hpp"
 #include "utils/JsonParser.hpp"
+#include "utils/RequestArena.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
 #include "thread/ThreadPool.hpp"
+#include "thread/CpuAffinity.hpp"
 
 #ifdef ENABLE_MYSQL
 #include "storage/MySQLStore.hpp"
@@ -21,12 +36,312 @@
 #endif
 
 static std::atomic<bool> g_running{true};
+static std::atomic<bool> g_dumpTrace{false};
+static std::atomic<bool> g_reloadConfig{false};
+static std::atomic<bool> g_drain{false};   // 排空后退出：SIGTERM 或监听 socket 已交给新进程
+static std::atomic<bool> g_ready{false};   // /api/v1/health 的就绪状态，排空时置 false
 
+// SIGINT：立即退出
 void signalHandler(int sig) {
     (void)sig;
     g_running = false;
 }
 
+// SIGTERM：停止 accept，排空连接后退出
+void drainHandler(int sig) {
+    (void)sig;
+    g_drain = true;
+}
+
+// SIGUSR2：由主循环把追踪数据写到当前目录的 trace-<时间戳>.json
+void traceDumpHandler(int sig) {
+    (void)sig;
+    g_dumpTrace = true;
+}
+
+// SIGHUP：由主循环重新加载配置
+void reloadHandler(int sig) {
+    (void)sig;
+    g_reloadConfig = true;
+}
+
+static void dumpTraceToFile() {
+    std::string path = "trace-" + std::to_string(std::time(nullptr)) + ".json";
+    std::string json;
+    Tracer::dumpChromeJson(json);
+    std::ofstream out(path, std::ios::binary);
+    if (!out || !out.write(json.data(), static_cast<std::streamsize>(json.size()))) {
+        LOG_ERROR("Failed to write trace file " + path);
+        return;
+    }
+    LOG_INFO("Trace written to " + path);
+}
+
+// 按路由统计的请求耗时与解析耗时，启动时注册一次，请求处理中直接引用
+struct HttpMetrics {
+    static Histogram& route(const char* path) {
+        return Metrics::getInstance().histogram("device_server_http_request_duration_seconds",
+                                                "HTTP request handling time by route",
+                                                std::string("route=\"") + path + "\"");
+    }
+    static Histogram& parse(const char* stage) {
+        return Metrics::getInstance().histogram("device_server_http_parse_duration_seconds",
+                                                "Request parsing time (stage=http: request line and headers, body: JSON body)",
+                                                std::string("stage=\"") + stage + "\"");
+    }
+
+    Histogram& health = route("/api/v1/health");
+    Histogram& metrics = route("/api/v1/metrics");
+    Histogram& trace = route("/api/v1/admin/trace");
+    Histogram& adminReload = route("/api/v1/admin/reload");
+    Histogram& report = route("/api/v1/report");
+    Histogram& reportBatch = route("/api/v1/report/batch");
+    Histogram& query = route("/api/v1/query");
+    Histogram& requirementReport = route("/api/v1/requirement/report");
+    Histogram& requirementQuery = route("/api/v1/requirement/query");
+    Histogram& stream = route("/api/v1/stream");
+    Histogram& wsReport = route("/api/v1/ws/report");
+    Histogram& other = route("other");
+    Histogram& parseHttp = parse("http");
+    Histogram& parseBody = parse("body");
+};
+
+// 非阻塞存储路径的完成回调：结果就绪后在线程池中生成响应（etag 为空时不带 ETag）
+static std::function<void(ReportHandler::BodyWriter)> respondWhenReady(DeferredResponse deferred, std::string etag) {
+    return [deferred = std::move(deferred), etag = std::move(etag)](ReportHandler::BodyWriter write) {
+        deferred.resume([write = std::move(write), etag](std::string& response) {
+            RequestArena arena;
+            std::pmr::string body(arena.resource());
+            write(body);
+            HttpParser::buildCacheableResponse(response, body, etag, arena.resource());
+        });
+    };
+}
+
+// 单个事件流连接可订阅的设备数上限
+static constexpr std::size_t kMaxStreamDevices = 64;
+
+// /api/v1/stream 的订阅主题：device_id 为逗号分隔的设备列表，requirements=1 订阅新需求
+static bool parseStreamTopics(std::string_view query, std::vector<std::string>& topics) {
+    std::string_view devices = HttpParser::queryParam(query, "device_id");
+    while (!devices.empty()) {
+        std::size_t comma = devices.find(',');
+        std::string_view id = devices.substr(0, comma);
+        devices = comma == std::string_view::npos ? std::string_view() : devices.substr(comma + 1);
+        if (id.empty()) continue;
+        if (topics.size() == kMaxStreamDevices) return false;
+        topics.push_back(ReportHandler::deviceTopic(id));
+    }
+    if (HttpParser::queryParam(query, "requirements") == "1") {
+        topics.emplace_back(ReportHandler::kRequirementTopic);
+    }
+    return !topics.empty();
+}
+
+#ifdef ENABLE_MYSQL
+// [mysql] replicas：逗号分隔的 host[:port]，其余连接参数沿用主库
+static std::vector<MySQLConfig> parseReplicas(std::string_view list, const MySQLConfig& primary) {
+    std::vector<MySQLConfig> replicas;
+    while (!list.empty()) {
+        std::size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (item.empty()) continue;
+        MySQLConfig replica = primary;
+        std::size_t colon = item.rfind(':');
+        replica.host.assign(item.substr(0, colon));
+        if (colon != std::string_view::npos) {
+            std::string_view port = item.substr(colon + 1);
+            auto res = std::from_chars(port.data(), port.data() + port.size(), replica.port);
+            if (res.ec != std::errc() || res.ptr != port.data() + port.size()) {
+                LOG_WARNING("Ignoring MySQL replica with invalid port: " + std::string(item));
+                continue;
+            }
+        }
+        replicas.push_back(std::move(replica));
+    }
+    return replicas;
+}
+
+static PackedLayoutConfig packedLayoutConfig(const Config& config) {
+    PackedLayoutConfig layout;
+    layout.bucketSpan = config.getBucketSpan();
+    layout.partitionSpan = config.getPartitionSpan();
+    layout.aheadPartitions = config.getPartitionAhead();
+    layout.retainPartitions = config.getPartitionRetain();
+    layout.unitsPerSecond = config.getTimestampUnit() == "ms" ? 1000 : 1;
+    layout.compactDelaySec = config.getCompactDelaySec();
+    return layout;
+}
+#endif
+
+// CPU 绑定方案：reactor 为 epoll 线程，workers 为线程池，background 为其余线程
+struct AffinityPlan {
+    std::vector<int> reactor;
+    std::vector<int> workers;
+    std::vector<int> background;
+    int node = -1;  // 优先分配内存的 NUMA 节点
+};
+
+/**
+ * 读取 [affinity]：设置了 numa_node（或 nic 所在节点）时，未设置的项由该节点的 CPU 补全：
+ * reactor 取第一个 CPU，工作线程取其余 CPU，后台线程可用整个节点
+ */
+static AffinityPlan planAffinity(const Config& config) {
+    AffinityPlan plan;
+    auto parse = [](const char* key, const std::string& spec, std::vector<int>& cpus) {
+        if (!CpuAffinity::parseCpuList(spec, cpus)) {
+            LOG_WARNING(std::string("Invalid CPU list affinity.") + key + " = " + spec + ", ignored");
+            cpus.clear();
+        }
+    };
+    parse("reactor_cpus", config.getReactorCpus(), plan.reactor);
+    parse("worker_cpus", config.getWorkerCpus(), plan.workers);
+    parse("background_cpus", config.getBackgroundCpus(), plan.background);
+
+    plan.node = config.getNumaNode();
+    std::string nic = config.getAffinityNic();
+    if (plan.node < 0 && !nic.empty()) {
+        plan.node = CpuAffinity::nicNode(nic);
+        if (plan.node < 0) LOG_WARNING("NUMA node of " + nic + " is unknown, affinity.nic ignored");
+    }
+    if (plan.node < 0) return plan;
+    std::vector<int> nodeCpus = CpuAffinity::nodeCpus(plan.node);
+    if (nodeCpus.empty()) {
+        LOG_WARNING("NUMA node " + std::to_string(plan.node) + " has no CPUs, affinity.numa_node ignored");
+        plan.node = -1;
+        return plan;
+    }
+    if (plan.reactor.empty()) plan.reactor = {nodeCpus.front()};
+    if (plan.workers.empty()) {
+        for (int cpu : nodeCpus) {
+            if (std::find(plan.reactor.begin(), plan.reactor.end(), cpu) == plan.reactor.end()) {
+                plan.workers.push_back(cpu);
+            }
+        }
+        if (plan.workers.empty()) plan.workers = nodeCpus;
+    }
+    if (plan.background.empty()) plan.background = nodeCpus;
+    return plan;
+}
+
+// 日志级别与追踪采样率：启动时与配置热加载后应用
+static void applyLogSettings(const Config& config) {
+    LogLevel logLevel;
+    if (Logger::parseLevel(config.getLogLevel(), logLevel)) {
+        Logger::setLevel(logLevel);
+    } else {
+        LOG_WARNING("Unknown log level '" + config.getLogLevel() + "', keeping current level");
+    }
+    int traceSampleEvery = config.getTraceSampleEvery();
+    Tracer::setSampleEvery(traceSampleEvery > 0 ? static_cast<uint32_t>(traceSampleEvery) : 0);
+}
+
+// 配置热加载时重新应用配置的组件，未启用的为 nullptr
+struct Reloadable {
+    ThreadPool* threadPool = nullptr;
+    TcpServer* server = nullptr;
+    ReportHandler* handler = nullptr;
+#ifdef ENABLE_MYSQL
+    MySQLStore* mysqlStore = nullptr;
+#endif
+};
+
+// 热加载后立即生效的配置项，其余配置项变化时提示需要重启
+static bool isReloadable(const std::string& section, const std::string& key) {
+    static const std::set<std::pair<std::string, std::string>> keys = {
+        {"server", "thread_pool_size"},
+        {"server", "drain_timeout_sec"},
+        {"mysql", "pool_size_min"},
+        {"mysql", "pool_size_max"},
+        {"log", "level"},
+        {"trace", "sample_every"},
+        {"cache", "requirement_query_mb"},
+        {"limits", "queue_capacity"},
+        {"limits", "queue_target_ms"},
+        {"limits", "queue_interval_ms"},
+        {"limits", "retry_after_sec"},
+        {"limits", "ip_rate"},
+        {"limits", "ip_burst"},
+        {"limits", "device_rate"},
+        {"limits", "device_burst"},
+    };
+    return keys.count({section, key}) > 0;
+}
+
+static void warnRestartRequired(const Config::Data& before, const Config::Data& after) {
+    std::set<std::string> changed;
+    auto collect = [&changed](const Config::Data& from, const Config::Data& to) {
+        for (const auto& [section, values] : from) {
+            auto other = to.find(section);
+            for (const auto& [key, value] : values) {
+                if (isReloadable(section, key)) continue;
+                if (other == to.end()) {
+                    changed.insert(section + "." + key);
+                    continue;
+                }
+                auto it = other->second.find(key);
+                if (it == other->second.end() || it->second != value) changed.insert(section + "." + key);
+            }
+        }
+    };
+    collect(before, after);
+    collect(after, before);
+    if (changed.empty()) return;
+    std::string list;
+    for (const std::string& name : changed) list += (list.empty() ? "" : ", ") + name;
+    LOG_WARNING("Config changes that take effect only after restart: " + list);
+}
+
+static void applyRuntimeConfig(const Config& config, const Reloadable& targets) {
+    applyLogSettings(config);
+
+    int threadCount = config.getThreadPoolSize();
+    if (targets.threadPool) {
+        // 线程池运行中不能关闭：请求处理依赖它，thread_pool_size=0 需重启
+        if (threadCount > 0) {
+            targets.threadPool->resize(static_cast<std::size_t>(threadCount));
+        } else {
+            LOG_WARNING("thread_pool_size=0 requires restart, keeping " +
+                        std::to_string(targets.threadPool->size()) + " threads");
+        }
+        targets.threadPool->setAdmissionLimits(static_cast<std::size_t>(std::max(0, config.getQueueCapacity())),
+                                               config.getQueueTargetMs(), config.getQueueIntervalMs());
+    } else if (threadCount > 0) {
+        LOG_WARNING("ThreadPool was disabled at startup, thread_pool_size requires restart");
+    }
+
+    targets.server->setRetryAfter(config.getRetryAfterSec());
+    targets.server->setRateLimits(config.getIpRateLimit(), config.getIpRateBurst(),
+                                  config.getDeviceRateLimit(), config.getDeviceRateBurst());
+
+    std::size_t cacheBytes = static_cast<std::size_t>(std::max(0, config.getRequirementCacheMb())) * 1024 * 1024;
+    if (!targets.handler->resizeRequirementCache(cacheBytes)) {
+        LOG_WARNING("Requirement query cache was disabled at startup, requirement_query_mb requires restart");
+    }
+
+#ifdef ENABLE_MYSQL
+    if (targets.mysqlStore) targets.mysqlStore->resizePools(config.getPoolMinSize(), config.getPoolMaxSize());
+#endif
+}
+
+// 重新读取配置文件并应用到各组件；读取失败时保持原配置
+static void reloadConfig(Config& config, const Reloadable& targets) {
+    Metrics& metrics = Metrics::getInstance();
+    std::shared_ptr<const Config::Data> before = config.snapshot();
+    if (!config.reload()) {
+        metrics.counter("device_server_config_reloads_total", "Configuration reloads by result", "result=\"failed\"").inc();
+        LOG_ERROR("Config reload failed, keeping current configuration");
+        return;
+    }
+    warnRestartRequired(*before, *config.snapshot());
+    applyRuntimeConfig(config, targets);
+    metrics.counter("device_server_config_reloads_total", "Configuration reloads by result", "result=\"ok\"").inc();
+    LOG_INFO("Config reload applied");
+}
+
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [options]\n"
               << "Options:\n"
@@ -35,6 +350,35 @@ void printUsage(const char* programName) {
               << std::endl;
 }
 
+/**
+ * 排空：健康检查转为未就绪，服务器停止 accept 并关闭空闲连接，
+ * 等待其余连接处理完已读到的请求后关闭，直到 deadline（SIGINT 可提前结束）
+ */
+static void drainConnections(TcpServer& server, std::chrono::steady_clock::time_point deadline) {
+    g_ready = false;
+    server.drain();
+    std::size_t remaining = server.connectionCount();
+    LOG_INFO("Draining " + std::to_string(remaining) + " connections");
+    while (g_running && (remaining = server.connectionCount()) > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (remaining > 0) {
+        LOG_WARNING("Drain timed out, closing " + std::to_string(remaining) + " connections");
+    } else {
+        LOG_INFO("All connections drained");
+    }
+}
+
+// 关闭流程（停止线程池、写出待注册设备与 WAL 快照等）超过 deadline 时强制退出，卡住的组件不会让进程一直不退出
+static void startShutdownWatchdog(std::chrono::steady_clock::time_point deadline) {
+    std::thread([deadline] {
+        std::this_thread::sleep_until(deadline);
+        LOG_ERROR("Shutdown did not finish in time, exiting");
+        Logger::shutdown();
+        std::_Exit(1);
+    }).detach();
+}
+
 int main(int argc, char* argv[]) {
     std::string configFile = "config.ini";
 
@@ -72,8 +416,28 @@ int main(int argc, char* argv[]) {
     }
     config.loadFromEnv();
 
+    applyLogSettings(config);
+#ifndef ENABLE_TRACING
+    if (config.getTraceSampleEvery() > 0) {
+        LOG_WARNING("trace.sample_every is set but tracing was not compiled in (ENABLE_TRACING=OFF)");
+    }
+#endif
+
+    // 在创建其他线程之前应用：之后创建的线程继承主线程的 CPU 绑定与内存节点偏好，
+    // epoll 线程与工作线程启动时再各自绑定
+    AffinityPlan affinity = planAffinity(config);
+    if (affinity.node >= 0) CpuAffinity::preferNode(affinity.node);
+    CpuAffinity::pinProcess(affinity.background);
+    if (affinity.node >= 0 || !affinity.reactor.empty() || !affinity.workers.empty() || !affinity.background.empty()) {
+        LOG_INFO("CPU affinity: reactor [" + CpuAffinity::formatCpuList(affinity.reactor) + "], workers [" +
+                 CpuAffinity::formatCpuList(affinity.workers) + "], background [" +
+                 CpuAffinity::formatCpuList(affinity.background) + "], NUMA node " + std::to_string(affinity.node));
+    }
+
     signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    signal(SIGTERM, drainHandler);
+    signal(SIGUSR2, traceDumpHandler);
+    signal(SIGHUP, reloadHandler);
 
     StorageMode storageMode = config.getStorageMode();
     std::unique_ptr<StoreInterface> store;
@@ -83,10 +447,29 @@ int main(int argc, char* argv[]) {
 #endif
 
     switch (storageMode) {
-        case StorageMode::MEMORY:
+        case StorageMode::MEMORY: {
             LOG_INFO("Using MEMORY storage mode");
-            store = std::make_unique<MemoryStore>();
+            auto memoryStore = std::make_unique<MemoryStore>();
+            // 配置 wal_dir 后启用 WAL + 快照，重启不丢数据
+            std::string walDir = config.getWalDir();
+            if (!walDir.empty()) {
+                WalConfig walConfig;
+                walConfig.dir = walDir;
+                std::string fsync = config.getWalFsync();
+                if (fsync == "always") walConfig.fsyncPolicy = WalFsyncPolicy::ALWAYS;
+                else if (fsync == "off") walConfig.fsyncPolicy = WalFsyncPolicy::OFF;
+                else walConfig.fsyncPolicy = WalFsyncPolicy::INTERVAL;
+                walConfig.fsyncIntervalMs = config.getWalFsyncIntervalMs();
+                walConfig.snapshotIntervalSec = config.getSnapshotIntervalSec();
+                if (!memoryStore->enableDurability(walConfig)) {
+                    LOG_ERROR("Failed to enable WAL in " + walDir + ", running without durability");
+                } else {
+                    LOG_INFO("MemoryStore durability enabled (wal_dir=" + walDir + ", fsync=" + fsync + ")");
+                }
+            }
+            store = std::move(memoryStore);
             break;
+        }
 
 #ifdef ENABLE_MYSQL
         case StorageMode::MYSQL: {
@@ -102,12 +485,25 @@ int main(int argc, char* argv[]) {
             PoolConfig poolConfig;
             poolConfig.minSize = config.getPoolMinSize();
             poolConfig.maxSize = config.getPoolMaxSize();
+            poolConfig.maxIdleTime = config.getPoolMaxIdleSec();
+            poolConfig.healthCheckInterval = config.getPoolHealthCheckSec();
 
             mysqlStore = std::make_unique<MySQLStore>();
             if (!mysqlStore->init(mysqlConfig, poolConfig)) {
                 LOG_ERROR("Failed to initialize MySQL store, falling back to memory mode");
                 store = std::make_unique<MemoryStore>();
             } else {
+                if (config.getDataLayout() == "packed") {
+                    mysqlStore->enablePackedLayout(packedLayoutConfig(config));
+                }
+                std::vector<MySQLConfig> replicas = parseReplicas(config.getMySQLReplicas(), mysqlConfig);
+                if (!replicas.empty()) {
+                    mysqlStore->addReplicas(replicas, poolConfig, config.getReplicaMaxLagMs());
+                }
+                int asyncConnections = config.getMySQLAsyncConnections();
+                if (asyncConnections > 0) {
+                    mysqlStore->enableAsync(mysqlConfig, asyncConnections);
+                }
                 store.reset(mysqlStore.release());
             }
             break;
@@ -126,12 +522,25 @@ int main(int argc, char* argv[]) {
             PoolConfig poolConfig;
             poolConfig.minSize = config.getPoolMinSize();
             poolConfig.maxSize = config.getPoolMaxSize();
+            poolConfig.maxIdleTime = config.getPoolMaxIdleSec();
+            poolConfig.healthCheckInterval = config.getPoolHealthCheckSec();
 
             mysqlStore = std::make_unique<MySQLStore>();
             if (!mysqlStore->init(mysqlConfig, poolConfig)) {
                 LOG_ERROR("Failed to initialize MySQL store, falling back to memory mode");
                 store = std::make_unique<MemoryStore>();
             } else {
+                if (config.getDataLayout() == "packed") {
+                    mysqlStore->enablePackedLayout(packedLayoutConfig(config));
+                }
+                std::vector<MySQLConfig> replicas = parseReplicas(config.getMySQLReplicas(), mysqlConfig);
+                if (!replicas.empty()) {
+                    mysqlStore->addReplicas(replicas, poolConfig, config.getReplicaMaxLagMs());
+                }
+                int asyncConnections = config.getMySQLAsyncConnections();
+                if (asyncConnections > 0) {
+                    mysqlStore->enableAsync(mysqlConfig, asyncConnections);
+                }
                 store.reset(mysqlStore.release());
             }
             break;
@@ -149,7 +558,39 @@ int main(int argc, char* argv[]) {
             break;
     }
 
-    ReportHandler handler(*store);
+    // 设备管理：MySQL / 混合模式下首次出现的设备由后台线程批量注册
+    DeviceManagerMode deviceMode = DeviceManagerMode::MEMORY;
+#ifdef ENABLE_MYSQL
+    MySQLStore* mysqlStorePtr = dynamic_cast<MySQLStore*>(store.get());
+    if (mysqlStorePtr) {
+        deviceMode = (storageMode == StorageMode::HYBRID) ? DeviceManagerMode::HYBRID : DeviceManagerMode::MYSQL;
+    }
+#endif
+    DeviceManager deviceMgr(deviceMode);
+#ifdef ENABLE_MYSQL
+    if (mysqlStorePtr) {
+        deviceMgr.setMySQLStore(mysqlStorePtr);
+        deviceMgr.startRegistrar(config.getDeviceRegisterIntervalMs(),
+                                 static_cast<std::size_t>(config.getDeviceRegisterBatch()));
+    }
+#endif
+
+    ReportHandler handler(*store, deviceMgr);
+    int requirementCacheMb = config.getRequirementCacheMb();
+    if (requirementCacheMb > 0) {
+        handler.enableRequirementCache(static_cast<std::size_t>(requirementCacheMb) * 1024 * 1024);
+        LOG_INFO("Requirement query cache enabled (" + std::to_string(requirementCacheMb) + " MB)");
+    }
+    handler.setConditionalRequests(config.getConditionalGet());
+    if (!config.getConditionalGet()) LOG_INFO("Conditional GET (ETag / 304) disabled");
+
+    StreamConfig streamConfig;
+    streamConfig.queueLimit = static_cast<std::size_t>(std::max(0, config.getStreamQueueLimit()));
+    streamConfig.dropOldest = config.getStreamDropPolicy() != "disconnect";
+    streamConfig.heartbeatSec = config.getStreamHeartbeatSec();
+    EventHub eventHub(streamConfig);
+    eventHub.start();
+    handler.setEventHub(&eventHub);
 
     // 线程池：thread_pool_size=0 时禁用（适用于 2 核 2G 小服务器）
     int threadCount = config.getThreadPoolSize();
@@ -158,60 +599,285 @@ int main(int argc, char* argv[]) {
 
     if (threadCount > 0) {
         threadPool = std::make_unique<ThreadPool>();
+        threadPool->setCpuAffinity(affinity.workers);
         threadPool->start(static_cast<std::size_t>(threadCount));
+        threadPool->setAdmissionLimits(static_cast<std::size_t>(std::max(0, config.getQueueCapacity())),
+                                       config.getQueueTargetMs(), config.getQueueIntervalMs());
         threadPoolPtr = threadPool.get();
-        LOG_INFO("ThreadPool started with " + std::to_string(threadCount) + " threads");
+        LOG_INFO("ThreadPool started with " + std::to_string(threadCount) + " threads, queue capacity " +
+                 std::to_string(config.getQueueCapacity()) + ", queue delay target " +
+                 std::to_string(config.getQueueTargetMs()) + "ms");
     } else {
         LOG_INFO("ThreadPool disabled (thread_pool_size=0)");
     }
 
+    Metrics& metrics = Metrics::getInstance();
+    metrics.counterCallback("device_server_log_written_total", "Log lines written to the log file",
+                            [] { return static_cast<double>(Logger::getWrittenCount()); });
+    metrics.counterCallback("device_server_log_dropped_total", "Log lines dropped because a logger buffer was full",
+                            [] { return static_cast<double>(Logger::getDroppedCount()); });
+    HttpMetrics httpMetrics;
+
     TcpServer server;
     server.setThreadPool(threadPoolPtr);
-    server.setRequestHandler([&handler](const std::string& rawRequest, std::string& response) {
-        HttpRequest req;
-        if (!HttpParser::parseRequest(rawRequest, req)) {
-            response = HttpParser::buildResponse(400, "{\"code\":400,\"message\":\"Invalid request\"}");
+    server.setCpuAffinity(affinity.reactor);
+    server.setRetryAfter(config.getRetryAfterSec());
+    server.setRateLimits(config.getIpRateLimit(), config.getIpRateBurst(),
+                         config.getDeviceRateLimit(), config.getDeviceRateBurst());
+    if (config.getIpRateLimit() > 0 || config.getDeviceRateLimit() > 0) {
+        LOG_INFO("Rate limits: ip " + std::to_string(config.getIpRateLimit()) + "/s, device " +
+                 std::to_string(config.getDeviceRateLimit()) + "/s");
+    }
+    std::size_t ackWindow = static_cast<std::size_t>(std::max(1, config.getWebSocketAckWindow()));
+    server.setRequestHandler([&handler, &eventHub, &httpMetrics, ackWindow](const std::string& rawRequest, std::string& response) {
+        // 请求总耗时在确定路由后归入对应直方图
+        ScopedTimer requestTimer(&httpMetrics.other);
+
+        // 解析、处理与序列化的临时对象都分配在请求级分配区上，返回时整体释放
+        RequestArena arena;
+        std::pmr::memory_resource* mr = arena.resource();
+        std::pmr::string body(mr);
+
+        HttpRequest req(mr);
+        ScopedTimer parseTimer(&httpMetrics.parseHttp);
+        bool parsed = HttpParser::parseRequest(rawRequest, req);
+        parseTimer.stop();
+        if (!parsed) {
+            HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid request\"}");
             return;
         }
 
+        // 读己之写：同一会话的写入之后，读取在复制追上之前留在主库
+        std::string_view sessionId;
+        auto sessionIt = req.headers.find(std::pmr::string("x-session-id", req.headers.get_allocator()));
+        if (sessionIt != req.headers.end()) sessionId = sessionIt->second;
+        SessionScope session(sessionId);
+
         if (req.method == "GET" && req.path == "/api/v1/health") {
-            response = HttpParser::buildResponse(200, "{\"code\":0,\"message\":\"ok\"}");
+            // 排空期间返回 503，负载均衡据此把流量转到其他实例（或交接后的新进程）
+            requestTimer.retarget(&httpMetrics.health);
+            if (g_ready) {
+                HttpParser::buildResponse(response, 200, "{\"code\":0,\"message\":\"ok\",\"ready\":true}");
+            } else {
+                HttpParser::buildResponse(response, 503, "{\"code\":503,\"message\":\"draining\",\"ready\":false}");
+            }
+        } else if (req.method == "GET" && req.path == "/api/v1/metrics") {
+            // Prometheus 文本格式，各分片在此时汇总
+            requestTimer.retarget(&httpMetrics.metrics);
+            thread_local std::string text;
+            text.clear();
+            Metrics::getInstance().render(text);
+            HttpParser::buildResponse(response, 200, text, "text/plain; version=0.0.4");
+        } else if (req.method == "GET" && req.path == "/api/v1/admin/trace") {
+            // Chrome trace_event JSON；min_ms 只保留首尾跨度不小于该值的请求
+            requestTimer.retarget(&httpMetrics.trace);
+            double minMs = 0;
+            std::string_view minParam = HttpParser::queryParam(req.query, "min_ms");
+            std::from_chars(minParam.data(), minParam.data() + minParam.size(), minMs);
+            thread_local std::string text;
+            text.clear();
+            Tracer::dumpChromeJson(text, minMs);
+            HttpParser::buildResponse(response, 200, text);
+        } else if (req.method == "POST" && req.path == "/api/v1/admin/reload") {
+            // 与 SIGHUP 相同：由主循环重新加载配置（线程池缩容需等待工作线程，不能在工作线程中执行）
+            requestTimer.retarget(&httpMetrics.adminReload);
+            g_reloadConfig = true;
+            HttpParser::buildResponse(response, 202, "{\"code\":0,\"message\":\"Reload scheduled\"}");
+        } else if (req.method == "POST" && req.path == "/api/v1/admin/trace/sampling") {
+            // every=N：每 N 个请求采样 1 个，0 关闭
+            requestTimer.retarget(&httpMetrics.trace);
+            std::string_view everyParam = HttpParser::queryParam(req.query, "every");
+            uint32_t every = 0;
+            auto res = std::from_chars(everyParam.data(), everyParam.data() + everyParam.size(), every);
+            if (res.ec != std::errc() || res.ptr != everyParam.data() + everyParam.size()) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid every\"}");
+                return;
+            }
+            Tracer::setSampleEvery(every);
+            body += "{\"code\":0,\"sample_every\":";
+            body += std::to_string(every);
+            body += '}';
+            HttpParser::buildResponse(response, 200, body);
+        } else if (req.method == "POST" && req.path == "/api/v1/report") {
+            requestTimer.retarget(&httpMetrics.report);
+            ScopedTimer bodyTimer(&httpMetrics.parseBody);
+            JsonValue json = JsonParser::parse(req.body, mr);
+            ReportRequest reportReq(mr);
+            bool valid = ReportHandler::parseReportRequest(json, reportReq);
+            bodyTimer.stop();
+            if (!valid) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid request body\"}");
+                return;
+            }
+            if (DeferredResponse deferred = handler.asyncStore() ? TcpServer::deferResponse() : DeferredResponse()) {
+                handler.handleReportAsync(reportReq, respondWhenReady(std::move(deferred), std::string()));
+                return;
+            }
+            JsonParser::stringifyTo(handler.handleReport(reportReq, mr), body);
+            HttpParser::buildResponse(response, 200, body);
+
+        } else if (req.method == "POST" && req.path == "/api/v1/report/batch") {
+            // JSON 数组或 NDJSON（每行一个上报对象）
+            requestTimer.retarget(&httpMetrics.reportBatch);
+            ScopedTimer bodyTimer(&httpMetrics.parseBody);
+            BatchReportRequest batchReq;
+            bool valid = ReportHandler::parseBatchReportRequest(req.body, batchReq);
+            bodyTimer.stop();
+            if (!valid) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid request body\"}");
+                return;
+            }
+            JsonParser::stringifyTo(handler.handleBatchReport(batchReq, mr), body);
+            HttpParser::buildResponse(response, 200, body);
+
+        } else if (req.method == "GET" && req.path == "/api/v1/query") {
+            requestTimer.retarget(&httpMetrics.query);
+            QueryRequest queryReq(mr);
+            if (!ReportHandler::parseQueryRequest(req.query, queryReq)) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Missing device_id\"}");
+                return;
+            }
+            std::pmr::string etag = handler.queryETag(queryReq, mr);
+            if (HttpParser::notModified(req, etag, response)) return;
+            if (DeferredResponse deferred = handler.asyncStore() ? TcpServer::deferResponse() : DeferredResponse()) {
+                handler.handleQueryAsync(queryReq, respondWhenReady(std::move(deferred), std::string(etag)));
+                return;
+            }
+            JsonParser::stringifyTo(handler.handleQuery(queryReq, mr), body);
+            HttpParser::buildCacheableResponse(response, body, etag, mr);
+
         } else if (req.method == "POST" && req.path == "/api/v1/requirement/report") {
-            JsonValue json = JsonParser::parse(req.body);
-            RequirementReportRequest reportReq;
-            if (!ReportHandler::parseRequirementReportRequest(json, reportReq)) {
-                response = HttpParser::buildResponse(400, "{\"code\":400,\"message\":\"Invalid request body\"}");
+            requestTimer.retarget(&httpMetrics.requirementReport);
+            ScopedTimer bodyTimer(&httpMetrics.parseBody);
+            JsonValue json = JsonParser::parse(req.body, mr);
+            RequirementReportRequest reportReq(mr);
+            bool valid = ReportHandler::parseRequirementReportRequest(json, reportReq);
+            bodyTimer.stop();
+            if (!valid) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid request body\"}");
                 return;
             }
-            JsonValue result = handler.handleRequirementReport(reportReq);
-            std::string jsonStr = JsonParser::stringify(result);
-            response = HttpParser::buildResponse(200, jsonStr);
+            JsonParser::stringifyTo(handler.handleRequirementReport(reportReq, mr), body);
+            HttpParser::buildResponse(response, 200, body);
 
         } else if (req.method == "GET" && req.path == "/api/v1/requirement/query") {
-            RequirementQueryRequest queryReq;
+            requestTimer.retarget(&httpMetrics.requirementQuery);
+            RequirementQueryRequest queryReq(mr);
             ReportHandler::parseRequirementQueryRequest(req.query, queryReq);
-            JsonValue result = handler.handleRequirementQuery(queryReq);
-            std::string jsonStr = JsonParser::stringify(result);
-            response = HttpParser::buildResponse(200, jsonStr);
+            std::pmr::string etag = handler.requirementQueryETag(mr);
+            if (HttpParser::notModified(req, etag, response)) return;
+            if (DeferredResponse deferred = handler.asyncStore() ? TcpServer::deferResponse() : DeferredResponse()) {
+                handler.handleRequirementQueryAsync(queryReq, respondWhenReady(std::move(deferred), std::string(etag)));
+                return;
+            }
+            handler.handleRequirementQueryTo(queryReq, body, mr);
+            HttpParser::buildCacheableResponse(response, body, etag, mr);
+
+        } else if (req.method == "GET" && req.path == "/api/v1/stream") {
+            // SSE：连接保持打开，上报的数据点与新需求由 EventHub 推送，替代轮询
+            requestTimer.retarget(&httpMetrics.stream);
+            std::vector<std::string> topics;
+            if (!parseStreamTopics(req.query, topics)) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"Invalid device_id or requirements\"}");
+                return;
+            }
+            EventStream stream = TcpServer::openStream(EventHub::responseHead());
+            if (!stream) {
+                HttpParser::buildResponse(response, 500, "{\"code\":500,\"message\":\"Streaming unavailable\"}");
+                return;
+            }
+            eventHub.subscribe(topics, std::move(stream));
+
+        } else if (req.path == "/api/v1/ws/report") {
+            // WebSocket 二进制上报：长连接上以会话内下标与增量编码连续上报，累计确认（协议见 IngestSession）
+            requestTimer.retarget(&httpMetrics.wsReport);
+            if (!WebSocket::handshake(req, response)) {
+                HttpParser::buildResponse(response, 400, "{\"code\":400,\"message\":\"WebSocket upgrade required\"}");
+                return;
+            }
+            auto session = std::make_shared<IngestSession>(
+                [&handler](const BatchReportRequest& batch) { return handler.storeBatch(batch); }, ackWindow);
+            if (!TcpServer::acceptWebSocket([session](std::string_view message, bool more, std::string& reply) {
+                    return session->onMessage(message, more, reply);
+                })) {
+                HttpParser::buildResponse(response, 500, "{\"code\":500,\"message\":\"WebSocket unavailable\"}");
+                return;
+            }
+            std::string greeting;
+            session->greeting(greeting);
+            WebSocket::appendFrame(response, WebSocket::BINARY, greeting);
 
         } else {
-            response = HttpParser::buildResponse(404, "{\"code\":404,\"message\":\"Not found\"}");
+            HttpParser::buildResponse(response, 404, "{\"code\":404,\"message\":\"Not found\"}");
         }
     });
 
+    // 平滑升级：handoff_socket 上有运行中的旧进程时接收它的监听 socket，否则自己监听
+    std::string handoffPath = config.getHandoffSocket();
+    if (!handoffPath.empty() && storageMode == StorageMode::MEMORY && !config.getWalDir().empty()) {
+        // 新旧进程会同时写同一个 WAL 目录
+        LOG_WARNING("server.handoff_socket is ignored in memory mode with wal_dir");
+        handoffPath.clear();
+    }
+    ListenerHandoff handoff;
+    int inheritedFd = -1;
+    ListenerHandoff::Receive received = handoffPath.empty() ? ListenerHandoff::Receive::NONE
+                                                             : handoff.receive(handoffPath, inheritedFd);
+    if (received == ListenerHandoff::Receive::FAILED) {
+        LOG_ERROR("Failed to take over the listening socket from " + handoffPath);
+        Logger::shutdown();
+        return 1;
+    }
     int serverPort = config.getServerPort();
-    if (!server.listen("0.0.0.0", serverPort)) {
+    if (received == ListenerHandoff::Receive::RECEIVED) {
+        if (!server.adoptListener(inheritedFd)) {
+            Logger::shutdown();
+            return 1;
+        }
+    } else if (!server.listen("0.0.0.0", serverPort)) {
         LOG_ERROR("Failed to start server on port " + std::to_string(serverPort));
+        Logger::shutdown();
         return 1;
+    } else {
+        LOG_INFO("Server listening on port " + std::to_string(serverPort));
     }
-    LOG_INFO("Server listening on port " + std::to_string(serverPort));
 
     std::thread serverThread([&server]() {
         server.run();
     });
+    // 监听 socket 已加入 epoll，确认后旧进程开始排空
+    if (received == ListenerHandoff::Receive::RECEIVED && handoff.confirm()) {
+        LOG_INFO("Took over the listening socket from the previous process");
+    }
+    if (!handoffPath.empty()) {
+        handoff.serve(handoffPath, server.listenFd(), [] { g_drain = true; });
+    }
+    g_ready = true;
+
+    Reloadable reloadable;
+    reloadable.threadPool = threadPoolPtr;
+    reloadable.server = &server;
+    reloadable.handler = &handler;
+#ifdef ENABLE_MYSQL
+    reloadable.mysqlStore = mysqlStorePtr;
+#endif
 
-    while (g_running) {
+    while (g_running && !g_drain) {
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (g_dumpTrace.exchange(false)) {
+            dumpTraceToFile();
+        }
+        if (g_reloadConfig.exchange(false)) {
+            reloadConfig(config, reloadable);
+        }
+    }
+
+    // 排空与之后的关闭流程共用 drain_timeout_sec，另留 10 秒写出剩余数据
+    auto drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(std::max(0, config.getDrainTimeoutSec()));
+    startShutdownWatchdog(drainDeadline + std::chrono::seconds(10));
+    handoff.stop();
+    if (g_drain && g_running) {
+        drainConnections(server, drainDeadline);
     }
 
     LOG_INFO("Shutting down server...");
@@ -224,9 +890,17 @@ int main(int argc, char* argv[]) {
         threadPool->stop();
         LOG_INFO("ThreadPool stopped");
     }
+    eventHub.stop();
+
+    // 先写入剩余待注册设备，再关闭连接池
+    deviceMgr.stopRegistrar();
+
+    // 生成最终快照并关闭 WAL
+    if (MemoryStore* memoryStorePtr = dynamic_cast<MemoryStore*>(store.get())) {
+        memoryStorePtr->shutdownDurability();
+    }
 
 #ifdef ENABLE_MYSQL
-    MySQLStore* mysqlStorePtr = dynamic_cast<MySQLStore*>(store.get());
     if (mysqlStorePtr) {
         mysqlStorePtr->shutdown();
         LOG_INFO("MySQL store shutdown");
@@ -234,5 +908,6 @@ int main(int argc, char* argv[]) {
 #endif
 
     LOG_INFO("RequirementServer stopped.");
+    Logger::shutdown();
     return 0;
 }
@@ -1,46 +1,101 @@
 #include "Connection.hpp"
+#include "WebSocket.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <cstring>
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 
-Connection::Connection(int fd) : fd_(fd), closed_(false) {
+namespace {
+
+struct ConnectionMetrics {
+    Gauge& open = Metrics::getInstance().gauge("device_server_connections_open", "Currently open client connections");
+    Counter& accepted = Metrics::getInstance().counter("device_server_connections_total", "Accepted client connections");
+    Counter& bytesIn = Metrics::getInstance().counter("device_server_bytes_received_total", "Bytes read from client sockets");
+    Counter& bytesOut = Metrics::getInstance().counter("device_server_bytes_sent_total", "Bytes written to client sockets");
+};
+
+ConnectionMetrics& connectionMetrics() {
+    static ConnectionMetrics metrics;
+    return metrics;
+}
+
+uint64_t steadyNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}  // namespace
+
+Connection::Connection(int fd) : fd_(fd), closed_(false), lastReadNs_(steadyNowNs()) {
+    connectionMetrics().open.inc();
+    connectionMetrics().accepted.inc();
 }
 
 Connection::~Connection() {
-    close();
+    if (fd_ >= 0) ::close(fd_);
+    connectionMetrics().open.dec();
 }
 
-void Connection::close() {
-    std::lock_guard<std::mutex> lock(mtx_);
+void Connection::closeLocked() {
+    // 只关闭读写方向，fd 到析构时才释放：工作线程中关闭的连接 epoll 仍会报告 HUP，
+    // 由 epoll 线程移出连接表（直接 close 会让 fd 退出 epoll，连接留在表中无人清理）
     if (!closed_ && fd_ >= 0) {
-        ::close(fd_);
+        ::shutdown(fd_, SHUT_RDWR);
         closed_ = true;
     }
 }
 
 void Connection::onReadable() {
-    char buffer[4096];
-    ssize_t n = recv(fd_, buffer, sizeof(buffer) - 1, 0);
-    if (n <= 0) {
-        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
-            close();
+    char buffer[16384];
+    std::lock_guard<std::mutex> lock(mtx_);
+    bool received = false;
+    while (!closed_) {
+        ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0) {
+            // 对端关闭写方向：已读到的请求照常处理并写回，处理完后再关闭（事件流没有待处理的请求）
+            readClosed_ = true;
+            if (streaming_) closeLocked();
+            break;
         }
-        return;
-    }
-    
-    buffer[n] = '\0';
-    {
-        std::lock_guard<std::mutex> lock(mtx_);
-        readBuffer_ += buffer;
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closeLocked();
+            }
+            break;
+        }
+        
+        connectionMetrics().bytesIn.inc(static_cast<uint64_t>(n));
+        readBuffer_.append(buffer, static_cast<std::size_t>(n));
+        received = true;
     }
+    if (received) lastReadNs_ = steadyNowNs();
 }
 
 std::string Connection::extractRequest() {
     std::lock_guard<std::mutex> lock(mtx_);
+    if (streaming_ || closeAfterWrite_) {
+        readBuffer_.clear();
+        return "";
+    }
+    if (ws_) {
+        bool tooLarge = false;
+        std::size_t size = WebSocket::frameSize(readBuffer_, tooLarge);
+        if (tooLarge) {
+            closeLocked();
+            return "";
+        }
+        if (size == 0) return "";
+        std::string frame = readBuffer_.substr(0, size);
+        readBuffer_.erase(0, size);
+        return frame;
+    }
     // 查找HTTP头部的结束标记
     size_t headerEnd = readBuffer_.find("\r\n\r\n");
     if (headerEnd == std::string::npos) {
@@ -89,24 +144,168 @@ void Connection::appendResponse(const std::string& response) {
     writeBuffer_ += response;
 }
 
-void Connection::onWritable() {
-    std::string dataToSend;
-    {
-        std::lock_guard<std::mutex> lock(mtx_);
-        if (writeBuffer_.empty()) return;
-        dataToSend = writeBuffer_;
+bool Connection::enqueueRequest(PendingRequest request) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending_.push_back(std::move(request));
+    if (processing_) return false;
+    processing_ = true;
+    return true;
+}
+
+bool Connection::nextRequest(PendingRequest& request) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (pending_.empty() || closed_) {
+        pending_.clear();
+        processing_ = false;
+        finishInputLocked();
+        return false;
     }
-    
-    ssize_t n = send(fd_, dataToSend.c_str(), dataToSend.size(), 0);
-    if (n < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            close();
+    request = std::move(pending_.front());
+    pending_.pop_front();
+    return true;
+}
+
+void Connection::finishInput() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    finishInputLocked();
+}
+
+void Connection::finishInputLocked() {
+    if (!readClosed_ || processing_ || !pending_.empty() || closed_) return;
+    if (writeBuffer_.empty() && events_.empty()) {
+        closeLocked();
+    } else {
+        closeAfterWrite_ = true;
+    }
+}
+
+bool Connection::respondIfIdle(const std::string& response) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (processing_) return false;
+    writeBuffer_ += response;
+    return true;
+}
+
+void Connection::upgrade(MessageHandler handler) {
+    auto ws = std::make_unique<WebSocketState>();
+    ws->handler = std::move(handler);
+    std::lock_guard<std::mutex> lock(mtx_);
+    ws_ = std::move(ws);
+}
+
+void Connection::closeAfterWrite() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (writeBuffer_.empty() && events_.empty()) {
+        closeLocked();
+    } else {
+        closeAfterWrite_ = true;
+    }
+}
+
+bool Connection::closeIfIdle(std::string_view farewell, uint64_t idleSinceNs) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (closed_ || closeAfterWrite_) return true;
+    if (!streaming_) {
+        bool busy = processing_ || !pending_.empty() || !readBuffer_.empty();
+        if (ws_) {
+            // WebSocket 不看空闲时长：忙碌时由处理者在下一个消息边界关闭
+            if (busy) {
+                goingAway_ = true;
+                return false;
+            }
+        } else if (busy || lastReadNs_ > idleSinceNs) {
+            return false;
         }
-        return;
     }
+    writeBuffer_ += farewell;
+    if (writeBuffer_.empty() && events_.empty()) {
+        closeLocked();
+    } else {
+        closeAfterWrite_ = true;
+    }
+    return true;
+}
+
+void Connection::beginStream(std::string_view head) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    streaming_ = true;
+    readBuffer_.clear();
+    writeBuffer_ += head;
+}
+
+StreamPush Connection::pushEvent(std::shared_ptr<const std::string> event, std::size_t maxQueued,
+                                 bool dropOldest, bool& flush) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    flush = false;
+    if (closed_ || !streaming_ || closeAfterWrite_) return StreamPush::CLOSED;
     
-    {
-        std::lock_guard<std::mutex> lock(mtx_);
-        writeBuffer_.erase(0, n);
+    StreamPush result = StreamPush::QUEUED;
+    // 已发送一部分的首个事件不计入也不能丢弃，否则流中会出现半条事件
+    std::size_t partial = eventOffset_ > 0 ? 1 : 0;
+    if (maxQueued > 0 && events_.size() - partial >= maxQueued) {
+        if (!dropOldest) {
+            events_.clear();
+            eventOffset_ = 0;
+            closeLocked();
+            return StreamPush::OVERFLOW;
+        }
+        events_.erase(events_.begin() + static_cast<std::ptrdiff_t>(partial));
+        result = StreamPush::DROPPED;
+    }
+    flush = writeBuffer_.empty() && events_.empty();
+    events_.push_back(std::move(event));
+    return result;
+}
+
+ssize_t Connection::sendEventsLocked() {
+    constexpr std::size_t kMaxIov = 64;
+    iovec iov[kMaxIov];
+    std::size_t count = 0;
+    for (const auto& event : events_) {
+        if (count == kMaxIov) break;
+        std::size_t skip = count == 0 ? eventOffset_ : 0;
+        iov[count].iov_base = const_cast<char*>(event->data() + skip);
+        iov[count].iov_len = event->size() - skip;
+        ++count;
+    }
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return sendmsg(fd_, &msg, MSG_NOSIGNAL);
+}
+
+void Connection::consumeEventsLocked(std::size_t n) {
+    while (n > 0) {
+        std::size_t left = events_.front()->size() - eventOffset_;
+        if (n < left) {
+            eventOffset_ += n;
+            return;
+        }
+        n -= left;
+        events_.pop_front();
+        eventOffset_ = 0;
+    }
+}
+
+void Connection::onWritable() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    while (!closed_ && (!writeBuffer_.empty() || !events_.empty())) {
+        bool buffered = !writeBuffer_.empty();
+        ssize_t n = buffered ? send(fd_, writeBuffer_.data(), writeBuffer_.size(), MSG_NOSIGNAL)
+                             : sendEventsLocked();
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                closeLocked();
+            }
+            return;
+        }
+        connectionMetrics().bytesOut.inc(static_cast<uint64_t>(n));
+        if (buffered) {
+            writeBuffer_.erase(0, static_cast<std::size_t>(n));
+        } else {
+            consumeEventsLocked(static_cast<std::size_t>(n));
+        }
     }
+    if (closeAfterWrite_) closeLocked();
 }
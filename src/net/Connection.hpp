@@ -4,10 +4,54 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <deque>
+#include <cstdint>
+#include <string_view>
+#include <sys/types.h>
 
+// 已读出、等待处理的完整请求
+struct PendingRequest {
+    std::string raw;
+    uint64_t traceId = 0;      // 采样追踪 id，0 表示未采样
+    uint64_t enqueueTime = 0;  // 入队时间（Tracer::nowNs，仅采样请求记录）
+    bool rejected = false;     // 准入控制拒绝的请求：raw 为已生成的错误响应，按顺序直接写回
+    bool frame = false;        // 升级后的连接：raw 为一个完整的 WebSocket 帧
+};
+
+// 向事件流连接追加事件的结果
+enum class StreamPush {
+    QUEUED,    // 已进入发送队列
+    DROPPED,   // 队列已满，丢弃最旧的未发送事件后进入队列
+    OVERFLOW,  // 队列已满且不允许丢弃，连接已关闭
+    CLOSED     // 连接已关闭
+};
+
+/**
+ * 客户端连接
+ * 由 TcpServer 以 shared_ptr 持有，处理中的任务也持有一份引用，
+ * 连接从表中移除后对象仍存活到任务结束（fd 在析构时才关闭，不会被新连接复用）。
+ * 同一连接上的请求（含流水线请求）进入 pending 队列，由一个处理者按到达顺序串行执行，
+ * 保证响应顺序与请求一致。
+ * 转为事件流后不再解析请求，事件以共享缓冲区排队发送（多个连接共用同一份序列化结果）
+ */
 class Connection {
 public:
     using RequestHandler = std::function<void(const std::string& request, std::string& response)>;
+    /**
+     * WebSocket 消息处理函数：message 为重组后的完整二进制消息，more 表示连接上已有后续帧排队，
+     * reply 非空时作为一条二进制消息发回；返回 false 时发送 reply 后以 1008 关闭连接。
+     * 以 more=true 交付过消息、而排队的帧随后处理完时，再以空 message、more=false 调用一次
+     */
+    using MessageHandler = std::function<bool(std::string_view message, bool more, std::string& reply)>;
+    
+    // 升级为 WebSocket 后的状态，只由该连接当前的处理者访问（与请求处理同样串行）
+    struct WebSocketState {
+        MessageHandler handler;
+        std::string fragments;    // 未收齐的分片消息
+        bool fragmented = false;  // 正在接收分片消息
+        bool owesIdle = false;    // 上次以 more=true 交付，队列处理完时需补一次空消息
+        bool closing = false;     // 已发送关闭帧，之后的帧丢弃
+    };
     
     Connection(int fd);
     ~Connection();
@@ -16,7 +60,13 @@ public:
     
     void setHandler(RequestHandler handler) { handler_ = handler; }
     
+    // 对端 IP（accept 时设置，用于按客户端限流）
+    void setPeerAddress(std::string address) { peerAddress_ = std::move(address); }
+    const std::string& peerAddress() const { return peerAddress_; }
+    
+    // ET 模式：读到 EAGAIN 为止
     void onReadable();
+    // 持锁发送，epoll 线程与工作线程并发调用时不会重复发送同一段数据
     void onWritable();
     
     bool isClosed() const { 
@@ -30,13 +80,91 @@ public:
     // 线程安全的方法：追加响应到writeBuffer
     void appendResponse(const std::string& response);
     
+    bool hasPendingWrite() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return !writeBuffer_.empty() || !events_.empty();
+    }
+    
+    // 请求入队；返回 true 表示当前没有处理者，调用方需要安排处理
+    bool enqueueRequest(PendingRequest request);
+    
+    // 处理者取下一个请求；队列为空时释放处理权并返回 false
+    bool nextRequest(PendingRequest& request);
+    
+    // 没有处理者时直接把响应追加到写缓冲区并返回 true；
+    // 否则返回 false，调用方应将其作为 rejected 请求入队以保持响应顺序
+    bool respondIfIdle(const std::string& response);
+    
+    // 升级为 WebSocket：之后 extractRequest 按帧拆分
+    void upgrade(MessageHandler handler);
+    bool isUpgraded() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return ws_ != nullptr;
+    }
+    WebSocketState* webSocket() { return ws_.get(); }
+    
+    // 是否还有已读出、未处理的请求（或帧）
+    bool hasPendingRequests() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return !pending_.empty();
+    }
+    
+    // 写缓冲区发送完后关闭连接（缓冲区已空时立即关闭）
+    void closeAfterWrite();
+    
+    bool isReadClosed() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return readClosed_;
+    }
+    // 对端已关闭写方向且没有处理者与未处理的请求时，写完剩余响应后关闭；
+    // 读到 EOF 并取出全部请求后调用，之后由处理者在队列清空时自行收尾
+    void finishInput();
+    
+    /**
+     * 排空：没有处理者、没有未处理的请求与未读完的请求，且 idleSinceNs（steady_clock 纳秒）之后
+     * 没有读到数据时，追加 farewell（可为空）并在写完后关闭；事件流连接不看这些条件，未发送的事件照常发完。
+     * WebSocket 连接不看空闲时长，忙碌时记下关闭请求（goingAwayRequested），由处理者在消息边界关闭。
+     * 返回 false 表示连接仍在使用，稍后再试
+     */
+    bool closeIfIdle(std::string_view farewell, uint64_t idleSinceNs);
+    bool goingAwayRequested() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return goingAway_;
+    }
+    
+    // 转为事件流：head 为响应头，追加到写缓冲区；之后读到的数据直接丢弃
+    void beginStream(std::string_view head);
+    
+    /**
+     * 事件流：追加一条事件（不拷贝缓冲区）。未发送的事件达到 maxQueued 时，
+     * dropOldest 为 true 丢弃最旧的一条，否则关闭连接。
+     * flush 返回追加前发送队列是否为空：为空时调用方需要发送，否则已有 EPOLLOUT 在等待
+     */
+    StreamPush pushEvent(std::shared_ptr<const std::string> event, std::size_t maxQueued, bool dropOldest,
+                         bool& flush);
+    
 private:
     int fd_;
     mutable std::mutex mtx_;  // 保护以下成员
     std::string readBuffer_;
     std::string writeBuffer_;
+    std::deque<PendingRequest> pending_;
+    bool processing_ = false;  // 是否已有处理者在消费 pending_
     RequestHandler handler_;
+    std::string peerAddress_;
     bool closed_;
+    bool streaming_ = false;
+    bool closeAfterWrite_ = false;  // 之后读到的数据直接丢弃
+    bool readClosed_ = false;       // 已读到 EOF（对端半关闭），请求处理完并写回后关闭
+    bool goingAway_ = false;        // 排空时 WebSocket 仍在处理消息，处理者在消息边界发送 1001 关闭
+    uint64_t lastReadNs_;           // 最后一次读到数据（或建立连接）的时间，steady_clock 纳秒
+    std::unique_ptr<WebSocketState> ws_;
+    std::deque<std::shared_ptr<const std::string>> events_;  // 事件流待发送事件，排在 writeBuffer_ 之后
+    std::size_t eventOffset_ = 0;  // events_ 首个事件已发送的字节数
     
-    void close();
+    void closeLocked();
+    void finishInputLocked();
+    // 一次 sendmsg 发送多个事件，返回值同 send
+    ssize_t sendEventsLocked();
+    void consumeEventsLocked(std::size_t n);
 };
@@ -0,0 +1,153 @@
+#include "EventHub.hpp"
+#include "utils/Metrics.hpp"
+#include <algorithm>
+#include <chrono>
+
+EventHub::EventHub(StreamConfig config)
+    : config_(config),
+      subscribersGauge_(Metrics::getInstance().gauge(
+          "device_server_stream_subscribers", "Open event stream connections (pruned at each heartbeat)")),
+      published_(Metrics::getInstance().counter(
+          "device_server_stream_events_total", "Events published to at least one stream subscriber")),
+      dropped_(Metrics::getInstance().counter(
+          "device_server_stream_events_dropped_total", "Events dropped because a subscriber queue was full")),
+      slowDisconnects_(Metrics::getInstance().counter(
+          "device_server_stream_slow_disconnects_total", "Subscribers disconnected because their queue was full")) {
+}
+
+EventHub::~EventHub() {
+    stop();
+}
+
+void EventHub::start() {
+    std::lock_guard<std::mutex> lock(runMtx_);
+    if (running_) return;
+    running_ = true;
+    thread_ = std::thread(&EventHub::run, this);
+}
+
+void EventHub::stop() {
+    {
+        std::lock_guard<std::mutex> lock(runMtx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    runCv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+std::string_view EventHub::responseHead() {
+    // 注释行让客户端与代理立即收到响应头；X-Accel-Buffering 关闭 Nginx 对该响应的缓冲
+    return "HTTP/1.1 200 OK\r\n"
+           "Content-Type: text/event-stream; charset=utf-8\r\n"
+           "Cache-Control: no-cache\r\n"
+           "Connection: keep-alive\r\n"
+           "X-Accel-Buffering: no\r\n"
+           "\r\n"
+           ": ok\n\n";
+}
+
+void EventHub::subscribe(const std::vector<std::string>& topics, EventStream stream) {
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->stream = std::move(stream);
+    std::unique_lock<std::shared_mutex> lock(topicsMtx_);
+    for (const std::string& name : topics) {
+        std::unique_ptr<Topic>& topic = topics_[name];
+        if (!topic) topic = std::make_unique<Topic>();
+        std::lock_guard<std::mutex> topicLock(topic->mtx);
+        topic->subscribers.push_back(subscriber);
+    }
+    subscribers_.push_back(std::move(subscriber));
+    subscriberCount_.fetch_add(1, std::memory_order_relaxed);
+    subscribersGauge_.inc();
+}
+
+bool EventHub::hasSubscribers(std::string_view topic) const {
+    if (!active()) return false;
+    std::shared_lock<std::shared_mutex> lock(topicsMtx_);
+    return topics_.find(std::string(topic)) != topics_.end();
+}
+
+void EventHub::publish(std::string_view topic, std::string_view event, std::string_view data) {
+    if (!active()) return;
+    std::shared_lock<std::shared_mutex> lock(topicsMtx_);
+    auto it = topics_.find(std::string(topic));
+    if (it == topics_.end()) return;
+
+    auto buffer = std::make_shared<std::string>();
+    buffer->reserve(event.size() + data.size() + 16);
+    buffer->append("event: ").append(event).append("\n");
+    // 多行数据按 SSE 规范拆成多个 data 行
+    while (true) {
+        std::size_t eol = data.find('\n');
+        buffer->append("data: ").append(data.substr(0, eol)).append("\n");
+        if (eol == std::string_view::npos) break;
+        data.remove_prefix(eol + 1);
+    }
+    buffer->append("\n");
+    std::shared_ptr<const std::string> shared = std::move(buffer);
+
+    Topic& t = *it->second;
+    std::lock_guard<std::mutex> topicLock(t.mtx);
+    for (const auto& subscriber : t.subscribers) {
+        push(*subscriber, shared);
+    }
+    published_.inc();
+}
+
+void EventHub::push(Subscriber& subscriber, const std::shared_ptr<const std::string>& event) {
+    switch (subscriber.stream.push(event, config_.queueLimit, config_.dropOldest)) {
+        case StreamPush::DROPPED:
+            dropped_.inc();
+            break;
+        case StreamPush::OVERFLOW:
+            slowDisconnects_.inc();
+            break;
+        default:
+            break;
+    }
+}
+
+void EventHub::prune() {
+    std::unique_lock<std::shared_mutex> lock(topicsMtx_);
+    auto dead = [](const std::shared_ptr<Subscriber>& s) { return !s->stream.alive(); };
+    for (auto it = topics_.begin(); it != topics_.end();) {
+        auto& subscribers = it->second->subscribers;
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), dead), subscribers.end());
+        it = subscribers.empty() ? topics_.erase(it) : std::next(it);
+    }
+    std::size_t before = subscribers_.size();
+    subscribers_.erase(std::remove_if(subscribers_.begin(), subscribers_.end(), dead), subscribers_.end());
+    std::size_t removed = before - subscribers_.size();
+    if (removed > 0) {
+        subscriberCount_.fetch_sub(removed, std::memory_order_relaxed);
+        subscribersGauge_.add(-static_cast<int64_t>(removed));
+    }
+}
+
+void EventHub::run() {
+    // 关闭心跳时仍按默认间隔清理断开的订阅者
+    auto interval = std::chrono::seconds(config_.heartbeatSec > 0 ? config_.heartbeatSec : 15);
+    auto heartbeat = std::make_shared<const std::string>(":\n\n");
+    std::vector<std::shared_ptr<Subscriber>> snapshot;
+    std::unique_lock<std::mutex> lock(runMtx_);
+    while (running_) {
+        runCv_.wait_for(lock, interval, [this] { return !running_; });
+        if (!running_) break;
+        lock.unlock();
+
+        prune();
+        if (config_.heartbeatSec > 0) {
+            {
+                std::shared_lock<std::shared_mutex> topicsLock(topicsMtx_);
+                snapshot = subscribers_;
+            }
+            for (const auto& subscriber : snapshot) push(*subscriber, heartbeat);
+            snapshot.clear();
+        }
+
+        lock.lock();
+    }
+}
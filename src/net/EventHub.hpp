@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TcpServer.hpp"
+
+class Counter;
+class Gauge;
+
+struct StreamConfig {
+    std::size_t queueLimit = 256;  // 每个订阅者未发送事件上限，0 表示不限
+    bool dropOldest = true;        // 队列满时丢弃最旧事件；false 时断开慢订阅者（客户端重连后重新拉取）
+    int heartbeatSec = 15;         // 注释行心跳间隔，防止代理断开空闲连接，0 关闭
+};
+
+/**
+ * 事件推送中心（SSE）：按主题把事件扇出到订阅的事件流连接。
+ * 每条事件只序列化一次，所有订阅者共享同一缓冲区；同一主题的事件按发布顺序到达各订阅者。
+ * 发布方先用 hasSubscribers() 判断，无人订阅时不必构造事件。
+ * 已断开的订阅者由后台线程随心跳一并清理
+ */
+class EventHub {
+public:
+    explicit EventHub(StreamConfig config = StreamConfig());
+    ~EventHub();
+    EventHub(const EventHub&) = delete;
+    EventHub& operator=(const EventHub&) = delete;
+
+    void start();  // 启动心跳与清理线程
+    void stop();
+
+    // 一个连接可订阅多个主题
+    void subscribe(const std::vector<std::string>& topics, EventStream stream);
+
+    // 是否有任何订阅者：发布方据此跳过构造主题名
+    bool active() const { return subscriberCount_.load(std::memory_order_relaxed) > 0; }
+    bool hasSubscribers(std::string_view topic) const;
+
+    // 以 text/event-stream 格式发布：event 为事件名，data 为单行 JSON
+    void publish(std::string_view topic, std::string_view event, std::string_view data);
+
+    // 事件流连接的响应头
+    static std::string_view responseHead();
+
+private:
+    struct Subscriber {
+        EventStream stream;
+    };
+    struct Topic {
+        std::mutex mtx;  // 串行化同一主题的发布，保证各订阅者收到的顺序一致
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+    };
+
+    void run();
+    void push(Subscriber& subscriber, const std::shared_ptr<const std::string>& event);
+    // 移除已断开的订阅者与空主题
+    void prune();
+
+    StreamConfig config_;
+    mutable std::shared_mutex topicsMtx_;  // 保护 topics_ 的结构，发布只取共享锁
+    std::unordered_map<std::string, std::unique_ptr<Topic>> topics_;
+    std::vector<std::shared_ptr<Subscriber>> subscribers_;  // 全部订阅者（心跳用），受 topicsMtx_ 保护
+    std::atomic<std::size_t> subscriberCount_{0};
+
+    std::thread thread_;
+    std::mutex runMtx_;
+    std::condition_variable runCv_;
+    bool running_ = false;
+
+    Gauge& subscribersGauge_;
+    Counter& published_;
+    Counter& dropped_;
+    Counter& slowDisconnects_;
+};
@@ -1,70 +1,155 @@
 #include "HttpParser.hpp"
-#include <sstream>
+#include "utils/Tracer.hpp"
 #include <algorithm>
+#include <cctype>
+#include <charconv>
 
-bool HttpParser::parseRequest(const std::string& raw, HttpRequest& req) {
-    std::istringstream iss(raw);
-    std::string line;
+// 取出 [pos, 下一个 '\n') 的一行并去掉行尾 '\r'，pos 移到下一行开头
+static bool nextLine(std::string_view raw, std::size_t& pos, std::string_view& line) {
+    if (pos >= raw.size()) return false;
+    std::size_t eol = raw.find('\n', pos);
+    if (eol == std::string_view::npos) eol = raw.size();
+    line = raw.substr(pos, eol - pos);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    pos = eol < raw.size() ? eol + 1 : raw.size();
+    return true;
+}
+
+bool HttpParser::parseRequest(std::string_view raw, HttpRequest& req) {
+    TRACE_SPAN("http.parse");
+    std::size_t pos = 0;
+    std::string_view line;
     
     // 解析请求行
-    if (!std::getline(iss, line)) return false;
+    if (!nextLine(raw, pos, line)) return false;
     
     size_t pos1 = line.find(' ');
-    if (pos1 == std::string::npos) return false;
-    req.method = line.substr(0, pos1);
+    if (pos1 == std::string_view::npos) return false;
+    req.method.assign(line.substr(0, pos1));
     
     size_t pos2 = line.find(' ', pos1 + 1);
-    if (pos2 == std::string::npos) return false;
+    if (pos2 == std::string_view::npos) return false;
     
-    std::string pathAndQuery = line.substr(pos1 + 1, pos2 - pos1 - 1);
+    std::string_view pathAndQuery = line.substr(pos1 + 1, pos2 - pos1 - 1);
     size_t queryPos = pathAndQuery.find('?');
-    if (queryPos != std::string::npos) {
-        req.path = pathAndQuery.substr(0, queryPos);
-        req.query = pathAndQuery.substr(queryPos + 1);
+    if (queryPos != std::string_view::npos) {
+        req.path.assign(pathAndQuery.substr(0, queryPos));
+        req.query.assign(pathAndQuery.substr(queryPos + 1));
     } else {
-        req.path = pathAndQuery;
+        req.path.assign(pathAndQuery);
     }
     
     // 解析头部
-    while (std::getline(iss, line) && line != "\r" && !line.empty()) {
-        if (line.back() == '\r') line.pop_back();
+    while (nextLine(raw, pos, line) && !line.empty()) {
         size_t colonPos = line.find(':');
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 1);
+        if (colonPos != std::string_view::npos) {
+            std::pmr::string key(line.substr(0, colonPos), req.headers.get_allocator());
+            std::string_view value = line.substr(colonPos + 1);
             // 去除前导空格
             while (!value.empty() && value[0] == ' ') {
-                value = value.substr(1);
+                value.remove_prefix(1);
             }
             std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-            req.headers[key] = value;
+            req.headers[key].assign(value);
         }
     }
     
     // 读取 body
-    if (req.headers.find("content-length") != req.headers.end()) {
-        size_t contentLength = std::stoull(req.headers["content-length"]);
-        req.body.resize(contentLength);
-        iss.read(&req.body[0], contentLength);
+    auto it = req.headers.find(std::pmr::string("content-length", req.headers.get_allocator()));
+    if (it != req.headers.end()) {
+        size_t contentLength = 0;
+        std::from_chars(it->second.data(), it->second.data() + it->second.size(), contentLength);
+        req.body.assign(raw.substr(std::min(pos, raw.size()), contentLength));
     }
     
     return true;
 }
 
-std::string HttpParser::buildResponse(int statusCode, const std::string& body, 
-                                      const std::string& contentType) {
-    std::ostringstream oss;
+std::string_view HttpParser::queryParam(std::string_view query, std::string_view key) {
+    while (!query.empty()) {
+        std::size_t amp = query.find('&');
+        std::string_view token = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        std::size_t eq = token.find('=');
+        if (eq != std::string_view::npos && token.substr(0, eq) == key) {
+            return token.substr(eq + 1);
+        }
+    }
+    return {};
+}
+
+// 弱比较忽略 W/ 前缀
+static std::string_view opaqueTag(std::string_view tag) {
+    if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag.remove_prefix(2);
+    return tag;
+}
+
+bool HttpParser::etagMatches(std::string_view ifNoneMatch, std::string_view etag) {
+    std::string_view target = opaqueTag(etag);
+    while (!ifNoneMatch.empty()) {
+        std::size_t comma = ifNoneMatch.find(',');
+        std::string_view tag = ifNoneMatch.substr(0, comma);
+        ifNoneMatch = comma == std::string_view::npos ? std::string_view() : ifNoneMatch.substr(comma + 1);
+        while (!tag.empty() && (tag.front() == ' ' || tag.front() == '\t')) tag.remove_prefix(1);
+        while (!tag.empty() && (tag.back() == ' ' || tag.back() == '\t')) tag.remove_suffix(1);
+        if (tag == "*" || (!tag.empty() && opaqueTag(tag) == target)) return true;
+    }
+    return false;
+}
+
+std::string HttpParser::buildResponse(int statusCode, std::string_view body,
+                                      std::string_view contentType) {
+    std::string out;
+    buildResponse(out, statusCode, body, contentType);
+    return out;
+}
+
+void HttpParser::buildResponse(std::string& out, int statusCode, std::string_view body,
+                               std::string_view contentType, std::string_view extraHeaders) {
     const char* statusText = "OK";
-    if (statusCode == 400) statusText = "Bad Request";
+    if (statusCode == 202) statusText = "Accepted";
+    else if (statusCode == 304) statusText = "Not Modified";
+    else if (statusCode == 400) statusText = "Bad Request";
     else if (statusCode == 404) statusText = "Not Found";
+    else if (statusCode == 429) statusText = "Too Many Requests";
     else if (statusCode == 500) statusText = "Internal Server Error";
+    else if (statusCode == 503) statusText = "Service Unavailable";
     
-    oss << "HTTP/1.1 " << statusCode << " " << statusText << "\r\n";
-    oss << "Content-Type: " << contentType << "; charset=utf-8\r\n";
-    oss << "Content-Length: " << body.size() << "\r\n";
-    oss << "Connection: keep-alive\r\n";
-    oss << "\r\n";
-    oss << body;
-    
-    return oss.str();
+    char num[24];
+    out.clear();
+    out += "HTTP/1.1 ";
+    out.append(num, std::to_chars(num, num + sizeof(num), statusCode).ptr);
+    out += ' ';
+    out += statusText;
+    out += "\r\nContent-Type: ";
+    out += contentType;
+    out += "; charset=utf-8\r\nContent-Length: ";
+    out.append(num, std::to_chars(num, num + sizeof(num), body.size()).ptr);
+    out += "\r\nConnection: keep-alive\r\n";
+    out += extraHeaders;
+    out += "\r\n";
+    out += body;
+}
+
+bool HttpParser::notModified(const HttpRequest& req, std::string_view etag, std::string& out) {
+    if (etag.empty()) return false;
+    auto it = req.headers.find(std::pmr::string("if-none-match", req.headers.get_allocator()));
+    if (it == req.headers.end() || !etagMatches(it->second, etag)) return false;
+    std::pmr::string headers("ETag: ", req.headers.get_allocator());
+    headers += etag;
+    headers += "\r\nCache-Control: no-cache\r\n";
+    buildResponse(out, 304, "", "application/json", headers);
+    return true;
+}
+
+void HttpParser::buildCacheableResponse(std::string& out, std::string_view body, std::string_view etag,
+                                        std::pmr::memory_resource* mr) {
+    if (etag.empty()) {
+        buildResponse(out, 200, body);
+        return;
+    }
+    std::pmr::string headers("ETag: ", mr);
+    headers += etag;
+    headers += "\r\nCache-Control: no-cache\r\n";
+    buildResponse(out, 200, body, "application/json", headers);
 }
@@ -1,19 +1,39 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <memory_resource>
 
+// 字段均为 pmr 类型，可整体分配在请求级分配区（RequestArena）上
 struct HttpRequest {
-    std::string method;
-    std::string path;
-    std::string query;
-    std::unordered_map<std::string, std::string> headers;
-    std::string body;
+    explicit HttpRequest(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : method(mr), path(mr), query(mr), headers(mr), body(mr) {}
+
+    std::pmr::string method;
+    std::pmr::string path;
+    std::pmr::string query;
+    std::pmr::unordered_map<std::pmr::string, std::pmr::string> headers;
+    std::pmr::string body;
 };
 
 class HttpParser {
 public:
-    static bool parseRequest(const std::string& raw, HttpRequest& req);
-    static std::string buildResponse(int statusCode, const std::string& body, 
-                                      const std::string& contentType = "application/json");
+    static bool parseRequest(std::string_view raw, HttpRequest& req);
+    // 取查询串中 key 对应的原始值（不做 URL 解码），不存在返回空
+    static std::string_view queryParam(std::string_view query, std::string_view key);
+    // If-None-Match 是否与 etag 匹配（弱比较，支持逗号分隔的列表与 *）
+    static bool etagMatches(std::string_view ifNoneMatch, std::string_view etag);
+    static std::string buildResponse(int statusCode, std::string_view body,
+                                      std::string_view contentType = "application/json");
+    // 将响应写入 out（先清空，保留容量以便复用缓冲区）
+    // extraHeaders 为附加的完整头部行（每行以 \r\n 结尾），如 "Retry-After: 1\r\n"
+    static void buildResponse(std::string& out, int statusCode, std::string_view body,
+                              std::string_view contentType = "application/json",
+                              std::string_view extraHeaders = {});
+    // 条件 GET：If-None-Match 与 etag 匹配时写入 304 并返回 true，调用方无需执行查询（etag 为空时不匹配）
+    static bool notModified(const HttpRequest& req, std::string_view etag, std::string& out);
+    // 带 ETag 的 200 JSON 响应；no-cache 要求客户端每次用 If-None-Match 重新验证（etag 为空时为普通响应）
+    static void buildCacheableResponse(std::string& out, std::string_view body, std::string_view etag,
+                                       std::pmr::memory_resource* mr);
 };
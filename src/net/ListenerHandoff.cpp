@@ -0,0 +1,197 @@
+#include "ListenerHandoff.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+
+namespace {
+
+constexpr char kOffer = 'L';    // 旧进程 -> 新进程，随附监听 fd
+constexpr char kConfirm = 'R';  // 新进程 -> 旧进程，已开始 accept
+constexpr int kTimeoutSec = 5;  // 交接双方等待对方的上限
+
+struct HandoffMetrics {
+    Counter& ok = Metrics::getInstance().counter(
+        "device_server_listener_handoffs_total", "Listening socket handoffs to a new process by result",
+        "result=\"ok\"");
+    Counter& failed = Metrics::getInstance().counter(
+        "device_server_listener_handoffs_total", "Listening socket handoffs to a new process by result",
+        "result=\"failed\"");
+};
+
+HandoffMetrics& handoffMetrics() {
+    static HandoffMetrics metrics;
+    return metrics;
+}
+
+bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Invalid handoff socket path: " + path);
+        return false;
+    }
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+void setTimeouts(int fd) {
+    timeval tv{kTimeoutSec, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+}  // namespace
+
+ListenerHandoff::~ListenerHandoff() {
+    stop();
+}
+
+ListenerHandoff::Receive ListenerHandoff::receive(const std::string& path, int& listenFd) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return Receive::FAILED;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create handoff socket: " + std::string(strerror(errno)));
+        return Receive::FAILED;
+    }
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        // 文件不存在或残留（进程已退出）：正常启动
+        if (err == ENOENT || err == ECONNREFUSED) return Receive::NONE;
+        LOG_ERROR("Failed to connect to handoff socket " + path + ": " + strerror(err));
+        return Receive::FAILED;
+    }
+    setTimeouts(fd);
+
+    char offer = 0;
+    iovec iov{&offer, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    cmsghdr* cmsg = n == 1 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (offer != kOffer || !cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        LOG_ERROR("Handoff from " + path + " failed: " +
+                  (n < 0 ? std::string(strerror(errno)) : std::string("no listening socket received")));
+        close(fd);
+        return Receive::FAILED;
+    }
+    std::memcpy(&listenFd, CMSG_DATA(cmsg), sizeof(int));
+    peerFd_ = fd;
+    return Receive::RECEIVED;
+}
+
+bool ListenerHandoff::confirm() {
+    if (peerFd_ < 0) return false;
+    bool ok = send(peerFd_, &kConfirm, 1, MSG_NOSIGNAL) == 1;
+    if (!ok) LOG_ERROR("Failed to confirm handoff: " + std::string(strerror(errno)));
+    close(peerFd_);
+    peerFd_ = -1;
+    return ok;
+}
+
+bool ListenerHandoff::serve(const std::string& path, int listenFd, std::function<void()> onHandedOff) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return false;
+    serverFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (serverFd_ < 0) {
+        LOG_ERROR("Failed to create handoff socket: " + std::string(strerror(errno)));
+        return false;
+    }
+    // 残留文件，或刚把监听 socket 交给本进程的旧进程留下的文件
+    unlink(path.c_str());
+    if (bind(serverFd_, (sockaddr*)&addr, sizeof(addr)) < 0 || chmod(path.c_str(), 0600) < 0 ||
+        ::listen(serverFd_, 4) < 0) {
+        LOG_ERROR("Failed to listen on handoff socket " + path + ": " + strerror(errno));
+        close(serverFd_);
+        serverFd_ = -1;
+        return false;
+    }
+    path_ = path;
+    listenFd_ = listenFd;
+    onHandedOff_ = std::move(onHandedOff);
+    stopping_ = false;
+    thread_ = std::thread(&ListenerHandoff::serveLoop, this);
+    LOG_INFO("Waiting for listener handoff on " + path);
+    return true;
+}
+
+void ListenerHandoff::serveLoop() {
+    while (!stopping_) {
+        pollfd pfd{serverFd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        int peerFd = accept4(serverFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (peerFd < 0) continue;
+        bool ok = handOff(peerFd);
+        close(peerFd);
+        if (!ok) {
+            handoffMetrics().failed.inc();
+            continue;
+        }
+        handoffMetrics().ok.inc();
+        handedOff_ = true;
+        LOG_INFO("Listening socket handed off to new process");
+        onHandedOff_();
+        return;
+    }
+}
+
+bool ListenerHandoff::handOff(int peerFd) {
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    if (getsockopt(peerFd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || cred.uid != geteuid()) {
+        LOG_WARNING("Rejected handoff request from uid " + std::to_string(cred.uid));
+        return false;
+    }
+    setTimeouts(peerFd);
+
+    iovec iov{const_cast<char*>(&kOffer), 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &listenFd_, sizeof(int));
+    if (sendmsg(peerFd, &msg, MSG_NOSIGNAL) != 1) {
+        LOG_WARNING("Failed to send listening socket to pid " + std::to_string(cred.pid) + ": " + strerror(errno));
+        return false;
+    }
+    // 新进程在确认前退出（或超时）：继续服务，它已经 accept 的连接由它自己处理
+    char ack = 0;
+    if (recv(peerFd, &ack, 1, 0) != 1 || ack != kConfirm) {
+        LOG_WARNING("Process " + std::to_string(cred.pid) + " did not confirm the handoff, keep serving");
+        return false;
+    }
+    return true;
+}
+
+void ListenerHandoff::stop() {
+    stopping_ = true;
+    if (thread_.joinable()) thread_.join();
+    if (serverFd_ >= 0) {
+        close(serverFd_);
+        serverFd_ = -1;
+        if (!handedOff_) unlink(path_.c_str());
+    }
+    if (peerFd_ >= 0) {
+        close(peerFd_);
+        peerFd_ = -1;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * 监听 socket 交接（平滑升级）
+ * 运行中的进程在 Unix socket 上等待新进程连接，通过 SCM_RIGHTS 把监听 fd 交给它；
+ * 新进程开始 accept 后回复确认，旧进程收到确认才停止 accept 并排空，
+ * 交接期间两个进程共享同一个监听队列，客户端不会遇到拒绝连接。
+ * 新进程在确认前退出时旧进程照常服务，等待下一次交接。
+ * 只接受同一用户的进程连接（SO_PEERCRED），socket 文件权限为 0600
+ */
+class ListenerHandoff {
+public:
+    enum class Receive {
+        NONE,      // path 上没有运行中的进程
+        RECEIVED,  // 已收到监听 fd，开始 accept 后需调用 confirm()
+        FAILED     // 有进程在运行，但交接失败
+    };
+
+    ListenerHandoff() = default;
+    ~ListenerHandoff();
+    ListenerHandoff(const ListenerHandoff&) = delete;
+    ListenerHandoff& operator=(const ListenerHandoff&) = delete;
+
+    // 新进程：连接 path 上的旧进程并接收监听 fd
+    Receive receive(const std::string& path, int& listenFd);
+    // 新进程：已开始 accept，通知旧进程停止 accept 并排空
+    bool confirm();
+
+    /**
+     * 在 path 上等待下一个新进程（后台线程），交出 listenFd。
+     * 新进程确认后在后台线程中调用 onHandedOff，之后不再接受交接
+     */
+    bool serve(const std::string& path, int listenFd, std::function<void()> onHandedOff);
+    // 停止等待；未交接时删除 socket 文件（交接后该路径已属于新进程）
+    void stop();
+
+private:
+    void serveLoop();
+    bool handOff(int peerFd);
+
+    int peerFd_ = -1;    // receive 后保留到 confirm
+    int serverFd_ = -1;
+    int listenFd_ = -1;
+    std::string path_;
+    std::function<void()> onHandedOff_;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> handedOff_{false};
+};
@@ -0,0 +1,63 @@
+#include "RateLimiter.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr uint64_t kSweepIntervalNs = 1000000000;  // 两次清理至少间隔 1 秒
+
+}  // namespace
+
+RateLimiter::RateLimiter(double rate, double burst, std::size_t maxKeys)
+    : rate_(rate), burst_(std::max(burst, 1.0)), maxKeys_(maxKeys) {
+}
+
+void RateLimiter::setLimits(double rate, double burst) {
+    rate_ = rate;
+    burst_ = std::max(burst, 1.0);
+}
+
+bool RateLimiter::tryAcquire(std::string_view key, uint64_t nowNs, double& retryAfterSec) {
+    key_.assign(key.data(), key.size());
+    auto it = buckets_.find(key_);
+    if (it == buckets_.end()) {
+        if (buckets_.size() >= maxKeys_) {
+            sweep(nowNs);
+            // 活跃键已达上限：淘汰最久未使用的桶，新键照常限流
+            while (!lru_.empty() && buckets_.size() >= maxKeys_) {
+                buckets_.erase(*lru_.back());
+                lru_.pop_back();
+            }
+        }
+        auto inserted = buckets_.emplace(key_, Bucket{burst_ - 1, nowNs, {}}).first;
+        lru_.push_front(&inserted->first);
+        inserted->second.lru = lru_.begin();
+        return true;
+    }
+
+    Bucket& b = it->second;
+    lru_.splice(lru_.begin(), lru_, b.lru);
+    double elapsed = static_cast<double>(nowNs - std::min(nowNs, b.updatedNs)) / 1e9;
+    b.tokens = std::min(burst_, b.tokens + elapsed * rate_);
+    b.updatedNs = nowNs;
+    if (b.tokens >= 1) {
+        b.tokens -= 1;
+        return true;
+    }
+    retryAfterSec = (1 - b.tokens) / rate_;
+    return false;
+}
+
+void RateLimiter::sweep(uint64_t nowNs) {
+    if (lastSweepNs_ != 0 && nowNs - lastSweepNs_ < kSweepIntervalNs) return;
+    lastSweepNs_ = nowNs;
+    for (auto it = buckets_.begin(); it != buckets_.end();) {
+        double elapsed = static_cast<double>(nowNs - std::min(nowNs, it->second.updatedNs)) / 1e9;
+        if (it->second.tokens + elapsed * rate_ >= burst_) {
+            lru_.erase(it->second.lru);
+            it = buckets_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
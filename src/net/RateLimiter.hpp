@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * 令牌桶限流（按字符串键，如客户端 IP、device_id）
+ * 每个键以 rate 个/秒补充令牌，最多积累 burst 个，每个请求消耗一个。
+ * 只在 epoll 线程调用，不加锁。键数达到上限时清理已补满的桶（与新建的桶等价），
+ * 仍然满时淘汰最久未使用的桶，大量一次性客户端不会无限占用内存，新键也照常限流
+ */
+class RateLimiter {
+public:
+    RateLimiter(double rate, double burst, std::size_t maxKeys = 100000);
+
+    /**
+     * 为 key 取一个令牌
+     * @param retryAfterSec 令牌不足时写入下一个令牌补充到位的等待秒数
+     * @return 取到令牌返回 true
+     */
+    bool tryAcquire(std::string_view key, uint64_t nowNs, double& retryAfterSec);
+
+    // 调整速率与容量，已有的桶保留（令牌数在下次取用时按新容量截断）
+    void setLimits(double rate, double burst);
+
+    std::size_t size() const { return buckets_.size(); }
+
+private:
+    struct Bucket {
+        double tokens;
+        uint64_t updatedNs;
+        std::list<const std::string*>::iterator lru;  // 在 lru_ 中的位置
+    };
+
+    void sweep(uint64_t nowNs);
+
+    double rate_;
+    double burst_;
+    std::size_t maxKeys_;
+    uint64_t lastSweepNs_ = 0;
+    std::string key_;  // 查找用的复用缓冲区，避免每次构造 std::string
+    std::unordered_map<std::string, Bucket> buckets_;
+    std::list<const std::string*> lru_;  // 指向 buckets_ 中的键，最近使用的在前
+};
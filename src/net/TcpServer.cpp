@@ -1,6 +1,12 @@
 #include "TcpServer.hpp"
+#include "RateLimiter.hpp"
+#include "HttpParser.hpp"
+#include "WebSocket.hpp"
 #include "thread/ThreadPool.hpp"
+#include "thread/CpuAffinity.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -9,8 +15,137 @@
 #include <sys/epoll.h>
 #include <cstring>
 #include <errno.h>
+#include <chrono>
+#include <cmath>
 #include <mutex>
 
+namespace {
+
+struct AdmissionMetrics {
+    Counter& overload = Metrics::getInstance().counter(
+        "device_server_requests_rejected_total", "Requests rejected before dispatch by admission control",
+        "reason=\"overload\"");
+    Counter& ipRateLimit = Metrics::getInstance().counter(
+        "device_server_requests_rejected_total", "Requests rejected before dispatch by admission control",
+        "reason=\"ip_rate_limit\"");
+    Counter& deviceRateLimit = Metrics::getInstance().counter(
+        "device_server_requests_rejected_total", "Requests rejected before dispatch by admission control",
+        "reason=\"device_rate_limit\"");
+};
+
+AdmissionMetrics& admissionMetrics() {
+    static AdmissionMetrics metrics;
+    return metrics;
+}
+
+uint64_t steadyNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * 不做 HTTP / JSON 解析，只在原始请求中定位 device_id 的值：
+ * 先查请求行的查询串（device_id=xxx），再查 body 中的 "device_id":"xxx"，找不到返回空
+ */
+std::string_view findDeviceId(std::string_view raw) {
+    constexpr std::size_t kMaxLength = 128;
+    std::size_t lineEnd = raw.find("\r\n");
+    std::string_view requestLine = raw.substr(0, lineEnd);
+    std::size_t queryStart = requestLine.find('?');
+    if (queryStart != std::string_view::npos) {
+        std::string_view value = HttpParser::queryParam(
+            requestLine.substr(queryStart + 1, requestLine.rfind(' ') - queryStart - 1), "device_id");
+        if (!value.empty()) return value.substr(0, kMaxLength);
+    }
+
+    std::size_t bodyStart = raw.find("\r\n\r\n");
+    if (bodyStart == std::string_view::npos) return {};
+    std::size_t pos = raw.find("\"device_id\"", bodyStart);
+    if (pos == std::string_view::npos) return {};
+    pos += 11;
+    while (pos < raw.size() && (raw[pos] == ' ' || raw[pos] == '\t' || raw[pos] == ':')) ++pos;
+    if (pos >= raw.size() || raw[pos] != '"') return {};
+    std::size_t end = raw.find('"', pos + 1);
+    if (end == std::string_view::npos) return {};
+    return raw.substr(pos + 1, std::min(end - pos - 1, kMaxLength));
+}
+
+void buildRejection(std::string& out, int statusCode, double retryAfterSec) {
+    char header[48];
+    std::snprintf(header, sizeof(header), "Retry-After: %d\r\n",
+                  std::max(1, static_cast<int>(std::ceil(retryAfterSec))));
+    HttpParser::buildResponse(out, statusCode,
+                              statusCode == 429 ? "{\"code\":429,\"message\":\"Too many requests\"}"
+                                                : "{\"code\":503,\"message\":\"Server overloaded\"}",
+                              "application/json", header);
+}
+
+// 排空期间的最后一个响应：把 Connection: keep-alive 改为 close，通知客户端不再复用该连接
+void markConnectionClose(std::string& response) {
+    std::size_t headerEnd = response.find("\r\n\r\n");
+    if (response.compare(0, 5, "HTTP/") != 0 || headerEnd == std::string::npos) return;
+    constexpr std::string_view kKeepAlive = "\r\nConnection: keep-alive\r\n";
+    std::size_t pos = response.find(kKeepAlive);
+    if (pos != std::string::npos && pos < headerEnd) {
+        response.replace(pos, kKeepAlive.size(), "\r\nConnection: close\r\n");
+    } else {
+        response.insert(headerEnd + 2, "Connection: close\r\n");
+    }
+}
+
+}  // namespace
+
+thread_local TcpServer::HandlerContext* TcpServer::currentContext_ = nullptr;
+
+void DeferredResponse::resume(Builder build) const {
+    server_->resumeDeferred(conn_, std::move(build));
+}
+
+DeferredResponse TcpServer::deferResponse() {
+    DeferredResponse deferred;
+    HandlerContext* ctx = currentContext_;
+    if (!ctx || ctx->deferred) return deferred;
+    ctx->deferred = true;
+    deferred.server_ = ctx->server;
+    deferred.conn_ = *ctx->conn;
+    return deferred;
+}
+
+StreamPush EventStream::push(const std::shared_ptr<const std::string>& event, std::size_t maxQueued,
+                             bool dropOldest) const {
+    std::shared_ptr<Connection> conn = conn_.lock();
+    if (!conn) return StreamPush::CLOSED;
+    bool flush = false;
+    StreamPush result = conn->pushEvent(event, maxQueued, dropOldest, flush);
+    if (flush) server_->flush(*conn);
+    return result;
+}
+
+bool EventStream::alive() const {
+    std::shared_ptr<Connection> conn = conn_.lock();
+    return conn && !conn->isClosed();
+}
+
+EventStream TcpServer::openStream(std::string_view head) {
+    EventStream stream;
+    HandlerContext* ctx = currentContext_;
+    if (!ctx || ctx->deferred) return stream;
+    ctx->deferred = true;
+    ctx->streaming = true;
+    // 响应头先于任何事件进入写缓冲区：返回后其他线程即可推送
+    (*ctx->conn)->beginStream(head);
+    stream.server_ = ctx->server;
+    stream.conn_ = *ctx->conn;
+    return stream;
+}
+
+bool TcpServer::acceptWebSocket(MessageHandler handler) {
+    HandlerContext* ctx = currentContext_;
+    if (!ctx || ctx->deferred) return false;
+    (*ctx->conn)->upgrade(std::move(handler));
+    return true;
+}
+
 TcpServer::TcpServer() : listenFd_(-1), epollFd_(-1), threadPool_(nullptr), running_(false) {
 }
 
@@ -69,6 +204,27 @@ bool TcpServer::listen(const std::string& host, int port) {
     return true;
 }
 
+bool TcpServer::adoptListener(int fd) {
+    int accepting = 0;
+    socklen_t len = sizeof(accepting);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &len) < 0 || !accepting) {
+        LOG_ERROR("Inherited fd " + std::to_string(fd) + " is not a listening socket");
+        return false;
+    }
+    if (setNonBlocking(fd) < 0) {
+        LOG_ERROR("Failed to set non-blocking: " + std::string(strerror(errno)));
+        return false;
+    }
+    listenFd_ = fd;
+    setupEpoll();
+    
+    sockaddr_in addr{};
+    len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    LOG_INFO("Server listening on inherited socket, port " + std::to_string(ntohs(addr.sin_port)));
+    return true;
+}
+
 void TcpServer::setupEpoll() {
     epollFd_ = epoll_create1(0);
     if (epollFd_ < 0) {
@@ -90,6 +246,53 @@ void TcpServer::setThreadPool(ThreadPool* threadPool) {
     threadPool_ = threadPool;
 }
 
+void TcpServer::setRateLimits(double ipRate, double ipBurst, double deviceRate, double deviceBurst) {
+    std::lock_guard<std::mutex> lock(limitsMtx_);
+    pendingLimits_ = RateLimits{ipRate, ipBurst > 0 ? ipBurst : ipRate, deviceRate,
+                                deviceBurst > 0 ? deviceBurst : deviceRate};
+    limitsChanged_.store(true, std::memory_order_release);
+}
+
+void TcpServer::applyRateLimits() {
+    RateLimits limits;
+    {
+        std::lock_guard<std::mutex> lock(limitsMtx_);
+        limits = pendingLimits_;
+        limitsChanged_.store(false, std::memory_order_relaxed);
+    }
+    auto apply = [](std::unique_ptr<RateLimiter>& limiter, double rate, double burst) {
+        if (rate <= 0) limiter.reset();
+        else if (limiter) limiter->setLimits(rate, burst);
+        else limiter = std::make_unique<RateLimiter>(rate, burst);
+    };
+    apply(ipLimiter_, limits.ipRate, limits.ipBurst);
+    apply(deviceLimiter_, limits.deviceRate, limits.deviceBurst);
+}
+
+bool TcpServer::admit(const Connection& conn, const std::string& raw, uint64_t nowNs, std::string& rejection) {
+    // 先判断过载：被 503 拒绝的请求不消耗客户端的令牌
+    if (threadPool_ && threadPool_->overloaded()) {
+        admissionMetrics().overload.inc();
+        buildRejection(rejection, 503, retryAfterSec_.load(std::memory_order_relaxed));
+        return false;
+    }
+    double retryAfter = 0;
+    if (ipLimiter_ && !ipLimiter_->tryAcquire(conn.peerAddress(), nowNs, retryAfter)) {
+        admissionMetrics().ipRateLimit.inc();
+        buildRejection(rejection, 429, retryAfter);
+        return false;
+    }
+    if (deviceLimiter_) {
+        std::string_view deviceId = findDeviceId(raw);
+        if (!deviceId.empty() && !deviceLimiter_->tryAcquire(deviceId, nowNs, retryAfter)) {
+            admissionMetrics().deviceRateLimit.inc();
+            buildRejection(rejection, 429, retryAfter);
+            return false;
+        }
+    }
+    return true;
+}
+
 void TcpServer::handleAccept() {
     while (true) {
         sockaddr_in clientAddr{};
@@ -108,8 +311,11 @@ void TcpServer::handleAccept() {
             continue;
         }
         
-        auto conn = std::make_unique<Connection>(clientFd);
+        auto conn = std::make_shared<Connection>(clientFd);
         conn->setHandler(requestHandler_);
+        char ip[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &clientAddr.sin_addr, ip, sizeof(ip));
+        conn->setPeerAddress(ip);
         
         epoll_event ev{};
         ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
@@ -135,80 +341,236 @@ void TcpServer::handleEvent(int fd, uint32_t events) {
     std::unique_lock<std::mutex> lock(connectionsMtx_);
     auto it = connections_.find(fd);
     if (it == connections_.end()) return;
-    auto& conn = it->second;
-    
-    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-        connections_.erase(it);
-        return;
-    }
+    // 持有引用：处理期间即使连接被移出表，对象与 fd 仍然有效
+    std::shared_ptr<Connection> conn = it->second;
     
     if (events & EPOLLIN) {
+        // 开启采样时才取时间，读到完整请求后再决定是否追踪
+        uint64_t readStart = Tracer::getSampleEvery() ? Tracer::nowNs() : 0;
         conn->onReadable();
         
-        // 检查是否有完整请求需要处理
-        std::string request = conn->extractRequest();
-        if (!request.empty() && requestHandler_) {
+        // 一次读取可能包含多个请求（流水线），全部入队后由一个处理者按顺序执行
+        bool schedule = false;
+        bool responded = false;
+        uint64_t now = (ipLimiter_ || deviceLimiter_) ? steadyNowNs() : 0;
+        std::string request;
+        std::string rejection;
+        while (requestHandler_ && !(request = conn->extractRequest()).empty()) {
+            if (conn->isUpgraded()) {
+                PendingRequest pending;
+                pending.raw = std::move(request);
+                pending.frame = true;
+                schedule |= conn->enqueueRequest(std::move(pending));
+                continue;
+            }
+            // 准入控制在分发前完成，被拒绝的请求不进入线程池；
+            // 连接上还有未处理完的请求时，拒绝响应排在它们之后写回
+            if (!admit(*conn, request, now, rejection)) {
+                if (conn->respondIfIdle(rejection)) {
+                    responded = true;
+                } else {
+                    PendingRequest pending;
+                    pending.raw = std::move(rejection);
+                    pending.rejected = true;
+                    schedule |= conn->enqueueRequest(std::move(pending));
+                }
+                continue;
+            }
+            PendingRequest pending;
+            pending.raw = std::move(request);
+            pending.traceId = readStart ? Tracer::sampleRequest() : 0;
+            if (pending.traceId) {
+                pending.enqueueTime = Tracer::nowNs();
+                Tracer::record("epoll.read", pending.traceId, readStart, pending.enqueueTime);
+            }
+            schedule |= conn->enqueueRequest(std::move(pending));
+        }
+        
+        if (schedule) {
             // 如果有线程池，将业务处理提交到线程池
             if (threadPool_) {
-                // 捕获fd和request的副本，在线程池中处理
-                int clientFd = fd;
-                threadPool_->submit([this, clientFd, request]() {
-                    processRequest(clientFd, request);
+                threadPool_->submit([this, conn]() {
+                    processRequests(conn);
                 });
             } else {
-                // 无线程池时：必须先释放锁再调用 processRequest，否则 processRequest 内再次加锁会死锁
+                // 无线程池时：先释放锁再处理，避免处理期间阻塞 stop() 等其他加锁方
                 lock.unlock();
-                processRequest(fd, request);
+                processRequests(conn);
                 lock.lock();
-                // 锁释放期间 it 可能失效，需重新查找
-                it = connections_.find(fd);
-                if (it == connections_.end()) return;
             }
         }
-        
-        if (it->second->isClosed()) {
-            connections_.erase(it);
-            return;
+        if (responded) {
+            conn->onWritable();
+            if (conn->hasPendingWrite() && !conn->isClosed()) triggerWrite(fd);
         }
+        if (conn->isReadClosed()) conn->finishInput();
     }
     
     if (events & EPOLLOUT) {
         conn->onWritable();
-        if (conn->isClosed()) {
-            connections_.erase(it);
-            return;
-        }
+    }
+    
+    // 对端只关闭写方向（EPOLLRDHUP）时保留连接，继续等待 EPOLLOUT 写回已读到请求的响应；
+    // 完全关闭或出错时移除（处理任务持有连接引用，已读到的请求仍会处理完）
+    if ((events & (EPOLLHUP | EPOLLERR)) || conn->isClosed()) {
+        connections_.erase(fd);
+    }
+}
+
+void TcpServer::processRequests(const std::shared_ptr<Connection>& conn) {
+    PendingRequest request;
+    while (conn->nextRequest(request)) {
+        // 延迟响应：保留处理权直接返回，响应写回后由 resumeDeferred 继续处理队列
+        if (!processRequest(conn, request)) return;
     }
 }
 
-void TcpServer::processRequest(int fd, const std::string& request) {
-    Connection* conn = nullptr;
+bool TcpServer::processRequest(const std::shared_ptr<Connection>& conn, const PendingRequest& request) {
+    if (request.rejected) {
+        writeResponse(*conn, request.raw);
+        return true;
+    }
+    if (request.frame) {
+        processFrame(conn, request.raw);
+        return true;
+    }
+    
+    Tracer::Scope traceScope(request.traceId);
+    if (request.traceId) Tracer::record("threadpool.queue", request.traceId, request.enqueueTime, Tracer::nowNs());
+    TRACE_SPAN("processRequest");
+    
+    // 执行业务处理
+    // 响应缓冲区按线程复用，保留上次的容量
+    thread_local std::string response;
+    response.clear();
+    HandlerContext ctx{this, &conn, false, false};
     {
-        std::lock_guard<std::mutex> lock(connectionsMtx_);
-        auto it = connections_.find(fd);
-        if (it == connections_.end()) {
-            // 连接已关闭
-            return;
+        TRACE_SPAN("handler");
+        currentContext_ = &ctx;
+        requestHandler_(request.raw, response);
+        currentContext_ = nullptr;
+    }
+    if (ctx.deferred) {
+        // 事件流不再释放处理权，后续数据在 extractRequest 中丢弃
+        if (ctx.streaming) flush(*conn);
+        return false;
+    }
+    
+    TRACE_SPAN("write");
+    writeHttpResponse(*conn, response);
+    return true;
+}
+
+void TcpServer::processFrame(const std::shared_ptr<Connection>& conn, const std::string& raw) {
+    Connection::WebSocketState& ws = *conn->webSocket();
+    if (ws.closing) return;
+    thread_local std::string payload;
+    thread_local std::string reply;
+    thread_local std::string out;
+    out.clear();
+    
+    WebSocket::Frame frame;
+    uint16_t closeCode = 0;
+    if (!WebSocket::parseFrame(raw, frame, payload)) {
+        closeCode = WebSocket::PROTOCOL_ERROR;
+    } else if (frame.opcode == WebSocket::PING) {
+        WebSocket::appendFrame(out, WebSocket::PONG, payload);
+    } else if (frame.opcode == WebSocket::CLOSE) {
+        closeCode = WebSocket::NORMAL;
+    } else if (frame.opcode == WebSocket::TEXT || (frame.opcode == WebSocket::CONTINUATION && !ws.fragmented)) {
+        closeCode = frame.opcode == WebSocket::TEXT ? WebSocket::UNSUPPORTED_DATA : WebSocket::PROTOCOL_ERROR;
+    } else if (frame.opcode == WebSocket::BINARY || frame.opcode == WebSocket::CONTINUATION) {
+        bool complete = frame.fin;
+        std::string_view message = payload;
+        if (frame.opcode == WebSocket::BINARY && ws.fragmented) {
+            closeCode = WebSocket::PROTOCOL_ERROR;  // 上一条分片消息未结束
+        } else if (ws.fragmented || !frame.fin) {
+            // 分片消息：收齐后再交给处理函数
+            if (ws.fragments.size() + payload.size() > WebSocket::kMaxPayload) {
+                closeCode = WebSocket::TOO_LARGE;
+            } else {
+                ws.fragments += payload;
+                ws.fragmented = !frame.fin;
+                message = ws.fragments;
+            }
         }
-        if (it->second->isClosed()) {
-            return;
+        if (closeCode == 0 && complete) {
+            reply.clear();
+            ws.owesIdle = conn->hasPendingRequests();
+            bool ok = ws.handler(message, ws.owesIdle, reply);
+            ws.fragments.clear();
+            if (!reply.empty()) WebSocket::appendFrame(out, WebSocket::BINARY, reply);
+            if (!ok) closeCode = WebSocket::POLICY_VIOLATION;
         }
-        // 获取Connection指针（Connection本身是线程安全的）
-        conn = it->second.get();
     }
+    // PONG 与未知的非控制帧忽略
     
-    // 执行业务处理（在锁外执行，避免阻塞其他连接）
-    std::string response;
-    requestHandler_(request, response);
-    
+    // 排在数据消息之后的是控制帧或分片时，队列处理完也要通知处理函数
+    if (closeCode == 0 && ws.owesIdle && !conn->hasPendingRequests()) {
+        reply.clear();
+        ws.owesIdle = false;
+        bool ok = ws.handler(std::string_view(), false, reply);
+        if (!reply.empty()) WebSocket::appendFrame(out, WebSocket::BINARY, reply);
+        if (!ok) closeCode = WebSocket::POLICY_VIOLATION;
+    }
+    // 排空：在消息边界先写入累积的数据并确认，再以 1001 关闭，之后排队的帧丢弃（未确认，由客户端重发）
+    if (closeCode == 0 && !ws.fragmented && conn->goingAwayRequested()) {
+        if (ws.owesIdle) {
+            reply.clear();
+            ws.owesIdle = false;
+            bool ok = ws.handler(std::string_view(), false, reply);
+            if (!reply.empty()) WebSocket::appendFrame(out, WebSocket::BINARY, reply);
+            if (!ok) closeCode = WebSocket::POLICY_VIOLATION;
+        }
+        if (closeCode == 0) closeCode = WebSocket::GOING_AWAY;
+    }
+    if (closeCode != 0) {
+        WebSocket::appendClose(out, closeCode);
+        ws.closing = true;
+    }
+    if (!out.empty()) writeResponse(*conn, out);
+    // 关闭帧发送完后 shutdown，epoll 线程随 HUP 移除连接
+    if (closeCode != 0) conn->closeAfterWrite();
+}
+
+void TcpServer::resumeDeferred(const std::shared_ptr<Connection>& conn, DeferredResponse::Builder build) {
+    auto task = [this, conn, build = std::move(build)]() {
+        thread_local std::string response;
+        response.clear();
+        build(response);
+        writeHttpResponse(*conn, response);
+        processRequests(conn);
+    };
+    // 回调通常来自存储的 I/O 线程，生成响应与后续请求交回线程池执行
+    if (threadPool_ && running_) {
+        threadPool_->submit(std::move(task));
+    } else {
+        task();
+    }
+}
+
+void TcpServer::writeResponse(Connection& conn, const std::string& response) {
     // 将响应追加到连接的写缓冲区
-    conn->appendResponse(response);
-    
+    conn.appendResponse(response);
+    flush(conn);
+}
+
+void TcpServer::writeHttpResponse(Connection& conn, std::string& response) {
+    // 升级为 WebSocket 的 101 响应之后连接由帧处理接管，不在这里关闭
+    bool last = draining_.load(std::memory_order_relaxed) && !conn.isUpgraded() && !conn.hasPendingRequests();
+    if (last) markConnectionClose(response);
+    writeResponse(conn, response);
+    if (last) conn.closeAfterWrite();
+}
+
+void TcpServer::flush(Connection& conn) {
     // ET 模式下，socket 已可写时 epoll 不会触发 EPOLLOUT，需立即尝试发送
-    conn->onWritable();
+    conn.onWritable();
     
-    // 若 writeBuffer 仍有数据，触发 EPOLLOUT 以便后续发送
-    triggerWrite(fd);
+    // 若 writeBuffer 仍有数据（socket 发送缓冲区满），重新注册以等待 EPOLLOUT
+    if (conn.hasPendingWrite() && !conn.isClosed()) {
+        triggerWrite(conn.fd());
+    }
 }
 
 void TcpServer::triggerWrite(int fd) {
@@ -222,9 +584,27 @@ void TcpServer::triggerWrite(int fd) {
 
 void TcpServer::run() {
     running_ = true;
+    CpuAffinity::pinCurrentThread(cpus_);
+    Tracer::setThreadName("epoll");
     epoll_event events[MAX_EVENTS];
     
+    uint64_t lastSweepNs = 0;
     while (running_) {
+        if (limitsChanged_.load(std::memory_order_acquire)) applyRateLimits();
+        if (draining_.load(std::memory_order_acquire)) {
+            if (listenFd_ >= 0) {
+                // 交接后新进程持有同一监听 socket，这里关闭的只是本进程的引用
+                epoll_ctl(epollFd_, EPOLL_CTL_DEL, listenFd_, nullptr);
+                close(listenFd_);
+                listenFd_ = -1;
+                LOG_INFO("Stopped accepting connections, draining");
+            }
+            uint64_t now = steadyNowNs();
+            if (now - lastSweepNs >= 100000000) {
+                closeIdleConnections();
+                lastSweepNs = now;
+            }
+        }
         int nfds = epoll_wait(epollFd_, events, MAX_EVENTS, 100);
         if (nfds < 0) {
             if (errno == EINTR) continue;
@@ -238,6 +618,35 @@ void TcpServer::run() {
     }
 }
 
+void TcpServer::drain() {
+    draining_.store(true, std::memory_order_release);
+}
+
+std::size_t TcpServer::connectionCount() {
+    std::lock_guard<std::mutex> lock(connectionsMtx_);
+    return connections_.size();
+}
+
+void TcpServer::closeIdleConnections() {
+    std::vector<std::shared_ptr<Connection>> conns;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMtx_);
+        conns.reserve(connections_.size());
+        for (const auto& entry : connections_) conns.push_back(entry.second);
+    }
+    std::string goingAway;
+    WebSocket::appendClose(goingAway, WebSocket::GOING_AWAY);
+    // 活跃的 HTTP 连接等下一个请求以 Connection: close 响应后关闭（writeHttpResponse）；
+    // 只关闭 1 秒内没有读到数据的连接，减少客户端恰好在关闭时复用连接发送请求的竞争。
+    // 正在处理消息的 WebSocket 连接由处理者在消息边界确认后关闭（processFrame）
+    uint64_t idleSince = steadyNowNs() - 1000000000;
+    for (const auto& conn : conns) {
+        if (conn->closeIfIdle(conn->isUpgraded() ? std::string_view(goingAway) : std::string_view(), idleSince)) {
+            flush(*conn);
+        }
+    }
+}
+
 void TcpServer::stop() {
     running_ = false;
     
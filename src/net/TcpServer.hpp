@@ -6,39 +6,170 @@
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <string>
+#include <string_view>
 
 #include "Connection.hpp"
 
 class ThreadPool;
+class RateLimiter;
+class TcpServer;
+
+/**
+ * 延迟响应：处理函数把请求交给异步组件（如非阻塞存储）时通过 TcpServer::deferResponse() 取得，
+ * 随后可以不写 response 直接返回。该连接暂停处理后续请求，直到 resume() 写回响应，响应顺序不变
+ */
+class DeferredResponse {
+public:
+    using Builder = std::function<void(std::string& response)>;
+
+    DeferredResponse() = default;
+    explicit operator bool() const { return server_ != nullptr; }
+
+    /**
+     * 在任意线程调用且只调用一次：有线程池时在线程池中执行 build 生成响应，
+     * 写回后继续处理该连接上排队的请求
+     */
+    void resume(Builder build) const;
+
+private:
+    friend class TcpServer;
+    TcpServer* server_ = nullptr;
+    std::shared_ptr<Connection> conn_;
+};
+
+/**
+ * 事件流：处理函数通过 TcpServer::openStream() 把连接转为长连接推送（如 SSE）后取得，
+ * 可复制，任意线程调用。不持有连接，连接关闭后 push 返回 CLOSED
+ */
+class EventStream {
+public:
+    EventStream() = default;
+    explicit operator bool() const { return server_ != nullptr; }
+
+    /**
+     * 追加一条事件并在发送队列原本为空时立即尝试发送；event 的缓冲区被多个连接共享，不拷贝。
+     * 未发送的事件达到 maxQueued 时按 dropOldest 丢弃最旧的一条或关闭连接（0 表示不限）
+     */
+    StreamPush push(const std::shared_ptr<const std::string>& event, std::size_t maxQueued,
+                    bool dropOldest) const;
+    bool alive() const;
+
+private:
+    friend class TcpServer;
+    TcpServer* server_ = nullptr;
+    std::weak_ptr<Connection> conn_;
+};
 
 class TcpServer {
 public:
     using RequestHandler = Connection::RequestHandler;
+    using MessageHandler = Connection::MessageHandler;
     
     TcpServer();
     ~TcpServer();
     
     bool listen(const std::string& host, int port);
+    // 使用继承的监听 socket（平滑升级时由旧进程交接），代替 listen()
+    bool adoptListener(int fd);
+    int listenFd() const { return listenFd_; }
     void setRequestHandler(RequestHandler handler);
     void setThreadPool(ThreadPool* threadPool);  // 设置线程池
+    
+    /**
+     * 按客户端 IP / device_id 的令牌桶限流（每秒请求数），rate 为 0 表示不限；
+     * 在 epoll 线程中、请求分发到线程池之前检查，超限返回 429。
+     * 可在运行中调用：新参数由 epoll 线程在下一轮循环中应用，已有的桶保留
+     */
+    void setRateLimits(double ipRate, double ipBurst, double deviceRate, double deviceBurst);
+    // 线程池过载拒绝（503）时建议客户端的重试间隔（秒）
+    void setRetryAfter(int seconds) { retryAfterSec_.store(seconds, std::memory_order_relaxed); }
+    // 在 run 之前调用：epoll 线程绑定到 cpus（空为不绑定）
+    void setCpuAffinity(std::vector<int> cpus) { cpus_ = std::move(cpus); }
     void run();
     void stop();
     
+    /**
+     * 排空：停止 accept 并关闭监听 socket，空闲 1 秒以上的连接关闭（WebSocket 先发送 1001 关闭帧），
+     * 事件流连接直接关闭，其余 HTTP 连接的下一个响应带 Connection: close，写完后关闭。
+     * 任意线程调用，由 epoll 线程执行；之后用 connectionCount() 等待连接全部关闭
+     */
+    void drain();
+    std::size_t connectionCount();
+    
+    /**
+     * 只能在请求处理函数内调用：把本次请求改为延迟响应。
+     * 不在处理函数内或本次请求已延迟时返回空对象，调用方应同步处理
+     */
+    static DeferredResponse deferResponse();
+    
+    /**
+     * 只能在请求处理函数内调用：把连接转为事件流，head 为响应头（不带 Content-Length），
+     * 处理函数返回后发送。之后该连接不再处理请求，直到对端断开。
+     * 不在处理函数内或本次请求已延迟时返回空对象
+     */
+    static EventStream openStream(std::string_view head);
+    
+    /**
+     * 只能在请求处理函数内调用：把连接升级为 WebSocket，处理函数应已写入 101 响应。
+     * 之后该连接上的二进制消息按到达顺序交给 handler（与请求处理同样串行，状态无需加锁），
+     * ping / close 与分片重组由服务器处理，文本消息以 1003 关闭。
+     * 帧不经过准入控制，背压由上层协议（如确认窗口）负责
+     */
+    static bool acceptWebSocket(MessageHandler handler);
+    
 private:
+    friend class DeferredResponse;
+    friend class EventStream;
+    
+    // 处理函数执行期间的上下文（thread_local），供 deferResponse / openStream 使用
+    struct HandlerContext {
+        TcpServer* server;
+        const std::shared_ptr<Connection>* conn;
+        bool deferred;
+        bool streaming;  // 已转为事件流（同时置 deferred，保留处理权）
+    };
+    static thread_local HandlerContext* currentContext_;
+    
+
     void setupEpoll();
     void handleAccept();
     void handleEvent(int fd, uint32_t events);
-    void processRequest(int fd, const std::string& request);  // 处理请求（在线程池中执行）
+    void processRequests(const std::shared_ptr<Connection>& conn);  // 按顺序处理连接上排队的请求（在线程池中执行）
+    // 返回 false 表示请求被延迟响应，调用方应停止处理该连接，由 resumeDeferred 接续
+    bool processRequest(const std::shared_ptr<Connection>& conn, const PendingRequest& request);
+    void processFrame(const std::shared_ptr<Connection>& conn, const std::string& raw);
+    void resumeDeferred(const std::shared_ptr<Connection>& conn, DeferredResponse::Builder build);
+    void writeResponse(Connection& conn, const std::string& response);
+    // 写回 HTTP 响应；排空期间连接上没有后续请求时改为 Connection: close 并在写完后关闭
+    void writeHttpResponse(Connection& conn, std::string& response);
+    // 尝试发送写缓冲区，发不完时等待 EPOLLOUT
+    void flush(Connection& conn);
+    // 准入检查（线程池过载、IP 限流、设备限流），拒绝时把错误响应写入 rejection
+    bool admit(const Connection& conn, const std::string& raw, uint64_t nowNs, std::string& rejection);
+    void applyRateLimits();  // epoll 线程应用 setRateLimits 提交的参数
+    void closeIdleConnections();  // epoll 线程：排空期间关闭空闲连接
     void triggerWrite(int fd);  // 触发写事件（线程安全）
     
 private:
     int listenFd_;
     int epollFd_;
     std::mutex connectionsMtx_;  // 保护connections_的并发访问
-    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_;
     RequestHandler requestHandler_;
     ThreadPool* threadPool_;  // 线程池指针（不拥有所有权）
+    std::unique_ptr<RateLimiter> ipLimiter_;      // 仅 epoll 线程访问
+    std::unique_ptr<RateLimiter> deviceLimiter_;
+    struct RateLimits {
+        double ipRate, ipBurst, deviceRate, deviceBurst;
+    };
+    std::mutex limitsMtx_;
+    RateLimits pendingLimits_{};                  // setRateLimits 写入，epoll 线程取走后应用
+    std::atomic<bool> limitsChanged_{false};
+    std::atomic<int> retryAfterSec_{1};
     std::atomic<bool> running_;
+    std::atomic<bool> draining_{false};
+    std::vector<int> cpus_;
     
     static const int MAX_EVENTS = 10000;
 };
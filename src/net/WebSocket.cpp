@@ -0,0 +1,199 @@
+#include "WebSocket.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+// 握手只需要 SHA-1 一种摘要，不为此引入 OpenSSL
+void sha1(const std::string& message, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rotl = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+
+    std::string data = message;
+    uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56) data.push_back(0);
+    for (int i = 7; i >= 0; --i) data.push_back(static_cast<char>(bitLength >> (i * 8)));
+
+    for (std::size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const uint8_t*>(data.data() + block + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+std::string base64(const uint8_t* data, std::size_t len) {
+    static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    for (std::size_t i = 0; i < len; i += 3) {
+        uint32_t v = uint32_t(data[i]) << 16;
+        if (i + 1 < len) v |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        out += kTable[(v >> 18) & 63];
+        out += kTable[(v >> 12) & 63];
+        out += i + 1 < len ? kTable[(v >> 6) & 63] : '=';
+        out += i + 2 < len ? kTable[v & 63] : '=';
+    }
+    return out;
+}
+
+// 逗号分隔的头部值中是否包含 token（大小写不敏感），如 Connection: keep-alive, Upgrade
+bool headerHasToken(const HttpRequest& req, const char* name, std::string_view token) {
+    auto it = req.headers.find(std::pmr::string(name, req.headers.get_allocator()));
+    if (it == req.headers.end()) return false;
+    std::string_view value = it->second;
+    while (!value.empty()) {
+        std::size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.size() == token.size() &&
+            std::equal(item.begin(), item.end(), token.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+std::string WebSocket::acceptKey(std::string_view clientKey) {
+    std::string source(clientKey);
+    source += "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t digest[20];
+    sha1(source, digest);
+    return base64(digest, sizeof(digest));
+}
+
+bool WebSocket::handshake(const HttpRequest& req, std::string& out) {
+    if (req.method != "GET" || !headerHasToken(req, "upgrade", "websocket") ||
+        !headerHasToken(req, "connection", "upgrade") || !headerHasToken(req, "sec-websocket-version", "13")) {
+        return false;
+    }
+    auto key = req.headers.find(std::pmr::string("sec-websocket-key", req.headers.get_allocator()));
+    // 客户端密钥为 16 字节随机数的 base64
+    if (key == req.headers.end() || key->second.size() != 24) return false;
+
+    out.clear();
+    out += "HTTP/1.1 101 Switching Protocols\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Accept: ";
+    out += acceptKey(key->second);
+    out += "\r\n\r\n";
+    return true;
+}
+
+std::size_t WebSocket::frameSize(std::string_view data, bool& tooLarge) {
+    tooLarge = false;
+    if (data.size() < 2) return 0;
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    std::size_t header = 2;
+    uint64_t length = p[1] & 0x7F;
+    if (length == 126) {
+        header += 2;
+        if (data.size() < header) return 0;
+        length = (uint64_t(p[2]) << 8) | p[3];
+    } else if (length == 127) {
+        header += 8;
+        if (data.size() < header) return 0;
+        length = 0;
+        for (int i = 0; i < 8; ++i) length = (length << 8) | p[2 + i];
+    }
+    if (p[1] & 0x80) header += 4;
+    if (length > kMaxPayload) {
+        tooLarge = true;
+        return 0;
+    }
+    std::size_t total = header + static_cast<std::size_t>(length);
+    return data.size() < total ? 0 : total;
+}
+
+bool WebSocket::parseFrame(std::string_view raw, Frame& frame, std::string& payload) {
+    bool tooLarge = false;
+    if (frameSize(raw, tooLarge) != raw.size()) return false;
+    const auto* p = reinterpret_cast<const uint8_t*>(raw.data());
+    // RSV 位没有协商扩展时必须为 0；客户端帧必须带掩码
+    if ((p[0] & 0x70) != 0 || (p[1] & 0x80) == 0) return false;
+    frame.fin = (p[0] & 0x80) != 0;
+    frame.opcode = p[0] & 0x0F;
+
+    std::size_t offset = 2;
+    uint8_t length7 = p[1] & 0x7F;
+    if (length7 == 126) offset += 2;
+    else if (length7 == 127) offset += 8;
+    const uint8_t* mask = p + offset;
+    offset += 4;
+
+    // 控制帧不能分片，负载不超过 125 字节
+    if ((frame.opcode & 0x08) && (!frame.fin || length7 > 125)) return false;
+
+    payload.assign(raw.data() + offset, raw.size() - offset);
+    for (std::size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(payload[i] ^ mask[i & 3]);
+    }
+    return true;
+}
+
+void WebSocket::appendFrame(std::string& out, uint8_t opcode, std::string_view payload) {
+    out.push_back(static_cast<char>(0x80 | opcode));
+    if (payload.size() < 126) {
+        out.push_back(static_cast<char>(payload.size()));
+    } else if (payload.size() <= 0xFFFF) {
+        out.push_back(static_cast<char>(126));
+        out.push_back(static_cast<char>(payload.size() >> 8));
+        out.push_back(static_cast<char>(payload.size()));
+    } else {
+        out.push_back(static_cast<char>(127));
+        uint64_t length = payload.size();
+        for (int i = 7; i >= 0; --i) out.push_back(static_cast<char>(length >> (i * 8)));
+    }
+    out.append(payload);
+}
+
+void WebSocket::appendClose(std::string& out, uint16_t code) {
+    char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code)};
+    appendFrame(out, CLOSE, std::string_view(payload, sizeof(payload)));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "HttpParser.hpp"
+
+/**
+ * WebSocket（RFC 6455）握手与帧编解码，不涉及连接状态。
+ * 只实现服务端需要的部分：客户端帧必须带掩码，服务端帧不带掩码；不支持扩展（permessage-deflate 等）
+ */
+class WebSocket {
+public:
+    enum Opcode : uint8_t {
+        CONTINUATION = 0x0,
+        TEXT = 0x1,
+        BINARY = 0x2,
+        CLOSE = 0x8,
+        PING = 0x9,
+        PONG = 0xA
+    };
+
+    // 关闭码
+    enum CloseCode : uint16_t {
+        NORMAL = 1000,
+        GOING_AWAY = 1001,
+        PROTOCOL_ERROR = 1002,
+        UNSUPPORTED_DATA = 1003,
+        POLICY_VIOLATION = 1008,
+        TOO_LARGE = 1009
+    };
+
+    // 单帧与分片重组后的消息大小上限
+    static constexpr std::size_t kMaxPayload = 1024 * 1024;
+
+    struct Frame {
+        bool fin = true;
+        uint8_t opcode = 0;
+    };
+
+    /**
+     * 握手：校验升级请求（GET、Upgrade: websocket、版本 13、Sec-WebSocket-Key），
+     * 通过时把 101 响应写入 out 并返回 true
+     */
+    static bool handshake(const HttpRequest& req, std::string& out);
+
+    // Sec-WebSocket-Accept = base64(SHA-1(key + GUID))
+    static std::string acceptKey(std::string_view clientKey);
+
+    /**
+     * data 开头完整帧的字节数；数据不足返回 0。
+     * 负载超过 kMaxPayload 时置 tooLarge 并返回 0
+     */
+    static std::size_t frameSize(std::string_view data, bool& tooLarge);
+
+    // 解析一个完整的客户端帧，去掩码后的负载写入 payload；未带掩码或格式错误返回 false
+    static bool parseFrame(std::string_view raw, Frame& frame, std::string& payload);
+
+    // 追加一个不带掩码的完整帧（FIN=1）
+    static void appendFrame(std::string& out, uint8_t opcode, std::string_view payload);
+    static void appendClose(std::string& out, uint16_t code);
+};
@@ -0,0 +1,370 @@
+#include "AsyncMySQLClient.hpp"
+#include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kWakeTag = ~0ULL;          // epoll data：唤醒用 eventfd，其余为连接下标
+constexpr int kMaxEvents = 64;
+constexpr int kTickMs = 1000;                 // 重连与排队超时的检查周期上限
+constexpr auto kReconnectDelay = std::chrono::seconds(1);
+constexpr unsigned int kClientErrorBase = 2000;  // CR_* 客户端错误（连接断开、读写超时等）
+
+}  // namespace
+
+AsyncMySQLClient::AsyncMySQLClient()
+    : queuedGauge_(Metrics::getInstance().gauge("device_server_mysql_async_queued", "Statements waiting for an async MySQL connection")),
+      inFlightGauge_(Metrics::getInstance().gauge("device_server_mysql_async_in_flight", "Statements executing on async MySQL connections")),
+      latency_(Metrics::getInstance().histogram("device_server_mysql_async_duration_seconds", "Async MySQL statement time from submit to completion")),
+      errors_(Metrics::getInstance().counter("device_server_mysql_async_errors_total", "Async MySQL statements that failed")) {}
+
+AsyncMySQLClient::~AsyncMySQLClient() { stop(); }
+
+bool AsyncMySQLClient::start(const MySQLConfig& config, int connections) {
+    if (running_) return true;
+    config_ = config;
+    conns_.assign(static_cast<std::size_t>(std::max(1, connections)), Conn());
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0) {
+        LOG_ERROR("AsyncMySQLClient: failed to create epoll/eventfd: " + std::string(strerror(errno)));
+        if (epollFd_ >= 0) { close(epollFd_); epollFd_ = -1; }
+        if (wakeFd_ >= 0) { close(wakeFd_); wakeFd_ = -1; }
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeTag;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+    running_ = true;
+    thread_ = std::thread(&AsyncMySQLClient::run, this);
+    LOG_INFO("AsyncMySQLClient started with " + std::to_string(conns_.size()) + " connections");
+    return true;
+}
+
+void AsyncMySQLClient::stop() {
+    {
+        // 与 submit 互斥：停止后不再有语句入队，已入队的由 failAll 回调
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd_, &one, sizeof(one));
+    (void)n;
+    if (thread_.joinable()) thread_.join();
+    // I/O 线程已退出，剩余状态由当前线程清理
+    failAll("async MySQL client stopped");
+    for (std::size_t i = 0; i < conns_.size(); ++i) {
+        if (conns_[i].mysql) closeConnection(i);
+    }
+    close(wakeFd_);
+    close(epollFd_);
+    wakeFd_ = epollFd_ = -1;
+    LOG_INFO("AsyncMySQLClient stopped");
+}
+
+void AsyncMySQLClient::submit(std::string sql, Callback callback) {
+    const char* rejected = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            rejected = "async MySQL client is not running";
+        } else if (queue_.size() >= kMaxQueued) {
+            rejected = "async MySQL queue is full";
+        } else {
+            queue_.push_back(Op{std::move(sql), std::move(callback), std::chrono::steady_clock::now()});
+            queued_.fetch_add(1, std::memory_order_relaxed);
+            queuedGauge_.inc();
+        }
+    }
+    if (rejected) {
+        errors_.inc();
+        callback(nullptr, rejected);
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t n = write(wakeFd_, &one, sizeof(one));
+    (void)n;
+}
+
+void AsyncMySQLClient::escape(std::string_view in, std::string& out) {
+    out.reserve(out.size() + in.size());
+    for (char ch : in) {
+        switch (ch) {
+            case '\0': out += "\\0"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\\': out += "\\\\"; break;
+            case '\'': out += "\\'"; break;
+            case '"': out += "\\\""; break;
+            case '\032': out += "\\Z"; break;
+            default: out += ch; break;
+        }
+    }
+}
+
+void AsyncMySQLClient::run() {
+    Tracer::setThreadName("mysql-async");
+    mysql_thread_init();
+    for (std::size_t i = 0; i < conns_.size(); ++i) connect(i);
+
+    epoll_event events[kMaxEvents];
+    while (running_) {
+        int n = epoll_wait(epollFd_, events, kMaxEvents, nextTimeoutMs());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("AsyncMySQLClient: epoll_wait failed: " + std::string(strerror(errno)));
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == kWakeTag) {
+                uint64_t value;
+                while (read(wakeFd_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            std::size_t index = static_cast<std::size_t>(events[i].data.u64);
+            uint32_t ev = events[i].events;
+            if (conns_[index].phase == Phase::IDLE) {
+                // 空闲连接只监听可读：服务端主动断开（wait_timeout、重启）
+                LOG_WARNING("AsyncMySQLClient: idle connection closed by server");
+                closeConnection(index);
+                continue;
+            }
+            int ready = 0;
+            if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) ready |= MYSQL_WAIT_READ;
+            if (ev & (EPOLLOUT | EPOLLHUP | EPOLLERR)) ready |= MYSQL_WAIT_WRITE;
+            if (ev & EPOLLPRI) ready |= MYSQL_WAIT_EXCEPT;
+            advance(index, ready);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool anyConnected = false;
+        for (std::size_t i = 0; i < conns_.size(); ++i) {
+            Conn& c = conns_[i];
+            if (c.hasDeadline && now >= c.deadline) {
+                c.hasDeadline = false;
+                advance(i, MYSQL_WAIT_TIMEOUT);
+            } else if (c.phase == Phase::DISCONNECTED && now >= c.retryAt) {
+                connect(i);
+            }
+            anyConnected |= c.phase == Phase::IDLE || c.phase == Phase::QUERY || c.phase == Phase::STORE;
+        }
+        dispatch();
+
+        // 没有可用连接时，排队超过连接超时的语句直接失败，不让调用方无限等待
+        if (!anyConnected && queued_.load(std::memory_order_relaxed) > 0) {
+            auto expiry = now - std::chrono::seconds(std::max(1, config_.connectTimeout));
+            std::deque<Op> expired;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                while (!queue_.empty() && queue_.front().submitted <= expiry) {
+                    expired.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+            }
+            for (Op& op : expired) {
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                queuedGauge_.dec();
+                errors_.inc();
+                op.callback(nullptr, "no MySQL connection available");
+            }
+        }
+    }
+    mysql_thread_end();
+}
+
+int AsyncMySQLClient::nextTimeoutMs() const {
+    auto now = std::chrono::steady_clock::now();
+    long long timeout = kTickMs;
+    for (const Conn& c : conns_) {
+        if (c.hasDeadline) {
+            timeout = std::min<long long>(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(c.deadline - now).count());
+        } else if (c.phase == Phase::DISCONNECTED) {
+            timeout = std::min<long long>(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(c.retryAt - now).count());
+        }
+    }
+    return static_cast<int>(std::max(0LL, timeout));
+}
+
+void AsyncMySQLClient::connect(std::size_t index) {
+    Conn& c = conns_[index];
+    c.mysql = mysql_init(nullptr);
+    if (!c.mysql) {
+        LOG_ERROR("AsyncMySQLClient: mysql_init failed");
+        c.retryAt = std::chrono::steady_clock::now() + kReconnectDelay;
+        return;
+    }
+    mysql_options(c.mysql, MYSQL_OPT_NONBLOCK, nullptr);
+    unsigned int timeout = static_cast<unsigned int>(config_.connectTimeout);
+    mysql_options(c.mysql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    unsigned int readTimeout = static_cast<unsigned int>(config_.readTimeout);
+    mysql_options(c.mysql, MYSQL_OPT_READ_TIMEOUT, &readTimeout);
+    unsigned int writeTimeout = static_cast<unsigned int>(config_.writeTimeout);
+    mysql_options(c.mysql, MYSQL_OPT_WRITE_TIMEOUT, &writeTimeout);
+    mysql_options(c.mysql, MYSQL_SET_CHARSET_NAME, config_.charset.c_str());
+    c.phase = Phase::CONNECTING;
+    advance(index, 0);
+}
+
+void AsyncMySQLClient::advance(std::size_t index, int ready) {
+    Conn& c = conns_[index];
+    while (true) {
+        int status = 0;
+        switch (c.phase) {
+            case Phase::CONNECTING: {
+                MYSQL* ret = nullptr;
+                status = ready ? mysql_real_connect_cont(&ret, c.mysql, ready)
+                               : mysql_real_connect_start(&ret, c.mysql, config_.host.c_str(), config_.user.c_str(),
+                                                          config_.password.c_str(), config_.database.c_str(),
+                                                          static_cast<unsigned int>(config_.port), nullptr, 0);
+                if (status) { waitFor(index, status); return; }
+                if (!ret) {
+                    LOG_WARNING("AsyncMySQLClient: connect failed: " + std::string(mysql_error(c.mysql)));
+                    closeConnection(index);
+                    return;
+                }
+                c.phase = Phase::IDLE;
+                c.hasDeadline = false;
+                waitFor(index, MYSQL_WAIT_READ);
+                return;
+            }
+            case Phase::QUERY: {
+                int err = 0;
+                status = ready ? mysql_real_query_cont(&err, c.mysql, ready)
+                               : mysql_real_query_start(&err, c.mysql, c.op.sql.data(),
+                                                        static_cast<unsigned long>(c.op.sql.size()));
+                if (status) { waitFor(index, status); return; }
+                if (err) { finish(index, nullptr, mysql_error(c.mysql)); return; }
+                c.phase = Phase::STORE;
+                ready = 0;
+                continue;
+            }
+            case Phase::STORE: {
+                MYSQL_RES* result = nullptr;
+                status = ready ? mysql_store_result_cont(&result, c.mysql, ready)
+                               : mysql_store_result_start(&result, c.mysql);
+                if (status) { waitFor(index, status); return; }
+                // 没有结果集的语句（INSERT 等）返回 nullptr 且 errno 为 0
+                if (!result && mysql_errno(c.mysql) != 0) finish(index, nullptr, mysql_error(c.mysql));
+                else finish(index, result, std::string());
+                return;
+            }
+            default:
+                return;
+        }
+    }
+}
+
+void AsyncMySQLClient::waitFor(std::size_t index, int status) {
+    Conn& c = conns_[index];
+    uint32_t events = 0;
+    if (status & MYSQL_WAIT_READ) events |= EPOLLIN;
+    if (status & MYSQL_WAIT_WRITE) events |= EPOLLOUT;
+    if (status & MYSQL_WAIT_EXCEPT) events |= EPOLLPRI;
+
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = index;
+    int fd = mysql_get_socket(c.mysql);
+    if (fd != c.fd) {
+        if (c.fd >= 0) epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        c.fd = fd;
+        if (fd >= 0) epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+    } else if (fd >= 0) {
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    c.hasDeadline = (status & MYSQL_WAIT_TIMEOUT) != 0;
+    if (c.hasDeadline) {
+        c.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mysql_get_timeout_value_ms(c.mysql));
+    }
+}
+
+void AsyncMySQLClient::finish(std::size_t index, MYSQL_RES* result, const std::string& error) {
+    Conn& c = conns_[index];
+    Op op = std::move(c.op);
+    c.op = Op();
+    c.hasDeadline = false;
+    inFlightGauge_.dec();
+    latency_.recordSince(op.submitted);
+    if (!error.empty()) {
+        errors_.inc();
+        LOG_ERROR("AsyncMySQLClient: statement failed: " + error);
+    }
+    // 客户端错误说明连接已不可用，关闭后在后台重建；当前语句不重试
+    if (!error.empty() && mysql_errno(c.mysql) >= kClientErrorBase) {
+        closeConnection(index);
+    } else {
+        c.phase = Phase::IDLE;
+        waitFor(index, MYSQL_WAIT_READ);
+    }
+    op.callback(result, error);
+    if (result) mysql_free_result(result);
+}
+
+void AsyncMySQLClient::closeConnection(std::size_t index) {
+    Conn& c = conns_[index];
+    // 先从 epoll 移除再关闭 socket
+    if (c.fd >= 0) epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    c.fd = -1;
+    if (c.mysql) {
+        mysql_close(c.mysql);
+        c.mysql = nullptr;
+    }
+    c.phase = Phase::DISCONNECTED;
+    c.hasDeadline = false;
+    c.retryAt = std::chrono::steady_clock::now() + kReconnectDelay;
+}
+
+void AsyncMySQLClient::dispatch() {
+    for (std::size_t i = 0; i < conns_.size(); ++i) {
+        // 语句可能同步完成，连接回到 IDLE 后继续取下一条
+        while (conns_[i].phase == Phase::IDLE) {
+            Op op;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (queue_.empty()) return;
+                op = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            queuedGauge_.dec();
+            inFlightGauge_.inc();
+            conns_[i].op = std::move(op);
+            conns_[i].phase = Phase::QUERY;
+            advance(i, 0);
+        }
+    }
+}
+
+void AsyncMySQLClient::failAll(const std::string& error) {
+    for (Conn& c : conns_) {
+        if (c.phase == Phase::QUERY || c.phase == Phase::STORE) {
+            Op op = std::move(c.op);
+            c.op = Op();
+            c.phase = Phase::IDLE;
+            inFlightGauge_.dec();
+            errors_.inc();
+            op.callback(nullptr, error);
+        }
+    }
+    std::deque<Op> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.swap(queue_);
+    }
+    for (Op& op : pending) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        queuedGauge_.dec();
+        errors_.inc();
+        op.callback(nullptr, error);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mysql/mysql.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ConnectionPool.hpp"
+
+class Counter;
+class Gauge;
+class Histogram;
+
+/**
+ * 非阻塞 MySQL 客户端（MariaDB Connector/C 的 mysql_*_start / mysql_*_cont 接口）
+ * 一个专用 I/O 线程用 epoll 驱动 N 条非阻塞连接，每条连接同时执行一条语句，
+ * 语句在连接间排队分发；调用线程提交 SQL 后立即返回，结果在 I/O 线程中回调。
+ * 连接断开时当前语句以错误结束（不重试，避免重复写入），连接在后台重建。
+ * 编译期需要 HAVE_MYSQL_NONBLOCKING（CMake 检测客户端库是否提供上述接口）
+ */
+class AsyncMySQLClient {
+public:
+    /**
+     * 完成回调，在 I/O 线程中执行，应尽快返回（把后续工作转交给其他线程）
+     * @param result 结果集，没有结果集的语句或失败时为 nullptr；回调返回后由客户端释放
+     * @param error 错误信息，成功时为空
+     */
+    using Callback = std::function<void(MYSQL_RES* result, const std::string& error)>;
+
+    // 排队等待连接的语句上限，超过后新提交的语句直接以错误回调
+    static constexpr std::size_t kMaxQueued = 10000;
+
+    AsyncMySQLClient();
+    ~AsyncMySQLClient();
+    AsyncMySQLClient(const AsyncMySQLClient&) = delete;
+    AsyncMySQLClient& operator=(const AsyncMySQLClient&) = delete;
+
+    /**
+     * 启动 I/O 线程并建立连接（连接异步建立，失败的连接会周期性重试）
+     * @param connections 连接数，即可同时执行的语句数
+     */
+    bool start(const MySQLConfig& config, int connections);
+    // 停止 I/O 线程，未完成的语句以错误回调
+    void stop();
+    bool isRunning() const { return running_; }
+
+    // 线程安全：提交一条语句
+    void submit(std::string sql, Callback callback);
+
+    /**
+     * 不依赖连接的字符串转义（等价于 utf8mb4 连接上的 mysql_real_escape_string，
+     * 服务端未开启 NO_BACKSLASH_ESCAPES）；结果追加到 out
+     */
+    static void escape(std::string_view in, std::string& out);
+
+private:
+    enum class Phase { DISCONNECTED, CONNECTING, IDLE, QUERY, STORE };
+
+    struct Op {
+        std::string sql;
+        Callback callback;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    struct Conn {
+        MYSQL* mysql = nullptr;
+        Phase phase = Phase::DISCONNECTED;
+        int fd = -1;                // 已注册到 epoll 的 socket
+        Op op;
+        bool hasDeadline = false;   // 库要求的超时（MYSQL_WAIT_TIMEOUT）
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::time_point retryAt;  // DISCONNECTED 时下次重连时间
+    };
+
+    void run();
+    void connect(std::size_t index);
+    // 推进连接上的状态机；ready 为就绪事件（MYSQL_WAIT_*），0 表示开始新阶段
+    void advance(std::size_t index, int ready);
+    // 按库返回的等待状态注册 epoll 事件与超时
+    void waitFor(std::size_t index, int status);
+    void finish(std::size_t index, MYSQL_RES* result, const std::string& error);
+    void closeConnection(std::size_t index);
+    void dispatch();
+    void failAll(const std::string& error);
+    int nextTimeoutMs() const;
+
+    MySQLConfig config_;
+    std::vector<Conn> conns_;  // 仅 I/O 线程访问
+    int epollFd_ = -1;
+    int wakeFd_ = -1;          // eventfd，提交语句与停止时唤醒 I/O 线程
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;         // 保护 queue_
+    std::deque<Op> queue_;
+    std::atomic<std::size_t> queued_{0};
+
+    Gauge& queuedGauge_;
+    Gauge& inFlightGauge_;
+    Histogram& latency_;       // 提交到完成的耗时
+    Counter& errors_;
+};
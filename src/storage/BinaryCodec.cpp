@@ -0,0 +1,100 @@
+#include "BinaryCodec.hpp"
+#include <cstring>
+
+void ByteWriter::putU32(uint32_t v) {
+    for (int i = 0; i < 4; ++i) out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void ByteWriter::putU64(uint64_t v) {
+    for (int i = 0; i < 8; ++i) out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void ByteWriter::putVarint(uint64_t v) {
+    while (v >= 0x80) {
+        out_.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out_.push_back(static_cast<char>(v));
+}
+
+void ByteWriter::putDouble(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    putU64(bits);
+}
+
+void ByteWriter::putString(std::string_view s) {
+    putVarint(s.size());
+    out_.append(s);
+}
+
+bool ByteReader::getU8(uint8_t& v) {
+    if (p_ >= end_) return false;
+    v = static_cast<uint8_t>(*p_++);
+    return true;
+}
+
+bool ByteReader::getU32(uint32_t& v) {
+    if (remaining() < 4) return false;
+    v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(p_[i])) << (8 * i);
+    p_ += 4;
+    return true;
+}
+
+bool ByteReader::getU64(uint64_t& v) {
+    if (remaining() < 8) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<uint8_t>(p_[i])) << (8 * i);
+    p_ += 8;
+    return true;
+}
+
+bool ByteReader::getVarint(uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p_ >= end_) return false;
+        uint8_t b = static_cast<uint8_t>(*p_++);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool ByteReader::getZigzag(int64_t& v) {
+    uint64_t u;
+    if (!getVarint(u)) return false;
+    v = static_cast<int64_t>((u >> 1) ^ (~(u & 1) + 1));
+    return true;
+}
+
+bool ByteReader::getDouble(double& v) {
+    uint64_t bits;
+    if (!getU64(bits)) return false;
+    std::memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+bool ByteReader::getString(std::string& s) {
+    uint64_t len;
+    if (!getVarint(len) || len > remaining()) return false;
+    s.assign(p_, static_cast<std::size_t>(len));
+    p_ += len;
+    return true;
+}
+
+uint32_t crc32(const void* data, std::size_t len, uint32_t crc) {
+    static const auto table = [] {
+        struct Table { uint32_t v[256]; } t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t.v[i] = c;
+        }
+        return t;
+    }();
+    const auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < len; ++i) crc = table.v[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * 紧凑二进制编码工具（WAL / 快照共用）
+ * 整数使用 LEB128 变长编码，有符号数先做 zigzag，浮点数按 8 字节小端原样写入
+ */
+class ByteWriter {
+public:
+    explicit ByteWriter(std::string& out) : out_(out) {}
+
+    void putU8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+    void putU32(uint32_t v);
+    void putU64(uint64_t v);
+    void putVarint(uint64_t v);
+    void putZigzag(int64_t v) { putVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); }
+    void putDouble(double v);
+    void putString(std::string_view s);
+
+private:
+    std::string& out_;
+};
+
+class ByteReader {
+public:
+    ByteReader(const char* data, std::size_t len) : p_(data), end_(data + len) {}
+
+    bool getU8(uint8_t& v);
+    bool getU32(uint32_t& v);
+    bool getU64(uint64_t& v);
+    bool getVarint(uint64_t& v);
+    bool getZigzag(int64_t& v);
+    bool getDouble(double& v);
+    bool getString(std::string& s);
+
+    std::size_t remaining() const { return static_cast<std::size_t>(end_ - p_); }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+/**
+ * CRC-32（IEEE 802.3 多项式），用于 WAL 记录与快照校验
+ */
+uint32_t crc32(const void* data, std::size_t len, uint32_t crc = 0);
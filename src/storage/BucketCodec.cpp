@@ -0,0 +1,186 @@
+#include "BucketCodec.hpp"
+#include "BinaryCodec.hpp"
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// BLOCK 中值的类型（标签低 2 位）
+enum : uint8_t { VALUE_SAME = 0, VALUE_DOUBLE = 1, VALUE_INT_DELTA = 2 };
+
+// 整数值（计数、百分比等）按 zigzag 变长整数写，其余按 8 字节原样写
+static bool integral(double v, int64_t& out) {
+    if (!(std::fabs(v) < 9.0e15) || std::trunc(v) != v) return false;
+    out = static_cast<int64_t>(v);
+    return true;
+}
+
+static double bitsToDouble(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+long long BucketCodec::bucketStart(long long timestamp, long long span) {
+    if (span <= 1) return timestamp;
+    long long q = timestamp / span;
+    if (timestamp % span < 0) --q;
+    return q * span;
+}
+
+void BucketCodec::appendRecord(std::string& out, long long bucketStart, const DataPoint& point) {
+    InternTable& names = InternTable::getInstance();
+    ByteWriter w(out);
+    w.putU8(RECORD);
+    w.putZigzag(point.timestamp - bucketStart);
+    w.putVarint(point.metrics.size());
+    for (const Metric& metric : point.metrics) {
+        w.putString(names.name(metric.name));
+        int64_t iv;
+        if (integral(metric.value, iv)) {
+            w.putU8(0);
+            w.putZigzag(iv);
+        } else {
+            w.putU8(1);
+            w.putDouble(metric.value);
+        }
+    }
+}
+
+void BucketCodec::encodeBlock(std::string& out, long long bucketStart, const std::vector<DataPoint>& points) {
+    InternTable& names = InternTable::getInstance();
+    // 字典下标按首次出现顺序分配
+    std::unordered_map<InternId, uint64_t> index;
+    std::vector<InternId> dictionary;
+    for (const DataPoint& point : points) {
+        for (const Metric& metric : point.metrics) {
+            if (index.emplace(metric.name, dictionary.size()).second) dictionary.push_back(metric.name);
+        }
+    }
+
+    ByteWriter w(out);
+    w.putU8(BLOCK);
+    w.putVarint(dictionary.size());
+    for (InternId name : dictionary) w.putString(names.name(name));
+    w.putVarint(points.size());
+
+    // 每个值前的标签为 (字典下标 << 2 | 类型)：与上一个值相同时只写标签，
+    // 整数写与上一个值之差，恒定或缓慢变化的指标每个样本只占 1~2 字节
+    std::vector<double> last(dictionary.size(), 0.0);
+    long long previous = bucketStart;
+    for (const DataPoint& point : points) {
+        w.putZigzag(point.timestamp - previous);
+        previous = point.timestamp;
+        w.putVarint(point.metrics.size());
+        for (const Metric& metric : point.metrics) {
+            uint64_t i = index[metric.name];
+            int64_t iv;
+            int64_t lastIv;
+            uint64_t bits;
+            uint64_t lastBits;
+            std::memcpy(&bits, &metric.value, sizeof(bits));
+            std::memcpy(&lastBits, &last[i], sizeof(lastBits));
+            if (bits == lastBits) {
+                w.putVarint(i << 2 | VALUE_SAME);
+            } else if (integral(metric.value, iv) && integral(last[i], lastIv)) {
+                w.putVarint(i << 2 | VALUE_INT_DELTA);
+                w.putZigzag(iv - lastIv);
+            } else {
+                w.putVarint(i << 2 | VALUE_DOUBLE);
+                w.putU64(bits);
+            }
+            last[i] = metric.value;
+        }
+    }
+}
+
+static bool decodeRecord(ByteReader& r, long long bucketStart, std::vector<DataPoint>& out) {
+    InternTable& names = InternTable::getInstance();
+    int64_t offset;
+    uint64_t count;
+    if (!r.getZigzag(offset) || !r.getVarint(count) || count > r.remaining()) return false;
+    DataPoint point;
+    point.timestamp = bucketStart + offset;
+    point.metrics.reserve(static_cast<std::size_t>(count));
+    std::string name;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint8_t kind;
+        double value;
+        if (!r.getString(name) || !r.getU8(kind)) return false;
+        if (kind == 0) {
+            int64_t iv;
+            if (!r.getZigzag(iv)) return false;
+            value = static_cast<double>(iv);
+        } else if (kind != 1 || !r.getDouble(value)) {
+            return false;
+        }
+        point.metrics.push_back(Metric{names.intern(name), value});
+    }
+    out.push_back(std::move(point));
+    return true;
+}
+
+static bool decodeBlock(ByteReader& r, long long bucketStart, std::vector<DataPoint>& out) {
+    InternTable& names = InternTable::getInstance();
+    uint64_t dictSize;
+    if (!r.getVarint(dictSize) || dictSize > r.remaining()) return false;
+    std::vector<InternId> dictionary;
+    dictionary.reserve(static_cast<std::size_t>(dictSize));
+    std::string name;
+    for (uint64_t i = 0; i < dictSize; ++i) {
+        if (!r.getString(name)) return false;
+        dictionary.push_back(names.intern(name));
+    }
+
+    uint64_t pointCount;
+    if (!r.getVarint(pointCount) || pointCount > r.remaining()) return false;
+    std::vector<double> last(dictionary.size(), 0.0);
+    long long previous = bucketStart;
+    for (uint64_t p = 0; p < pointCount; ++p) {
+        int64_t delta;
+        uint64_t count;
+        if (!r.getZigzag(delta) || !r.getVarint(count) || count > r.remaining()) return false;
+        DataPoint point;
+        point.timestamp = previous + delta;
+        previous = point.timestamp;
+        point.metrics.reserve(static_cast<std::size_t>(count));
+        for (uint64_t m = 0; m < count; ++m) {
+            uint64_t tag;
+            if (!r.getVarint(tag) || (tag >> 2) >= dictionary.size()) return false;
+            std::size_t i = static_cast<std::size_t>(tag >> 2);
+            switch (tag & 3) {
+            case VALUE_SAME:
+                break;
+            case VALUE_DOUBLE: {
+                uint64_t bits;
+                if (!r.getU64(bits)) return false;
+                last[i] = bitsToDouble(bits);
+                break;
+            }
+            case VALUE_INT_DELTA: {
+                int64_t delta;
+                if (!r.getZigzag(delta)) return false;
+                last[i] = static_cast<double>(static_cast<int64_t>(last[i]) + delta);
+                break;
+            }
+            default:
+                return false;
+            }
+            point.metrics.push_back(Metric{dictionary[i], last[i]});
+        }
+        out.push_back(std::move(point));
+    }
+    return true;
+}
+
+bool BucketCodec::decode(std::string_view data, long long bucketStart, std::vector<DataPoint>& out) {
+    ByteReader r(data.data(), data.size());
+    while (r.remaining() > 0) {
+        uint8_t type;
+        r.getU8(type);
+        bool ok = type == RECORD ? decodeRecord(r, bucketStart, out)
+                : type == BLOCK ? decodeBlock(r, bucketStart, out)
+                : false;
+        if (!ok) return false;
+    }
+    return true;
+}
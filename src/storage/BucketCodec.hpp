@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "StoreInterface.hpp"
+
+/**
+ * 时间桶样本编码（MySQL data_buckets.samples 列）
+ * 一个桶内的样本由若干段拼接而成，每段以 1 字节类型开头：
+ *   RECORD：单个样本，写入时直接追加（INSERT ... ON DUPLICATE KEY UPDATE samples = CONCAT(...)），
+ *           时间戳为相对桶起点的 zigzag 变长整数，指标名为字符串，整数值写变长整数
+ *   BLOCK： 桶封闭后整理出的列式块：指标名字典 + 按时间排序的时间戳增量 + 逐样本的
+ *           (字典下标, 值)，值与同名指标上一个值相同时省略，整数写差值
+ * 解码接受任意顺序的混合段，整理后的桶仍可追加迟到的 RECORD
+ */
+class BucketCodec {
+public:
+    // 时间戳所在桶的起点（向下取整到 span 的整数倍，负数同样向下取整）
+    static long long bucketStart(long long timestamp, long long span);
+
+    // 追加一个 RECORD 段
+    static void appendRecord(std::string& out, long long bucketStart, const DataPoint& point);
+
+    // 把已按时间排序的样本编码为一个 BLOCK 段（追加到 out）
+    static void encodeBlock(std::string& out, long long bucketStart, const std::vector<DataPoint>& points);
+
+    // 解码全部段并追加到 out（不排序）；数据损坏时返回 false，已解出的样本保留
+    static bool decode(std::string_view data, long long bucketStart, std::vector<DataPoint>& out);
+
+private:
+    enum : uint8_t { RECORD = 1, BLOCK = 2 };
+};
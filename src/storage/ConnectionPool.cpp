@@ -1,12 +1,16 @@
 #include "ConnectionPool.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
+#include <algorithm>
 #include <chrono>
+#include <map>
 
 MySQLConnection::MySQLConnection() : conn_(nullptr), lastUsedTime_(0), connected_(false) {}
 
 MySQLConnection::~MySQLConnection() { disconnect(); }
 
-MySQLConnection::MySQLConnection(MySQLConnection&& other) noexcept : conn_(other.conn_), lastUsedTime_(other.lastUsedTime_), connected_(other.connected_) {
+MySQLConnection::MySQLConnection(MySQLConnection&& other) noexcept : conn_(other.conn_), lastUsedTime_(other.lastUsedTime_), connected_(other.connected_), poolSlot_(other.poolSlot_) {
     other.conn_ = nullptr;
     other.connected_ = false;
 }
@@ -17,6 +21,7 @@ MySQLConnection& MySQLConnection::operator=(MySQLConnection&& other) noexcept {
         conn_ = other.conn_;
         lastUsedTime_ = other.lastUsedTime_;
         connected_ = other.connected_;
+        poolSlot_ = other.poolSlot_;
         other.conn_ = nullptr;
         other.connected_ = false;
     }
@@ -58,6 +63,7 @@ bool MySQLConnection::isValid() const { return conn_ != nullptr && connected_; }
 bool MySQLConnection::ping() { return conn_ && mysql_ping(conn_) == 0; }
 
 bool MySQLConnection::execute(const std::string& sql) {
+    TRACE_SPAN("mysql.execute");
     if (!isValid()) { LOG_ERROR("Connection is not valid"); return false; }
     if (mysql_query(conn_, sql.c_str()) != 0) { LOG_ERROR("mysql_query failed"); return false; }
     while (mysql_more_results(conn_)) { mysql_next_result(conn_); MYSQL_RES* r = mysql_store_result(conn_); if (r) mysql_free_result(r); }
@@ -66,6 +72,7 @@ bool MySQLConnection::execute(const std::string& sql) {
 }
 
 MYSQL_RES* MySQLConnection::query(const std::string& sql) {
+    TRACE_SPAN("mysql.query");
     if (!isValid()) { LOG_ERROR("Connection is not valid"); return nullptr; }
     if (mysql_query(conn_, sql.c_str()) != 0) { LOG_ERROR("mysql_query failed"); return nullptr; }
     updateLastUsedTime();
@@ -89,73 +96,285 @@ std::string MySQLConnection::escapeString(const std::string& str) {
 
 void MySQLConnection::updateLastUsedTime() { lastUsedTime_ = std::time(nullptr); }
 
-ConnectionPool::ConnectionPool() : totalCount_(0), activeCount_(0), initialized_(false), shutdown_(false) {}
+namespace {
+
+// 本线程上次归还的连接池与槽位
+thread_local const ConnectionPool* affinityPool = nullptr;
+thread_local int affinitySlot = -1;
+
+// 各线程扫描共享槽位的起点，错开以减少在同一槽位上的 CAS 竞争
+int scanStart() {
+    static std::atomic<int> next{0};
+    thread_local int start = next.fetch_add(1, std::memory_order_relaxed);
+    return start;
+}
+
+// mysql_library_init / mysql_library_end 按进程计数：多个连接池共用客户端库
+std::mutex libraryMutex;
+int libraryUsers = 0;
+
+bool acquireLibrary() {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    if (libraryUsers == 0 && mysql_library_init(0, nullptr, nullptr) != 0) return false;
+    ++libraryUsers;
+    return true;
+}
+
+void releaseLibrary() {
+    std::lock_guard<std::mutex> lock(libraryMutex);
+    if (--libraryUsers == 0) mysql_library_end();
+}
+
+}  // namespace
+
+// 标签串：pool="<name>"，extra 非空时追加在后
+static std::string poolLabels(const std::string& name, const char* extra = nullptr) {
+    std::string labels = "pool=\"" + name + "\"";
+    if (extra) { labels += ','; labels += extra; }
+    return labels;
+}
+
+ConnectionPool::ConnectionPool(std::string name)
+    : name_(std::move(name)), totalCount_(0), activeCount_(0), initialized_(false), shutdown_(false),
+      waitTime_(Metrics::getInstance().histogram("device_server_mysql_pool_wait_seconds", "Time spent acquiring a MySQL connection", poolLabels(name_))),
+      timeouts_(Metrics::getInstance().counter("device_server_mysql_pool_timeouts_total", "MySQL connection acquisitions that timed out", poolLabels(name_))),
+      affinityHits_(Metrics::getInstance().counter("device_server_mysql_pool_acquire_total", "MySQL connection acquisitions by path", poolLabels(name_, "path=\"affinity\""))),
+      sharedHits_(Metrics::getInstance().counter("device_server_mysql_pool_acquire_total", "MySQL connection acquisitions by path", poolLabels(name_, "path=\"shared\""))),
+      waited_(Metrics::getInstance().counter("device_server_mysql_pool_acquire_total", "MySQL connection acquisitions by path", poolLabels(name_, "path=\"wait\""))),
+      reaped_(Metrics::getInstance().counter("device_server_mysql_pool_closed_total", "MySQL connections closed by pool maintenance", poolLabels(name_, "reason=\"idle\""))),
+      unhealthy_(Metrics::getInstance().counter("device_server_mysql_pool_closed_total", "MySQL connections closed by pool maintenance", poolLabels(name_, "reason=\"unhealthy\""))) {
+    // 回调在抓取时执行，不能在持有 mutex_ 时注册（导出时注册表锁在外、mutex_ 在内）
+    Metrics& metrics = Metrics::getInstance();
+    std::string labels = poolLabels(name_);
+    metrics.gaugeCallback("device_server_mysql_pool_active", "MySQL connections checked out",
+                          [this] { return static_cast<double>(getActiveCount()); }, labels);
+    metrics.gaugeCallback("device_server_mysql_pool_idle", "MySQL connections idle in the pool",
+                          [this] { return static_cast<double>(getPoolSize()); }, labels);
+    metrics.gaugeCallback("device_server_mysql_pool_total", "MySQL connections opened by the pool",
+                          [this] { return static_cast<double>(totalCount_.load()); }, labels);
+    metrics.gaugeCallback("device_server_mysql_pool_waiters", "Threads waiting for a MySQL connection",
+                          [this] { return static_cast<double>(waiterCount_.load()); }, labels);
+    metrics.gaugeCallback("device_server_mysql_pool_healthy", "1 if the pool can reach its server",
+                          [this] { return healthy_ ? 1.0 : 0.0; }, labels);
+}
 
 ConnectionPool::~ConnectionPool() { shutdown(); }
 
-ConnectionPool& ConnectionPool::getInstance() { static ConnectionPool instance; return instance; }
+ConnectionPool& ConnectionPool::getInstance() { static ConnectionPool instance("primary"); return instance; }
+
+ConnectionPool& ConnectionPool::getInstance(const std::string& name) {
+    // 有意不析构：指标回调持有 this，直到进程退出
+    static std::mutex registryMutex;
+    static std::map<std::string, ConnectionPool*> registry;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ConnectionPool*& pool = registry[name];
+    if (!pool) pool = new ConnectionPool(name);
+    return *pool;
+}
 
 bool ConnectionPool::init(const MySQLConfig& mysqlConfig, const PoolConfig& poolConfig) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (initialized_) { LOG_WARNING("ConnectionPool already initialized"); return true; }
     mysqlConfig_ = mysqlConfig;
     poolConfig_ = poolConfig;
+    poolConfig_.maxSize = std::max(1, poolConfig_.maxSize);
+    poolConfig_.minSize = std::min(std::max(0, poolConfig_.minSize), poolConfig_.maxSize);
     shutdown_ = false;
-    if (mysql_library_init(0, nullptr, nullptr) != 0) { LOG_ERROR("mysql_library_init failed"); return false; }
+    if (!acquireLibrary()) { LOG_ERROR("mysql_library_init failed"); return false; }
+    slotCount_ = std::max(poolConfig_.maxSize, kMaxSlots);
+    slots_ = std::make_unique<Slot[]>(static_cast<std::size_t>(slotCount_));
+    slotLimit_ = poolConfig_.maxSize;
+    minSize_ = poolConfig_.minSize;
     for (int i = 0; i < poolConfig_.minSize; ++i) {
         auto conn = createConnection();
-        if (conn) { pool_.push(conn); ++totalCount_; } else { LOG_ERROR("Failed to create initial connection"); }
+        if (!conn) { LOG_ERROR("Failed to create initial connection"); continue; }
+        int slot = totalCount_++;
+        conn->poolSlot_ = slot;
+        slots_[slot].conn = std::move(conn);
+        slots_[slot].state.store(SLOT_IDLE);
     }
-    if (pool_.empty()) { LOG_ERROR("Failed to create any connection"); mysql_library_end(); return false; }
+    if (totalCount_ == 0 && poolConfig_.minSize > 0) { LOG_ERROR("Failed to create any connection"); releaseLibrary(); return false; }
+    prewarmRequested_ = false;
+    healthy_ = true;
     initialized_ = true;
-    LOG_INFO("ConnectionPool initialized");
+    maintenanceThread_ = std::thread(&ConnectionPool::maintenanceLoop, this);
+    LOG_INFO("ConnectionPool " + name_ + " initialized");
     return true;
 }
 
 void ConnectionPool::shutdown() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!initialized_) return;
-    shutdown_ = true;
-    while (!pool_.empty()) pool_.pop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!initialized_ || shutdown_) return;
+        shutdown_ = true;
+        for (Waiter* waiter : waiters_) waiter->cv.notify_one();
+    }
+    // 维护线程可能正在锁外建连或 ping，先等它退出再关闭连接
+    maintenanceCv_.notify_all();
+    if (maintenanceThread_.joinable()) maintenanceThread_.join();
+    // 借出的连接归还时即断开（releaseConnection），全部归还后才能释放客户端库
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        returnedCv_.wait_for(lock, std::chrono::milliseconds(kShutdownWaitMs), [this] { return activeCount_ == 0; });
+    }
+    int outstanding = 0;
+    for (int i = 0; i < slotCount_; ++i) {
+        int expected = SLOT_IDLE;
+        if (slots_[i].state.compare_exchange_strong(expected, SLOT_RESERVED)) {
+            slots_[i].conn.reset();
+            slots_[i].state.store(SLOT_EMPTY);
+        } else if (expected != SLOT_EMPTY) {
+            ++outstanding;
+        }
+    }
     totalCount_ = 0;
-    activeCount_ = 0;
     initialized_ = false;
-    mysql_library_end();
-    LOG_INFO("ConnectionPool shutdown");
+    if (outstanding > 0) {
+        // 仍在使用的连接之后会调用客户端库，保留库（进程退出时回收）
+        LOG_WARNING("ConnectionPool " + name_ + " shutdown with " + std::to_string(outstanding) +
+                    " connections still checked out, keeping the MySQL library loaded");
+    } else {
+        releaseLibrary();
+    }
+    LOG_INFO("ConnectionPool " + name_ + " shutdown");
+}
+
+void ConnectionPool::resize(int minSize, int maxSize) {
+    if (!initialized_ || shutdown_) return;
+    if (maxSize > slotCount_) {
+        LOG_WARNING("Pool " + name_ + " pool_size_max " + std::to_string(maxSize) + " exceeds " +
+                    std::to_string(slotCount_) + " slots, clamped");
+    }
+    maxSize = std::min(std::max(1, maxSize), slotCount_);
+    minSize = std::min(std::max(0, minSize), maxSize);
+    slotLimit_ = maxSize;
+    minSize_ = minSize;
+    for (int i = maxSize; i < slotCount_; ++i) {
+        int expected = SLOT_IDLE;
+        if (slots_[i].state.compare_exchange_strong(expected, SLOT_RESERVED)) discard(i);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prewarmRequested_ = true;
+    }
+    maintenanceCv_.notify_one();
+    LOG_INFO("Pool " + name_ + " resized to min " + std::to_string(minSize) + ", max " + std::to_string(maxSize));
+}
+
+int ConnectionPool::tryAcquire() {
+    int limit = slotLimit_.load(std::memory_order_relaxed);
+    int slot = affinityPool == this ? affinitySlot : -1;
+    int expected = SLOT_IDLE;
+    if (slot >= 0 && slot < limit && slots_[slot].state.compare_exchange_strong(expected, SLOT_IN_USE)) {
+        affinityHits_.inc();
+        return slot;
+    }
+    int start = scanStart();
+    for (int i = 0; i < limit; ++i) {
+        slot = (start + i) % limit;
+        if (slots_[slot].state.load() != SLOT_IDLE) continue;
+        expected = SLOT_IDLE;
+        if (slots_[slot].state.compare_exchange_strong(expected, SLOT_IN_USE)) {
+            sharedHits_.inc();
+            return slot;
+        }
+    }
+    return -1;
 }
 
 std::shared_ptr<MySQLConnection> ConnectionPool::getConnection(int timeoutMs) {
-    std::unique_lock<std::mutex> lock(mutex_);
     if (!initialized_ || shutdown_) { LOG_ERROR("ConnectionPool is not available"); return nullptr; }
-    auto waitUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
-    while (pool_.empty()) {
-        if (totalCount_ < poolConfig_.maxSize) {
-            auto conn = createConnection();
-            if (conn) { ++totalCount_; ++activeCount_; conn->updateLastUsedTime(); return conn; }
+    TRACE_SPAN("mysql.getConnection");
+    ScopedTimer timer(&waitTime_);
+    int slot = tryAcquire();
+    if (slot < 0) {
+        auto waitUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        Waiter self;
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiters_.push_back(&self);
+        waiterCount_.fetch_add(1);
+        if (totalCount_ < slotLimit_) { prewarmRequested_ = true; maintenanceCv_.notify_one(); }
+        lock.unlock();
+        // 入队后再试一次：入队前归还的连接看不到等待者，不会移交过来
+        slot = tryAcquire();
+        lock.lock();
+        if (slot < 0) {
+            auto ready = [&] { return self.slot >= 0 || shutdown_; };
+            if (timeoutMs < 0) self.cv.wait(lock, ready);
+            else self.cv.wait_until(lock, waitUntil, ready);
+        }
+        auto it = std::find(waiters_.begin(), waiters_.end(), &self);
+        if (it != waiters_.end()) { waiters_.erase(it); waiterCount_.fetch_sub(1); }
+        lock.unlock();
+        if (self.slot >= 0) {
+            if (slot >= 0) publish(self.slot);  // 重试已取到，移交来的连接退回
+            else { slot = self.slot; waited_.inc(); }
+        }
+        if (slot < 0) {
+            if (!shutdown_) { timeouts_.inc(); LOG_WARNING("Get connection timeout"); }
+            return nullptr;
         }
-        if (timeoutMs < 0) cv_.wait(lock);
-        else if (cv_.wait_until(lock, waitUntil) == std::cv_status::timeout) { LOG_WARNING("Get connection timeout"); return nullptr; }
-        if (shutdown_) return nullptr;
     }
-    auto conn = pool_.front();
-    pool_.pop();
     ++activeCount_;
-    if (!conn->ping()) {
-        --totalCount_; --activeCount_;
-        conn = createConnection();
-        if (conn) { ++totalCount_; ++activeCount_; }
-    }
-    if (conn) conn->updateLastUsedTime();
-    return conn;
+    return slots_[slot].conn;
 }
 
 void ConnectionPool::releaseConnection(std::shared_ptr<MySQLConnection> conn) {
     if (!conn) return;
-    std::lock_guard<std::mutex> lock(mutex_);
+    releaseSlot(conn);
+    // 计数最后才减：shutdown 看到计数归零时连接已回到槽位或已断开
     --activeCount_;
-    if (shutdown_) { --totalCount_; return; }
-    if (conn->isValid()) { conn->updateLastUsedTime(); pool_.push(conn); cv_.notify_one(); }
-    else { --totalCount_; LOG_WARNING("Released invalid connection"); }
+    if (shutdown_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        returnedCv_.notify_all();
+    }
+}
+
+void ConnectionPool::releaseSlot(const std::shared_ptr<MySQLConnection>& conn) {
+    int slot = conn->poolSlot_;
+    if (slot < 0 || slot >= slotCount_ || slots_[slot].conn != conn) return;
+    if (shutdown_ || !conn->isValid()) {
+        if (!shutdown_) LOG_WARNING("Released invalid connection");
+        // 调用方可能仍持有引用，先断开，客户端库释放后不再有人调用 mysql_close
+        conn->disconnect();
+        discard(slot);
+        return;
+    }
+    // resize 缩小后上限以外的连接归还时关闭
+    if (slot >= slotLimit_.load(std::memory_order_relaxed)) {
+        discard(slot);
+        return;
+    }
+    conn->updateLastUsedTime();
+    affinityPool = this;
+    affinitySlot = slot;
+    publish(slot);
+}
+
+void ConnectionPool::publish(int slot) {
+    // 先置空闲再检查等待者，与等待者先入队再重试配对，两边至少有一方看到对方
+    slots_[slot].state.store(SLOT_IDLE);
+    if (waiterCount_.load() == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (waiters_.empty()) return;
+    int expected = SLOT_IDLE;
+    if (!slots_[slot].state.compare_exchange_strong(expected, SLOT_IN_USE)) return;
+    Waiter* waiter = waiters_.front();
+    waiters_.pop_front();
+    waiterCount_.fetch_sub(1);
+    waiter->slot = slot;
+    waiter->cv.notify_one();
+}
+
+void ConnectionPool::discard(int slot) {
+    slots_[slot].conn.reset();
+    slots_[slot].state.store(SLOT_EMPTY);
+    --totalCount_;
+    if (waiterCount_.load() > 0 || totalCount_ < minSize_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prewarmRequested_ = true;
+        maintenanceCv_.notify_one();
+    }
 }
 
 std::shared_ptr<MySQLConnection> ConnectionPool::createConnection() {
@@ -164,32 +383,118 @@ std::shared_ptr<MySQLConnection> ConnectionPool::createConnection() {
     return conn;
 }
 
-int ConnectionPool::getPoolSize() const { std::lock_guard<std::mutex> lock(mutex_); return static_cast<int>(pool_.size()); }
+int ConnectionPool::getPoolSize() const {
+    if (!slots_) return 0;
+    int idle = 0;
+    for (int i = 0; i < slotCount_; ++i) {
+        if (slots_[i].state.load(std::memory_order_relaxed) == SLOT_IDLE) ++idle;
+    }
+    return idle;
+}
 
 int ConnectionPool::getActiveCount() const { return activeCount_.load(); }
 
+void ConnectionPool::maintenanceLoop() {
+    auto interval = std::chrono::seconds(std::max(1, poolConfig_.healthCheckInterval));
+    auto nextCheck = std::chrono::steady_clock::now() + interval;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!shutdown_) {
+        maintenanceCv_.wait_until(lock, nextCheck, [this] { return shutdown_ || prewarmRequested_; });
+        if (shutdown_) break;
+        prewarmRequested_ = false;
+        if (std::chrono::steady_clock::now() >= nextCheck) {
+            lock.unlock();
+            reapIdleConnections(std::time(nullptr));
+            cleanupInvalidConnections();
+            lock.lock();
+            nextCheck = std::chrono::steady_clock::now() + interval;
+        }
+        prewarmConnections(lock);
+    }
+}
+
+void ConnectionPool::reapIdleConnections(time_t now) {
+    int limit = slotLimit_.load(std::memory_order_relaxed);
+    for (int i = 0; i < slotCount_; ++i) {
+        if (i < limit && totalCount_ <= minSize_) continue;
+        int expected = SLOT_IDLE;
+        if (!slots_[i].state.compare_exchange_strong(expected, SLOT_RESERVED)) continue;
+        if (i >= limit || now - slots_[i].conn->getLastUsedTime() >= poolConfig_.maxIdleTime) {
+            discard(i);
+            reaped_.inc();
+        } else {
+            publish(i);
+        }
+    }
+}
+
 void ConnectionPool::cleanupInvalidConnections() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::queue<std::shared_ptr<MySQLConnection>> validConnections;
-    while (!pool_.empty()) {
-        auto conn = pool_.front();
-        pool_.pop();
-        if (conn->ping()) validConnections.push(conn);
-        else { --totalCount_; LOG_WARNING("Removed invalid connection"); }
+    time_t now = std::time(nullptr);
+    int alive = 0;
+    int dead = 0;
+    for (int i = 0; i < slotCount_ && !shutdown_; ++i) {
+        int expected = SLOT_IDLE;
+        if (!slots_[i].state.compare_exchange_strong(expected, SLOT_RESERVED)) continue;
+        // 检查期间该连接暂不可取用，取用方会转向其他槽位或等待移交
+        if (now - slots_[i].conn->getLastUsedTime() < poolConfig_.healthCheckInterval) {
+            publish(i);
+        } else if (slots_[i].conn->ping()) {
+            ++alive;
+            publish(i);
+        } else {
+            ++dead;
+            discard(i);
+            unhealthy_.inc();
+            LOG_WARNING("Removed invalid connection from pool " + name_);
+        }
+    }
+    // 单条连接失效（如被服务端按 wait_timeout 断开）不代表服务端不可用
+    if (alive > 0) {
+        if (!healthy_.exchange(true)) LOG_INFO("Pool " + name_ + " healthy again");
+    } else if (dead > 0) {
+        if (healthy_.exchange(false)) LOG_WARNING("Pool " + name_ + " marked unhealthy: health check failed");
+    }
+}
+
+void ConnectionPool::prewarmConnections(std::unique_lock<std::mutex>& lock) {
+    while (!shutdown_ && totalCount_ < slotLimit_ &&
+           (totalCount_ < minSize_ || !waiters_.empty() || getPoolSize() == 0)) {
+        lock.unlock();
+        auto conn = createConnection();
+        if (!conn) {
+            if (healthy_.exchange(false)) LOG_WARNING("Pool " + name_ + " marked unhealthy: cannot connect");
+            lock.lock();
+            return;
+        }
+        if (!healthy_.exchange(true)) LOG_INFO("Pool " + name_ + " healthy again");
+        // 只有本线程填充空槽位；缩小上限后仍在使用的连接可能占着上限以外的槽位，此时可能没有空槽位
+        int limit = slotLimit_.load(std::memory_order_relaxed);
+        int slot = 0;
+        for (int expected = SLOT_EMPTY; slot < limit; ++slot, expected = SLOT_EMPTY) {
+            if (slots_[slot].state.compare_exchange_strong(expected, SLOT_RESERVED)) break;
+        }
+        if (slot == limit) { lock.lock(); return; }
+        conn->poolSlot_ = slot;
+        slots_[slot].conn = std::move(conn);
+        ++totalCount_;
+        if (shutdown_) discard(slot);
+        else publish(slot);
+        lock.lock();
     }
-    pool_ = std::move(validConnections);
 }
 
-ConnectionGuard::ConnectionGuard(std::shared_ptr<MySQLConnection> conn) : conn_(std::move(conn)) {}
+ConnectionGuard::ConnectionGuard(std::shared_ptr<MySQLConnection> conn, ConnectionPool& pool)
+    : conn_(std::move(conn)), pool_(&pool) {}
 
-ConnectionGuard::~ConnectionGuard() { if (conn_) ConnectionPool::getInstance().releaseConnection(conn_); }
+ConnectionGuard::~ConnectionGuard() { if (conn_) pool_->releaseConnection(conn_); }
 
-ConnectionGuard::ConnectionGuard(ConnectionGuard&& other) noexcept : conn_(std::move(other.conn_)) {}
+ConnectionGuard::ConnectionGuard(ConnectionGuard&& other) noexcept : conn_(std::move(other.conn_)), pool_(other.pool_) {}
 
 ConnectionGuard& ConnectionGuard::operator=(ConnectionGuard&& other) noexcept {
     if (this != &other) {
-        if (conn_) ConnectionPool::getInstance().releaseConnection(conn_);
+        if (conn_) pool_->releaseConnection(conn_);
         conn_ = std::move(other.conn_);
+        pool_ = other.pool_;
     }
     return *this;
 }
\ No newline at end of file
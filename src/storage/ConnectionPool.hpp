@@ -2,11 +2,16 @@
 
 #include <mysql/mysql.h>
 #include <string>
-#include <queue>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <atomic>
+#include <thread>
+
+class Counter;
+class Histogram;
+class ConnectionPool;
 
 struct MySQLConfig {
     std::string host = "127.0.0.1";
@@ -23,8 +28,8 @@ struct MySQLConfig {
 struct PoolConfig {
     int minSize = 5;
     int maxSize = 20;
-    int maxIdleTime = 300;
-    int healthCheckInterval = 60;
+    int maxIdleTime = 300;         // 秒：空闲超过该时长且总数多于 minSize 的连接被关闭
+    int healthCheckInterval = 60;  // 秒：后台线程检查周期，空闲超过该时长的连接会被 ping
 };
 
 class MySQLConnection {
@@ -52,39 +57,112 @@ private:
     MYSQL* conn_;
     time_t lastUsedTime_;
     bool connected_;
+    int poolSlot_ = -1;  // 所在连接池槽位
+    friend class ConnectionPool;
 };
 
+/**
+ * MySQL 连接池
+ * 连接放在 maxSize 个定长槽位中，每个槽位用原子状态（空/空闲/使用中/维护中）表示归属，取用与归还
+ * 只做 CAS，不加锁：线程先尝试上次归还的槽位（线程亲和，常用连接保持热），再从线程各自的起点
+ * 扫描共享槽位。没有空闲连接时请求唯一的建连线程新建，自身进入 FIFO 等待队列，归还或新建的
+ * 连接直接移交给队首等待者；超过 timeoutMs 仍未拿到则返回 nullptr。
+ * 建连线程同时负责维护：每 healthCheckInterval 秒 ping 空闲较久的连接并丢弃失效连接，关闭空闲
+ * 超过 maxIdleTime 的多余连接（总数不低于 minSize），总数低于 minSize 或空闲连接用尽时提前新建。
+ * 建连失败或健康检查 ping 失败时标记为不健康，下次建连成功后恢复（读写分离据此摘除副本）。
+ * 槽位数组按 max(maxSize, kMaxSlots) 一次分配，resize 只移动可用槽位上限，取用路径仍不加锁
+ */
 class ConnectionPool {
 public:
+    // 运行时 resize 可达的连接数上限（初始 maxSize 更大时以其为准）
+    static constexpr int kMaxSlots = 256;
+    // shutdown 等待借出的连接归还的上限，超时则不释放客户端库
+    static constexpr int kShutdownWaitMs = 5000;
+
+    // 主库连接池
     static ConnectionPool& getInstance();
+    // 按名称取连接池（如副本 "replica-0"），首次调用时创建，进程退出前不销毁
+    static ConnectionPool& getInstance(const std::string& name);
     ConnectionPool(const ConnectionPool&) = delete;
     ConnectionPool& operator=(const ConnectionPool&) = delete;
     bool init(const MySQLConfig& mysqlConfig, const PoolConfig& poolConfig = PoolConfig());
     void shutdown();
+    /**
+     * 运行时调整连接数上下限：扩大时按需新建；缩小时上限以外的空闲连接立即关闭，
+     * 使用中的在归还时关闭
+     */
+    void resize(int minSize, int maxSize);
     std::shared_ptr<MySQLConnection> getConnection(int timeoutMs = 5000);
     void releaseConnection(std::shared_ptr<MySQLConnection> conn);
     int getPoolSize() const;
     int getActiveCount() const;
     bool isInitialized() const { return initialized_; }
+    bool isHealthy() const { return healthy_; }
+    const std::string& name() const { return name_; }
 private:
-    ConnectionPool();
+    enum SlotState : int { SLOT_EMPTY, SLOT_IDLE, SLOT_IN_USE, SLOT_RESERVED };
+    struct alignas(64) Slot {
+        std::atomic<int> state{SLOT_EMPTY};
+        // 只有把状态从 IDLE/EMPTY 换走的一方可以读写
+        std::shared_ptr<MySQLConnection> conn;
+    };
+    struct Waiter {
+        std::condition_variable cv;
+        int slot = -1;  // 移交到的槽位，已处于 IN_USE
+    };
+
+    explicit ConnectionPool(std::string name);
     ~ConnectionPool();
     std::shared_ptr<MySQLConnection> createConnection();
+    // 无锁取一个空闲槽位：先试线程亲和槽位再扫描，失败返回 -1
+    int tryAcquire();
+    // 归还连接到槽位（失效、关闭期间或超出上限时关闭）
+    void releaseSlot(const std::shared_ptr<MySQLConnection>& conn);
+    // 槽位变为空闲；有等待者时直接移交给队首
+    void publish(int slot);
+    // 关闭槽位中的连接并清空槽位，调用方持有该槽位
+    void discard(int slot);
+    void maintenanceLoop();
+    // 关闭空闲超过 maxIdleTime 的多余连接
+    void reapIdleConnections(time_t now);
+    // ping 空闲超过 healthCheckInterval 的连接并丢弃失效连接；有连接 ping 通即视为健康，全部失败才标记不健康
     void cleanupInvalidConnections();
+    // 补足 minSize，有等待者或空闲连接用尽时新建；建连在锁外进行
+    void prewarmConnections(std::unique_lock<std::mutex>& lock);
+    std::string name_;  // 指标标签 pool="..."
     MySQLConfig mysqlConfig_;
     PoolConfig poolConfig_;
-    std::queue<std::shared_ptr<MySQLConnection>> pool_;
+    std::unique_ptr<Slot[]> slots_;
+    int slotCount_ = 0;                 // 已分配的槽位数
+    std::atomic<int> slotLimit_{0};     // 可用槽位 [0, slotLimit_)，即当前 maxSize
+    std::atomic<int> minSize_{0};
+    // mutex_ 只保护等待队列与建连线程的唤醒，取用/归还的快路径不经过它
     mutable std::mutex mutex_;
-    std::condition_variable cv_;
+    std::deque<Waiter*> waiters_;
+    std::atomic<int> waiterCount_{0};
+    std::condition_variable maintenanceCv_;
+    std::condition_variable returnedCv_;  // 关闭期间借出的连接归还
+    std::thread maintenanceThread_;
+    bool prewarmRequested_ = false;
     std::atomic<int> totalCount_;
     std::atomic<int> activeCount_;
     std::atomic<bool> initialized_;
     std::atomic<bool> shutdown_;
+    std::atomic<bool> healthy_{true};
+    Histogram& waitTime_;   // getConnection 等待耗时
+    Counter& timeouts_;     // 获取连接超时次数
+    Counter& affinityHits_; // 命中本线程上次归还的连接
+    Counter& sharedHits_;   // 扫描共享槽位取得
+    Counter& waited_;       // 进入等待队列后取得
+    Counter& reaped_;       // 因空闲过久关闭的连接数
+    Counter& unhealthy_;    // 健康检查失败丢弃的连接数
 };
 
 class ConnectionGuard {
 public:
-    explicit ConnectionGuard(std::shared_ptr<MySQLConnection> conn);
+    // conn 须来自 pool，析构时归还给它
+    explicit ConnectionGuard(std::shared_ptr<MySQLConnection> conn,
+                             ConnectionPool& pool = ConnectionPool::getInstance());
     ~ConnectionGuard();
     ConnectionGuard(const ConnectionGuard&) = delete;
     ConnectionGuard& operator=(const ConnectionGuard&) = delete;
@@ -95,4 +173,5 @@ public:
     explicit operator bool() const { return conn_ != nullptr && conn_->isValid(); }
 private:
     std::shared_ptr<MySQLConnection> conn_;
+    ConnectionPool* pool_;
 };
\ No newline at end of file
@@ -1,27 +1,109 @@
 #pragma once
 
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <condition_variable>
 #include "StoreInterface.hpp"
+#include "WriteAheadLog.hpp"
+#include "SnapshotImage.hpp"
+#include "thread/EpochManager.hpp"
+#include "thread/SegmentedLog.hpp"
 
 /**
  * 内存存储实现
  * 使用 unordered_map + vector 存储设备数据
- * 线程安全，使用读写锁保护
+ * 线程安全：设备数据使用读写锁保护；需求记录为读多写少，采用 RCU 方式发布——
+ * 只追加的分段存储 + 原子发布的长度与视图指针，查询不加任何锁，写入只与写入互斥，
+ * 被替换的视图和已并入镜像的段由 EpochManager 在读者退出后回收
+ *
+ * 可选持久化（enableDurability）：每次写入先追加 WAL。数据分两层：
+ * 只读 mmap 的镜像（SnapshotImage）+ 镜像之后写入的可变覆盖层（series_ / data_）。
+ * 后台定期把覆盖层合并进新镜像；启动时 mmap 镜像并只回放镜像之后的 WAL 段
  */
 class MemoryStore : public StoreInterface {
 public:
+    MemoryStore();
+    ~MemoryStore() override;
+
     // 写入一条数据
-    void append(const std::string& deviceId, const DataPoint& point) override;
+    void append(InternId deviceId, const DataPoint& point) override;
+
+    // 批量写入：每个设备只加一次写锁
+    bool appendBatch(InternId deviceId, const std::vector<DataPoint>& points) override;
 
     // 查询指定设备最近的 limit 条数据
-    std::vector<DataPoint> queryLatest(const std::string& deviceId, std::size_t limit) const override;
+    std::vector<DataPoint> queryLatest(InternId deviceId, std::size_t limit) const override;
+
+    // 设备版本号：该设备的数据点总数（只追加，镜像合并前后不变）
+    uint64_t deviceVersion(InternId deviceId) const override;
+
+    // 写入一条需求记录
+    void appendRequirement(const Requirement& req) override;
+
+    // 分页查询需求记录
+    RequirementQueryResult queryRequirements(int page, int limit,
+        int willingToPay, const std::string& keyword) const override;
+
+    /**
+     * 启用 WAL + 快照持久化：从快照与 WAL 恢复数据后打开新日志段，并启动快照线程
+     * 必须在开始处理请求之前调用
+     */
+    bool enableDurability(const WalConfig& config);
+
+    /**
+     * 生成快照并删除已被快照覆盖的 WAL 段
+     */
+    bool checkpoint();
+
+    /**
+     * 停止快照线程，生成最终快照并关闭 WAL
+     */
+    void shutdownDurability();
 
 private:
     using Series = std::vector<DataPoint>;
 
-    mutable std::shared_mutex mtx_;
-    std::unordered_map<std::string, Series> data_;
+    /**
+     * 需求记录的只读视图：镜像 + 覆盖层中尚未并入镜像的起始下标
+     * 发布后不再修改，替换时整体换新并延迟回收
+     */
+    struct RequirementView {
+        std::shared_ptr<const SnapshotImage> image;
+        std::size_t head = 0;
+    };
+
+    void replayRecord(uint8_t type, const char* data, std::size_t len);
+    void snapshotLoop();
+    // ALWAYS 策略下等待记录落盘，失败时记录错误并返回 false
+    bool waitDurable(uint64_t lsn);
+    // 发布新视图并延迟回收旧视图；调用方需持有 reqWriteMtx_
+    void publishView(std::shared_ptr<const SnapshotImage> image, std::size_t head);
+
+    // 锁顺序：seriesMtx_ 先于 reqWriteMtx_（仅恢复与 checkpoint 同时持有两者）
+    mutable std::shared_mutex seriesMtx_;
+    std::unordered_map<InternId, Series> series_;   // 按设备 InternId 索引
+
+    // 需求记录：写者之间用 reqWriteMtx_ 串行，读者只进入 epoch
+    std::mutex reqWriteMtx_;
+    SegmentedLog<Requirement> data_;
+    std::atomic<const RequirementView*> reqView_{nullptr};
+    mutable EpochManager epochs_;
+
+    // 只读镜像：设备数据读取需持有 seriesMtx_（读锁即可），替换需同时持有 seriesMtx_ 写锁与 reqWriteMtx_
+    std::shared_ptr<const SnapshotImage> image_;
+
+    // 持久化
+    WalConfig walConfig_;
+    std::unique_ptr<WriteAheadLog> wal_;
+    std::mutex checkpointMtx_;
+    std::mutex snapshotMtx_;
+    std::condition_variable snapshotCv_;
+    std::thread snapshotThread_;
+    bool snapshotRunning_ = false;
 };
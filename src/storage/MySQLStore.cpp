@@ -1,9 +1,31 @@
 #include "MySQLStore.hpp"
 #include "utils/Logger.hpp"
+#include "utils/JsonParser.hpp"
+#include "utils/Metrics.hpp"
+#include "BucketCodec.hpp"
+#include <map>
 #include <sstream>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <algorithm>
 
-MySQLStore::MySQLStore() : initialized_(false) {
+static Counter& readCounter(const char* target) {
+    return Metrics::getInstance().counter("device_server_mysql_reads_total",
+                                          "Routed MySQL reads by target", std::string("target=\"") + target + "\"");
+}
+
+MySQLStore::MySQLStore()
+    : initialized_(false),
+      replicaReads_(readCounter("replica")),
+      primaryReads_(readCounter("primary")),
+      stickyReads_(readCounter("primary_sticky")),
+      compacted_(Metrics::getInstance().counter("device_server_mysql_buckets_compacted_total",
+                                                "data_buckets rows rewritten as compressed column blocks")),
+      partitionsAdded_(Metrics::getInstance().counter("device_server_mysql_partitions_total",
+                                                      "data_buckets partitions managed by the server", "op=\"add\"")),
+      partitionsDropped_(Metrics::getInstance().counter("device_server_mysql_partitions_total",
+                                                        "data_buckets partitions managed by the server", "op=\"drop\"")) {
 }
 
 MySQLStore::~MySQLStore() { shutdown(); }
@@ -18,11 +40,647 @@ bool MySQLStore::init(const MySQLConfig& config, const PoolConfig& poolConfig) {
 
 void MySQLStore::shutdown() {
     if (!initialized_) return;
+#ifdef HAVE_MYSQL_NONBLOCKING
+    // 先停非阻塞客户端：未完成的语句以错误回调
+    if (async_) async_->stop();
+#endif
+    if (layoutThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(layoutMutex_);
+            layoutStopping_ = true;
+        }
+        layoutCv_.notify_all();
+        layoutThread_.join();
+    }
+    if (replicaThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(replicaMutex_);
+            replicaStopping_ = true;
+        }
+        replicaCv_.notify_all();
+        replicaThread_.join();
+    }
+    for (const auto& replica : replicas_) replica->pool->shutdown();
+    replicas_.clear();
     ConnectionPool::getInstance().shutdown();
     initialized_ = false;
     LOG_INFO("MySQLStore shutdown");
 }
 
+static std::string metricsToJson(const std::vector<Metric>& metrics) {
+    InternTable& names = InternTable::getInstance();
+    JsonValue::Object obj;
+    for (const Metric& metric : metrics) obj.emplace(names.name(metric.name), JsonValue(metric.value));
+    return JsonParser::stringify(JsonValue(std::move(obj)));
+}
+
+// 以下 SQL 构造与结果解析由同步与非阻塞路径共用，参数均为已转义的字符串
+
+static std::string insertPointSql(const std::string& escapedId, long long timestamp, const std::string& escapedMetrics) {
+    std::ostringstream sql;
+    sql << "INSERT INTO device_data.data_points (device_id, timestamp, metrics) VALUES ('"
+        << escapedId << "', " << timestamp << ", '" << escapedMetrics << "')";
+    return sql.str();
+}
+
+static std::string queryLatestSql(const std::string& escapedId, std::size_t limit) {
+    std::ostringstream sql;
+    sql << "SELECT timestamp, metrics FROM device_data.data_points WHERE device_id = '"
+        << escapedId << "' ORDER BY timestamp DESC LIMIT " << limit;
+    return sql.str();
+}
+
+// 按接口约定以时间正序返回
+static std::vector<DataPoint> readDataPoints(MYSQL_RES* res) {
+    std::vector<DataPoint> points;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        DataPoint point;
+        point.timestamp = row[0] ? std::stoll(row[0]) : 0;
+        if (row[1]) {
+            JsonValue metrics = JsonParser::parse(std::string_view(row[1], lengths[1]));
+            if (metrics.isObject()) {
+                for (const auto& [key, value] : metrics.asObject()) {
+                    if (value.isNumber()) {
+                        point.metrics.push_back(Metric{InternTable::getInstance().intern(key), value.asDouble()});
+                    }
+                }
+            }
+        }
+        points.push_back(std::move(point));
+    }
+    std::reverse(points.begin(), points.end());
+    return points;
+}
+
+static std::string requirementWhereClause(int willingToPay, const std::string& escapedKeyword) {
+    std::ostringstream whereClause;
+    bool hasWhere = false;
+    if (willingToPay >= 0) {
+        if (willingToPay == 2) {
+            whereClause << "willing_to_pay IS NULL";
+        } else {
+            whereClause << "willing_to_pay = " << willingToPay;
+        }
+        hasWhere = true;
+    }
+    if (!escapedKeyword.empty()) {
+        if (hasWhere) whereClause << " AND ";
+        whereClause << "(title LIKE '%" << escapedKeyword << "%' OR content LIKE '%" << escapedKeyword << "%')";
+        hasWhere = true;
+    }
+    return hasWhere ? ("WHERE " + whereClause.str()) : "";
+}
+
+static std::string requirementCountSql(const std::string& whereStr) {
+    return "SELECT COUNT(*) FROM requirements " + whereStr;
+}
+
+static std::string requirementDataSql(const std::string& whereStr, int page, int limit) {
+    int offset = (page - 1) * limit;
+    if (offset < 0) offset = 0;
+    std::ostringstream dataSql;
+    dataSql << "SELECT id, title, content, willing_to_pay, contact, notes, created_at, updated_at ";
+    dataSql << "FROM requirements " << whereStr << " ";
+    dataSql << "ORDER BY created_at DESC LIMIT " << limit << " OFFSET " << offset;
+    return dataSql.str();
+}
+
+static int64_t readCount(MYSQL_RES* res) {
+    MYSQL_ROW row = mysql_fetch_row(res);
+    return row && row[0] ? std::stoll(row[0]) : 0;
+}
+
+static void readRequirements(MYSQL_RES* res, std::vector<Requirement>& out) {
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        Requirement r;
+        r.id = row[0] ? std::stoll(row[0]) : 0;
+        r.title = row[1] && lengths[1] > 0 ? std::string(row[1], lengths[1]) : "";
+        r.content = row[2] && lengths[2] > 0 ? std::string(row[2], lengths[2]) : "";
+        r.willing_to_pay = row[3] ? std::stoi(row[3]) : -1;
+        r.contact = row[4] && lengths[4] > 0 ? std::string(row[4], lengths[4]) : "";
+        r.notes = row[5] && lengths[5] > 0 ? std::string(row[5], lengths[5]) : "";
+        r.created_at = row[6] && lengths[6] > 0 ? std::string(row[6], lengths[6]) : "";
+        r.updated_at = row[7] && lengths[7] > 0 ? std::string(row[7], lengths[7]) : "";
+        out.push_back(std::move(r));
+    }
+}
+
+bool MySQLStore::addReplicas(const std::vector<MySQLConfig>& replicas, const PoolConfig& poolConfig, int maxLagMs) {
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
+    // 副本至少保留一条连接：维护线程靠它判断副本是否恢复
+    PoolConfig replicaPool = poolConfig;
+    replicaPool.minSize = std::max(1, replicaPool.minSize);
+    for (const MySQLConfig& config : replicas) {
+        ConnectionPool& pool = ConnectionPool::getInstance("replica-" + std::to_string(replicas_.size()));
+        if (!pool.init(config, replicaPool)) {
+            LOG_WARNING("Skipping unreachable MySQL replica " + config.host + ":" + std::to_string(config.port));
+            continue;
+        }
+        auto replica = std::make_unique<Replica>();
+        replica->pool = &pool;
+        replicas_.push_back(std::move(replica));
+        LOG_INFO("MySQL replica " + pool.name() + " at " + config.host + ":" + std::to_string(config.port));
+    }
+    maxLag_ = std::chrono::milliseconds(std::max(0, maxLagMs));
+    // 延迟每秒检查一次且只精确到秒：窗口短于此时，副本落后接近 2 秒仍可能被视为已追上
+    readAfterWrite_ = std::max(maxLag_, std::chrono::steady_clock::duration(
+        std::chrono::milliseconds(kMinReadAfterWriteMs)));
+    if (replicas_.empty()) return false;
+    // 首次检查完成前不从副本读取
+    checkReplicaLag();
+    replicaThread_ = std::thread(&MySQLStore::replicaLagLoop, this);
+    return true;
+}
+
+// 副本的复制延迟（秒）；复制未运行（NULL）或查询失败返回 -1，不是副本返回 0
+static long long readReplicaLag(MySQLConnection& conn, bool& legacy) {
+    MYSQL_RES* res = conn.query(legacy ? "SHOW SLAVE STATUS" : "SHOW REPLICA STATUS");
+    if (!res && !legacy) {
+        // MySQL 8.0.22 之前只有 SHOW SLAVE STATUS
+        legacy = true;
+        res = conn.query("SHOW SLAVE STATUS");
+    }
+    if (!res) return -1;
+    long long lag = 0;
+    MYSQL_ROW row = mysql_fetch_row(res);
+    if (row) {
+        lag = -1;
+        MYSQL_FIELD* fields = mysql_fetch_fields(res);
+        for (unsigned i = 0; i < mysql_num_fields(res); ++i) {
+            std::string_view name(fields[i].name);
+            if (name == "Seconds_Behind_Source" || name == "Seconds_Behind_Master") {
+                if (row[i]) lag = std::atoll(row[i]);
+                break;
+            }
+        }
+    }
+    mysql_free_result(res);
+    return lag;
+}
+
+void MySQLStore::checkReplicaLag() {
+    long long maxLagMs = std::chrono::duration_cast<std::chrono::milliseconds>(maxLag_).count();
+    for (const auto& replica : replicas_) {
+        long long lag = -1;
+        {
+            auto conn = replica->pool->getConnection(kReplicaAcquireTimeoutMs);
+            if (conn) {
+                ConnectionGuard guard(std::move(conn), *replica->pool);
+                lag = readReplicaLag(*guard.get(), legacyReplicaStatus_);
+            }
+        }
+        // Seconds_Behind_Source 为整秒，0 表示不足 1 秒
+        bool lagging = lag < 0 || lag * 1000 >= std::max(maxLagMs, 1LL);
+        if (replica->lagging.exchange(lagging) != lagging) {
+            if (lagging) {
+                LOG_WARNING("MySQL replica " + replica->pool->name() + " removed from reads: " +
+                            (lag < 0 ? std::string("replication lag unknown") : "lag " + std::to_string(lag) + "s"));
+            } else {
+                LOG_INFO("MySQL replica " + replica->pool->name() + " back in rotation");
+            }
+        }
+    }
+}
+
+void MySQLStore::replicaLagLoop() {
+    std::unique_lock<std::mutex> lock(replicaMutex_);
+    while (!replicaCv_.wait_for(lock, std::chrono::milliseconds(kReplicaLagCheckMs),
+                                [this] { return replicaStopping_; })) {
+        lock.unlock();
+        checkReplicaLag();
+        expireStaleVersions();
+        lock.lock();
+    }
+}
+
+void MySQLStore::expireStaleVersions() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    auto window = readAfterWrite_.count();
+    std::chrono::steady_clock::rep written = lastRequirementWrite_.load();
+    if (written != expiredRequirementWrite_ && now - written >= window) {
+        expiredRequirementWrite_ = written;
+        bumpRequirementVersion();
+    }
+    written = lastDataWrite_.load();
+    if (written != expiredDataWrite_ && now - written >= window) {
+        expiredDataWrite_ = written;
+        bumpDataVersion();
+    }
+}
+
+void MySQLStore::resizePools(int minSize, int maxSize) {
+    if (!initialized_) return;
+    ConnectionPool::getInstance().resize(minSize, maxSize);
+    // 与 addReplicas 一致，副本至少保留一条连接
+    for (const auto& replica : replicas_) replica->pool->resize(std::max(1, minSize), maxSize);
+}
+
+bool MySQLStore::mustReadPrimary(bool requirement) const {
+    auto now = std::chrono::steady_clock::now();
+    if (requirement) {
+        std::chrono::steady_clock::time_point written(std::chrono::steady_clock::duration(lastRequirementWrite_.load()));
+        if (now - written < readAfterWrite_) return true;
+    }
+    std::string_view session = SessionScope::current();
+    if (session.empty()) return false;
+    std::lock_guard<std::mutex> lock(sessionMutex_);
+    auto it = sessionWrites_.find(std::string(session));
+    return it != sessionWrites_.end() && now - it->second < readAfterWrite_;
+}
+
+void MySQLStore::noteWrite(bool requirement, std::string_view session) {
+    if (replicas_.empty()) return;
+    auto now = std::chrono::steady_clock::now();
+    (requirement ? lastRequirementWrite_ : lastDataWrite_).store(now.time_since_epoch().count());
+    if (session.empty()) return;
+    std::lock_guard<std::mutex> lock(sessionMutex_);
+    if (sessionWrites_.size() >= kMaxTrackedSessions) {
+        for (auto it = sessionWrites_.begin(); it != sessionWrites_.end();) {
+            if (now - it->second >= readAfterWrite_) it = sessionWrites_.erase(it);
+            else ++it;
+        }
+    }
+    sessionWrites_[std::string(session)] = now;
+}
+
+ConnectionGuard MySQLStore::readConnection(bool requirement) const {
+    if (!replicas_.empty()) {
+        if (mustReadPrimary(requirement)) {
+            stickyReads_.inc();
+            return ConnectionGuard(ConnectionPool::getInstance().getConnection());
+        }
+        // 最少未完成请求：未归还连接数最少的健康副本
+        ConnectionPool* best = nullptr;
+        unsigned start = nextReplica_.fetch_add(1, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < replicas_.size(); ++i) {
+            const Replica& candidate = *replicas_[(start + i) % replicas_.size()];
+            if (candidate.lagging.load(std::memory_order_relaxed)) continue;
+            ConnectionPool* replica = candidate.pool;
+            if (!replica->isHealthy()) continue;
+            if (!best || replica->getActiveCount() < best->getActiveCount()) best = replica;
+        }
+        if (best) {
+            auto conn = best->getConnection(kReplicaAcquireTimeoutMs);
+            if (conn) {
+                replicaReads_.inc();
+                return ConnectionGuard(std::move(conn), *best);
+            }
+        }
+    }
+    primaryReads_.inc();
+    return ConnectionGuard(ConnectionPool::getInstance().getConnection());
+}
+
+// packed 布局：按桶分组的样本记录，escape 为所在路径的转义函数
+struct PackedBucket {
+    std::string samples;
+    unsigned count = 0;
+};
+
+static std::map<long long, PackedBucket> groupIntoBuckets(const DataPoint* points, std::size_t count, long long span) {
+    std::map<long long, PackedBucket> buckets;
+    for (std::size_t i = 0; i < count; ++i) {
+        long long start = BucketCodec::bucketStart(points[i].timestamp, span);
+        PackedBucket& bucket = buckets[start];
+        BucketCodec::appendRecord(bucket.samples, start, points[i]);
+        ++bucket.count;
+    }
+    return buckets;
+}
+
+// data_buckets.compacted：0 为追加中的记录，1 为已整理的压缩块，2 为无法解码、不再整理的桶（原样保留）
+static const int kBucketCompacted = 1;
+static const int kBucketCorrupt = 2;
+
+// 已整理（压缩）的桶收到迟到样本时解压、追加、重新压缩，仍保持 compacted
+template <typename Escape>
+static std::string packedInsertSql(const std::string& escapedId, const std::map<long long, PackedBucket>& buckets,
+                                   Escape&& escape) {
+    std::string sql = "INSERT INTO device_data.data_buckets (device_id, bucket_start, sample_count, samples) VALUES ";
+    bool first = true;
+    for (const auto& [start, bucket] : buckets) {
+        if (!first) sql += ", ";
+        first = false;
+        sql += "('" + escapedId + "', " + std::to_string(start) + ", " + std::to_string(bucket.count) + ", _binary'";
+        escape(bucket.samples, sql);
+        sql += "')";
+    }
+    sql += " ON DUPLICATE KEY UPDATE"
+           " samples = IF(compacted = 1, COMPRESS(CONCAT(UNCOMPRESS(samples), VALUES(samples))), CONCAT(samples, VALUES(samples))),"
+           " sample_count = sample_count + VALUES(sample_count)";
+    return sql;
+}
+
+static const char* const kCreateBucketsTableSql =
+    "CREATE TABLE IF NOT EXISTS device_data.data_buckets ("
+    " device_id VARCHAR(128) NOT NULL,"
+    " bucket_start BIGINT NOT NULL,"
+    " sample_count INT UNSIGNED NOT NULL DEFAULT 0,"
+    " compacted TINYINT NOT NULL DEFAULT 0,"
+    " samples MEDIUMBLOB NOT NULL,"
+    " PRIMARY KEY (device_id, bucket_start),"
+    " INDEX idx_compacted (compacted, bucket_start)"
+    ") ENGINE=InnoDB DEFAULT CHARSET=utf8mb4 COLLATE=utf8mb4_unicode_ci"
+    " PARTITION BY RANGE (bucket_start) (PARTITION p_future VALUES LESS THAN MAXVALUE)";
+
+static const char* const kSamplesColumn = "IF(compacted = 1, UNCOMPRESS(samples), samples)";
+
+bool MySQLStore::enablePackedLayout(const PackedLayoutConfig& config) {
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
+    {
+        ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+        if (!guard) { LOG_ERROR("Failed to get connection"); return false; }
+        if (!guard->execute(kCreateBucketsTableSql)) {
+            LOG_ERROR("Failed to create data_buckets table: " + guard->getLastError());
+            return false;
+        }
+    }
+    layout_ = config;
+    layout_.bucketSpan = std::max(1LL, layout_.bucketSpan);
+    layout_.partitionSpan = std::max(0LL, layout_.partitionSpan);
+    layout_.unitsPerSecond = std::max(1LL, layout_.unitsPerSecond);
+    packed_ = true;
+    layoutStopping_ = false;
+    layoutThread_ = std::thread(&MySQLStore::layoutLoop, this);
+    LOG_INFO("MySQLStore using packed data_buckets layout, bucket span " + std::to_string(layout_.bucketSpan));
+    return true;
+}
+
+bool MySQLStore::appendPacked(MySQLConnection& conn, InternId deviceId, const DataPoint* points, std::size_t count) {
+    std::string escapedId = conn.escapeString(std::string(InternTable::getInstance().name(deviceId)));
+    std::string sql = packedInsertSql(escapedId, groupIntoBuckets(points, count, layout_.bucketSpan),
+                                      [&conn](const std::string& in, std::string& out) { out += conn.escapeString(in); });
+    if (!conn.execute(sql)) {
+        LOG_ERROR("Failed to insert packed data points: " + conn.getLastError());
+        return false;
+    }
+    return true;
+}
+
+std::vector<DataPoint> MySQLStore::queryLatestPacked(MySQLConnection& conn, InternId deviceId, std::size_t limit) const {
+    std::vector<DataPoint> points;
+    if (limit == 0) return points;
+    std::string escapedId = conn.escapeString(std::string(InternTable::getInstance().name(deviceId)));
+
+    // 先按样本数从最新的桶往前累计，只解码覆盖 limit 所需的桶
+    std::string sql = "SELECT bucket_start, sample_count FROM device_data.data_buckets WHERE device_id = '" +
+                      escapedId + "' ORDER BY bucket_start DESC LIMIT " + std::to_string(limit);
+    MYSQL_RES* res = conn.query(sql);
+    if (!res) return points;
+    long long oldest = 0;
+    std::size_t covered = 0;
+    MYSQL_ROW row;
+    while (covered < limit && (row = mysql_fetch_row(res)) != nullptr) {
+        oldest = row[0] ? std::stoll(row[0]) : 0;
+        covered += row[1] ? std::stoul(row[1]) : 0;
+    }
+    mysql_free_result(res);
+    if (covered == 0) return points;
+
+    sql = std::string("SELECT bucket_start, ") + kSamplesColumn + " FROM device_data.data_buckets WHERE device_id = '" +
+          escapedId + "' AND bucket_start >= " + std::to_string(oldest);
+    res = conn.query(sql);
+    if (!res) return points;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        long long start = row[0] ? std::stoll(row[0]) : 0;
+        if (!row[1] || !BucketCodec::decode(std::string_view(row[1], lengths[1]), start, points)) {
+            LOG_WARNING("Corrupt data bucket at " + std::to_string(start));
+        }
+    }
+    mysql_free_result(res);
+
+    // 按接口约定以时间正序返回最新的 limit 个
+    std::stable_sort(points.begin(), points.end(),
+                     [](const DataPoint& a, const DataPoint& b) { return a.timestamp < b.timestamp; });
+    if (points.size() > limit) points.erase(points.begin(), points.end() - static_cast<std::ptrdiff_t>(limit));
+    return points;
+}
+
+void MySQLStore::layoutLoop() {
+    std::unique_lock<std::mutex> lock(layoutMutex_);
+    while (!layoutStopping_) {
+        lock.unlock();
+        {
+            ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+            if (guard) {
+                if (layout_.partitionSpan > 0) maintainPartitions(*guard.get());
+                while (!layoutStopping_ && compactBuckets(*guard.get()) == kCompactBatch) {}
+            }
+        }
+        lock.lock();
+        layoutCv_.wait_for(lock, std::chrono::seconds(kLayoutIntervalSec), [this] { return layoutStopping_.load(); });
+    }
+}
+
+int MySQLStore::compactBuckets(MySQLConnection& conn) {
+    // 桶结束 compactDelaySec 之后才整理，之后迟到的样本仍可追加
+    long long now = static_cast<long long>(std::time(nullptr)) * layout_.unitsPerSecond;
+    long long sealedBefore = now - layout_.bucketSpan - layout_.compactDelaySec * layout_.unitsPerSecond;
+    std::string sql = std::string("SELECT device_id, bucket_start, sample_count, ") + kSamplesColumn +
+                      " FROM device_data.data_buckets WHERE compacted = 0 AND bucket_start < " +
+                      std::to_string(sealedBefore) + " LIMIT " + std::to_string(kCompactBatch);
+    MYSQL_RES* res = conn.query(sql);
+    if (!res) return 0;
+
+    std::vector<std::pair<std::string, bool>> updates;  // UPDATE 语句，是否为整理（否则为标记损坏）
+    MYSQL_ROW row;
+    std::vector<DataPoint> points;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        if (!row[0] || !row[1] || !row[2]) continue;
+        std::string deviceId(row[0], lengths[0]);
+        long long start = std::stoll(row[1]);
+        std::string where = " WHERE device_id = '" + conn.escapeString(deviceId) +
+                            "' AND bucket_start = " + std::to_string(start);
+        points.clear();
+        if (!row[3] || !BucketCodec::decode(std::string_view(row[3], lengths[3]), start, points)) {
+            // 标记后不再被选中，否则每轮都会选出同一批坏桶，排在其后的桶永远整理不到
+            LOG_WARNING("Marking corrupt data bucket " + deviceId + "@" + std::to_string(start));
+            updates.emplace_back("UPDATE device_data.data_buckets SET compacted = " + std::to_string(kBucketCorrupt) +
+                                 where + " AND compacted = 0", false);
+            continue;
+        }
+        std::stable_sort(points.begin(), points.end(),
+                         [](const DataPoint& a, const DataPoint& b) { return a.timestamp < b.timestamp; });
+        std::string block;
+        BucketCodec::encodeBlock(block, start, points);
+        // sample_count 不变才写回：读取之后追加的样本不会被覆盖
+        updates.emplace_back("UPDATE device_data.data_buckets SET samples = COMPRESS(_binary'" +
+                             conn.escapeString(block) + "'), compacted = " + std::to_string(kBucketCompacted) + where +
+                             " AND sample_count = " + std::string(row[2], lengths[2]) + " AND compacted = 0", true);
+    }
+    mysql_free_result(res);
+
+    // 只统计实际更新的行：未能处理的桶留到下一周期，调用方据此判断是否继续，不会原地空转
+    int done = 0;
+    for (const auto& [update, compact] : updates) {
+        if (layoutStopping_) break;
+        if (!conn.execute(update)) {
+            LOG_WARNING("Failed to compact data bucket: " + conn.getLastError());
+            continue;
+        }
+        if (conn.getAffectedRows() == 0) continue;
+        ++done;
+        if (compact) compacted_.inc();
+    }
+    return done;
+}
+
+void MySQLStore::maintainPartitions(MySQLConnection& conn) {
+    MYSQL_RES* res = conn.query(
+        "SELECT PARTITION_NAME, PARTITION_DESCRIPTION FROM information_schema.PARTITIONS"
+        " WHERE TABLE_SCHEMA = 'device_data' AND TABLE_NAME = 'data_buckets'");
+    if (!res) return;
+    bool partitioned = false;
+    bool hasFuture = false;
+    std::vector<std::pair<std::string, long long>> bounded;  // (分区名, 上界)
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        if (!row[0]) continue;  // 未分区的表只有一行且分区名为 NULL
+        partitioned = true;
+        std::string name = row[0];
+        if (!row[1] || std::strcmp(row[1], "MAXVALUE") == 0) {
+            hasFuture = name == "p_future";
+            continue;
+        }
+        bounded.emplace_back(name, std::stoll(row[1]));
+    }
+    mysql_free_result(res);
+
+    if (!partitioned) {
+        // 旧版脚本建的表：改为只有 p_future 的分区表，之后按周期拆分
+        LOG_INFO("Partitioning data_buckets by bucket_start");
+        if (!conn.execute("ALTER TABLE device_data.data_buckets PARTITION BY RANGE (bucket_start)"
+                          " (PARTITION p_future VALUES LESS THAN MAXVALUE)")) {
+            LOG_ERROR("Failed to partition data_buckets: " + conn.getLastError());
+            return;
+        }
+        hasFuture = true;
+    }
+    if (!hasFuture) {
+        LOG_WARNING("data_buckets has no p_future partition, skipping partition management");
+        return;
+    }
+
+    long long span = layout_.partitionSpan;
+    long long now = static_cast<long long>(std::time(nullptr)) * layout_.unitsPerSecond;
+    long long current = BucketCodec::bucketStart(now, span);
+    long long highest = current;
+    for (const auto& entry : bounded) highest = std::max(highest, entry.second);
+
+    // 从 p_future 拆出直到 current + (ahead + 1) * span 的分区，分区名为其上界
+    long long target = current + (static_cast<long long>(std::max(0, layout_.aheadPartitions)) + 1) * span;
+    long long next = bounded.empty() ? current + span : highest + span;
+    if (!bounded.empty() && highest < current) next = current + span;
+    std::string parts;
+    int added = 0;
+    for (; next <= target; next += span, ++added) {
+        parts += "PARTITION p" + std::to_string(next) + " VALUES LESS THAN (" + std::to_string(next) + "), ";
+    }
+    if (added > 0) {
+        std::string sql = "ALTER TABLE device_data.data_buckets REORGANIZE PARTITION p_future INTO (" + parts +
+                          "PARTITION p_future VALUES LESS THAN MAXVALUE)";
+        if (conn.execute(sql)) {
+            partitionsAdded_.inc(static_cast<uint64_t>(added));
+            LOG_INFO("Added " + std::to_string(added) + " data_buckets partitions");
+        } else {
+            LOG_ERROR("Failed to add data_buckets partitions: " + conn.getLastError());
+        }
+    }
+
+    if (layout_.retainPartitions <= 0) return;
+    long long cutoff = current - static_cast<long long>(layout_.retainPartitions) * span;
+    std::string drop;
+    int dropped = 0;
+    for (const auto& [name, bound] : bounded) {
+        if (bound > cutoff) continue;
+        if (!drop.empty()) drop += ", ";
+        drop += name;
+        ++dropped;
+    }
+    if (dropped == 0) return;
+    if (conn.execute("ALTER TABLE device_data.data_buckets DROP PARTITION " + drop)) {
+        partitionsDropped_.inc(static_cast<uint64_t>(dropped));
+        LOG_INFO("Dropped expired data_buckets partitions: " + drop);
+    } else {
+        LOG_ERROR("Failed to drop data_buckets partitions: " + conn.getLastError());
+    }
+}
+
+void MySQLStore::append(InternId deviceId, const DataPoint& point) {
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return; }
+    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    if (!guard) { LOG_ERROR("Failed to get connection"); return; }
+
+    if (packed_) {
+        if (appendPacked(*guard.get(), deviceId, &point, 1)) {
+            noteWrite(false);
+            bumpDataVersion();
+        }
+        return;
+    }
+    std::string sql = insertPointSql(guard->escapeString(std::string(InternTable::getInstance().name(deviceId))),
+                                     point.timestamp, guard->escapeString(metricsToJson(point.metrics)));
+    if (!guard->execute(sql)) {
+        LOG_ERROR("Failed to insert data point");
+        return;
+    }
+    noteWrite(false);
+    bumpDataVersion();
+}
+
+bool MySQLStore::appendBatch(InternId deviceId, const std::vector<DataPoint>& points) {
+    if (points.empty()) return true;
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
+    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    if (!guard) { LOG_ERROR("Failed to get connection"); return false; }
+
+    if (packed_) {
+        if (!appendPacked(*guard.get(), deviceId, points.data(), points.size())) return false;
+        noteWrite(false);
+        bumpDataVersion();
+        return true;
+    }
+    std::string escapedId = guard->escapeString(std::string(InternTable::getInstance().name(deviceId)));
+    for (std::size_t start = 0; start < points.size(); start += kInsertChunkRows) {
+        std::size_t end = std::min(points.size(), start + kInsertChunkRows);
+        std::ostringstream sql;
+        sql << "INSERT INTO device_data.data_points (device_id, timestamp, metrics) VALUES ";
+        for (std::size_t i = start; i < end; ++i) {
+            if (i > start) sql << ", ";
+            sql << "('" << escapedId << "', " << points[i].timestamp << ", '"
+                << guard->escapeString(metricsToJson(points[i].metrics)) << "')";
+        }
+        if (!guard->execute(sql.str())) {
+            LOG_ERROR("Failed to insert data point batch: " + guard->getLastError());
+            return false;
+        }
+        noteWrite(false);
+        bumpDataVersion();
+    }
+    return true;
+}
+
+std::vector<DataPoint> MySQLStore::queryLatest(InternId deviceId, std::size_t limit) const {
+    std::vector<DataPoint> points;
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return points; }
+    ConnectionGuard guard(readConnection(false));
+    if (!guard) return points;
+
+    if (packed_) return queryLatestPacked(*guard.get(), deviceId, limit);
+    MYSQL_RES* res = guard->query(queryLatestSql(
+        guard->escapeString(std::string(InternTable::getInstance().name(deviceId))), limit));
+    if (!res) return points;
+    points = readDataPoints(res);
+    mysql_free_result(res);
+    return points;
+}
+
 void MySQLStore::appendRequirement(const Requirement& req) {
     if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return; }
     ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
@@ -55,7 +713,12 @@ void MySQLStore::appendRequirement(const Requirement& req) {
     }
     sql << ")";
 
-    if (!guard->execute(sql.str())) LOG_ERROR("Failed to insert requirement");
+    if (!guard->execute(sql.str())) {
+        LOG_ERROR("Failed to insert requirement");
+        return;
+    }
+    noteWrite(true);
+    bumpRequirementVersion();
 }
 
 RequirementQueryResult MySQLStore::queryRequirements(int page, int limit,
@@ -63,71 +726,30 @@ RequirementQueryResult MySQLStore::queryRequirements(int page, int limit,
     RequirementQueryResult result;
     result.page = page;
     result.limit = limit;
+    result.ok = false;
 
     if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return result; }
-    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    ConnectionGuard guard(readConnection(true));
     if (!guard) return result;
 
-    std::ostringstream whereClause;
-    bool hasWhere = false;
-    if (willingToPay >= 0) {
-        if (hasWhere) whereClause << " AND ";
-        if (willingToPay == 2) {
-            whereClause << "willing_to_pay IS NULL";
-        } else {
-            whereClause << "willing_to_pay = " << willingToPay;
-        }
-        hasWhere = true;
-    }
-    if (!keyword.empty()) {
-        if (hasWhere) whereClause << " AND ";
-        std::string escapedKeyword = guard->escapeString(keyword);
-        whereClause << "(title LIKE '%" << escapedKeyword << "%' OR content LIKE '%" << escapedKeyword << "%')";
-        hasWhere = true;
-    }
-    std::string whereStr = hasWhere ? ("WHERE " + whereClause.str()) : "";
-
-    std::ostringstream countSql;
-    countSql << "SELECT COUNT(*) FROM requirements " << whereStr;
-    MYSQL_RES* countRes = guard->query(countSql.str());
-    if (countRes) {
-        MYSQL_ROW row = mysql_fetch_row(countRes);
-        if (row && row[0]) result.total = std::stoll(row[0]);
-        mysql_free_result(countRes);
-    }
-
-    int offset = (page - 1) * limit;
-    if (offset < 0) offset = 0;
+    std::string whereStr = requirementWhereClause(willingToPay, keyword.empty() ? keyword : guard->escapeString(keyword));
 
-    std::ostringstream dataSql;
-    dataSql << "SELECT id, title, content, willing_to_pay, contact, notes, created_at, updated_at ";
-    dataSql << "FROM requirements " << whereStr << " ";
-    dataSql << "ORDER BY created_at DESC LIMIT " << limit << " OFFSET " << offset;
+    MYSQL_RES* countRes = guard->query(requirementCountSql(whereStr));
+    if (!countRes) return result;
+    result.total = readCount(countRes);
+    mysql_free_result(countRes);
 
-    MYSQL_RES* res = guard->query(dataSql.str());
+    MYSQL_RES* res = guard->query(requirementDataSql(whereStr, page, limit));
     if (!res) return result;
-
-    MYSQL_ROW row;
-    while ((row = mysql_fetch_row(res)) != nullptr) {
-        unsigned long* lengths = mysql_fetch_lengths(res);
-        Requirement r;
-        r.id = row[0] ? std::stoll(row[0]) : 0;
-        r.title = row[1] && lengths[1] > 0 ? std::string(row[1], lengths[1]) : "";
-        r.content = row[2] && lengths[2] > 0 ? std::string(row[2], lengths[2]) : "";
-        r.willing_to_pay = row[3] ? std::stoi(row[3]) : -1;
-        r.contact = row[4] && lengths[4] > 0 ? std::string(row[4], lengths[4]) : "";
-        r.notes = row[5] && lengths[5] > 0 ? std::string(row[5], lengths[5]) : "";
-        r.created_at = row[6] && lengths[6] > 0 ? std::string(row[6], lengths[6]) : "";
-        r.updated_at = row[7] && lengths[7] > 0 ? std::string(row[7], lengths[7]) : "";
-        result.data.push_back(r);
-    }
+    readRequirements(res, result.data);
     mysql_free_result(res);
+    result.ok = true;
     return result;
 }
 
 bool MySQLStore::deviceExists(const std::string& deviceId) const {
     if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
-    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    ConnectionGuard guard(readConnection(false));
     if (!guard) return false;
 
     std::string escapedId = guard->escapeString(deviceId);
@@ -148,5 +770,134 @@ void MySQLStore::ensureDeviceRegistered(const std::string& deviceId) {
     std::string escapedId = guard->escapeString(deviceId);
     std::ostringstream sql;
     sql << "INSERT IGNORE INTO device_data.devices (device_id) VALUES ('" << escapedId << "')";
-    if (!guard->execute(sql.str())) LOG_ERROR("Failed to ensure device registered");
+    if (!guard->execute(sql.str())) {
+        LOG_ERROR("Failed to ensure device registered");
+        return;
+    }
+    noteWrite(false);
 }
+
+bool MySQLStore::registerDevices(const std::vector<std::string>& deviceIds) {
+    if (deviceIds.empty()) return true;
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
+    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    if (!guard) { LOG_ERROR("Failed to get connection"); return false; }
+
+    std::ostringstream sql;
+    sql << "INSERT IGNORE INTO device_data.devices (device_id) VALUES ";
+    for (std::size_t i = 0; i < deviceIds.size(); ++i) {
+        if (i > 0) sql << ", ";
+        sql << "('" << guard->escapeString(deviceIds[i]) << "')";
+    }
+    if (!guard->execute(sql.str())) {
+        LOG_ERROR("Failed to register devices: " + guard->getLastError());
+        return false;
+    }
+    noteWrite(false);
+    return true;
+}
+
+bool MySQLStore::loadDeviceIds(std::vector<std::string>& deviceIds) const {
+    if (!initialized_) { LOG_ERROR("MySQLStore not initialized"); return false; }
+    ConnectionGuard guard(ConnectionPool::getInstance().getConnection());
+    if (!guard) return false;
+
+    MYSQL_RES* res = guard->query("SELECT device_id FROM device_data.devices");
+    if (!res) return false;
+    deviceIds.reserve(deviceIds.size() + static_cast<std::size_t>(mysql_num_rows(res)));
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(res)) != nullptr) {
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        if (row[0]) deviceIds.emplace_back(row[0], lengths[0]);
+    }
+    mysql_free_result(res);
+    return true;
+}
+
+bool MySQLStore::enableAsync(const MySQLConfig& config, int connections) {
+#ifdef HAVE_MYSQL_NONBLOCKING
+    auto client = std::make_unique<AsyncMySQLClient>();
+    if (!client->start(config, connections)) return false;
+    async_ = std::move(client);
+    return true;
+#else
+    (void)config;
+    (void)connections;
+    LOG_INFO("MySQL client library has no non-blocking API, store calls stay on the connection pool");
+    return false;
+#endif
+}
+
+#ifdef HAVE_MYSQL_NONBLOCKING
+
+void MySQLStore::appendAsync(InternId deviceId, DataPoint point, std::function<void()> done) {
+    // 回调在 I/O 线程执行，会话需在提交前取出
+    std::string session(replicas_.empty() ? std::string_view() : SessionScope::current());
+    std::string escapedId;
+    AsyncMySQLClient::escape(InternTable::getInstance().name(deviceId), escapedId);
+    std::string sql;
+    if (packed_) {
+        sql = packedInsertSql(escapedId, groupIntoBuckets(&point, 1, layout_.bucketSpan),
+                              [](const std::string& in, std::string& out) { AsyncMySQLClient::escape(in, out); });
+    } else {
+        std::string escapedMetrics;
+        AsyncMySQLClient::escape(metricsToJson(point.metrics), escapedMetrics);
+        sql = insertPointSql(escapedId, point.timestamp, escapedMetrics);
+    }
+    async_->submit(std::move(sql),
+                   [this, session = std::move(session), done = std::move(done)](MYSQL_RES*, const std::string& error) {
+                       if (error.empty()) {
+                           noteWrite(false, session);
+                           bumpDataVersion();
+                       } else {
+                           LOG_ERROR("Failed to insert data point");
+                       }
+                       done();
+                   });
+}
+
+void MySQLStore::queryLatestAsync(InternId deviceId, std::size_t limit,
+                                  std::function<void(std::vector<DataPoint>)> done) const {
+    // 非阻塞客户端只连主库；配置了副本时读取走连接池以便路由到副本。
+    // packed 布局的查询需要两次往返与解码，同样走同步路径
+    if (!replicas_.empty() || packed_) {
+        StoreInterface::queryLatestAsync(deviceId, limit, std::move(done));
+        return;
+    }
+    std::string escapedId;
+    AsyncMySQLClient::escape(InternTable::getInstance().name(deviceId), escapedId);
+    async_->submit(queryLatestSql(escapedId, limit),
+                   [done = std::move(done)](MYSQL_RES* res, const std::string&) {
+                       done(res ? readDataPoints(res) : std::vector<DataPoint>());
+                   });
+}
+
+void MySQLStore::queryRequirementsAsync(int page, int limit, int willingToPay, const std::string& keyword,
+                                        std::function<void(RequirementQueryResult)> done) const {
+    if (!replicas_.empty()) {
+        StoreInterface::queryRequirementsAsync(page, limit, willingToPay, keyword, std::move(done));
+        return;
+    }
+    std::string escapedKeyword;
+    AsyncMySQLClient::escape(keyword, escapedKeyword);
+    std::string whereStr = requirementWhereClause(willingToPay, escapedKeyword);
+    std::string dataSql = requirementDataSql(whereStr, page, limit);
+    AsyncMySQLClient* client = async_.get();
+    // 计数与分页数据两条语句依次执行，第二条在第一条的回调中提交
+    client->submit(requirementCountSql(whereStr),
+        [client, page, limit, dataSql = std::move(dataSql), done = std::move(done)](MYSQL_RES* countRes, const std::string&) mutable {
+            RequirementQueryResult result;
+            result.page = page;
+            result.limit = limit;
+            if (countRes) result.total = readCount(countRes);
+            result.ok = countRes != nullptr;
+            client->submit(std::move(dataSql),
+                [result = std::move(result), done = std::move(done)](MYSQL_RES* res, const std::string&) mutable {
+                    if (res) readRequirements(res, result.data);
+                    result.ok = result.ok && res != nullptr;
+                    done(std::move(result));
+                });
+        });
+}
+
+#endif
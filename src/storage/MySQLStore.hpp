@@ -2,8 +2,28 @@
 
 #include "StoreInterface.hpp"
 #include "ConnectionPool.hpp"
+#include "AsyncMySQLClient.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 按时间桶打包的数据点布局（data_buckets 表）
+ * 时间相关的参数与上报的 timestamp 同单位
+ */
+struct PackedLayoutConfig {
+    long long bucketSpan = 3600;       // 每行保存一个设备在该时长内的全部样本
+    long long partitionSpan = 604800;  // RANGE 分区跨度，0 表示不管理分区
+    int aheadPartitions = 2;           // 预建的未来分区数
+    int retainPartitions = 0;          // 当前分区之前保留的分区数，更早的分区被删除；0 表示不删除
+    long long unitsPerSecond = 1;      // timestamp 单位：1 为秒，1000 为毫秒
+    int compactDelaySec = 300;         // 桶结束后多久整理为列式压缩块
+};
 
 class MySQLStore : public StoreInterface {
 public:
@@ -11,15 +31,131 @@ public:
     ~MySQLStore() override;
     bool init(const MySQLConfig& config, const PoolConfig& poolConfig = PoolConfig());
     void shutdown();
+    void append(InternId deviceId, const DataPoint& point) override;
+    std::vector<DataPoint> queryLatest(InternId deviceId, std::size_t limit) const override;
+    /** 批量写入：多行 INSERT，每条语句最多 kInsertChunkRows 行 */
+    bool appendBatch(InternId deviceId, const std::vector<DataPoint>& points) override;
     void appendRequirement(const Requirement& req) override;
     RequirementQueryResult queryRequirements(int page, int limit,
         int willingToPay, const std::string& keyword) const override;
 
+    /**
+     * 启用非阻塞路径：上报写入与两类查询改由 AsyncMySQLClient 的 I/O 线程执行，
+     * 调用线程不等待数据库往返；客户端库不支持非阻塞接口时返回 false，保持同步路径
+     * @param connections 非阻塞连接数（与连接池相互独立）
+     */
+    bool enableAsync(const MySQLConfig& config, int connections);
+#ifdef HAVE_MYSQL_NONBLOCKING
+    bool supportsAsync() const override { return async_ != nullptr; }
+    void appendAsync(InternId deviceId, DataPoint point, std::function<void()> done) override;
+    void queryLatestAsync(InternId deviceId, std::size_t limit,
+                          std::function<void(std::vector<DataPoint>)> done) const override;
+    void queryRequirementsAsync(int page, int limit, int willingToPay, const std::string& keyword,
+                                std::function<void(RequirementQueryResult)> done) const override;
+#endif
+
+    /**
+     * 读写分离：添加只读副本（各自独立的连接池，须在 init 之后调用，连不上的副本被跳过）。
+     * 之后 queryLatest / queryRequirements / deviceExists 从未归还连接最少的健康副本读取，
+     * 写入与其余读取仍走主库。以下读取留在主库，避免读到复制延迟前的数据：
+     * 同一会话（SessionScope）写入后 maxLagMs 内的读取；任意需求写入后 maxLagMs 内的需求查询
+     * （其结果会进入响应缓存）。后台线程定期读取各副本的复制延迟（Seconds_Behind_Source，秒级），
+     * 延迟达到 maxLagMs、复制未运行或无法查询的副本暂停读取，上述窗口因此足以覆盖复制延迟
+     */
+    bool addReplicas(const std::vector<MySQLConfig>& replicas, const PoolConfig& poolConfig, int maxLagMs);
+
+    // 运行时调整主库与各副本连接池的上下限（配置热加载）
+    void resizePools(int minSize, int maxSize);
+
+    /**
+     * 改用 data_buckets 布局：主键 (device_id, bucket_start)，一行保存一个时间桶内的样本
+     * （BucketCodec 编码），写入只追加二进制记录，不在服务端解析 JSON。后台线程把已结束的桶
+     * 整理为列式块并用 COMPRESS 压缩，按 partitionSpan 预建 / 删除时间范围分区。
+     * 须在 init 之后调用；表不存在时自动创建，data_points 中的历史数据不迁移
+     */
+    bool enablePackedLayout(const PackedLayoutConfig& config);
+
     /** 检查设备是否已注册 */
     bool deviceExists(const std::string& deviceId) const;
     /** 确保设备已注册（不存在则插入） */
     void ensureDeviceRegistered(const std::string& deviceId);
+    /** 批量注册设备：单条多行 INSERT IGNORE，成功返回 true */
+    bool registerDevices(const std::vector<std::string>& deviceIds);
+    /** 读取全部已注册设备 ID（启动时预热内存设备表） */
+    bool loadDeviceIds(std::vector<std::string>& deviceIds) const;
 
 private:
+    static constexpr std::size_t kInsertChunkRows = 1000;
+    // 副本取连接的等待上限，超时改走主库
+    static constexpr int kReplicaAcquireTimeoutMs = 200;
+    // 会话写入记录的条数上限，超过时清理已过期的记录
+    static constexpr std::size_t kMaxTrackedSessions = 10000;
+    // 副本复制延迟的检查周期；延迟只精确到秒，读己之写窗口至少为检查周期加 1 秒
+    static constexpr int kReplicaLagCheckMs = 1000;
+    static constexpr int kMinReadAfterWriteMs = kReplicaLagCheckMs + 1000;
+
+    // 整理的一批桶数上限，以及整理与分区维护的周期
+    static constexpr int kCompactBatch = 200;
+    static constexpr int kLayoutIntervalSec = 60;
+
+    // packed 布局的读写
+    bool appendPacked(MySQLConnection& conn, InternId deviceId, const DataPoint* points, std::size_t count);
+    std::vector<DataPoint> queryLatestPacked(MySQLConnection& conn, InternId deviceId, std::size_t limit) const;
+    void layoutLoop();
+    // 把已结束且未整理的桶编码为列式块（无法解码的桶标记为损坏），返回实际更新的桶数
+    int compactBuckets(MySQLConnection& conn);
+    void maintainPartitions(MySQLConnection& conn);
+
+    // 读连接：选中的副本或主库；requirement 表示需求查询
+    ConnectionGuard readConnection(bool requirement) const;
+    bool mustReadPrimary(bool requirement) const;
+    // 写入成功后记录会话与需求写入时间，供 mustReadPrimary 判断
+    void noteWrite(bool requirement, std::string_view session = SessionScope::current());
+    // 定期检查副本复制延迟
+    void replicaLagLoop();
+    void checkReplicaLag();
+    /**
+     * 写入后窗口内从副本读到的可能是旧数据，却带着写入后的版本号（进入缓存或生成 ETag）；
+     * 窗口过去后再递增一次版本号，使这些结果失效（由检查线程调用）
+     */
+    void expireStaleVersions();
+
+    struct Replica {
+        ConnectionPool* pool;
+        std::atomic<bool> lagging{false};  // 延迟超限或无法确认，暂不参与读取
+    };
+
     bool initialized_;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    std::chrono::steady_clock::duration maxLag_{};        // 副本延迟达到该值即暂停读取
+    std::chrono::steady_clock::duration readAfterWrite_{}; // 写入后读主库的窗口，不小于 kMinReadAfterWriteMs
+    std::atomic<std::chrono::steady_clock::rep> lastRequirementWrite_{0};
+    std::atomic<std::chrono::steady_clock::rep> lastDataWrite_{0};
+    // 已为之补递增过版本号的写入时间（仅检查线程访问）
+    std::chrono::steady_clock::rep expiredRequirementWrite_ = 0;
+    std::chrono::steady_clock::rep expiredDataWrite_ = 0;
+    mutable std::atomic<unsigned> nextReplica_{0};  // 负载相同时轮转
+    mutable std::mutex sessionMutex_;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> sessionWrites_;
+    Counter& replicaReads_;
+    Counter& primaryReads_;
+    Counter& stickyReads_;
+    std::thread replicaThread_;
+    std::mutex replicaMutex_;
+    std::condition_variable replicaCv_;
+    bool replicaStopping_ = false;
+    bool legacyReplicaStatus_ = false;  // 服务端不支持 SHOW REPLICA STATUS，改用旧语句（仅检查线程访问）
+
+    bool packed_ = false;
+    PackedLayoutConfig layout_;
+    std::thread layoutThread_;
+    std::mutex layoutMutex_;
+    std::condition_variable layoutCv_;
+    std::atomic<bool> layoutStopping_{false};
+    Counter& compacted_;
+    Counter& partitionsAdded_;
+    Counter& partitionsDropped_;
+#ifdef HAVE_MYSQL_NONBLOCKING
+    std::unique_ptr<AsyncMySQLClient> async_;
+#endif
 };
@@ -0,0 +1,295 @@
+#include "SnapshotImage.hpp"
+#include "BinaryCodec.hpp"
+#include "utils/Logger.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+static_assert(sizeof(SnapshotImage::Header) == 112, "Header layout changed");
+static_assert(sizeof(SnapshotImage::DeviceEntry) == 24, "DeviceEntry layout changed");
+static_assert(sizeof(SnapshotImage::PointEntry) == 24, "PointEntry layout changed");
+static_assert(sizeof(SnapshotImage::MetricEntry) == 16, "MetricEntry layout changed");
+static_assert(sizeof(SnapshotImage::RequirementEntry) == 64, "RequirementEntry layout changed");
+static_assert(std::is_trivially_copyable<SnapshotImage::RequirementEntry>::value, "entries must be POD");
+
+static bool isLittleEndian() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+static std::size_t align8(std::size_t n) { return (n + 7) & ~static_cast<std::size_t>(7); }
+
+static uint32_t headerCrc(const SnapshotImage::Header& h) {
+    return crc32(&h, offsetof(SnapshotImage::Header, headerCrc));
+}
+
+// [first, first + count) 落在 [0, total) 内（避免 first + count 溢出）
+static bool rangeOk(uint64_t first, uint64_t count, uint64_t total) {
+    return count <= total && first <= total - count;
+}
+
+// 逐条校验条目中的下标与字符串引用，之后访问无需边界检查
+static bool entriesOk(const SnapshotImage& image, const SnapshotImage::Header& h,
+                      const SnapshotImage::DeviceEntry* devices, const SnapshotImage::PointEntry* points,
+                      const SnapshotImage::MetricEntry* metrics) {
+    auto strOk = [&h](const SnapshotImage::StringRef& ref) { return rangeOk(ref.offset, ref.length, h.stringSize); };
+    for (uint64_t i = 0; i < h.deviceCount; ++i) {
+        if (!strOk(devices[i].id) || !rangeOk(devices[i].firstPoint, devices[i].pointCount, h.pointCount)) return false;
+    }
+    for (uint64_t i = 0; i < h.pointCount; ++i) {
+        if (!rangeOk(points[i].firstMetric, points[i].metricCount, h.metricCount)) return false;
+    }
+    for (uint64_t i = 0; i < h.metricCount; ++i) {
+        if (!strOk(metrics[i].name)) return false;
+    }
+    for (std::size_t i = 0; i < image.requirementCount(); ++i) {
+        const SnapshotImage::RequirementEntry& e = image.requirementEntry(i);
+        if (!strOk(e.title) || !strOk(e.content) || !strOk(e.contact) || !strOk(e.notes) ||
+            !strOk(e.createdAt) || !strOk(e.updatedAt)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SnapshotImage::~SnapshotImage() {
+    if (base_) ::munmap(base_, size_);
+}
+
+std::unique_ptr<SnapshotImage> SnapshotImage::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        LOG_ERROR("Snapshot image too small: " + path);
+        return nullptr;
+    }
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    void* base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR("Failed to mmap snapshot image " + path + ": " + std::string(strerror(errno)));
+        return nullptr;
+    }
+
+    std::unique_ptr<SnapshotImage> image(new SnapshotImage());
+    image->base_ = base;
+    image->size_ = size;
+    const char* p = static_cast<const char*>(base);
+    const Header* h = reinterpret_cast<const Header*>(p);
+
+    auto sectionOk = [size](uint64_t offset, uint64_t count, std::size_t elemSize) {
+        return offset % 8 == 0 && offset <= size &&
+               count <= (size - offset) / elemSize;
+    };
+    if (!isLittleEndian() || h->magic != kMagic || h->version != kVersion ||
+        h->headerCrc != headerCrc(*h) || h->fileSize != size ||
+        !sectionOk(h->deviceOffset, h->deviceCount, sizeof(DeviceEntry)) ||
+        !sectionOk(h->pointOffset, h->pointCount, sizeof(PointEntry)) ||
+        !sectionOk(h->metricOffset, h->metricCount, sizeof(MetricEntry)) ||
+        !sectionOk(h->requirementOffset, h->requirementCount, sizeof(RequirementEntry)) ||
+        !sectionOk(h->stringOffset, h->stringSize, 1)) {
+        LOG_ERROR("Invalid snapshot image: " + path);
+        return nullptr;
+    }
+
+    image->header_ = h;
+    image->devices_ = reinterpret_cast<const DeviceEntry*>(p + h->deviceOffset);
+    image->points_ = reinterpret_cast<const PointEntry*>(p + h->pointOffset);
+    image->metrics_ = reinterpret_cast<const MetricEntry*>(p + h->metricOffset);
+    image->requirements_ = reinterpret_cast<const RequirementEntry*>(p + h->requirementOffset);
+    image->strings_ = p + h->stringOffset;
+    if (!entriesOk(*image, *h, image->devices_, image->points_, image->metrics_)) {
+        LOG_ERROR("Snapshot image has out-of-range entries: " + path);
+        return nullptr;
+    }
+    // 查询按设备随机访问
+    ::madvise(base, size, MADV_RANDOM);
+    return image;
+}
+
+std::size_t SnapshotImage::findDevice(std::string_view deviceId) const {
+    const DeviceEntry* begin = devices_;
+    const DeviceEntry* end = devices_ + deviceCount();
+    const DeviceEntry* it = std::lower_bound(begin, end, deviceId,
+        [this](const DeviceEntry& e, std::string_view id) { return str(e.id) < id; });
+    if (it == end || str(it->id) != deviceId) return npos;
+    return static_cast<std::size_t>(it - begin);
+}
+
+DataPoint SnapshotImage::point(std::size_t dev, std::size_t i) const {
+    const PointEntry& pe = points_[devices_[dev].firstPoint + i];
+    DataPoint point;
+    point.timestamp = pe.timestamp;
+    point.metrics.reserve(static_cast<std::size_t>(pe.metricCount));
+    InternTable& names = InternTable::getInstance();
+    for (uint64_t m = 0; m < pe.metricCount; ++m) {
+        const MetricEntry& me = metrics_[pe.firstMetric + m];
+        point.metrics.push_back(Metric{names.intern(str(me.name)), me.value});
+    }
+    return point;
+}
+
+Requirement SnapshotImage::requirement(std::size_t i) const {
+    const RequirementEntry& e = requirements_[i];
+    Requirement r;
+    r.id = e.id;
+    r.willing_to_pay = static_cast<int>(e.willingToPay);
+    r.title = std::string(str(e.title));
+    r.content = std::string(str(e.content));
+    r.contact = std::string(str(e.contact));
+    r.notes = std::string(str(e.notes));
+    r.created_at = std::string(str(e.createdAt));
+    r.updated_at = std::string(str(e.updatedAt));
+    return r;
+}
+
+SnapshotImage::StringRef SnapshotImageBuilder::addString(std::string_view s) {
+    SnapshotImage::StringRef ref{static_cast<uint32_t>(strings_.size()), static_cast<uint32_t>(s.size())};
+    strings_.append(s.data(), s.size());
+    return ref;
+}
+
+SnapshotImage::StringRef SnapshotImageBuilder::intern(std::string_view s) {
+    auto it = interned_.find(std::string(s));
+    if (it != interned_.end()) return it->second;
+    SnapshotImage::StringRef ref = addString(s);
+    interned_.emplace(std::string(s), ref);
+    return ref;
+}
+
+void SnapshotImageBuilder::beginDevice(std::string_view deviceId) {
+    SnapshotImage::DeviceEntry e{};
+    e.id = intern(deviceId);
+    e.firstPoint = points_.size();
+    e.pointCount = 0;
+    devices_.push_back(e);
+}
+
+SnapshotImage::StringRef SnapshotImageBuilder::intern(InternId id) {
+    auto it = internedIds_.find(id);
+    if (it != internedIds_.end()) return it->second;
+    SnapshotImage::StringRef ref = intern(InternTable::getInstance().name(id));
+    internedIds_.emplace(id, ref);
+    return ref;
+}
+
+void SnapshotImageBuilder::addPoint(const DataPoint& point) {
+    SnapshotImage::PointEntry pe{point.timestamp, metrics_.size(), point.metrics.size()};
+    for (const Metric& metric : point.metrics) {
+        metrics_.push_back(SnapshotImage::MetricEntry{intern(metric.name), metric.value});
+    }
+    points_.push_back(pe);
+    ++devices_.back().pointCount;
+}
+
+void SnapshotImageBuilder::addPoint(const SnapshotImage& image, std::size_t dev, std::size_t i) {
+    // 直接复制条目，指标名在新镜像中重新去重，不经过 DataPoint 物化
+    const SnapshotImage::PointEntry& src = image.points_[image.devices_[dev].firstPoint + i];
+    SnapshotImage::PointEntry pe{src.timestamp, metrics_.size(), src.metricCount};
+    for (uint64_t m = 0; m < src.metricCount; ++m) {
+        const SnapshotImage::MetricEntry& me = image.metrics_[src.firstMetric + m];
+        metrics_.push_back(SnapshotImage::MetricEntry{intern(image.str(me.name)), me.value});
+    }
+    points_.push_back(pe);
+    ++devices_.back().pointCount;
+}
+
+void SnapshotImageBuilder::addRequirement(const Requirement& req) {
+    SnapshotImage::RequirementEntry e{};
+    e.id = req.id;
+    e.willingToPay = req.willing_to_pay;
+    e.title = addString(req.title);
+    e.content = addString(req.content);
+    e.contact = addString(req.contact);
+    e.notes = addString(req.notes);
+    e.createdAt = addString(req.created_at);
+    e.updatedAt = addString(req.updated_at);
+    requirements_.push_back(e);
+}
+
+void SnapshotImageBuilder::addRequirement(const SnapshotImage& image, std::size_t i) {
+    addRequirement(image.requirement(i));
+}
+
+bool SnapshotImageBuilder::writeTo(const std::string& path, uint64_t walSegment) {
+    if (strings_.size() > std::numeric_limits<uint32_t>::max()) {
+        LOG_ERROR("Snapshot image string area exceeds 4 GiB");
+        return false;
+    }
+
+    SnapshotImage::Header h{};
+    h.magic = SnapshotImage::kMagic;
+    h.version = SnapshotImage::kVersion;
+    h.walSegment = walSegment;
+    std::size_t offset = align8(sizeof(h));
+    h.deviceOffset = offset;
+    h.deviceCount = devices_.size();
+    offset = align8(offset + devices_.size() * sizeof(SnapshotImage::DeviceEntry));
+    h.pointOffset = offset;
+    h.pointCount = points_.size();
+    offset = align8(offset + points_.size() * sizeof(SnapshotImage::PointEntry));
+    h.metricOffset = offset;
+    h.metricCount = metrics_.size();
+    offset = align8(offset + metrics_.size() * sizeof(SnapshotImage::MetricEntry));
+    h.requirementOffset = offset;
+    h.requirementCount = requirements_.size();
+    offset = align8(offset + requirements_.size() * sizeof(SnapshotImage::RequirementEntry));
+    h.stringOffset = offset;
+    h.stringSize = strings_.size();
+    h.fileSize = offset + strings_.size();
+    h.headerCrc = headerCrc(h);
+
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = true;
+    auto put = [&](const void* data, std::size_t len, uint64_t at) {
+        const char* p = static_cast<const char*>(data);
+        while (ok && len > 0) {
+            ssize_t n = ::pwrite(fd, p, len, static_cast<off_t>(at));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok = false;
+                break;
+            }
+            p += n;
+            at += static_cast<uint64_t>(n);
+            len -= static_cast<std::size_t>(n);
+        }
+    };
+    ok = ::ftruncate(fd, static_cast<off_t>(h.fileSize)) == 0;  // 对齐填充位置保持为 0
+    put(&h, sizeof(h), 0);
+    put(devices_.data(), devices_.size() * sizeof(SnapshotImage::DeviceEntry), h.deviceOffset);
+    put(points_.data(), points_.size() * sizeof(SnapshotImage::PointEntry), h.pointOffset);
+    put(metrics_.data(), metrics_.size() * sizeof(SnapshotImage::MetricEntry), h.metricOffset);
+    put(requirements_.data(), requirements_.size() * sizeof(SnapshotImage::RequirementEntry), h.requirementOffset);
+    put(strings_.data(), strings_.size(), h.stringOffset);
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+
+    std::size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
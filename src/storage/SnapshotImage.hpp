@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "StoreInterface.hpp"
+
+/**
+ * MemoryStore 的磁盘镜像（只读 mmap 直接提供查询）
+ *
+ * 文件布局（全部小端、8 字节对齐，所有偏移相对文件起始，与加载地址无关）：
+ *   Header | DeviceEntry[] (按 device_id 排序) | PointEntry[] | MetricEntry[] | RequirementEntry[] | 字符串区
+ * 字符串区对设备 ID 与指标名去重。打开时校验头部、各段边界以及每个条目的下标与字符串引用，
+ * 不物化数据点与字符串。镜像通过 tmp + fsync + rename 原子替换，不会出现半写文件
+ */
+class SnapshotImage {
+public:
+    static constexpr uint32_t kMagic = 0x474D494D;  // "MIMG"
+    static constexpr uint32_t kVersion = 2;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t walSegment;        // 镜像之后需回放的首个 WAL 段
+        uint64_t fileSize;
+        uint64_t deviceOffset;
+        uint64_t deviceCount;
+        uint64_t pointOffset;
+        uint64_t pointCount;
+        uint64_t metricOffset;
+        uint64_t metricCount;
+        uint64_t requirementOffset;
+        uint64_t requirementCount;
+        uint64_t stringOffset;
+        uint64_t stringSize;
+        uint32_t headerCrc;         // 覆盖 headerCrc 之前的字段
+        uint32_t reserved;
+    };
+
+    struct StringRef {
+        uint32_t offset;            // 相对字符串区
+        uint32_t length;
+    };
+
+    struct DeviceEntry {
+        StringRef id;
+        uint64_t firstPoint;
+        uint64_t pointCount;
+    };
+
+    struct PointEntry {
+        int64_t timestamp;
+        uint64_t firstMetric;
+        uint64_t metricCount;
+    };
+
+    struct MetricEntry {
+        StringRef name;
+        double value;
+    };
+
+    struct RequirementEntry {
+        int64_t id;
+        int64_t willingToPay;
+        StringRef title;
+        StringRef content;
+        StringRef contact;
+        StringRef notes;
+        StringRef createdAt;
+        StringRef updatedAt;
+    };
+
+    ~SnapshotImage();
+    SnapshotImage(const SnapshotImage&) = delete;
+    SnapshotImage& operator=(const SnapshotImage&) = delete;
+
+    /**
+     * 以只读方式 mmap 镜像文件
+     * @return 文件不存在或校验失败时返回 nullptr
+     */
+    static std::unique_ptr<SnapshotImage> open(const std::string& path);
+
+    uint64_t walSegment() const { return header_->walSegment; }
+    std::size_t fileSize() const { return size_; }
+
+    std::size_t deviceCount() const { return static_cast<std::size_t>(header_->deviceCount); }
+    std::string_view deviceId(std::size_t dev) const { return str(devices_[dev].id); }
+    // 二分查找设备，不存在返回 npos
+    std::size_t findDevice(std::string_view deviceId) const;
+    std::size_t pointCount(std::size_t dev) const { return static_cast<std::size_t>(devices_[dev].pointCount); }
+    // 物化第 dev 个设备的第 i 个数据点
+    DataPoint point(std::size_t dev, std::size_t i) const;
+
+    std::size_t requirementCount() const { return static_cast<std::size_t>(header_->requirementCount); }
+    const RequirementEntry& requirementEntry(std::size_t i) const { return requirements_[i]; }
+    Requirement requirement(std::size_t i) const;
+
+    std::string_view str(const StringRef& ref) const { return std::string_view(strings_ + ref.offset, ref.length); }
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+private:
+    friend class SnapshotImageBuilder;
+    SnapshotImage() = default;
+
+    void* base_ = nullptr;
+    std::size_t size_ = 0;
+    const Header* header_ = nullptr;
+    const DeviceEntry* devices_ = nullptr;
+    const PointEntry* points_ = nullptr;
+    const MetricEntry* metrics_ = nullptr;
+    const RequirementEntry* requirements_ = nullptr;
+    const char* strings_ = nullptr;
+};
+
+/**
+ * 镜像构建器：设备需按 device_id 升序依次加入
+ */
+class SnapshotImageBuilder {
+public:
+    void beginDevice(std::string_view deviceId);
+    void addPoint(const DataPoint& point);
+    void addPoint(const SnapshotImage& image, std::size_t dev, std::size_t i);
+    void addRequirement(const Requirement& req);
+    void addRequirement(const SnapshotImage& image, std::size_t i);
+
+    /**
+     * 生成镜像并以 tmp + fsync + rename 方式写入 path
+     */
+    bool writeTo(const std::string& path, uint64_t walSegment);
+
+private:
+    SnapshotImage::StringRef intern(std::string_view s);    // 设备 ID / 指标名：去重
+    SnapshotImage::StringRef intern(InternId id);           // 已驻留的指标名：按 id 缓存
+    SnapshotImage::StringRef addString(std::string_view s); // 需求文本：不去重
+
+    std::vector<SnapshotImage::DeviceEntry> devices_;
+    std::vector<SnapshotImage::PointEntry> points_;
+    std::vector<SnapshotImage::MetricEntry> metrics_;
+    std::vector<SnapshotImage::RequirementEntry> requirements_;
+    std::string strings_;
+    std::unordered_map<std::string, SnapshotImage::StringRef> interned_;
+    std::unordered_map<InternId, SnapshotImage::StringRef> internedIds_;
+};
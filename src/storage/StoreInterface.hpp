@@ -1,16 +1,72 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
+#include "utils/InternTable.hpp"
+
+/**
+ * 单个指标：指标名为 InternTable 中的 id
+ */
+struct Metric {
+    InternId name;
+    double value;
+};
 
 /**
  * 数据点结构
- * 包含时间戳和指标数据
+ * 包含时间戳和指标数据（指标名已驻留，同一点内不重复）
  */
 struct DataPoint {
-    long long timestamp;
-    std::unordered_map<std::string, double> metrics;
+    long long timestamp = 0;
+    std::vector<Metric> metrics;
+};
+
+/**
+ * 需求记录结构
+ * willing_to_pay: 0=不愿意, 1=愿意, -1=未填（对应数据库 NULL）
+ */
+struct Requirement {
+    int64_t id = 0;
+    std::string title;
+    std::string content;
+    int willing_to_pay = -1;
+    std::string contact;
+    std::string notes;
+    std::string created_at;
+    std::string updated_at;
+};
+
+/**
+ * 需求分页查询结果
+ */
+struct RequirementQueryResult {
+    std::vector<Requirement> data;
+    int64_t total = 0;
+    int page = 1;
+    int limit = 20;
+    bool ok = true;  // 查询失败（存储不可用）时为 false，结果为空，不应缓存
+};
+
+/**
+ * 当前请求所属的客户端会话（HTTP 头 X-Session-Id），在作用域内对本线程有效。
+ * 读写分离的存储据此把同一会话写入之后的读取留在主库，保证读己之写
+ */
+class SessionScope {
+public:
+    explicit SessionScope(std::string_view sessionId) : previous_(current_) { current_ = sessionId; }
+    ~SessionScope() { current_ = previous_; }
+    SessionScope(const SessionScope&) = delete;
+    SessionScope& operator=(const SessionScope&) = delete;
+
+    static std::string_view current() { return current_; }
+
+private:
+    std::string_view previous_;
+    static inline thread_local std::string_view current_;
 };
 
 /**
@@ -23,29 +79,100 @@ public:
 
     /**
      * 写入一条数据
-     * @param deviceId 设备ID
+     * @param deviceId 设备ID（InternTable id）
      * @param point 数据点
      */
-    virtual void append(const std::string& deviceId, const DataPoint& point) = 0;
+    virtual void append(InternId deviceId, const DataPoint& point) = 0;
 
     /**
      * 查询指定设备最近的 limit 条数据
-     * @param deviceId 设备ID
+     * @param deviceId 设备ID（InternTable id）
      * @param limit 返回条数上限
      * @return 数据点列表，按时间正序排列
      */
-    virtual std::vector<DataPoint> queryLatest(const std::string& deviceId, 
+    virtual std::vector<DataPoint> queryLatest(InternId deviceId, 
                                                 std::size_t limit) const = 0;
 
     /**
      * 批量写入数据（可选实现，默认循环调用append）
-     * @param deviceId 设备ID
+     * @param deviceId 设备ID（InternTable id）
      * @param points 数据点列表
+     * @return 写入失败（或未能确认持久化）时返回 false，此时可能已写入一部分；
+     *         需要向客户端确认的调用方据此让客户端重发
      */
-    virtual void appendBatch(const std::string& deviceId, 
+    virtual bool appendBatch(InternId deviceId, 
                              const std::vector<DataPoint>& points) {
         for (const auto& point : points) {
             append(deviceId, point);
         }
+        return true;
+    }
+
+    /**
+     * 写入一条需求记录（id / created_at / updated_at 由存储层生成）
+     * @param req 需求记录
+     */
+    virtual void appendRequirement(const Requirement& req) = 0;
+
+    /**
+     * 分页查询需求记录，按创建时间倒序
+     * @param page 页码（从 1 开始）
+     * @param limit 每页条数
+     * @param willingToPay 付费意愿过滤：-1=不过滤, 0/1=精确匹配, 2=未填
+     * @param keyword 标题/内容关键字，空串表示不过滤
+     */
+    virtual RequirementQueryResult queryRequirements(int page, int limit,
+        int willingToPay, const std::string& keyword) const = 0;
+
+    /**
+     * 异步接口：supportsAsync() 为 true 的实现在自己的 I/O 线程上执行数据库往返，
+     * 调用线程不等待，done 在结果就绪的线程中调用一次（只应把后续工作转交出去）。
+     * 默认实现同步执行后立即在调用线程回调
+     */
+    virtual bool supportsAsync() const { return false; }
+
+    virtual void appendAsync(InternId deviceId, DataPoint point, std::function<void()> done) {
+        append(deviceId, point);
+        done();
+    }
+
+    virtual void queryLatestAsync(InternId deviceId, std::size_t limit,
+                                  std::function<void(std::vector<DataPoint>)> done) const {
+        done(queryLatest(deviceId, limit));
     }
+
+    virtual void queryRequirementsAsync(int page, int limit, int willingToPay, const std::string& keyword,
+                                        std::function<void(RequirementQueryResult)> done) const {
+        done(queryRequirements(page, limit, willingToPay, keyword));
+    }
+
+    /**
+     * 需求数据版本号：每写入一条需求记录递增（只反映本进程内的写入）
+     * 查询结果缓存用它判断是否过期：查询前读取版本号，版本号不变则结果仍然有效
+     */
+    uint64_t requirementVersion() const {
+        return requirementVersion_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 设备数据版本号：该设备写入新数据后必然变化（单调递增，只在本进程内有意义）
+     * 默认实现为全局写入计数，任一设备写入都会变化；实现类可按设备细化
+     */
+    virtual uint64_t deviceVersion(InternId deviceId) const {
+        (void)deviceId;
+        return dataVersion_.load(std::memory_order_acquire);
+    }
+
+protected:
+    // 实现类在新记录对查询可见之后调用
+    void bumpRequirementVersion() {
+        requirementVersion_.fetch_add(1, std::memory_order_release);
+    }
+    void bumpDataVersion() {
+        dataVersion_.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint64_t> requirementVersion_{0};
+    std::atomic<uint64_t> dataVersion_{0};
 };
@@ -0,0 +1,281 @@
+#include "WriteAheadLog.hpp"
+#include "BinaryCodec.hpp"
+#include "utils/Logger.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+
+static const std::size_t kRecordHeaderSize = 8;                 // u32 长度 + u32 CRC
+static const uint32_t kMaxRecordSize = 64u * 1024u * 1024u;     // 防止损坏的长度字段导致超大分配
+
+static bool writeAll(int fd, const char* data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+std::string WriteAheadLog::segmentPath(const std::string& dir, uint64_t segmentId) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(segmentId));
+    return dir + "/" + name;
+}
+
+bool WriteAheadLog::openSegment(uint64_t segmentId) {
+    std::string path = segmentPath(dir_, segmentId);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open WAL segment " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    fd_ = fd;
+    segmentId_ = segmentId;
+    segmentSize_ = size > 0 ? size : 0;
+    // 新建文件需同步目录项
+    int dirFd = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+bool WriteAheadLog::open(const std::string& dir, uint64_t segmentId, WalFsyncPolicy policy, int intervalMs) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_) return true;
+    dir_ = dir;
+    policy_ = policy;
+    intervalMs_ = intervalMs > 0 ? intervalMs : 100;
+    if (!openSegment(segmentId)) return false;
+    running_ = true;
+    if (policy_ != WalFsyncPolicy::ALWAYS) {
+        flusher_ = std::thread(&WriteAheadLog::flusherLoop, this);
+    }
+    return true;
+}
+
+void WriteAheadLog::close() {
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    flushCv_.notify_all();
+    if (flusher_.joinable()) flusher_.join();
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!flushLocked(lock, true)) {
+        LOG_ERROR("WAL closed with " + std::to_string(buffer_.size()) + " bytes not written");
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint64_t WriteAheadLog::append(uint8_t type, const std::string& payload) {
+    std::string frame;
+    frame.reserve(kRecordHeaderSize + 1 + payload.size());
+    ByteWriter writer(frame);
+    uint32_t len = static_cast<uint32_t>(payload.size() + 1);
+    uint32_t crc = crc32(&type, 1);
+    crc = crc32(payload.data(), payload.size(), crc);
+    writer.putU32(len);
+    writer.putU32(crc);
+    writer.putU8(type);
+    frame.append(payload);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    buffer_.append(frame);
+    return ++nextLsn_;
+}
+
+bool WriteAheadLog::flushLocked(std::unique_lock<std::mutex>& lock, bool sync) {
+    // 同一时刻只允许一个刷写者，保证段内记录顺序
+    durableCv_.wait(lock, [this] { return !flushing_; });
+    if (buffer_.empty()) {
+        durableLsn_ = std::max(durableLsn_, nextLsn_);
+        return true;
+    }
+    uint64_t upto = nextLsn_;
+    // 之前的写入失败或切换段失败：先打开下一个段
+    if (fd_ < 0 && !openSegment(segmentId_ + 1)) {
+        failedLsn_ = std::max(failedLsn_, upto);
+        ++failureCount_;
+        durableCv_.notify_all();
+        return false;
+    }
+    flushing_ = true;
+    std::string data;
+    data.swap(buffer_);
+    int fd = fd_;
+    off_t offset = segmentSize_;
+    uint64_t segment = segmentId_;  // 解锁后 rotate 可能修改 segmentId_
+    lock.unlock();
+
+    bool ok = writeAll(fd, data.data(), data.size());
+    if (ok && sync) {
+        ok = ::fdatasync(fd) == 0;
+        ++syncCount_;
+    }
+    int err = errno;
+    if (!ok) {
+        LOG_ERROR("WAL write to segment " + std::to_string(segment) + " failed: " + strerror(err));
+        // fdatasync 失败后页缓存状态不可信，截掉本次写出的部分并改用新段
+        if (::ftruncate(fd, offset) != 0) {
+            LOG_ERROR("Failed to truncate WAL segment after write error: " + std::string(strerror(errno)));
+        }
+    }
+
+    lock.lock();
+    flushing_ = false;
+    if (ok) {
+        segmentSize_ += static_cast<off_t>(data.size());
+        durableLsn_ = std::max(durableLsn_, upto);
+    } else {
+        ::close(fd_);
+        fd_ = -1;
+        data.append(buffer_);
+        buffer_.swap(data);
+        failedLsn_ = std::max(failedLsn_, upto);
+        ++failureCount_;
+    }
+    durableCv_.notify_all();
+    return ok;
+}
+
+bool WriteAheadLog::waitDurable(uint64_t lsn) {
+    if (policy_ != WalFsyncPolicy::ALWAYS) return true;
+    std::unique_lock<std::mutex> lock(mtx_);
+    uint64_t failures = failureCount_;
+    while (durableLsn_ < lsn) {
+        // 覆盖本记录的刷写已失败：不再等待，由调用方报告错误
+        if (failureCount_ != failures && failedLsn_ >= lsn) return false;
+        if (!flushing_) {
+            // 成为刷盘者：一次 fdatasync 覆盖当前所有已缓冲记录
+            if (!flushLocked(lock, true) && durableLsn_ < lsn) return false;
+        } else {
+            durableCv_.wait(lock);
+        }
+    }
+    return true;
+}
+
+void WriteAheadLog::flusherLoop() {
+    bool sync = policy_ == WalFsyncPolicy::INTERVAL;
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (running_) {
+        flushCv_.wait_for(lock, std::chrono::milliseconds(intervalMs_), [this] { return !running_; });
+        if (!buffer_.empty()) {
+            flushLocked(lock, sync);
+        }
+    }
+}
+
+bool WriteAheadLog::rotate(uint64_t& segmentId) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!flushLocked(lock, true)) {
+        LOG_ERROR("WAL rotate failed: buffered records could not be written");
+        return false;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    // 失败时 fd_ 保持 -1，下次刷写重试打开同一个新段
+    if (!openSegment(segmentId_ + 1)) {
+        LOG_ERROR("WAL rotate failed: could not open segment " + std::to_string(segmentId_ + 1));
+        return false;
+    }
+    segmentId = segmentId_;
+    return true;
+}
+
+uint64_t WriteAheadLog::currentSegment() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return segmentId_;
+}
+
+std::vector<uint64_t> WriteAheadLog::listSegments(const std::string& dir) {
+    std::vector<uint64_t> segments;
+    DIR* d = ::opendir(dir.c_str());
+    if (!d) return segments;
+    while (dirent* entry = ::readdir(d)) {
+        unsigned long long id = 0;
+        char tail[8] = {0};
+        if (std::sscanf(entry->d_name, "wal-%20llu.%3s", &id, tail) == 2 && std::strcmp(tail, "log") == 0) {
+            segments.push_back(static_cast<uint64_t>(id));
+        }
+    }
+    ::closedir(d);
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void WriteAheadLog::removeSegmentsBefore(uint64_t segmentId) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        dir = dir_;
+    }
+    for (uint64_t id : listSegments(dir)) {
+        if (id >= segmentId) break;
+        ::unlink(segmentPath(dir, id).c_str());
+    }
+}
+
+std::size_t WriteAheadLog::replaySegment(const std::string& dir, uint64_t segmentId, const RecordCallback& cb) {
+    std::string path = segmentPath(dir, segmentId);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    std::string data;
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0) data.append(buf, static_cast<std::size_t>(n));
+    }
+    ::close(fd);
+
+    std::size_t pos = 0;
+    std::size_t count = 0;
+    while (data.size() - pos >= kRecordHeaderSize + 1) {
+        ByteReader header(data.data() + pos, kRecordHeaderSize);
+        uint32_t len = 0;
+        uint32_t crc = 0;
+        header.getU32(len);
+        header.getU32(crc);
+        if (len == 0 || len > kMaxRecordSize || data.size() - pos - kRecordHeaderSize < len) break;
+        const char* body = data.data() + pos + kRecordHeaderSize;
+        if (crc32(body, len) != crc) break;
+        cb(static_cast<uint8_t>(body[0]), body + 1, len - 1);
+        pos += kRecordHeaderSize + len;
+        ++count;
+    }
+
+    if (pos < data.size()) {
+        LOG_WARNING("WAL segment " + path + " has a torn tail, truncating " +
+                    std::to_string(data.size() - pos) + " bytes");
+        if (::truncate(path.c_str(), static_cast<off_t>(pos)) != 0) {
+            LOG_ERROR("Failed to truncate WAL segment: " + std::string(strerror(errno)));
+        }
+    }
+    return count;
+}
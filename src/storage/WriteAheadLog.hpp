@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+/**
+ * WAL 刷盘策略
+ */
+enum class WalFsyncPolicy {
+    ALWAYS,     // 每次写入返回前保证落盘（多个并发写入合并为一次 fdatasync）
+    INTERVAL,   // 后台线程按固定间隔写入并 fdatasync
+    OFF         // 后台线程按固定间隔写入，不主动 fdatasync
+};
+
+/**
+ * 持久化配置（MEMORY 模式下启用）
+ */
+struct WalConfig {
+    std::string dir;                               // WAL 与快照目录，空表示不启用
+    WalFsyncPolicy fsyncPolicy = WalFsyncPolicy::INTERVAL;
+    int fsyncIntervalMs = 100;                      // INTERVAL / OFF 模式下的刷写间隔
+    int snapshotIntervalSec = 300;                  // 快照间隔，0 表示仅在关闭时生成
+};
+
+/**
+ * 追加写日志（Write-Ahead Log）
+ * 记录格式：[u32 长度][u32 CRC32][u8 类型][payload]，长度与 CRC 均覆盖 类型+payload
+ * 日志按段（segment）存放：<dir>/wal-<segment>.log，快照完成后删除旧段
+ *
+ * 写入分两步：append() 仅追加到内存缓冲区并返回 LSN，waitDurable() 在 ALWAYS 策略下
+ * 等待该 LSN 落盘。并发等待者中第一个成为刷盘者，一次 write + fdatasync 覆盖所有已缓冲记录（group commit）
+ */
+class WriteAheadLog {
+public:
+    using RecordCallback = std::function<void(uint8_t type, const char* data, std::size_t len)>;
+
+    WriteAheadLog() = default;
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * 打开（新建）日志段并启动后台刷写线程
+     * @param dir 日志目录（需已存在）
+     * @param segmentId 新日志段编号
+     */
+    bool open(const std::string& dir, uint64_t segmentId, WalFsyncPolicy policy, int intervalMs);
+
+    /**
+     * 刷写剩余缓冲并关闭
+     */
+    void close();
+
+    /**
+     * 追加一条记录到缓冲区
+     * @return 记录的 LSN
+     */
+    uint64_t append(uint8_t type, const std::string& payload);
+
+    /**
+     * 等待 lsn 之前的记录落盘（仅 ALWAYS 策略阻塞）
+     * @return 覆盖 lsn 的刷盘失败时返回 false（记录仍留在缓冲区，之后换新段重试）
+     */
+    bool waitDurable(uint64_t lsn);
+
+    /**
+     * 将缓冲区写入并同步当前段，然后切换到下一个段
+     * @param segmentId 输出新段编号
+     * @return 刷盘或新段打开失败时返回 false，此时不应推进快照
+     */
+    bool rotate(uint64_t& segmentId);
+
+    /**
+     * 删除编号小于 segmentId 的日志段
+     */
+    void removeSegmentsBefore(uint64_t segmentId);
+
+    uint64_t currentSegment() const;
+    uint64_t getSyncCount() const { return syncCount_.load(); }
+
+    /**
+     * 列出目录下所有日志段编号（升序）
+     */
+    static std::vector<uint64_t> listSegments(const std::string& dir);
+
+    /**
+     * 回放一个日志段，遇到截断或 CRC 不符的记录即停止，并把文件截断到最后一条完整记录
+     * @return 回放的记录数
+     */
+    static std::size_t replaySegment(const std::string& dir, uint64_t segmentId, const RecordCallback& cb);
+
+    static std::string segmentPath(const std::string& dir, uint64_t segmentId);
+
+private:
+    void flusherLoop();
+    /**
+     * 在持有 lock 的前提下把缓冲区写出（写出期间释放锁），sync 表示是否 fdatasync。
+     * 失败时截掉本次写出的部分并放弃当前段，数据放回缓冲区，下次刷写在新段中重试，
+     * 避免段中间出现残缺记录导致回放丢弃其后的有效记录
+     */
+    bool flushLocked(std::unique_lock<std::mutex>& lock, bool sync);
+    bool openSegment(uint64_t segmentId);
+
+    std::string dir_;
+    WalFsyncPolicy policy_ = WalFsyncPolicy::INTERVAL;
+    int intervalMs_ = 100;
+
+    mutable std::mutex mtx_;  // 保护以下成员
+    std::condition_variable durableCv_;
+    std::condition_variable flushCv_;
+    std::string buffer_;
+    uint64_t nextLsn_ = 0;
+    uint64_t durableLsn_ = 0;
+    uint64_t failedLsn_ = 0;      // 最近一次失败的刷写覆盖到的 LSN
+    uint64_t failureCount_ = 0;   // 刷写失败次数，等待者据此判断覆盖自己的刷写是否失败
+    off_t segmentSize_ = 0;       // 当前段已写出的字节数
+    bool flushing_ = false;
+    bool running_ = false;
+    int fd_ = -1;
+    uint64_t segmentId_ = 0;
+
+    std::thread flusher_;
+    std::atomic<uint64_t> syncCount_{0};
+};
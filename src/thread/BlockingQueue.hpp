@@ -15,10 +15,18 @@ public:
         cv_.notify_one();
     }
 
+    void push(T&& value) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            queue_.push(std::move(value));
+        }
+        cv_.notify_one();
+    }
+
     T take() {
         std::unique_lock<std::mutex> lock(mtx_);
         cv_.wait(lock, [this] { return !queue_.empty(); });
-        T value = queue_.front();
+        T value = std::move(queue_.front());
         queue_.pop();
         return value;
     }
@@ -0,0 +1,132 @@
+#include "CpuAffinity.hpp"
+#include "utils/Logger.hpp"
+
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// <linux/mempolicy.h> 中的 MPOL_PREFERRED
+constexpr int kMpolPreferred = 1;
+constexpr int kMaxNodes = 1024;
+
+bool fillSet(const std::vector<int>& cpus, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    return true;
+}
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+}  // namespace
+
+bool CpuAffinity::parseCpuList(const std::string& spec, std::vector<int>& cpus) {
+    cpus.clear();
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::size_t start = item.find_first_not_of(" \t");
+        if (start == std::string::npos) continue;
+        std::size_t end = item.find_last_not_of(" \t");
+        item = item.substr(start, end - start + 1);
+        char* next = nullptr;
+        long first = std::strtol(item.c_str(), &next, 10);
+        long last = first;
+        if (next == item.c_str()) return false;
+        if (*next == '-') {
+            const char* rangeEnd = next + 1;
+            last = std::strtol(rangeEnd, &next, 10);
+            if (next == rangeEnd) return false;
+        }
+        if (*next != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) return false;
+        for (long cpu = first; cpu <= last; ++cpu) cpus.push_back(static_cast<int>(cpu));
+    }
+    return true;
+}
+
+std::string CpuAffinity::formatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (std::size_t i = 0; i < cpus.size();) {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+bool CpuAffinity::pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) return true;
+    cpu_set_t set;
+    int err = fillSet(cpus, set) ? pthread_setaffinity_np(pthread_self(), sizeof(set), &set) : EINVAL;
+    if (err != 0) {
+        LOG_WARNING("Failed to pin thread to CPUs " + formatCpuList(cpus) + ": " + strerror(err));
+        return false;
+    }
+    return true;
+}
+
+bool CpuAffinity::pinProcess(const std::vector<int>& cpus) {
+    if (cpus.empty()) return true;
+    cpu_set_t set;
+    if (!fillSet(cpus, set)) return false;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return false;
+    bool ok = true;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        pid_t tid = static_cast<pid_t>(std::atoi(entry->d_name));
+        if (sched_setaffinity(tid, sizeof(set), &set) < 0) {
+            LOG_WARNING("Failed to pin thread " + std::to_string(tid) + " to CPUs " + formatCpuList(cpus) + ": " +
+                        strerror(errno));
+            ok = false;
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+std::vector<int> CpuAffinity::nodeCpus(int node) {
+    std::vector<int> cpus;
+    if (node < 0) return cpus;
+    std::string list = readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    if (!parseCpuList(list, cpus)) cpus.clear();
+    return cpus;
+}
+
+int CpuAffinity::nicNode(const std::string& interface) {
+    std::string value = readFirstLine("/sys/class/net/" + interface + "/device/numa_node");
+    if (value.empty()) return -1;
+    return std::atoi(value.c_str());
+}
+
+bool CpuAffinity::preferNode(int node) {
+    if (node < 0 || node >= kMaxNodes) return false;
+    constexpr int kBitsPerWord = static_cast<int>(sizeof(unsigned long) * 8);
+    unsigned long mask[kMaxNodes / kBitsPerWord] = {};
+    mask[node / kBitsPerWord] = 1UL << (node % kBitsPerWord);
+    // 内核按 maxnode - 1 位读取掩码
+    if (syscall(SYS_set_mempolicy, kMpolPreferred, mask, static_cast<unsigned long>(kMaxNodes) + 1) < 0) {
+        LOG_WARNING("Failed to prefer memory from NUMA node " + std::to_string(node) + ": " + strerror(errno));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * CPU 绑定与 NUMA 节点查询（Linux），不依赖 libnuma。
+ * 内存按首次写入的线程所在节点分配（first-touch），线程绑定 CPU 后，
+ * 由该线程首次写入的缓冲区（线程级分配区、连接缓冲区、存储数据）即为本地内存
+ */
+class CpuAffinity {
+public:
+    // 解析 CPU 列表（如 "0-3,8,10-11"），空串得到空列表；格式错误返回 false
+    static bool parseCpuList(const std::string& spec, std::vector<int>& cpus);
+    static std::string formatCpuList(const std::vector<int>& cpus);
+
+    // 把调用线程绑定到 cpus，空列表不做任何事
+    static bool pinCurrentThread(const std::vector<int>& cpus);
+    // 把进程中现有的全部线程绑定到 cpus；之后创建的线程继承创建者的绑定
+    static bool pinProcess(const std::vector<int>& cpus);
+
+    // NUMA 节点的 CPU 列表，节点不存在时为空
+    static std::vector<int> nodeCpus(int node);
+    // 网卡所在的 NUMA 节点（/sys/class/net/<name>/device/numa_node），未知时返回 -1
+    static int nicNode(const std::string& interface);
+    /**
+     * 调用线程及之后由它创建的线程优先从 node 分配内存（MPOL_PREFERRED），
+     * 节点内存不足时仍会从其他节点分配
+     */
+    static bool preferNode(int node);
+};
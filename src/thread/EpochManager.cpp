@@ -0,0 +1,98 @@
+#include "EpochManager.hpp"
+#include "utils/Logger.hpp"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// 存活的 EpochManager：线程退出时只归还仍存活实例的槽位。有意不析构，线程退出晚于静态析构时仍可用
+std::mutex& liveMutex() {
+    static std::mutex* mtx = new std::mutex;
+    return *mtx;
+}
+
+std::unordered_set<const EpochManager*>& liveManagers() {
+    static auto* live = new std::unordered_set<const EpochManager*>;
+    return *live;
+}
+
+}  // namespace
+
+// 本线程占用的槽位；线程退出时归还，线程池扩缩容反复创建线程也不会耗尽槽位
+struct EpochManager::SlotCache {
+    std::unordered_map<const EpochManager*, Slot*> slots;
+    ~SlotCache() {
+        std::lock_guard<std::mutex> lock(liveMutex());
+        for (const auto& [mgr, slot] : slots) {
+            if (liveManagers().count(mgr)) slot->used.store(false, std::memory_order_release);
+        }
+    }
+};
+
+EpochManager::EpochManager() {
+    std::lock_guard<std::mutex> lock(liveMutex());
+    liveManagers().insert(this);
+}
+
+EpochManager::~EpochManager() {
+    {
+        std::lock_guard<std::mutex> lock(liveMutex());
+        liveManagers().erase(this);
+    }
+    // 析构时不应再有读者
+    for (auto& r : retired_) r.deleter();
+}
+
+std::atomic<uint64_t>* EpochManager::acquireSlot() {
+    // 每个线程在每个 EpochManager 上固定占用一个槽位
+    thread_local SlotCache cache;
+    auto it = cache.slots.find(this);
+    if (it != cache.slots.end()) return &it->second->epoch;
+    for (auto& slot : slots_) {
+        bool expected = false;
+        if (!slot.used.load(std::memory_order_relaxed) &&
+            slot.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            cache.slots.emplace(this, &slot);
+            return &slot.epoch;
+        }
+    }
+    LOG_ERROR("EpochManager slots exhausted");
+    std::abort();
+}
+
+EpochManager::Guard::Guard(EpochManager& mgr) : slot_(mgr.acquireSlot()) {
+    // seq_cst 保证登记对随后读取共享指针之前的 reclaim 可见
+    slot_->store(mgr.globalEpoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+}
+
+EpochManager::Guard::~Guard() {
+    slot_->store(0, std::memory_order_release);
+}
+
+void EpochManager::retire(std::function<void()> deleter) {
+    std::lock_guard<std::mutex> lock(retireMtx_);
+    uint64_t epoch = globalEpoch_.fetch_add(1, std::memory_order_acq_rel);
+    retired_.push_back(Retired{epoch, std::move(deleter)});
+}
+
+std::size_t EpochManager::reclaim() {
+    uint64_t minActive = std::numeric_limits<uint64_t>::max();
+    for (auto& slot : slots_) {
+        uint64_t e = slot.epoch.load(std::memory_order_seq_cst);
+        if (e != 0) minActive = std::min(minActive, e);
+    }
+
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lock(retireMtx_);
+        // 读者登记的 epoch > 退休 epoch 说明它是在对象摘除之后进入的，看不到该对象
+        auto it = std::partition(retired_.begin(), retired_.end(),
+            [minActive](const Retired& r) { return r.epoch >= minActive; });
+        ready.assign(std::make_move_iterator(it), std::make_move_iterator(retired_.end()));
+        retired_.erase(it, retired_.end());
+    }
+    for (auto& r : ready) r.deleter();
+    return ready.size();
+}
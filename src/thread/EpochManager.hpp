@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * 基于 epoch 的延迟回收（EBR）
+ * 读者进入临界区时登记当前全局 epoch，退出时清除；写者 retire 的对象
+ * 只有在所有活跃读者都进入了更新的 epoch 之后才会被释放。
+ * 读者路径只有两次原子写，不加锁、不等待写者；回收由写者调用 reclaim() 完成
+ */
+class EpochManager {
+public:
+    static constexpr std::size_t kMaxThreads = 256;
+
+    EpochManager();
+    ~EpochManager();
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    /**
+     * 读临界区守卫（RAII）
+     */
+    class Guard {
+    public:
+        explicit Guard(EpochManager& mgr);
+        ~Guard();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    private:
+        std::atomic<uint64_t>* slot_;
+    };
+
+    /**
+     * 延迟释放：当前所有读者退出后执行 deleter
+     */
+    void retire(std::function<void()> deleter);
+
+    /**
+     * 释放所有已安全的延迟对象，返回释放个数
+     */
+    std::size_t reclaim();
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};     // 0 表示不在临界区
+        std::atomic<bool> used{false};
+    };
+
+    struct SlotCache;
+
+    std::atomic<uint64_t>* acquireSlot();
+
+    std::atomic<uint64_t> globalEpoch_{1};
+    Slot slots_[kMaxThreads];
+
+    std::mutex retireMtx_;
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> deleter;
+    };
+    std::vector<Retired> retired_;
+};
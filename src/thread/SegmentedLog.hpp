@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include "EpochManager.hpp"
+
+/**
+ * 只追加的分段数组（单写者、多读者）
+ * 元素写入固定大小的段，段一旦分配不会移动；写者构造好元素后以 release 发布长度，
+ * 读者 acquire 读取长度后即可无锁访问 [0, size) 内的元素，写入永远不等待读者。
+ * 下标为全局递增的逻辑下标；releaseBefore 可把整段落在某下标之前的段交给 EpochManager 延迟释放
+ *
+ * push_back / releaseBefore 需由调用方串行化
+ */
+template <typename T, std::size_t SegmentBits = 10, std::size_t MaxSegments = (1u << 16)>
+class SegmentedLog {
+public:
+    static constexpr std::size_t kSegmentSize = std::size_t(1) << SegmentBits;
+    static constexpr std::size_t kCapacity = kSegmentSize * MaxSegments;
+
+    SegmentedLog() : segments_(new std::atomic<Segment*>[MaxSegments]) {
+        for (std::size_t i = 0; i < MaxSegments; ++i) segments_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~SegmentedLog() {
+        std::size_t n = size_.load(std::memory_order_relaxed);
+        for (std::size_t s = firstLive_; s < MaxSegments; ++s) {
+            Segment* seg = segments_[s].load(std::memory_order_relaxed);
+            if (!seg) break;
+            std::size_t begin = s * kSegmentSize;
+            destroySegment(seg, n > begin ? std::min(n - begin, kSegmentSize) : 0);
+        }
+    }
+
+    SegmentedLog(const SegmentedLog&) = delete;
+    SegmentedLog& operator=(const SegmentedLog&) = delete;
+
+    /**
+     * 已发布的元素个数（逻辑下标上界）
+     */
+    std::size_t size() const {
+        return size_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 读取已发布的元素；调用方需保证 index < size() 且未被 releaseBefore 回收
+     */
+    const T& operator[](std::size_t index) const {
+        Segment* seg = segments_[index >> SegmentBits].load(std::memory_order_acquire);
+        return seg->at(index & (kSegmentSize - 1));
+    }
+
+    /**
+     * 追加一个元素并发布，返回其逻辑下标
+     */
+    std::size_t push_back(T value) {
+        std::size_t index = size_.load(std::memory_order_relaxed);
+        if (index >= kCapacity) throw std::length_error("SegmentedLog capacity exceeded");
+        std::size_t s = index >> SegmentBits;
+        Segment* seg = segments_[s].load(std::memory_order_relaxed);
+        if (!seg) {
+            seg = new Segment();
+            segments_[s].store(seg, std::memory_order_release);
+        }
+        new (seg->slot(index & (kSegmentSize - 1))) T(std::move(value));
+        size_.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    /**
+     * 声明 index 之前的元素不再被新读者访问：完全位于其前的段交给 epochs 延迟析构
+     * 调用方须先发布不再引用这些下标的视图，再调用本函数
+     */
+    void releaseBefore(std::size_t index, EpochManager& epochs) {
+        std::size_t endSegment = index >> SegmentBits;
+        for (; firstLive_ < endSegment; ++firstLive_) {
+            Segment* seg = segments_[firstLive_].load(std::memory_order_relaxed);
+            epochs.retire([seg] { destroySegment(seg, kSegmentSize); });
+        }
+    }
+
+private:
+    struct Segment {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[kSegmentSize];
+
+        void* slot(std::size_t i) { return &storage[i]; }
+        const T& at(std::size_t i) const { return *std::launder(reinterpret_cast<const T*>(&storage[i])); }
+        T& at(std::size_t i) { return *std::launder(reinterpret_cast<T*>(&storage[i])); }
+    };
+
+    // 析构段内前 count 个元素并释放段
+    static void destroySegment(Segment* seg, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) seg->at(i).~T();
+        delete seg;
+    }
+
+    std::unique_ptr<std::atomic<Segment*>[]> segments_;
+    std::atomic<std::size_t> size_{0};
+    std::size_t firstLive_ = 0;     // 第一个未被回收的段（仅写者访问）
+};
@@ -1,36 +1,104 @@
 #include "ThreadPool.hpp"
+#include "CpuAffinity.hpp"
 #include "utils/Logger.hpp"
+#include "utils/Metrics.hpp"
+#include "utils/Tracer.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool()
+    : queueDepth_(Metrics::getInstance().gauge("device_server_threadpool_queue_depth",
+                                               "Tasks waiting in the thread pool queue")),
+      waitTime_(Metrics::getInstance().histogram("device_server_threadpool_wait_seconds",
+                                                 "Time tasks spend queued before a worker picks them up")) {
+}
 
 ThreadPool::~ThreadPool() {
     stop();
 }
 
 void ThreadPool::start(std::size_t threadCount) {
+    std::lock_guard<std::mutex> lock(workersMtx_);
     if (running_) return;
     running_ = true;
     activeTasks_ = 0;
     for (std::size_t i = 0; i < threadCount; ++i) {
-        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+        spawnWorker();
     }
 }
 
 void ThreadPool::stop() {
+    std::lock_guard<std::mutex> lock(workersMtx_);
     if (!running_) return;
     running_ = false;
 
     // 向队列中塞入空任务以唤醒线程并退出
     for (std::size_t i = 0; i < workers_.size(); ++i) {
-        taskQueue_.push(nullptr);
+        taskQueue_.push(QueuedTask{nullptr, {}});
     }
 
-    for (auto& t : workers_) {
-        if (t.joinable()) {
-            t.join();
+    for (auto& w : workers_) {
+        if (w.thread.joinable()) {
+            w.thread.join();
         }
     }
     workers_.clear();
 }
 
+void ThreadPool::resize(std::size_t threadCount) {
+    std::lock_guard<std::mutex> lock(workersMtx_);
+    if (!running_ || threadCount == 0 || threadCount == workers_.size()) return;
+    std::size_t before = workers_.size();
+    if (threadCount > before) {
+        for (std::size_t i = before; i < threadCount; ++i) {
+            spawnWorker();
+        }
+    } else {
+        // 空任务排在已有任务之后，退出的线程不会丢下队列中的任务
+        std::size_t count = before - threadCount;
+        retiring_.store(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            taskQueue_.push(QueuedTask{nullptr, {}});
+        }
+        std::unique_lock<std::mutex> exitLock(exitMtx_);
+        exitCv_.wait(exitLock, [&] { return exited_.size() == count; });
+        for (std::thread::id id : exited_) {
+            auto it = std::find_if(workers_.begin(), workers_.end(),
+                                   [id](const Worker& w) { return w.thread.get_id() == id; });
+            it->thread.join();
+            workers_.erase(it);
+        }
+        exited_.clear();
+    }
+    LOG_INFO("ThreadPool resized from " + std::to_string(before) + " to " + std::to_string(threadCount) +
+             " threads");
+}
+
+void ThreadPool::spawnWorker() {
+    int cpu = pickCpu();
+    workers_.push_back(Worker{std::thread(&ThreadPool::workerLoop, this, nextIndex_++, cpu), cpu});
+}
+
+int ThreadPool::pickCpu() const {
+    // 缩容后留下的线程不一定占着列表前面的 CPU，按现有绑定选最空闲的，而不是按线程编号取模
+    int best = -1;
+    std::size_t bestCount = 0;
+    for (int cpu : cpus_) {
+        std::size_t count = static_cast<std::size_t>(std::count_if(
+            workers_.begin(), workers_.end(), [cpu](const Worker& w) { return w.cpu == cpu; }));
+        if (best < 0 || count < bestCount) {
+            best = cpu;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+std::size_t ThreadPool::size() const {
+    std::lock_guard<std::mutex> lock(workersMtx_);
+    return workers_.size();
+}
+
 void ThreadPool::waitForTasks() {
     std::unique_lock<std::mutex> lock(waitMtx_);
     // 等待队列为空且没有正在执行的任务
@@ -41,23 +109,77 @@ void ThreadPool::waitForTasks() {
 
 void ThreadPool::submit(Task task) {
     if (!running_) return;
-    taskQueue_.push(std::move(task));
+    queueDepth_.inc();
+    queued_.fetch_add(1, std::memory_order_relaxed);
+    taskQueue_.push(QueuedTask{std::move(task), std::chrono::steady_clock::now()});
+}
+
+void ThreadPool::setAdmissionLimits(std::size_t capacity, int targetMs, int intervalMs) {
+    capacity_.store(capacity, std::memory_order_relaxed);
+    targetNs_.store(static_cast<int64_t>(targetMs) * 1000000, std::memory_order_relaxed);
+    intervalNs_.store(static_cast<int64_t>(intervalMs) * 1000000, std::memory_order_relaxed);
+    firstAboveNs_.store(0, std::memory_order_relaxed);
+    dropping_.store(false, std::memory_order_relaxed);
+}
+
+bool ThreadPool::overloaded() const {
+    std::size_t queued = queued_.load(std::memory_order_relaxed);
+    std::size_t capacity = capacity_.load(std::memory_order_relaxed);
+    if (capacity > 0 && queued >= capacity) return true;
+    // 队列已排空时不再拒绝，否则没有新任务出队就无法退出过载状态
+    return queued > 0 && dropping_.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::observeQueueDelay(int64_t delayNs, int64_t nowNs) {
+    int64_t target = targetNs_.load(std::memory_order_relaxed);
+    if (target <= 0) return;
+    if (delayNs < target) {
+        firstAboveNs_.store(0, std::memory_order_relaxed);
+        dropping_.store(false, std::memory_order_relaxed);
+        return;
+    }
+    // 短暂突发不触发拒绝：超过目标的状态持续一个 interval 才进入过载
+    int64_t firstAbove = firstAboveNs_.load(std::memory_order_relaxed);
+    if (firstAbove == 0) {
+        firstAboveNs_.store(nowNs + intervalNs_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    } else if (nowNs >= firstAbove) {
+        dropping_.store(true, std::memory_order_relaxed);
+    }
 }
 
-void ThreadPool::workerLoop(std::size_t threadIndex) {
+void ThreadPool::workerLoop(std::size_t threadIndex, int cpu) {
+    // 先绑定再分配线程级缓冲区（追踪环等），使其落在本地 NUMA 节点
+    if (cpu >= 0) CpuAffinity::pinCurrentThread({cpu});
+    Tracer::setThreadName("worker-" + std::to_string(threadIndex));
     while (running_) {
-        Task task = taskQueue_.take();
-        if (!task) {
-            // 退出信号
+        QueuedTask item = taskQueue_.take();
+        if (!item.task) {
+            // 退出信号：缩容时由取到它的线程退出，停止时由 running_ 结束循环
+            std::size_t retiring = retiring_.load();
+            while (retiring > 0 && !retiring_.compare_exchange_weak(retiring, retiring - 1)) {
+            }
+            if (retiring > 0) {
+                std::lock_guard<std::mutex> lock(exitMtx_);
+                exited_.push_back(std::this_thread::get_id());
+                exitCv_.notify_all();
+                return;
+            }
             continue;
         }
+        queueDepth_.dec();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        int64_t delayNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - item.enqueueTime).count();
+        waitTime_.record(static_cast<uint64_t>(delayNs));
+        observeQueueDelay(delayNs, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch()).count());
         
         // 增加正在执行的任务计数
         ++activeTasks_;
         LOG_DEBUG("ThreadPool worker #" + std::to_string(threadIndex) + " executing task");
         
         try {
-            task();
+            item.task();
         } catch (...) {
             // 捕获异常，确保计数正确减少
         }
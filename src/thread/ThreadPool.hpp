@@ -6,32 +6,86 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <chrono>
 
 #include "BlockingQueue.hpp"
 
+class Gauge;
+class Histogram;
+
 class ThreadPool {
 public:
     using Task = std::function<void()>;
 
-    ThreadPool() = default;
+    ThreadPool();
     ~ThreadPool();
 
     void start(std::size_t threadCount);
     void stop();
     
+    /**
+     * 运行时调整工作线程数（至少 1）：增加时立即启动新线程；减少时多余线程执行完手头任务后退出，
+     * 本函数等待它们退出后返回。不能在池内线程中调用
+     */
+    void resize(std::size_t threadCount);
+    std::size_t size() const;
+    
+    // 在 start 之前调用：每个工作线程绑定 cpus 中的一个 CPU，新线程取当前绑定线程最少的 CPU（线程多于 CPU 时共用）
+    void setCpuAffinity(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+    
     // 等待所有任务完成（包括队列中的和正在执行的）
     void waitForTasks();
 
     void submit(Task task);
 
+    /**
+     * 准入控制参数（CoDel 式）：排队时延持续 intervalMs 以上超过 targetMs 即进入过载状态，
+     * 任一任务的排队时延回落到目标以下或队列排空后恢复
+     * @param capacity 队列中等待的任务数上限，0 表示不限
+     * @param targetMs 排队时延目标，0 表示不按时延判断
+     */
+    void setAdmissionLimits(std::size_t capacity, int targetMs, int intervalMs);
+
+    // 新任务是否应被拒绝（由提交方在入队前检查，拒绝时直接快速失败）
+    bool overloaded() const;
+
 private:
-    void workerLoop(std::size_t threadIndex);
+    // 记录入队时间，用于统计任务排队等待时长
+    struct QueuedTask {
+        Task task;
+        std::chrono::steady_clock::time_point enqueueTime;
+    };
+
+    struct Worker {
+        std::thread thread;
+        int cpu;  // 绑定的 CPU，-1 表示不绑定
+    };
+
+    void spawnWorker();
+    int pickCpu() const;
+    void workerLoop(std::size_t threadIndex, int cpu);
+    void observeQueueDelay(int64_t delayNs, int64_t nowNs);
 
 private:
-    std::vector<std::thread> workers_;
-    BlockingQueue<Task> taskQueue_;
+    mutable std::mutex workersMtx_;  // 串行化 start / stop / resize
+    std::vector<Worker> workers_;
+    std::size_t nextIndex_ = 0;                 // 线程编号（线程名），缩容后不复用
+    std::vector<int> cpus_;
+    std::atomic<std::size_t> retiring_{0};      // 缩容时尚未退出的线程数，取到空任务的线程据此退出
+    std::mutex exitMtx_;
+    std::condition_variable exitCv_;
+    std::vector<std::thread::id> exited_;       // 缩容退出、待 join 的线程
+    BlockingQueue<QueuedTask> taskQueue_;
+    Gauge& queueDepth_;
+    Histogram& waitTime_;
     std::atomic<bool> running_{false};
     std::atomic<std::size_t> activeTasks_{0};  // 正在执行的任务数
+    std::atomic<std::size_t> queued_{0};       // 等待中的任务数（准入判断用，不经过队列锁）
+    std::atomic<std::size_t> capacity_{0};
+    std::atomic<int64_t> targetNs_{0};
+    std::atomic<int64_t> intervalNs_{0};
+    std::atomic<int64_t> firstAboveNs_{0};     // 时延首次超过目标后 interval 到期的时刻，0 表示未超过
+    std::atomic<bool> dropping_{false};
     std::mutex waitMtx_;  // 用于等待任务完成的互斥锁
     std::condition_variable waitCv_;  // 用于通知任务完成的条件变量
 };
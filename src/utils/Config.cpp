@@ -7,18 +7,20 @@
 #include <vector>
 #include <tuple>
 
+Config::Config() : data_(std::make_shared<const Data>()) {
+}
+
 Config& Config::getInstance() {
     static Config instance;
     return instance;
 }
 
-bool Config::loadFromFile(const std::string& filename) {
+bool Config::parseFile(const std::string& filename, Data& data) {
     std::ifstream file(filename);
     if (!file.is_open()) {
         LOG_ERROR("Failed to open config file: " + filename);
         return false;
     }
-    std::lock_guard<std::mutex> lock(mutex_);
     std::string currentSection;
     std::string line;
     int lineNumber = 0;
@@ -41,17 +43,14 @@ bool Config::loadFromFile(const std::string& filename) {
                 value = value.substr(1, value.length() - 2);
             }
             if (!currentSection.empty() && !key.empty()) {
-                data_[currentSection][key] = value;
+                data[currentSection][key] = value;
             }
         }
     }
-    file.close();
-    LOG_INFO("Config loaded from: " + filename);
     return true;
 }
 
-void Config::loadFromEnv() {
-    std::lock_guard<std::mutex> lock(mutex_);
+void Config::applyEnv(Data& data) {
     const std::vector<std::tuple<std::string, std::string, std::string>> envMappings = {
         {"mysql", "host", "DEVICE_SERVER_MYSQL_HOST"},
         {"mysql", "port", "DEVICE_SERVER_MYSQL_PORT"},
@@ -60,24 +59,104 @@ void Config::loadFromEnv() {
         {"mysql", "database", "DEVICE_SERVER_MYSQL_DATABASE"},
         {"mysql", "pool_size_min", "DEVICE_SERVER_MYSQL_POOL_MIN"},
         {"mysql", "pool_size_max", "DEVICE_SERVER_MYSQL_POOL_MAX"},
+        {"mysql", "pool_max_idle_sec", "DEVICE_SERVER_MYSQL_POOL_MAX_IDLE_SEC"},
+        {"mysql", "pool_health_check_sec", "DEVICE_SERVER_MYSQL_POOL_HEALTH_CHECK_SEC"},
+        {"mysql", "async_connections", "DEVICE_SERVER_MYSQL_ASYNC_CONNECTIONS"},
+        {"mysql", "replicas", "DEVICE_SERVER_MYSQL_REPLICAS"},
+        {"mysql", "replica_max_lag_ms", "DEVICE_SERVER_MYSQL_REPLICA_MAX_LAG_MS"},
+        {"mysql", "data_layout", "DEVICE_SERVER_MYSQL_DATA_LAYOUT"},
+        {"mysql", "bucket_span", "DEVICE_SERVER_MYSQL_BUCKET_SPAN"},
+        {"mysql", "partition_span", "DEVICE_SERVER_MYSQL_PARTITION_SPAN"},
+        {"mysql", "partition_retain", "DEVICE_SERVER_MYSQL_PARTITION_RETAIN"},
         {"mysql", "connect_timeout", "DEVICE_SERVER_MYSQL_TIMEOUT"},
         {"server", "port", "DEVICE_SERVER_PORT"},
         {"server", "thread_pool_size", "DEVICE_SERVER_THREADS"},
+        {"server", "handoff_socket", "DEVICE_SERVER_HANDOFF_SOCKET"},
+        {"server", "drain_timeout_sec", "DEVICE_SERVER_DRAIN_TIMEOUT_SEC"},
         {"storage", "mode", "DEVICE_SERVER_STORAGE_MODE"},
         {"storage", "batch_size", "DEVICE_SERVER_BATCH_SIZE"},
+        {"storage", "wal_dir", "DEVICE_SERVER_WAL_DIR"},
+        {"storage", "wal_fsync", "DEVICE_SERVER_WAL_FSYNC"},
+        {"log", "level", "DEVICE_SERVER_LOG_LEVEL"},
+        {"trace", "sample_every", "DEVICE_SERVER_TRACE_SAMPLE_EVERY"},
+        {"cache", "requirement_query_mb", "DEVICE_SERVER_REQUIREMENT_CACHE_MB"},
+        {"cache", "conditional_get", "DEVICE_SERVER_CONDITIONAL_GET"},
+        {"stream", "queue_limit", "DEVICE_SERVER_STREAM_QUEUE_LIMIT"},
+        {"stream", "drop_policy", "DEVICE_SERVER_STREAM_DROP_POLICY"},
+        {"websocket", "ack_window", "DEVICE_SERVER_WS_ACK_WINDOW"},
+        {"affinity", "reactor_cpus", "DEVICE_SERVER_REACTOR_CPUS"},
+        {"affinity", "worker_cpus", "DEVICE_SERVER_WORKER_CPUS"},
+        {"affinity", "background_cpus", "DEVICE_SERVER_BACKGROUND_CPUS"},
+        {"affinity", "numa_node", "DEVICE_SERVER_NUMA_NODE"},
+        {"limits", "queue_capacity", "DEVICE_SERVER_QUEUE_CAPACITY"},
+        {"limits", "queue_target_ms", "DEVICE_SERVER_QUEUE_TARGET_MS"},
+        {"limits", "ip_rate", "DEVICE_SERVER_IP_RATE"},
+        {"limits", "device_rate", "DEVICE_SERVER_DEVICE_RATE"},
     };
     for (const auto& [section, key, envName] : envMappings) {
         const char* envValue = std::getenv(envName.c_str());
         if (envValue && envValue[0] != '\0') {
-            data_[section][key] = envValue;
+            data[section][key] = envValue;
         }
     }
 }
 
-std::string Config::getString(const std::string& section, const std::string& key, const std::string& defaultValue) const {
+void Config::publish(Data data) {
+    auto next = std::make_shared<const Data>(std::move(data));
     std::lock_guard<std::mutex> lock(mutex_);
-    auto sectionIt = data_.find(section);
-    if (sectionIt == data_.end()) return defaultValue;
+    data_ = std::move(next);
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+const Config::Data& Config::current() const {
+    // 版本号未变时直接使用本线程缓存的快照；Config 为单例，缓存不区分实例
+    thread_local std::shared_ptr<const Data> cached;
+    thread_local uint64_t cachedVersion = 0;
+    if (!cached || version_.load(std::memory_order_acquire) != cachedVersion) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cached = data_;
+        cachedVersion = version_.load(std::memory_order_relaxed);
+    }
+    return *cached;
+}
+
+std::shared_ptr<const Config::Data> Config::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_;
+}
+
+bool Config::loadFromFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    Data data = *snapshot();
+    if (!parseFile(filename, data)) return false;
+    publish(std::move(data));
+    filename_ = filename;
+    LOG_INFO("Config loaded from: " + filename);
+    return true;
+}
+
+void Config::loadFromEnv() {
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    Data data = *snapshot();
+    applyEnv(data);
+    publish(std::move(data));
+}
+
+bool Config::reload() {
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    // 从空白开始，文件中删除的键回到默认值
+    Data data;
+    if (!filename_.empty() && !parseFile(filename_, data)) return false;
+    applyEnv(data);
+    publish(std::move(data));
+    LOG_INFO("Config reloaded" + (filename_.empty() ? std::string() : " from: " + filename_));
+    return true;
+}
+
+std::string Config::getString(const std::string& section, const std::string& key, const std::string& defaultValue) const {
+    const Data& data = current();
+    auto sectionIt = data.find(section);
+    if (sectionIt == data.end()) return defaultValue;
     auto keyIt = sectionIt->second.find(key);
     if (keyIt == sectionIt->second.end()) return defaultValue;
     return keyIt->second;
@@ -106,14 +185,16 @@ double Config::getDouble(const std::string& section, const std::string& key, dou
 }
 
 void Config::set(const std::string& section, const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    data_[section][key] = value;
+    std::lock_guard<std::mutex> lock(writeMtx_);
+    Data data = *snapshot();
+    data[section][key] = value;
+    publish(std::move(data));
 }
 
 bool Config::has(const std::string& section, const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto sectionIt = data_.find(section);
-    if (sectionIt == data_.end()) return false;
+    const Data& data = current();
+    auto sectionIt = data.find(section);
+    if (sectionIt == data.end()) return false;
     return sectionIt->second.find(key) != sectionIt->second.end();
 }
 
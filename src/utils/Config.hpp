@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <mutex>
@@ -15,10 +18,15 @@ enum class StorageMode {
 
 /**
  * 配置管理类
- * 支持从 INI 文件和环境变量读取配置
+ * 支持从 INI 文件和环境变量读取配置。
+ * 配置以不可变快照发布：修改（加载、set、reload）复制出新快照后整体替换，读取方各线程缓存
+ * 当前快照，只在版本号变化后取一次锁更新缓存，读路径不加锁
  */
 class Config {
 public:
+    using Section = std::unordered_map<std::string, std::string>;
+    using Data = std::unordered_map<std::string, Section>;
+
     static Config& getInstance();
     Config(const Config&) = delete;
     Config& operator=(const Config&) = delete;
@@ -32,6 +40,17 @@ public:
     double getDouble(const std::string& section, const std::string& key, double defaultValue = 0.0) const;
     void set(const std::string& section, const std::string& key, const std::string& value);
     bool has(const std::string& section, const std::string& key) const;
+
+    /**
+     * 重新读取上次成功加载的配置文件与环境变量，整体替换当前快照（set 写入的值不保留）。
+     * 文件读取失败时保留原配置并返回 false
+     */
+    bool reload();
+    // 当前快照：同一快照内的多个值相互一致，reload 后旧快照仍可安全读取
+    std::shared_ptr<const Data> snapshot() const;
+    // 每次发布新快照时递增
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
     StorageMode getStorageMode() const;
     std::string getMySQLHost() const { return getString("mysql", "host", "127.0.0.1"); }
     int getMySQLPort() const { return getInt("mysql", "port", 3306); }
@@ -40,16 +59,72 @@ public:
     std::string getMySQLDatabase() const { return getString("mysql", "database", "device_data"); }
     int getPoolMinSize() const { return getInt("mysql", "pool_size_min", 5); }
     int getPoolMaxSize() const { return getInt("mysql", "pool_size_max", 20); }
+    int getPoolMaxIdleSec() const { return getInt("mysql", "pool_max_idle_sec", 300); }
+    int getPoolHealthCheckSec() const { return getInt("mysql", "pool_health_check_sec", 60); }
+    int getMySQLAsyncConnections() const { return getInt("mysql", "async_connections", 4); }
+    // 只读副本，逗号分隔的 host[:port]，账号与库名同主库
+    std::string getMySQLReplicas() const { return getString("mysql", "replicas", ""); }
+    int getReplicaMaxLagMs() const { return getInt("mysql", "replica_max_lag_ms", 1000); }
+    // 数据点布局：rows（data_points 每样本一行 JSON）或 packed（data_buckets 按时间桶打包）
+    std::string getDataLayout() const { return getString("mysql", "data_layout", "rows"); }
+    int getBucketSpan() const { return getInt("mysql", "bucket_span", 3600); }
+    int getPartitionSpan() const { return getInt("mysql", "partition_span", 604800); }
+    int getPartitionAhead() const { return getInt("mysql", "partition_ahead", 2); }
+    int getPartitionRetain() const { return getInt("mysql", "partition_retain", 0); }
+    std::string getTimestampUnit() const { return getString("mysql", "timestamp_unit", "s"); }
+    int getCompactDelaySec() const { return getInt("mysql", "compact_delay_sec", 300); }
     int getConnectTimeout() const { return getInt("mysql", "connect_timeout", 5); }
     int getServerPort() const { return getInt("server", "port", 8080); }
     int getThreadPoolSize() const { return getInt("server", "thread_pool_size", 4); }
+    // 平滑升级：交接监听 socket 的 Unix socket 路径（空为关闭）、排空连接与待写数据的时限
+    std::string getHandoffSocket() const { return getString("server", "handoff_socket", ""); }
+    int getDrainTimeoutSec() const { return getInt("server", "drain_timeout_sec", 30); }
     int getBatchSize() const { return getInt("storage", "batch_size", 0); }
     int getBatchIntervalMs() const { return getInt("storage", "batch_interval_ms", 1000); }
+    std::string getWalDir() const { return getString("storage", "wal_dir", ""); }
+    std::string getWalFsync() const { return getString("storage", "wal_fsync", "interval"); }
+    int getWalFsyncIntervalMs() const { return getInt("storage", "wal_fsync_interval_ms", 100); }
+    int getSnapshotIntervalSec() const { return getInt("storage", "snapshot_interval_sec", 300); }
+    int getDeviceRegisterIntervalMs() const { return getInt("storage", "device_register_interval_ms", 200); }
+    int getDeviceRegisterBatch() const { return getInt("storage", "device_register_batch", 500); }
+    std::string getLogLevel() const { return getString("log", "level", "info"); }
+    int getTraceSampleEvery() const { return getInt("trace", "sample_every", 0); }
+    int getRequirementCacheMb() const { return getInt("cache", "requirement_query_mb", 16); }
+    // 查询接口的 ETag / 304；版本号只反映本进程的写入，多实例共用一个 MySQL 库时应关闭
+    bool getConditionalGet() const { return getBool("cache", "conditional_get", true); }
+    // SSE 事件流：每个订阅者的未发送事件上限、队列满时的处理（drop_oldest / disconnect）、心跳间隔
+    int getStreamQueueLimit() const { return getInt("stream", "queue_limit", 256); }
+    std::string getStreamDropPolicy() const { return getString("stream", "drop_policy", "drop_oldest"); }
+    int getStreamHeartbeatSec() const { return getInt("stream", "heartbeat_sec", 15); }
+    // WebSocket 二进制上报：确认窗口（未确认的 REPORT 条数上限）
+    int getWebSocketAckWindow() const { return getInt("websocket", "ack_window", 64); }
+    // CPU 绑定：CPU 列表（如 "0-3,8"），为空不绑定；numa_node（或 nic 所在节点）用于补全未设置的项
+    std::string getReactorCpus() const { return getString("affinity", "reactor_cpus", ""); }
+    std::string getWorkerCpus() const { return getString("affinity", "worker_cpus", ""); }
+    std::string getBackgroundCpus() const { return getString("affinity", "background_cpus", ""); }
+    int getNumaNode() const { return getInt("affinity", "numa_node", -1); }
+    std::string getAffinityNic() const { return getString("affinity", "nic", ""); }
+    int getQueueCapacity() const { return getInt("limits", "queue_capacity", 10000); }
+    int getQueueTargetMs() const { return getInt("limits", "queue_target_ms", 20); }
+    int getQueueIntervalMs() const { return getInt("limits", "queue_interval_ms", 100); }
+    int getRetryAfterSec() const { return getInt("limits", "retry_after_sec", 1); }
+    double getIpRateLimit() const { return getDouble("limits", "ip_rate", 0.0); }
+    double getIpRateBurst() const { return getDouble("limits", "ip_burst", 0.0); }
+    double getDeviceRateLimit() const { return getDouble("limits", "device_rate", 0.0); }
+    double getDeviceRateBurst() const { return getDouble("limits", "device_burst", 0.0); }
 private:
-    Config() = default;
+    Config();
     ~Config() = default;
     static std::string trim(const std::string& str);
     static std::string toUpper(const std::string& str);
-    mutable std::mutex mutex_;
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> data_;
+    static bool parseFile(const std::string& filename, Data& data);
+    static void applyEnv(Data& data);
+    // 本线程缓存的当前快照
+    const Data& current() const;
+    void publish(Data data);
+    mutable std::mutex mutex_;  // 只保护 data_ 指针的替换与读取，不在读路径上
+    std::mutex writeMtx_;       // 串行化修改（复制 - 修改 - 发布）
+    std::shared_ptr<const Data> data_;
+    std::atomic<uint64_t> version_{0};
+    std::string filename_;      // 上次成功加载的文件，受 writeMtx_ 保护
 };
\ No newline at end of file
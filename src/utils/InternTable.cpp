@@ -0,0 +1,36 @@
+#include "InternTable.hpp"
+
+InternTable& InternTable::getInstance() {
+    static InternTable instance;
+    return instance;
+}
+
+InternId InternTable::find(std::string_view s, std::size_t hash) const {
+    const Shard& shard = shardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.ids.find(Key{s, hash});
+    return it == shard.ids.end() ? kInvalidId : it->second;
+}
+
+InternId InternTable::intern(std::string_view s, std::size_t hash) {
+    Shard& shard = shardFor(hash);
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mtx);
+        auto it = shard.ids.find(Key{s, hash});
+        if (it != shard.ids.end()) return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mtx);
+    auto it = shard.ids.find(Key{s, hash});
+    if (it != shard.ids.end()) return it->second;
+
+    // 锁顺序：分片锁先于 appendMtx_
+    InternId id;
+    {
+        std::lock_guard<std::mutex> appendLock(appendMtx_);
+        id = static_cast<InternId>(names_.push_back(std::string(s)));
+    }
+    // 键引用 names_ 中的字符串，元素永不移动
+    shard.ids.emplace(Key{names_[id], hash}, id);
+    return id;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "thread/SegmentedLog.hpp"
+
+// 驻留字符串的紧凑 id（设备 ID、指标名）
+using InternId = uint32_t;
+
+/**
+ * 全局并发字符串驻留表
+ * 相同字符串始终映射到同一个 id，id 在进程生命周期内稳定（不跨重启持久化，
+ * 落盘格式仍写字符串）。查找按哈希分片加读锁，新字符串只锁所在分片；
+ * id → 字符串的反查不加锁，返回的 string_view 永久有效
+ *
+ * 调用方可先计算一次 hash() 再传入 intern/find，避免同一请求内重复哈希
+ */
+class InternTable {
+public:
+    static constexpr InternId kInvalidId = static_cast<InternId>(-1);
+
+    static InternTable& getInstance();
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    static std::size_t hash(std::string_view s) { return std::hash<std::string_view>()(s); }
+
+    // 返回 s 的 id，不存在则分配
+    InternId intern(std::string_view s) { return intern(s, hash(s)); }
+    InternId intern(std::string_view s, std::size_t hash);
+
+    // 仅查找，不存在返回 kInvalidId（查询路径使用，避免未知字符串撑大表）
+    InternId find(std::string_view s) const { return find(s, hash(s)); }
+    InternId find(std::string_view s, std::size_t hash) const;
+
+    // id 必须来自 intern()
+    std::string_view name(InternId id) const { return names_[id]; }
+
+    std::size_t size() const { return names_.size(); }
+
+private:
+    InternTable() = default;
+
+    static constexpr std::size_t kShardBits = 6;
+
+    // 携带预先计算的哈希，map 内部不再对字符串求哈希
+    struct Key {
+        std::string_view str;
+        std::size_t hash;
+        bool operator==(const Key& o) const { return hash == o.hash && str == o.str; }
+    };
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const { return k.hash; }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mtx;
+        std::unordered_map<Key, InternId, KeyHash> ids;
+    };
+
+    Shard& shardFor(std::size_t hash) { return shards_[hash >> (sizeof(std::size_t) * 8 - kShardBits)]; }
+    const Shard& shardFor(std::size_t hash) const { return shards_[hash >> (sizeof(std::size_t) * 8 - kShardBits)]; }
+
+    Shard shards_[std::size_t(1) << kShardBits];
+    std::mutex appendMtx_;                  // 串行化 names_ 的追加（SegmentedLog 单写者）
+    SegmentedLog<std::string> names_;
+};
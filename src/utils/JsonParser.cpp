@@ -1,16 +1,21 @@
 #include "JsonParser.hpp"
-#include <sstream>
+#include "Tracer.hpp"
+#include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
 
 void JsonParser::skipWhitespace(const char*& p, const char* end) {
     while (p < end && std::isspace(*p)) ++p;
 }
 
-JsonValue JsonParser::parseString(const char*& p, const char* end) {
+JsonValue JsonParser::parseString(const char*& p, const char* end, std::pmr::memory_resource* mr) {
     if (p >= end || *p != '"') return JsonValue(nullptr);
     ++p;
-    std::string s;
+    JsonValue::String s(mr);
     while (p < end && *p != '"') {
         if (*p == '\\' && p + 1 < end) {
             ++p;
@@ -28,7 +33,7 @@ JsonValue JsonParser::parseString(const char*& p, const char* end) {
         ++p;
     }
     if (p < end) ++p;
-    return JsonValue(s);
+    return JsonValue(std::move(s));
 }
 
 JsonValue JsonParser::parseNumber(const char*& p, const char* end) {
@@ -38,26 +43,30 @@ JsonValue JsonParser::parseNumber(const char*& p, const char* end) {
         if (*p == '.' || *p == 'e' || *p == 'E') isFloat = true;
         ++p;
     }
-    std::string numStr(start, p);
+    // 数字字面量很短，复制到栈上再转换，避免临时 std::string
+    char buf[64];
+    std::size_t len = std::min(static_cast<std::size_t>(p - start), sizeof(buf) - 1);
+    std::memcpy(buf, start, len);
+    buf[len] = '\0';
     if (isFloat) {
-        return JsonValue(std::stod(numStr));
+        return JsonValue(std::strtod(buf, nullptr));
     } else {
-        return JsonValue(std::stoll(numStr));
+        return JsonValue(std::strtoll(buf, nullptr, 10));
     }
 }
 
-JsonValue JsonParser::parseArray(const char*& p, const char* end) {
+JsonValue JsonParser::parseArray(const char*& p, const char* end, std::pmr::memory_resource* mr) {
     if (p >= end || *p != '[') return JsonValue(nullptr);
     ++p;
     skipWhitespace(p, end);
-    std::vector<JsonValue> arr;
+    JsonValue::Array arr(mr);
     if (p < end && *p == ']') {
         ++p;
-        return JsonValue(arr);
+        return JsonValue(std::move(arr));
     }
     while (p < end) {
         skipWhitespace(p, end);
-        arr.push_back(parseValue(p, end));
+        arr.push_back(parseValue(p, end, mr));
         skipWhitespace(p, end);
         if (p >= end || *p == ']') {
             if (p < end) ++p;
@@ -66,29 +75,28 @@ JsonValue JsonParser::parseArray(const char*& p, const char* end) {
         if (*p != ',') break;
         ++p;
     }
-    return JsonValue(arr);
+    return JsonValue(std::move(arr));
 }
 
-JsonValue JsonParser::parseObject(const char*& p, const char* end) {
+JsonValue JsonParser::parseObject(const char*& p, const char* end, std::pmr::memory_resource* mr) {
     if (p >= end || *p != '{') return JsonValue(nullptr);
     ++p;
     skipWhitespace(p, end);
-    std::unordered_map<std::string, JsonValue> obj;
+    JsonValue::Object obj(mr);
     if (p < end && *p == '}') {
         ++p;
-        return JsonValue(obj);
+        return JsonValue(std::move(obj));
     }
     while (p < end) {
         skipWhitespace(p, end);
         if (*p != '"') break;
-        JsonValue keyVal = parseString(p, end);
+        JsonValue keyVal = parseString(p, end, mr);
         if (!keyVal.isString()) break;
-        std::string key = keyVal.asString();
         skipWhitespace(p, end);
         if (p >= end || *p != ':') break;
         ++p;
         skipWhitespace(p, end);
-        obj[key] = parseValue(p, end);
+        obj[keyVal.asString()] = parseValue(p, end, mr);
         skipWhitespace(p, end);
         if (p >= end || *p == '}') {
             if (p < end) ++p;
@@ -97,97 +105,138 @@ JsonValue JsonParser::parseObject(const char*& p, const char* end) {
         if (*p != ',') break;
         ++p;
     }
-    return JsonValue(obj);
+    return JsonValue(std::move(obj));
 }
 
-JsonValue JsonParser::parseValue(const char*& p, const char* end) {
+JsonValue JsonParser::parseValue(const char*& p, const char* end, std::pmr::memory_resource* mr) {
     skipWhitespace(p, end);
     if (p >= end) return JsonValue(nullptr);
     
     if (*p == '"') {
-        return parseString(p, end);
+        return parseString(p, end, mr);
     } else if (*p == '{') {
-        return parseObject(p, end);
+        return parseObject(p, end, mr);
     } else if (*p == '[') {
-        return parseArray(p, end);
+        return parseArray(p, end, mr);
     } else if (*p == '-' || std::isdigit(*p)) {
         return parseNumber(p, end);
-    } else if (p + 4 <= end && std::string(p, p + 4) == "null") {
+    } else if (p + 4 <= end && std::memcmp(p, "null", 4) == 0) {
         p += 4;
         return JsonValue(nullptr);
-    } else if (p + 4 <= end && std::string(p, p + 4) == "true") {
+    } else if (p + 4 <= end && std::memcmp(p, "true", 4) == 0) {
         p += 4;
         return JsonValue(true);
-    } else if (p + 5 <= end && std::string(p, p + 5) == "false") {
+    } else if (p + 5 <= end && std::memcmp(p, "false", 5) == 0) {
         p += 5;
         return JsonValue(false);
     }
     return JsonValue(nullptr);
 }
 
-JsonValue JsonParser::parse(const std::string& json) {
-    const char* p = json.c_str();
+JsonValue JsonParser::parse(std::string_view json, std::pmr::memory_resource* mr) {
+    TRACE_SPAN("json.parse");
+    const char* p = json.data();
     const char* end = p + json.size();
-    return parseValue(p, end);
+    return parseValue(p, end, mr);
 }
 
-std::string JsonParser::stringify(const JsonValue& value) {
-    if (value.isNull()) {
-        return "null";
-    } else if (value.isString()) {
-        return "\"" + escapeString(value.asString()) + "\"";
-    } else {
-        const auto& val = value.getValue();
-        if (std::holds_alternative<bool>(val)) {
-            return std::get<bool>(val) ? "true" : "false";
+bool JsonParser::forEach(std::string_view text, const std::function<bool(const JsonValue&)>& fn) {
+    TRACE_SPAN("json.parse");
+    // 逐个元素解析后即丢弃，使用默认分配：单调分配区在大批量请求下只增不减
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+    const char* p = text.data();
+    const char* end = p + text.size();
+    skipWhitespace(p, end);
+    if (p >= end) return true;
+
+    if (*p == '[') {
+        ++p;
+        skipWhitespace(p, end);
+        if (p < end && *p == ']') return true;
+        while (p < end) {
+            if (!fn(parseValue(p, end, mr))) return false;
+            skipWhitespace(p, end);
+            if (p < end && *p == ']') return true;
+            if (p >= end || *p != ',') return false;
+            ++p;
         }
+        return false;
     }
-    if (value.isNumber()) {
-        std::ostringstream oss;
-        const auto& val = value.getValue();
-        if (std::holds_alternative<long long>(val)) {
-            oss << std::get<long long>(val);
-        } else if (std::holds_alternative<double>(val)) {
-            oss << std::get<double>(val);
+
+    // NDJSON：空白行忽略
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!lineEnd) lineEnd = end;
+        const char* q = p;
+        skipWhitespace(q, lineEnd);
+        if (q < lineEnd) {
+            if (!fn(parseValue(q, lineEnd, mr))) return false;
         }
-        return oss.str();
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return true;
+}
+
+std::string JsonParser::stringify(const JsonValue& value) {
+    std::pmr::string out;
+    stringifyTo(value, out);
+    return std::string(out);
+}
+
+void JsonParser::stringifyTo(const JsonValue& value, std::pmr::string& out) {
+    const auto& val = value.getValue();
+    if (value.isNull()) {
+        out += "null";
+    } else if (value.isString()) {
+        out += '"';
+        escapeStringTo(value.asString(), out);
+        out += '"';
+    } else if (std::holds_alternative<bool>(val)) {
+        out += std::get<bool>(val) ? "true" : "false";
+    } else if (std::holds_alternative<long long>(val)) {
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof(buf), std::get<long long>(val));
+        out.append(buf, res.ptr);
+    } else if (std::holds_alternative<double>(val)) {
+        // 与 ostream 默认格式一致（%g，6 位有效数字）
+        char buf[32];
+        int n = std::snprintf(buf, sizeof(buf), "%g", std::get<double>(val));
+        out.append(buf, static_cast<std::size_t>(n));
     } else if (value.isObject()) {
-        std::ostringstream oss;
-        oss << "{";
+        out += '{';
         bool first = true;
         for (const auto& [k, v] : value.asObject()) {
-            if (!first) oss << ",";
+            if (!first) out += ',';
             first = false;
-            oss << "\"" << escapeString(k) << "\":" << stringify(v);
+            out += '"';
+            escapeStringTo(k, out);
+            out += "\":";
+            stringifyTo(v, out);
         }
-        oss << "}";
-        return oss.str();
+        out += '}';
     } else if (value.isArray()) {
-        std::ostringstream oss;
-        oss << "[";
+        out += '[';
         bool first = true;
         for (const auto& v : value.asArray()) {
-            if (!first) oss << ",";
+            if (!first) out += ',';
             first = false;
-            oss << stringify(v);
+            stringifyTo(v, out);
         }
-        oss << "]";
-        return oss.str();
+        out += ']';
+    } else {
+        out += "null";
     }
-    return "null";
 }
 
-std::string JsonParser::escapeString(const std::string& s) {
-    std::string result;
+void JsonParser::escapeStringTo(std::string_view s, std::pmr::string& out) {
     for (char c : s) {
         switch (c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default: result += c; break;
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: out += c; break;
         }
     }
-    return result;
 }
@@ -1,36 +1,54 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <variant>
+#include <functional>
+#include <memory_resource>
+#include <type_traits>
 
 // 简易 JSON 解析器（仅支持基本类型和对象）
+// 字符串与容器均为 std::pmr 类型：解析与构造时可传入请求级分配区（见 RequestArena），
+// 未指定时使用默认堆分配
 class JsonValue {
 public:
-    using Value = std::variant<std::nullptr_t, bool, long long, double, std::string, 
-                               std::unordered_map<std::string, JsonValue>, 
-                               std::vector<JsonValue>>;
+    using String = std::pmr::string;
+    using Object = std::pmr::unordered_map<std::pmr::string, JsonValue>;
+    using Array = std::pmr::vector<JsonValue>;
+    using Value = std::variant<std::nullptr_t, bool, long long, double, String, Object, Array>;
     
     JsonValue() : value_(nullptr) {}
-    JsonValue(Value v) : value_(std::move(v)) {}
+    JsonValue(std::nullptr_t) : value_(nullptr) {}
+    JsonValue(bool v) : value_(v) {}
+    JsonValue(double v) : value_(v) {}
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    JsonValue(T v) : value_(static_cast<long long>(v)) {}
+    JsonValue(String s) : value_(std::move(s)) {}
+    JsonValue(std::string_view s, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : value_(String(s, mr)) {}
+    JsonValue(const char* s, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : value_(String(s, mr)) {}
+    JsonValue(Object obj) : value_(std::move(obj)) {}
+    JsonValue(Array arr) : value_(std::move(arr)) {}
     
     bool isNull() const { return std::holds_alternative<std::nullptr_t>(value_); }
-    bool isObject() const { return std::holds_alternative<std::unordered_map<std::string, JsonValue>>(value_); }
-    bool isArray() const { return std::holds_alternative<std::vector<JsonValue>>(value_); }
-    bool isString() const { return std::holds_alternative<std::string>(value_); }
+    bool isObject() const { return std::holds_alternative<Object>(value_); }
+    bool isArray() const { return std::holds_alternative<Array>(value_); }
+    bool isString() const { return std::holds_alternative<String>(value_); }
     bool isNumber() const { return std::holds_alternative<long long>(value_) || std::holds_alternative<double>(value_); }
     
-    const std::unordered_map<std::string, JsonValue>& asObject() const {
-        return std::get<std::unordered_map<std::string, JsonValue>>(value_);
+    const Object& asObject() const {
+        return std::get<Object>(value_);
     }
     
-    const std::vector<JsonValue>& asArray() const {
-        return std::get<std::vector<JsonValue>>(value_);
+    const Array& asArray() const {
+        return std::get<Array>(value_);
     }
     
-    const std::string& asString() const {
-        return std::get<std::string>(value_);
+    const String& asString() const {
+        return std::get<String>(value_);
     }
     
     long long asInt() const {
@@ -47,36 +65,51 @@ public:
         return static_cast<double>(std::get<long long>(value_));
     }
     
-    bool has(const std::string& key) const {
+    bool has(std::string_view key) const {
         if (!isObject()) return false;
-        return asObject().find(key) != asObject().end();
+        return find(key) != nullptr;
     }
     
-    const JsonValue& get(const std::string& key) const {
-        static JsonValue nullValue;
-        if (!isObject()) return nullValue;
-        auto it = asObject().find(key);
-        if (it == asObject().end()) return nullValue;
-        return it->second;
+    const JsonValue& get(std::string_view key) const {
+        static const JsonValue nullValue;
+        const JsonValue* v = isObject() ? find(key) : nullptr;
+        return v ? *v : nullValue;
     }
     
     const Value& getValue() const { return value_; }
     
 private:
+    // 键与对象使用同一分配器，短键落在 SSO 内不分配
+    const JsonValue* find(std::string_view key) const {
+        const Object& obj = asObject();
+        auto it = obj.find(String(key, obj.get_allocator()));
+        return it == obj.end() ? nullptr : &it->second;
+    }
+
     Value value_;
 };
 
 class JsonParser {
 public:
-    static JsonValue parse(const std::string& json);
+    static JsonValue parse(std::string_view json, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
     static std::string stringify(const JsonValue& value);
     
+    // 追加序列化结果到 out（不经过 ostringstream，out 可为请求分配区上的字符串）
+    static void stringifyTo(const JsonValue& value, std::pmr::string& out);
+    
+    /**
+     * 流式遍历多个 JSON 值：顶层数组逐元素解析，否则按 NDJSON（每行一个值）解析
+     * 不构造整体数组 DOM；回调返回 false 时提前终止
+     * @return 输入格式合法且未被提前终止时返回 true
+     */
+    static bool forEach(std::string_view text, const std::function<bool(const JsonValue&)>& fn);
+    
 private:
-    static JsonValue parseValue(const char*& p, const char* end);
-    static JsonValue parseObject(const char*& p, const char* end);
-    static JsonValue parseArray(const char*& p, const char* end);
-    static JsonValue parseString(const char*& p, const char* end);
+    static JsonValue parseValue(const char*& p, const char* end, std::pmr::memory_resource* mr);
+    static JsonValue parseObject(const char*& p, const char* end, std::pmr::memory_resource* mr);
+    static JsonValue parseArray(const char*& p, const char* end, std::pmr::memory_resource* mr);
+    static JsonValue parseString(const char*& p, const char* end, std::pmr::memory_resource* mr);
     static JsonValue parseNumber(const char*& p, const char* end);
     static void skipWhitespace(const char*& p, const char* end);
-    static std::string escapeString(const std::string& s);
+    static void escapeStringTo(std::string_view s, std::pmr::string& out);
 };
@@ -1,13 +1,25 @@
 #include "Logger.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <chrono>
-#include <iomanip>
+#include <condition_variable>
+#include <cstdio>
+#include <cctype>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<int> Logger::minLevel_{static_cast<int>(LogLevel::INFO)};
+
+namespace {
 
-std::mutex Logger::mtx_;
-std::ofstream Logger::ofs_;
+using Clock = std::chrono::system_clock;
 
-static const char* levelToString(LogLevel level) {
+const char* levelToString(LogLevel level) {
     switch (level) {
     case LogLevel::DEBUG: return "DEBUG";
     case LogLevel::INFO:  return "INFO";
@@ -17,28 +29,246 @@ static const char* levelToString(LogLevel level) {
     }
 }
 
+struct Entry {
+    LogLevel level = LogLevel::INFO;
+    Clock::time_point time;
+    std::string msg;
+};
+
+// 单生产者（所属线程）单消费者（写线程）环形缓冲区
+struct Ring {
+    static constexpr std::size_t kCapacity = 1024;
+
+    Entry entries[kCapacity];
+    alignas(64) std::atomic<std::size_t> head{0};   // 生产者写入位置
+    alignas(64) std::atomic<std::size_t> tail{0};   // 消费者读取位置
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> orphaned{false};              // 所属线程已退出
+};
+
+// 按秒缓存格式化后的时间
+class TimeFormatter {
+public:
+    const char* format(Clock::time_point tp) {
+        std::time_t t = Clock::to_time_t(tp);
+        if (t != cachedSec_) {
+            std::tm tm_time{};
+#if defined(_WIN32)
+            localtime_s(&tm_time, &t);
+#else
+            localtime_r(&t, &tm_time);
+#endif
+            std::strftime(buf_, sizeof(buf_), "%Y-%m-%d %H:%M:%S", &tm_time);
+            cachedSec_ = t;
+        }
+        return buf_;
+    }
+
+private:
+    std::time_t cachedSec_ = -1;
+    char buf_[32] = {0};
+};
+
+struct State {
+    std::mutex mtx;                 // 保护 rings / ofs / 同步写入
+    std::condition_variable cv;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::ofstream ofs;
+    std::thread writer;
+    std::atomic<bool> async{false};
+    bool running = false;
+    TimeFormatter syncTime;         // 同步路径使用（持有 mtx）
+
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> written{0};
+};
+
+// 有意不析构：线程退出与静态析构顺序无关
+State& state() {
+    static State* s = new State();
+    return *s;
+}
+
+// 线程退出时标记缓冲区，由写线程在取空后回收
+struct RingHolder {
+    std::shared_ptr<Ring> ring;
+    ~RingHolder() {
+        if (ring) ring->orphaned.store(true, std::memory_order_release);
+    }
+};
+
+Ring& localRing() {
+    thread_local RingHolder holder;
+    if (!holder.ring) {
+        holder.ring = std::make_shared<Ring>();
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.rings.push_back(holder.ring);
+    }
+    return *holder.ring;
+}
+
+void appendLine(std::string& out, TimeFormatter& fmt, const Entry& e) {
+    out += fmt.format(e.time);
+    out += " [";
+    out += levelToString(e.level);
+    out += "] ";
+    out += e.msg;
+    out += '\n';
+}
+
+void writeOut(State& s, const std::string& out) {
+    if (s.ofs.is_open()) {
+        s.ofs.write(out.data(), static_cast<std::streamsize>(out.size()));
+        s.ofs.flush();
+    } else {
+        std::cerr.write(out.data(), static_cast<std::streamsize>(out.size()));
+        std::cerr.flush();
+    }
+}
+
+// 取出所有缓冲区中的日志，按时间排序后一次写出；返回写出条数
+std::size_t drain(State& s, TimeFormatter& fmt, std::vector<Entry>& batch, std::string& out) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        rings = s.rings;
+    }
+
+    uint64_t dropped = 0;
+    for (const auto& ring : rings) {
+        std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        std::size_t head = ring->head.load(std::memory_order_acquire);
+        for (std::size_t i = tail; i < head; ++i) {
+            batch.push_back(std::move(ring->entries[i % Ring::kCapacity]));
+        }
+        ring->tail.store(head, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (!batch.empty() || dropped > 0) {
+        std::stable_sort(batch.begin(), batch.end(),
+            [](const Entry& a, const Entry& b) { return a.time < b.time; });
+        out.clear();
+        for (const auto& e : batch) appendLine(out, fmt, e);
+        if (dropped > 0) {
+            s.dropped.fetch_add(dropped, std::memory_order_relaxed);
+            Entry e;
+            e.level = LogLevel::WARN;
+            e.time = Clock::now();
+            e.msg = "Logger dropped " + std::to_string(dropped) + " messages (buffer full)";
+            appendLine(out, fmt, e);
+        }
+        std::lock_guard<std::mutex> lock(s.mtx);
+        writeOut(s, out);
+        // 回收已退出线程且已取空的缓冲区
+        s.rings.erase(std::remove_if(s.rings.begin(), s.rings.end(), [](const std::shared_ptr<Ring>& r) {
+            return r->orphaned.load(std::memory_order_acquire) &&
+                   r->tail.load(std::memory_order_relaxed) == r->head.load(std::memory_order_acquire);
+        }), s.rings.end());
+    }
+
+    std::size_t n = batch.size();
+    s.written.fetch_add(n, std::memory_order_relaxed);
+    batch.clear();
+    return n;
+}
+
+void writerLoop() {
+    State& s = state();
+    TimeFormatter fmt;
+    std::vector<Entry> batch;
+    std::string out;
+    std::unique_lock<std::mutex> lock(s.mtx);
+    while (s.running) {
+        s.cv.wait_for(lock, std::chrono::milliseconds(50));
+        lock.unlock();
+        drain(s, fmt, batch, out);
+        lock.lock();
+    }
+    lock.unlock();
+    drain(s, fmt, batch, out);
+}
+
+} // namespace
+
 void Logger::init(const std::string& filename) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    ofs_.open(filename, std::ios::app);
-    if (!ofs_) {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    s.ofs.open(filename, std::ios::app);
+    if (!s.ofs) {
         std::cerr << "Failed to open log file: " << filename << std::endl;
     }
+    if (!s.running) {
+        s.running = true;
+        s.writer = std::thread(writerLoop);
+        s.async.store(true, std::memory_order_release);
+    }
 }
 
-void Logger::log(LogLevel level, const std::string& msg) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto now = std::chrono::system_clock::now();
-    auto t = std::chrono::system_clock::to_time_t(now);
-    std::tm tm_time{};
-#if defined(_WIN32)
-    localtime_s(&tm_time, &t);
-#else
-    localtime_r(&t, &tm_time);
-#endif
+void Logger::shutdown() {
+    State& s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        if (!s.running) return;
+        s.running = false;
+        s.async.store(false, std::memory_order_release);
+    }
+    s.cv.notify_all();
+    if (s.writer.joinable()) s.writer.join();
+}
+
+void Logger::log(LogLevel level, std::string msg) {
+    State& s = state();
+    if (!s.async.load(std::memory_order_acquire)) {
+        // 同步路径：未初始化或已关闭
+        Entry e;
+        e.level = level;
+        e.time = Clock::now();
+        e.msg = std::move(msg);
+        std::string out;
+        std::lock_guard<std::mutex> lock(s.mtx);
+        appendLine(out, s.syncTime, e);
+        writeOut(s, out);
+        s.written.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Ring& ring = localRing();
+    std::size_t head = ring.head.load(std::memory_order_relaxed);
+    std::size_t used = head - ring.tail.load(std::memory_order_acquire);
+    if (used >= Ring::kCapacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Entry& e = ring.entries[head % Ring::kCapacity];
+    e.level = level;
+    e.time = Clock::now();
+    e.msg = std::move(msg);
+    ring.head.store(head + 1, std::memory_order_release);
 
-    std::ostream& out = ofs_.is_open() ? ofs_ : std::cerr;
-    out << std::put_time(&tm_time, "%Y-%m-%d %H:%M:%S")
-        << " [" << levelToString(level) << "] "
-        << msg << std::endl;
+    // 错误日志或缓冲区将满时提前唤醒写线程，其余情况由写线程定时取出
+    if (level == LogLevel::ERROR || used + 1 >= Ring::kCapacity * 3 / 4) {
+        s.cv.notify_one();
+    }
+}
+
+bool Logger::parseLevel(const std::string& name, LogLevel& level) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+        [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+    if (lower == "debug") level = LogLevel::DEBUG;
+    else if (lower == "info") level = LogLevel::INFO;
+    else if (lower == "warn" || lower == "warning") level = LogLevel::WARN;
+    else if (lower == "error") level = LogLevel::ERROR;
+    else return false;
+    return true;
 }
 
+uint64_t Logger::getDroppedCount() {
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t Logger::getWrittenCount() {
+    return state().written.load(std::memory_order_relaxed);
+}
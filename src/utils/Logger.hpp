@@ -1,8 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
-#include <mutex>
-#include <fstream>
 
 enum class LogLevel {
     DEBUG,
@@ -11,18 +11,50 @@ enum class LogLevel {
     ERROR
 };
 
+/**
+ * 异步日志
+ * 调用线程把消息写入自己的无锁环形缓冲区（单生产者单消费者），后台写线程批量取出、
+ * 按时间合并后一次写入文件并 flush；时间戳按秒缓存格式化结果。
+ * 环形缓冲区满时丢弃消息并计数，不阻塞调用方。
+ * 级别在构造消息之前判断（LOG_* 宏），低于当前级别的日志不产生任何开销。
+ * 未调用 init 或 shutdown 之后退化为同步写入
+ */
 class Logger {
 public:
     static void init(const std::string& filename);
-    static void log(LogLevel level, const std::string& msg);
+
+    /**
+     * 停止后台写线程并写出剩余日志，之后的日志同步写入
+     */
+    static void shutdown();
+
+    static void log(LogLevel level, std::string msg);
+
+    static void setLevel(LogLevel level) { minLevel_.store(static_cast<int>(level), std::memory_order_relaxed); }
+    static LogLevel getLevel() { return static_cast<LogLevel>(minLevel_.load(std::memory_order_relaxed)); }
+    static bool shouldLog(LogLevel level) {
+        return static_cast<int>(level) >= minLevel_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 解析级别名（debug / info / warn / error，大小写不敏感），无法识别时返回 false
+     */
+    static bool parseLevel(const std::string& name, LogLevel& level);
+
+    // 因缓冲区满而丢弃的消息数
+    static uint64_t getDroppedCount();
+    // 已写出的消息数
+    static uint64_t getWrittenCount();
 
 private:
-    static std::mutex mtx_;
-    static std::ofstream ofs_;
+    static std::atomic<int> minLevel_;
 };
 
-#define LOG_DEBUG(msg) Logger::log(LogLevel::DEBUG, msg)
-#define LOG_INFO(msg)  Logger::log(LogLevel::INFO, msg)
-#define LOG_WARN(msg)  Logger::log(LogLevel::WARN, msg)
-#define LOG_WARNING(msg) Logger::log(LogLevel::WARN, msg)
-#define LOG_ERROR(msg) Logger::log(LogLevel::ERROR, msg)
+#define LOG_AT(level, msg) \
+    do { if (Logger::shouldLog(level)) Logger::log(level, msg); } while (0)
+
+#define LOG_DEBUG(msg) LOG_AT(LogLevel::DEBUG, msg)
+#define LOG_INFO(msg)  LOG_AT(LogLevel::INFO, msg)
+#define LOG_WARN(msg)  LOG_AT(LogLevel::WARN, msg)
+#define LOG_WARNING(msg) LOG_AT(LogLevel::WARN, msg)
+#define LOG_ERROR(msg) LOG_AT(LogLevel::ERROR, msg)
@@ -0,0 +1,192 @@
+#include "Metrics.hpp"
+
+#include <charconv>
+#include <cstdio>
+
+std::size_t metricShardIndex() {
+    static std::atomic<std::size_t> nextIndex{0};
+    thread_local std::size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return index;
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& cell : cells_) total += cell.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+int64_t Gauge::value() const {
+    int64_t total = 0;
+    for (const auto& cell : cells_) total += cell.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+uint64_t Histogram::bucketUpperBound(std::size_t index) {
+    constexpr std::size_t kSubBucketCount = std::size_t(1) << kSubBucketBits;
+    if (index < kSubBucketCount) return index + 1;
+    std::size_t group = index >> kSubBucketBits;
+    std::size_t sub = index & (kSubBucketCount - 1);
+    int shift = static_cast<int>(group) - 1;
+    return (static_cast<uint64_t>(kSubBucketCount + sub + 1)) << shift;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snap;
+    snap.buckets.assign(kBucketCount, 0);
+    for (const auto& shard : shards_) {
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+            snap.buckets[i] += n;
+            snap.count += n;
+        }
+        snap.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return snap;
+}
+
+Metrics& Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+Metrics::Series& Metrics::series(const std::string& name, const std::string& help, Type type,
+                                 const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(name, Family{help, type, {}}).first;
+    }
+    for (auto& s : it->second.series) {
+        if (s->labels == labels) return *s;
+    }
+    it->second.series.push_back(std::make_unique<Series>());
+    Series& s = *it->second.series.back();
+    s.labels = labels;
+    return s;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    Series& s = series(name, help, Type::COUNTER, labels);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!s.counter) s.counter = std::make_unique<Counter>();
+    return *s.counter;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    Series& s = series(name, help, Type::GAUGE, labels);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!s.gauge) s.gauge = std::make_unique<Gauge>();
+    return *s.gauge;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help, const std::string& labels) {
+    Series& s = series(name, help, Type::HISTOGRAM, labels);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!s.histogram) s.histogram = std::make_unique<Histogram>();
+    return *s.histogram;
+}
+
+void Metrics::gaugeCallback(const std::string& name, const std::string& help, std::function<double()> fn,
+                            const std::string& labels) {
+    Series& s = series(name, help, Type::GAUGE, labels);
+    std::lock_guard<std::mutex> lock(mtx_);
+    s.callback = std::move(fn);
+}
+
+void Metrics::counterCallback(const std::string& name, const std::string& help, std::function<double()> fn,
+                              const std::string& labels) {
+    Series& s = series(name, help, Type::COUNTER, labels);
+    std::lock_guard<std::mutex> lock(mtx_);
+    s.callback = std::move(fn);
+}
+
+namespace {
+
+// 导出的直方图分界（秒），HDR 桶按上界归入不小于它的第一个分界
+constexpr double kExportBounds[] = {
+    0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+void appendNumber(std::string& out, double v) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%.9g", v);
+    out.append(buf, static_cast<std::size_t>(n));
+}
+
+template <typename Int>
+void appendInt(std::string& out, Int v) {
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+}
+
+void appendName(std::string& out, const std::string& name, const char* suffix,
+                const std::string& labels, const std::string& extraLabel = "") {
+    out += name;
+    out += suffix;
+    if (!labels.empty() || !extraLabel.empty()) {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extraLabel.empty()) out += ',';
+        out += extraLabel;
+        out += '}';
+    }
+    out += ' ';
+}
+
+}  // namespace
+
+void Metrics::render(std::string& out) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& [name, family] : families_) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += family.help;
+        out += "\n# TYPE ";
+        out += name;
+        out += family.type == Type::COUNTER ? " counter\n" : family.type == Type::GAUGE ? " gauge\n" : " histogram\n";
+
+        for (const auto& s : family.series) {
+            if (s->callback) {
+                appendName(out, name, "", s->labels);
+                appendNumber(out, s->callback());
+                out += '\n';
+            } else if (family.type == Type::COUNTER && s->counter) {
+                appendName(out, name, "", s->labels);
+                appendInt(out, s->counter->value());
+                out += '\n';
+            } else if (family.type == Type::GAUGE && s->gauge) {
+                appendName(out, name, "", s->labels);
+                appendInt(out, s->gauge->value());
+                out += '\n';
+            } else if (family.type == Type::HISTOGRAM && s->histogram) {
+                Histogram::Snapshot snap = s->histogram->snapshot();
+                uint64_t cumulative = 0;
+                std::size_t bucket = 0;
+                for (double bound : kExportBounds) {
+                    uint64_t boundNs = static_cast<uint64_t>(bound * 1e9);
+                    while (bucket < snap.buckets.size() && Histogram::bucketUpperBound(bucket) <= boundNs) {
+                        cumulative += snap.buckets[bucket++];
+                    }
+                    std::string le = "le=\"";
+                    appendNumber(le, bound);
+                    le += '"';
+                    appendName(out, name, "_bucket", s->labels, le);
+                    appendInt(out, cumulative);
+                    out += '\n';
+                }
+                appendName(out, name, "_bucket", s->labels, "le=\"+Inf\"");
+                appendInt(out, snap.count);
+                out += '\n';
+                appendName(out, name, "_sum", s->labels);
+                appendNumber(out, static_cast<double>(snap.sum) / 1e9);
+                out += '\n';
+                appendName(out, name, "_count", s->labels);
+                appendInt(out, snap.count);
+                out += '\n';
+            }
+        }
+    }
+}
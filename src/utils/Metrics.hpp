@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * 运行指标（Prometheus 文本格式导出）
+ * 记录端按线程分片：每个线程固定写一个独占缓存行的分片，只做 relaxed 原子加，
+ * 不加锁、不与其他线程争用同一缓存行；抓取 /api/v1/metrics 时才汇总各分片。
+ * 指标对象在启动阶段注册一次，热路径上直接持有引用
+ */
+
+// 分片数；线程按首次记录的顺序轮流分配到分片
+constexpr std::size_t kMetricShards = 16;
+
+// 当前线程的分片下标
+std::size_t metricShardIndex();
+
+class Counter {
+public:
+    void inc(uint64_t n = 1) {
+        cells_[metricShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<uint64_t> value{0};
+    };
+    Cell cells_[kMetricShards];
+};
+
+// 可增可减的计数（当前连接数、队列深度等），各分片之和为当前值
+class Gauge {
+public:
+    void add(int64_t n) {
+        cells_[metricShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+    void inc() { add(1); }
+    void dec() { add(-1); }
+    int64_t value() const;
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<int64_t> value{0};
+    };
+    Cell cells_[kMetricShards];
+};
+
+/**
+ * HDR 风格耗时直方图（单位纳秒）
+ * 每个 2 的幂区间再等分 8 个子桶，相对误差不超过 12.5%，覆盖 0 ~ 2^40 ns（约 18 分钟），
+ * 超出范围的值计入最后一个桶。记录只需几次位运算和两次原子加
+ */
+class Histogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kMaxExponent = 40;
+    static constexpr std::size_t kBucketCount =
+        static_cast<std::size_t>(kMaxExponent - kSubBucketBits + 1) << kSubBucketBits;
+
+    void record(uint64_t ns) {
+        Shard& shard = shards_[metricShardIndex()];
+        shard.buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    void recordSince(std::chrono::steady_clock::time_point start) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    // 各分片汇总后的结果
+    struct Snapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+    };
+    Snapshot snapshot() const;
+
+    static std::size_t bucketIndex(uint64_t ns) {
+        constexpr uint64_t kSubBucketCount = uint64_t(1) << kSubBucketBits;
+        if (ns < kSubBucketCount) return static_cast<std::size_t>(ns);
+        if (ns >= (uint64_t(1) << kMaxExponent)) return kBucketCount - 1;
+        int exponent = 63 - __builtin_clzll(ns);
+        std::size_t sub = static_cast<std::size_t>(ns >> (exponent - kSubBucketBits)) & (kSubBucketCount - 1);
+        return (static_cast<std::size_t>(exponent - kSubBucketBits + 1) << kSubBucketBits) + sub;
+    }
+
+    // 桶的上界（不含）
+    static uint64_t bucketUpperBound(std::size_t index);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[kBucketCount] = {};
+        std::atomic<uint64_t> sum{0};
+    };
+    Shard shards_[kMetricShards];
+};
+
+// 作用域计时：析构（或 stop）时把耗时记入直方图
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram* histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { stop(); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    // 计时中途才确定归属时（如路由）改写目标直方图
+    void retarget(Histogram* histogram) { histogram_ = histogram; }
+
+    void stop() {
+        if (histogram_) {
+            histogram_->recordSince(start_);
+            histogram_ = nullptr;
+        }
+    }
+
+private:
+    Histogram* histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * 指标注册表
+ * 同名指标可带不同标签（如 route="/api/v1/report"），导出时归为同一组；
+ * 重复注册相同名称与标签返回已有对象。回调型指标在抓取时求值，
+ * 适合本身已有计数的组件（连接池空闲数等）
+ */
+class Metrics {
+public:
+    static Metrics& getInstance();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // labels 为已格式化的标签串，如 route="/api/v1/query"，可为空
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+    void gaugeCallback(const std::string& name, const std::string& help, std::function<double()> fn,
+                       const std::string& labels = "");
+    // 回调型 counter：组件自带单调计数时使用（如日志丢弃数）
+    void counterCallback(const std::string& name, const std::string& help, std::function<double()> fn,
+                         const std::string& labels = "");
+
+    // 以 Prometheus 文本格式输出全部指标（追加到 out）
+    void render(std::string& out) const;
+
+private:
+    Metrics() = default;
+
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> callback;
+    };
+
+    struct Family {
+        std::string help;
+        Type type;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    Series& series(const std::string& name, const std::string& help, Type type, const std::string& labels);
+
+    mutable std::mutex mtx_;  // 仅保护注册与导出，记录路径不加锁
+    std::map<std::string, Family> families_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+/**
+ * 请求级 bump 分配区
+ * 一个请求从解析、处理到序列化产生的临时对象（HttpRequest、JsonValue DOM、请求结构体、
+ * 响应 JSON）都从这里分配，请求结束时整体释放，不逐个 free。
+ * 每个线程持有一块可复用的初始缓冲区，普通大小的请求不触发任何堆分配；超出部分向堆申请。
+ * 初始缓冲区在线程首次使用时分配，由该线程首次写入，线程绑定 CPU 后位于本地 NUMA 节点
+ * （静态 thread_local 数组在创建线程时由父线程清零，会落在父线程的节点）
+ *
+ * 用法：在请求处理函数内构造于栈上，把 resource() 传给各 pmr 容器；
+ * 从分配区分配的对象不能逃逸出该作用域（写入存储前需拷贝为普通 std 类型）
+ */
+class RequestArena {
+public:
+    static constexpr std::size_t kInitialSize = 64 * 1024;
+
+    RequestArena()
+        : ownsBuffer_(!bufferInUse()),
+          resource_(ownsBuffer_ ? buffer() : fallback_, ownsBuffer_ ? kInitialSize : sizeof(fallback_),
+                    std::pmr::new_delete_resource()) {
+        if (ownsBuffer_) bufferInUse() = true;
+    }
+
+    ~RequestArena() {
+        resource_.release();
+        if (ownsBuffer_) bufferInUse() = false;
+    }
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &resource_; }
+
+private:
+    static char* buffer() {
+        static thread_local std::unique_ptr<char[]> buf(new char[kInitialSize]);
+        return buf.get();
+    }
+
+    // 同一线程上嵌套构造时，内层分配区不复用线程缓冲区
+    static bool& bufferInUse() {
+        static thread_local bool inUse = false;
+        return inUse;
+    }
+
+    bool ownsBuffer_;
+    alignas(std::max_align_t) char fallback_[256];
+    std::pmr::monotonic_buffer_resource resource_;
+};
@@ -0,0 +1,113 @@
+#include "ResponseCache.hpp"
+#include "Metrics.hpp"
+
+#include <functional>
+
+namespace {
+
+constexpr std::size_t kEntryOverhead = 96;  // 链表节点、哈希表节点等固定开销的估计值
+
+}  // namespace
+
+ResponseCache::ResponseCache(std::size_t maxBytes, std::size_t shardCount)
+    : shardCapacity_(maxBytes / (shardCount ? shardCount : 1)),
+      shards_(new Shard[shardCount ? shardCount : 1]),
+      shardCount_(shardCount ? shardCount : 1),
+      hits_(Metrics::getInstance().counter("device_server_response_cache_hits_total", "Response cache hits")),
+      misses_(Metrics::getInstance().counter("device_server_response_cache_misses_total",
+                                             "Response cache misses, including stale entries")),
+      evictions_(Metrics::getInstance().counter("device_server_response_cache_evictions_total",
+                                                "Response cache entries evicted by the memory cap")),
+      bytesGauge_(Metrics::getInstance().gauge("device_server_response_cache_bytes",
+                                               "Approximate memory held by the response cache")) {
+}
+
+std::size_t ResponseCache::entryBytes(const Entry& e) {
+    return e.key.size() + e.value.size() + kEntryOverhead;
+}
+
+ResponseCache::Shard& ResponseCache::shardFor(std::string_view key) {
+    return shards_[std::hash<std::string_view>()(key) % shardCount_];
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Entry>::iterator it) {
+    std::size_t size = entryBytes(*it);
+    shard.bytes -= size;
+    bytesGauge_.add(-static_cast<int64_t>(size));
+    shard.index.erase(std::string_view(it->key));
+    shard.lru.erase(it);
+}
+
+bool ResponseCache::get(std::string_view key, uint64_t version, std::pmr::string& out) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        misses_.inc();
+        return false;
+    }
+    auto it = found->second;
+    if (it->version != version) {
+        erase(shard, it);
+        misses_.inc();
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it);
+    out.append(it->value);
+    hits_.inc();
+    return true;
+}
+
+void ResponseCache::put(std::string_view key, uint64_t version, std::string_view value) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto found = shard.index.find(key);
+    if (found != shard.index.end()) {
+        // 并发生成的结果可能基于更旧的版本，不覆盖较新的记录
+        if (found->second->version > version) return;
+        erase(shard, found->second);
+    }
+    std::size_t capacity = shardCapacity_.load(std::memory_order_relaxed);
+    if (key.size() + value.size() + kEntryOverhead > capacity) return;
+
+    shard.lru.push_front(Entry{std::string(key), std::string(value), version});
+    shard.index.emplace(std::string_view(shard.lru.front().key), shard.lru.begin());
+    std::size_t size = entryBytes(shard.lru.front());
+    shard.bytes += size;
+    bytesGauge_.add(static_cast<int64_t>(size));
+    evict(shard, capacity);
+}
+
+void ResponseCache::evict(Shard& shard, std::size_t capacity) {
+    while (shard.bytes > capacity) {
+        erase(shard, std::prev(shard.lru.end()));
+        evictions_.inc();
+    }
+}
+
+void ResponseCache::setMaxBytes(std::size_t maxBytes) {
+    std::size_t capacity = maxBytes / shardCount_;
+    shardCapacity_.store(capacity, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < shardCount_; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        evict(shards_[i], capacity);
+    }
+}
+
+std::size_t ResponseCache::bytes() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shardCount_; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        total += shards_[i].bytes;
+    }
+    return total;
+}
+
+std::size_t ResponseCache::entries() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shardCount_; ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i].mtx);
+        total += shards_[i].lru.size();
+    }
+    return total;
+}
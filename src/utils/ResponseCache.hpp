@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class Counter;
+class Gauge;
+
+/**
+ * 已序列化响应的进程内缓存
+ * 键为规范化后的查询参数，值为可直接发送的响应体；每条记录带写入时的数据版本号，
+ * 读取时版本号与当前不一致即视为过期并删除，写入方只需递增版本号，无需逐条失效。
+ * 按键哈希分片，每个分片一把锁、一条 LRU 链表，总占用超过 maxBytes 时从各分片尾部淘汰
+ */
+class ResponseCache {
+public:
+    explicit ResponseCache(std::size_t maxBytes, std::size_t shardCount = 16);
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * 命中且版本号一致时把响应体追加到 out
+     * @return 是否命中
+     */
+    bool get(std::string_view key, uint64_t version, std::pmr::string& out);
+
+    /**
+     * 写入（覆盖同键旧值）；version 应为生成该响应之前读到的版本号，
+     * 生成期间发生的写入会使这条记录在下次读取时失效
+     */
+    void put(std::string_view key, uint64_t version, std::string_view value);
+
+    // 调整内存上限，超出部分立即从各分片尾部淘汰；0 表示不再缓存
+    void setMaxBytes(std::size_t maxBytes);
+
+    std::size_t bytes() const;
+    std::size_t entries() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::string value;
+        uint64_t version;
+    };
+
+    // 索引键指向链表节点中的 key，节点地址稳定
+    struct Shard {
+        std::mutex mtx;
+        std::list<Entry> lru;  // 头部为最近使用
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        std::size_t bytes = 0;
+    };
+
+    static std::size_t entryBytes(const Entry& e);
+    Shard& shardFor(std::string_view key);
+    void erase(Shard& shard, std::list<Entry>::iterator it);
+    // 从尾部淘汰直到不超过 capacity，调用方持有分片锁
+    void evict(Shard& shard, std::size_t capacity);
+
+    std::atomic<std::size_t> shardCapacity_;
+    std::unique_ptr<Shard[]> shards_;
+    std::size_t shardCount_;
+    Counter& hits_;
+    Counter& misses_;
+    Counter& evictions_;
+    Gauge& bytesGauge_;
+};
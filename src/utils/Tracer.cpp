@@ -0,0 +1,194 @@
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+std::atomic<uint32_t> Tracer::sampleEvery_{0};
+thread_local uint64_t Tracer::current_ = 0;
+
+namespace {
+
+constexpr std::size_t kRingCapacity = 4096;  // 每线程保留的 span 数（2 的幂）
+
+// seq 为 0 表示正在写入或从未写入，否则为写入序号 + 1
+struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> traceId{0};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct Ring {
+    uint32_t tid = 0;
+    std::string threadName;  // 受 Registry::mtx 保护
+    bool inUse = true;       // 受 Registry::mtx 保护，所属线程退出后为 false
+    uint64_t head = 0;       // 仅所属线程读写
+    Slot slots[kRingCapacity];
+};
+
+struct Registry {
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Ring>> rings;
+    uint32_t nextTid = 0;
+};
+
+// 线程退出后其缓冲区仍保留以便导出；进程退出时不析构，避免与仍在运行的线程竞争
+Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+// 本线程占用的缓冲区；线程退出时归还，由之后新建的线程复用，线程池扩缩容反复创建线程也不会持续增长
+struct RingLease {
+    Ring* ring = nullptr;
+    ~RingLease() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(registry().mtx);
+        ring->inUse = false;
+    }
+};
+
+Ring& localRing() {
+    thread_local RingLease lease;
+    if (!lease.ring) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        for (const auto& ring : reg.rings) {
+            if (ring->inUse) continue;
+            // 复用已退出线程的缓冲区：丢弃其记录，换新的 tid，避免旧记录归到新线程名下
+            for (Slot& slot : ring->slots) slot.seq.store(0, std::memory_order_relaxed);
+            ring->head = 0;
+            ring->inUse = true;
+            lease.ring = ring.get();
+            break;
+        }
+        if (!lease.ring) {
+            reg.rings.push_back(std::make_unique<Ring>());
+            lease.ring = reg.rings.back().get();
+        }
+        lease.ring->tid = ++reg.nextTid;
+        lease.ring->threadName = "thread-" + std::to_string(lease.ring->tid);
+    }
+    return *lease.ring;
+}
+
+struct Event {
+    uint32_t tid;
+    const char* name;
+    uint64_t traceId;
+    uint64_t start;
+    uint64_t end;
+};
+
+void appendMicros(std::string& out, uint64_t ns) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%llu.%03llu",
+                          static_cast<unsigned long long>(ns / 1000),
+                          static_cast<unsigned long long>(ns % 1000));
+    out.append(buf, static_cast<std::size_t>(n));
+}
+
+}  // namespace
+
+uint64_t Tracer::sampleSlow(uint32_t every) {
+    static std::atomic<uint64_t> requestCount{0};
+    uint64_t n = requestCount.fetch_add(1, std::memory_order_relaxed);
+    if (n % every != 0) return 0;
+    return n + 1;
+}
+
+void Tracer::record(const char* name, uint64_t traceId, uint64_t startNs, uint64_t endNs) {
+    if (traceId == 0) return;
+    Ring& ring = localRing();
+    uint64_t index = ring.head++;
+    Slot& slot = ring.slots[index & (kRingCapacity - 1)];
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.traceId.store(traceId, std::memory_order_relaxed);
+    slot.start.store(startNs, std::memory_order_relaxed);
+    slot.end.store(endNs, std::memory_order_relaxed);
+    slot.seq.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    Ring& ring = localRing();
+    std::lock_guard<std::mutex> lock(registry().mtx);
+    ring.threadName = name;
+}
+
+void Tracer::dumpChromeJson(std::string& out, double minDurationMs) {
+    std::vector<Event> events;
+    std::vector<std::pair<uint32_t, std::string>> threads;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mtx);
+        for (const auto& ring : reg.rings) {
+            threads.emplace_back(ring->tid, ring->threadName);
+            for (const Slot& slot : ring->slots) {
+                uint64_t seq = slot.seq.load(std::memory_order_acquire);
+                if (seq == 0) continue;
+                Event e{ring->tid,
+                        slot.name.load(std::memory_order_relaxed),
+                        slot.traceId.load(std::memory_order_relaxed),
+                        slot.start.load(std::memory_order_relaxed),
+                        slot.end.load(std::memory_order_relaxed)};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // 读取期间被覆盖则丢弃
+                if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+                events.push_back(e);
+            }
+        }
+    }
+
+    // 按请求首尾跨度过滤，便于只看慢请求
+    if (minDurationMs > 0) {
+        std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> extent;
+        for (const Event& e : events) {
+            auto [it, inserted] = extent.try_emplace(e.traceId, e.start, e.end);
+            if (!inserted) {
+                it->second.first = std::min(it->second.first, e.start);
+                it->second.second = std::max(it->second.second, e.end);
+            }
+        }
+        uint64_t minNs = static_cast<uint64_t>(minDurationMs * 1e6);
+        events.erase(std::remove_if(events.begin(), events.end(), [&](const Event& e) {
+            const auto& span = extent[e.traceId];
+            return span.second - span.first < minNs;
+        }), events.end());
+    }
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& [tid, name] : threads) {
+        if (!first) out += ',';
+        first = false;
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+        out += std::to_string(tid);
+        out += ",\"args\":{\"name\":\"";
+        out += name;
+        out += "\"}}";
+    }
+    for (const Event& e : events) {
+        if (!first) out += ',';
+        first = false;
+        out += "{\"name\":\"";
+        out += e.name;
+        out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        out += std::to_string(e.tid);
+        out += ",\"ts\":";
+        appendMicros(out, e.start);
+        out += ",\"dur\":";
+        appendMicros(out, e.end >= e.start ? e.end - e.start : 0);
+        out += ",\"args\":{\"trace_id\":";
+        out += std::to_string(e.traceId);
+        out += "}}";
+    }
+    out += "]}";
+}
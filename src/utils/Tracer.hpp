@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * 请求级追踪（导出为 Chrome trace_event JSON，可直接用 Perfetto / chrome://tracing 打开）
+ * 按采样率选中的请求在入口分配追踪 id，沿 epoll 线程 → 线程池 → 处理函数 → 存储传递
+ * （线程内用 thread_local 上下文，跨线程由调用方显式携带）；未采样的请求只付出一次
+ * thread_local 读取。每个线程把 span 写入自己的定长环形缓冲区，写满后覆盖最旧的记录，
+ * 导出时读取各线程缓冲区（seqlock 校验，不阻塞写入方）。线程退出后其缓冲区保留到被新线程复用。
+ * 编译时未定义 ENABLE_TRACING 则 TRACE_SPAN 为空、采样恒为关闭
+ */
+class Tracer {
+public:
+    static uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * 每 n 个请求采样 1 个；0 关闭，1 全部采样
+     */
+    static void setSampleEvery(uint32_t n) { sampleEvery_.store(n, std::memory_order_relaxed); }
+    static uint32_t getSampleEvery() { return sampleEvery_.load(std::memory_order_relaxed); }
+
+    /**
+     * 新请求到达时调用：按采样率返回追踪 id，未采样返回 0
+     */
+    static uint64_t sampleRequest() {
+#ifdef ENABLE_TRACING
+        uint32_t every = sampleEvery_.load(std::memory_order_relaxed);
+        if (every == 0) return 0;
+        return sampleSlow(every);
+#else
+        return 0;
+#endif
+    }
+
+    // 当前线程正在处理的追踪 id（0 表示未采样）
+    static uint64_t current() { return current_; }
+
+    /**
+     * 记录一个已结束的 span（start/end 取自 nowNs），traceId 为 0 时忽略；
+     * name 必须是静态字符串
+     */
+    static void record(const char* name, uint64_t traceId, uint64_t startNs, uint64_t endNs);
+
+    /**
+     * 为当前线程命名（导出为 thread_name 元数据），应在线程开始时调用
+     */
+    static void setThreadName(const std::string& name);
+
+    /**
+     * 导出为 Chrome trace JSON（追加到 out）
+     * @param minDurationMs 只导出首尾跨度不小于该值的请求，0 表示全部
+     */
+    static void dumpChromeJson(std::string& out, double minDurationMs = 0);
+
+    // 当前线程的追踪上下文：构造时切换，析构时恢复
+    class Scope {
+    public:
+        explicit Scope(uint64_t traceId) : saved_(current_) { current_ = traceId; }
+        ~Scope() { current_ = saved_; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        uint64_t saved_;
+    };
+
+private:
+    static uint64_t sampleSlow(uint32_t every);
+
+    static std::atomic<uint32_t> sampleEvery_;
+    static thread_local uint64_t current_;
+};
+
+// 作用域 span：当前线程处于采样请求中时记录构造到析构的耗时
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name)
+        : name_(name), traceId_(Tracer::current()), start_(traceId_ ? Tracer::nowNs() : 0) {}
+    ~TraceSpan() {
+        if (traceId_) Tracer::record(name_, traceId_, start_, Tracer::nowNs());
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    uint64_t traceId_;
+    uint64_t start_;
+};
+
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(name)
+#else
+#define TRACE_SPAN(name) do {} while (0)
+#endif